@@ -0,0 +1,848 @@
+/* Throughput and latency of every cipher and mode in the library, over
+ * message sizes from 16 bytes up to 64 MB, with warm and cold caches.
+ * The results are printed as one JSON document on stdout so that runs
+ * can be stored and compared across releases.
+ *
+ * Each result holds the message size, the best (warm) or median (cold)
+ * time of one call, and that time as cycles per byte and MB/s (10^6
+ * bytes per second).  The key setup benchmarks also give the number of
+ * keys set up per call and per second, and the bcrypt ones the number of
+ * passwords checked in the same fields.  sha256-multi hashes the message
+ * as independent pieces of up to SHA_MSG_SIZE bytes, SHA_BATCH to a call.
+ * Cycles come from the time stamp counter, which ticks at the nominal clock
+ * rate whatever the core is actually running at; they are null where there
+ * is none.
+ *
+ * warm: the call is made once before timing, then repeated back to back.
+ * cold: before every timed call the data and tables are pushed out of the
+ *     caches by writing to a buffer larger than the last level cache. */
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#include <ecrypt/bcrypt.h>
+#include <ecrypt/blowfish.h>
+#include <ecrypt/drbg.h>
+#include <ecrypt/gcm.h>
+#include <ecrypt/kdf.h>
+#include <ecrypt/ocb.h>
+#include <ecrypt/rijndael.h>
+#include <ecrypt/sha256.h>
+#include <ecrypt/xts.h>
+
+#define MIN_SIZE	(16)
+#define MAX_SIZE	(64 * 1024 * 1024)
+#define EVICT_SIZE	(64 * 1024 * 1024)
+#define WARM_SAMPLES	(5)
+#define COLD_SAMPLES	(11)
+#define KEY_BATCH	(8)
+#define KEY_MAX_SIZE	(64 * 1024)
+#define BCRYPT_COST	(5)
+#define BCRYPT_BATCH	(64)
+#define SHA_MSG_SIZE	(256)
+#define SHA_BATCH	(256)
+
+/* the command line, see usage() */
+struct options_t {
+    const char *filter;
+    size_t max_size;
+    double min_time;
+    int warm;
+    int cold;
+    int keybits;
+    uint32_t rounds;
+};
+
+/* whatever a benchmark needs between calls */
+struct state_t {
+    rijndael_ctx aes;
+    gcm_ctx gcm;
+    ocb_ctx ocb;
+    xts_ctx xts;
+    struct blowfish_context_t bf;
+    uint8_t iv[16];
+    uint8_t tag[GCM_TAG_LENGTH];
+    uint32_t rounds;
+    int keybits;
+    uint8_t keys[KEY_BATCH][32];	/* for the key setup benchmarks */
+    rijndael_ctx batch[KEY_BATCH];
+    struct blowfish_context_t bf_batch[KEY_BATCH];
+    char bcrypt[BCRYPT_HASH_LENGTH + 1];
+    struct bcrypt_batch_t jobs[BCRYPT_BATCH];
+    struct sha256_batch_t sha_jobs[SHA_BATCH];
+    uint8_t digests[SHA_BATCH][SHA256_DIGEST_LENGTH];
+};
+
+/* what a benchmark is run once per implementation of */
+#define BENCH_PORTABLE	(0)
+#define BENCH_AES	(1)
+#define BENCH_BLOWFISH	(2)
+#define BENCH_SHA256	(3)
+#define BENCH_SHA256_MULTI	(4)
+
+struct bench_t {
+    const char *name;
+    int impls;			/* BENCH_* */
+    void (*run)(struct state_t *st, uint8_t *buf, size_t len);
+    int keys;			/* one key, or password, per 16 bytes of len */
+};
+
+struct sample_t {
+    double ns;
+    double cycles;		/* < 0 without a cycle counter */
+};
+
+static uint8_t *evict_buf;
+
+static void
+bench_aes_ecb_encrypt(struct state_t *st, uint8_t *buf, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i += 16) {
+        rijndael_encrypt(&st->aes, buf + i, buf + i);
+    }
+}
+
+static void
+bench_aes_ecb_decrypt(struct state_t *st, uint8_t *buf, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i += 16) {
+        rijndael_decrypt(&st->aes, buf + i, buf + i);
+    }
+}
+
+static void
+bench_aes_cbc_encrypt(struct state_t *st, uint8_t *buf, size_t len)
+{
+    rijndael_encrypt_cbc(&st->aes, st->iv, buf, len, buf);
+}
+
+static void
+bench_aes_cbc_decrypt(struct state_t *st, uint8_t *buf, size_t len)
+{
+    rijndael_decrypt_cbc(&st->aes, st->iv, buf, len, buf);
+}
+
+static void
+bench_aes_ctr(struct state_t *st, uint8_t *buf, size_t len)
+{
+    rijndael_encrypt_ctr(&st->aes, st->iv, buf, len, buf);
+}
+
+static void
+bench_aes_ctr_mt(struct state_t *st, uint8_t *buf, size_t len)
+{
+    rijndael_encrypt_ctr_mt(&st->aes, st->iv, buf, len, buf, 0);
+}
+
+static void
+bench_aes_gcm_encrypt(struct state_t *st, uint8_t *buf, size_t len)
+{
+    gcm_encrypt(&st->gcm, st->iv, 12, NULL, 0, buf, len, buf, st->tag,
+        sizeof(st->tag));
+}
+
+static void
+bench_aes_ocb_encrypt(struct state_t *st, uint8_t *buf, size_t len)
+{
+    ocb_encrypt(&st->ocb, st->iv, 12, NULL, 0, buf, len, buf, st->tag,
+        sizeof(st->tag));
+}
+
+/* 4096 byte sectors, or one sector of len bytes below that */
+static void
+bench_aes_xts_encrypt(struct state_t *st, uint8_t *buf, size_t len)
+{
+    xts_encrypt_sectors(&st->xts, 0, len < 4096 ? len : 4096, buf, len, buf);
+}
+
+static void
+bench_aes_xts_decrypt(struct state_t *st, uint8_t *buf, size_t len)
+{
+    xts_decrypt_sectors(&st->xts, 0, len < 4096 ? len : 4096, buf, len, buf);
+}
+
+/* the key setup benchmarks key len / 16 times, KEY_BATCH keys round */
+static void
+bench_aes_key_setup(struct state_t *st, uint8_t *buf, size_t len)
+{
+    size_t i;
+
+    (void)buf;
+    for (i = 0; i < len / 16; i++) {
+        rijndael_set_key(&st->aes, st->keys[i % KEY_BATCH], st->keybits);
+    }
+}
+
+static void
+bench_aes_key_setup_enc(struct state_t *st, uint8_t *buf, size_t len)
+{
+    size_t i;
+
+    (void)buf;
+    for (i = 0; i < len / 16; i++) {
+        rijndael_set_key_enc_only(&st->aes, st->keys[i % KEY_BATCH],
+            st->keybits);
+    }
+}
+
+static void
+bench_aes_key_setup_multi(struct state_t *st, uint8_t *buf, size_t len)
+{
+    const uint8_t *keys[KEY_BATCH];
+    size_t i, n;
+
+    (void)buf;
+    for (i = 0; i < KEY_BATCH; i++) {
+        keys[i] = st->keys[i];
+    }
+    for (i = 0; i < len / 16; i += n) {
+        n = len / 16 - i < KEY_BATCH ? len / 16 - i : KEY_BATCH;
+        rijndael_init_enc_only_multi(st->batch, keys,
+            (uint32_t)st->keybits / 8, n);
+    }
+}
+
+/* a fresh key for every message: key setup plus len bytes of ECB */
+static void
+bench_aes_oneshot_encrypt(struct state_t *st, uint8_t *buf, size_t len)
+{
+    rijndael_encrypt_oneshot(st->keys[0], (uint32_t)st->keybits / 8, buf,
+        len, buf);
+}
+
+/* 128-bit Blowfish keys, one per 16 bytes of len */
+static void
+bench_blowfish_key_setup(struct state_t *st, uint8_t *buf, size_t len)
+{
+    size_t i;
+
+    (void)buf;
+    for (i = 0; i < len / 16; i++) {
+        blowfish_init(&st->bf_batch[i % KEY_BATCH], st->keys[i % KEY_BATCH],
+            16);
+    }
+}
+
+static void
+bench_blowfish_key_setup_multi(struct state_t *st, uint8_t *buf, size_t len)
+{
+    const uint8_t *keys[KEY_BATCH];
+    size_t i, n;
+
+    (void)buf;
+    for (i = 0; i < KEY_BATCH; i++) {
+        keys[i] = st->keys[i];
+    }
+    for (i = 0; i < len / 16; i += n) {
+        n = len / 16 - i < KEY_BATCH ? len / 16 - i : KEY_BATCH;
+        blowfish_init_multi(st->bf_batch, keys, 16, n);
+    }
+}
+
+static void
+bench_blowfish_ecb_encrypt(struct state_t *st, uint8_t *buf, size_t len)
+{
+    blowfish_encrypt_ecb(&st->bf, buf, len, buf);
+}
+
+static void
+bench_blowfish_ecb_decrypt(struct state_t *st, uint8_t *buf, size_t len)
+{
+    blowfish_decrypt_ecb(&st->bf, buf, len, buf);
+}
+
+static void
+bench_blowfish_cbc_encrypt(struct state_t *st, uint8_t *buf, size_t len)
+{
+    blowfish_encrypt(&st->bf, st->iv, buf, len, buf);
+}
+
+static void
+bench_blowfish_cbc_decrypt(struct state_t *st, uint8_t *buf, size_t len)
+{
+    blowfish_decrypt(&st->bf, st->iv, buf, len, buf);
+}
+
+static void
+bench_blowfish_cbc_decrypt_mt(struct state_t *st, uint8_t *buf, size_t len)
+{
+    blowfish_decrypt_mt(&st->bf, st->iv, buf, len, buf, 0);
+}
+
+static void
+bench_blowfish_ctr(struct state_t *st, uint8_t *buf, size_t len)
+{
+    blowfish_encrypt_ctr(&st->bf, st->iv, buf, len, buf);
+}
+
+static void
+bench_blowfish_ctr_mt(struct state_t *st, uint8_t *buf, size_t len)
+{
+    blowfish_ctr_at(&st->bf, st->iv, 0, buf, len, buf, 0);
+}
+
+/* len bytes from the calling thread's generator, IV-sized and up */
+static void
+bench_drbg_random(struct state_t *st, uint8_t *buf, size_t len)
+{
+    (void)st;
+    drbg_random(buf, len);
+}
+
+/* len is the length of the derived key; the password and salt are short */
+static void
+bench_pbkdf2(struct state_t *st, uint8_t *buf, size_t len)
+{
+    static const uint8_t pass[] = "password";
+    static const uint8_t salt[] = "NaCl, but not too much";
+
+    pbkdf2_hmac_sha256(pass, sizeof(pass) - 1, salt, sizeof(salt) - 1, buf,
+        len, st->rounds);
+}
+
+/* one message of len bytes */
+static void
+bench_sha256(struct state_t *st, uint8_t *buf, size_t len)
+{
+    struct sha256_context_t ctx;
+
+    sha256_init(&ctx);
+    sha256_update(&ctx, buf, len);
+    sha256_finalize(&ctx, st->digests[0]);
+}
+
+/* len bytes as messages of up to SHA_MSG_SIZE */
+static void
+bench_sha256_multi(struct state_t *st, uint8_t *buf, size_t len)
+{
+    size_t n, m;
+
+    while (len > 0) {
+        for (n = 0; n < SHA_BATCH && len > 0; n++) {
+            m = len < SHA_MSG_SIZE ? len : SHA_MSG_SIZE;
+            st->sha_jobs[n].msg = buf;
+            st->sha_jobs[n].len = m;
+            buf += m;
+            len -= m;
+        }
+        sha256_multi(st->sha_jobs, n);
+    }
+}
+
+static const uint8_t bcrypt_pass[] = "correct horse battery staple";
+
+/* one password per 16 bytes of len, one at a time */
+static void
+bench_bcrypt_verify(struct state_t *st, uint8_t *buf, size_t len)
+{
+    size_t i;
+
+    (void)buf;
+    for (i = 0; i < len / 16; i++) {
+        bcrypt_verify(bcrypt_pass, sizeof(bcrypt_pass) - 1, st->bcrypt);
+    }
+}
+
+/* and all of them in one call */
+static void
+bench_bcrypt_verify_batch(struct state_t *st, uint8_t *buf, size_t len)
+{
+    (void)buf;
+    bcrypt_verify_batch(st->jobs, len / 16, 0);
+}
+
+static const struct bench_t benches[] = {
+    { "aes-ecb-encrypt", BENCH_AES, bench_aes_ecb_encrypt, 0 },
+    { "aes-ecb-decrypt", BENCH_AES, bench_aes_ecb_decrypt, 0 },
+    { "aes-cbc-encrypt", BENCH_AES, bench_aes_cbc_encrypt, 0 },
+    { "aes-cbc-decrypt", BENCH_AES, bench_aes_cbc_decrypt, 0 },
+    { "aes-ctr", BENCH_AES, bench_aes_ctr, 0 },
+    { "aes-ctr-mt", BENCH_AES, bench_aes_ctr_mt, 0 },
+    { "aes-gcm-encrypt", BENCH_AES, bench_aes_gcm_encrypt, 0 },
+    { "aes-ocb-encrypt", BENCH_AES, bench_aes_ocb_encrypt, 0 },
+    { "aes-xts-encrypt", BENCH_AES, bench_aes_xts_encrypt, 0 },
+    { "aes-xts-decrypt", BENCH_AES, bench_aes_xts_decrypt, 0 },
+    { "aes-key-setup", BENCH_AES, bench_aes_key_setup, 1 },
+    { "aes-key-setup-enc", BENCH_AES, bench_aes_key_setup_enc, 1 },
+    { "aes-key-setup-multi", BENCH_AES, bench_aes_key_setup_multi, 1 },
+    { "aes-oneshot-encrypt", BENCH_AES, bench_aes_oneshot_encrypt, 0 },
+    { "blowfish-key-setup", BENCH_PORTABLE, bench_blowfish_key_setup, 1 },
+    { "blowfish-key-setup-multi", BENCH_PORTABLE,
+        bench_blowfish_key_setup_multi, 1 },
+    { "blowfish-ecb-encrypt", BENCH_BLOWFISH, bench_blowfish_ecb_encrypt, 0 },
+    { "blowfish-ecb-decrypt", BENCH_BLOWFISH, bench_blowfish_ecb_decrypt, 0 },
+    { "blowfish-cbc-encrypt", BENCH_PORTABLE, bench_blowfish_cbc_encrypt, 0 },
+    { "blowfish-cbc-decrypt", BENCH_BLOWFISH, bench_blowfish_cbc_decrypt, 0 },
+    { "blowfish-cbc-decrypt-mt", BENCH_BLOWFISH,
+        bench_blowfish_cbc_decrypt_mt, 0 },
+    { "blowfish-ctr", BENCH_BLOWFISH, bench_blowfish_ctr, 0 },
+    { "blowfish-ctr-mt", BENCH_BLOWFISH, bench_blowfish_ctr_mt, 0 },
+    { "bcrypt-verify", BENCH_PORTABLE, bench_bcrypt_verify, 1 },
+    { "bcrypt-verify-batch", BENCH_PORTABLE, bench_bcrypt_verify_batch, 1 },
+    { "drbg-random", BENCH_PORTABLE, bench_drbg_random, 0 },
+    { "sha256", BENCH_SHA256, bench_sha256, 0 },
+    { "sha256-multi", BENCH_SHA256_MULTI, bench_sha256_multi, 0 },
+    { "pbkdf2-hmac-sha256", BENCH_SHA256, bench_pbkdf2, 0 }
+};
+
+static double
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static double
+now_cycles(void)
+{
+#if defined(HAVE_TSC)
+    return (double)__rdtsc();
+#else
+    return -1.0;
+#endif
+}
+
+/* reps back to back calls, timed as one */
+static struct sample_t
+measure(const struct bench_t *b, struct state_t *st, uint8_t *buf,
+    size_t len, long reps)
+{
+    struct sample_t s;
+    double ns, cycles;
+    long i;
+
+    ns = now_ns();
+    cycles = now_cycles();
+    for (i = 0; i < reps; i++) {
+        b->run(st, buf, len);
+    }
+    s.cycles = now_cycles() - cycles;
+    s.ns = now_ns() - ns;
+
+    s.ns /= (double)reps;
+    s.cycles = cycles < 0.0 ? -1.0 : s.cycles / (double)reps;
+    return s;
+}
+
+/* best of WARM_SAMPLES runs that take about min_time between them */
+static struct sample_t
+run_warm(const struct bench_t *b, struct state_t *st, uint8_t *buf,
+    size_t len, double min_time)
+{
+    struct sample_t s, best;
+    long reps = 1;
+    int i;
+
+    b->run(st, buf, len);
+
+    /* enough calls per sample that the clock resolution does not matter */
+    for (;;) {
+        s = measure(b, st, buf, len, reps);
+        if (s.ns * (double)reps * WARM_SAMPLES >= min_time * 1e9 ||
+            reps >= (1L << 24)) {
+            break;
+        }
+        reps *= 2;
+    }
+
+    best = s;
+    for (i = 1; i < WARM_SAMPLES; i++) {
+        s = measure(b, st, buf, len, reps);
+        if (s.ns < best.ns) {
+            best = s;
+        }
+    }
+
+    return best;
+}
+
+static void
+evict(void)
+{
+    size_t i;
+
+    for (i = 0; i < EVICT_SIZE; i += 64) {
+        evict_buf[i]++;
+    }
+}
+
+static int
+cmp_sample(const void *a, const void *b)
+{
+    double x = ((const struct sample_t *)a)->ns;
+    double y = ((const struct sample_t *)b)->ns;
+
+    return (x > y) - (x < y);
+}
+
+/* median of COLD_SAMPLES single calls, each after evict() */
+static struct sample_t
+run_cold(const struct bench_t *b, struct state_t *st, uint8_t *buf,
+    size_t len)
+{
+    struct sample_t s[COLD_SAMPLES];
+    int i;
+
+    for (i = 0; i < COLD_SAMPLES; i++) {
+        evict();
+        s[i] = measure(b, st, buf, len, 1);
+    }
+
+    qsort(s, COLD_SAMPLES, sizeof(s[0]), cmp_sample);
+    return s[COLD_SAMPLES / 2];
+}
+
+static int first_result = 1;
+
+static void
+report(const struct bench_t *b, const char *impl, const char *cache,
+    size_t len, uint32_t rounds, struct sample_t s)
+{
+    printf("%s\n    {\"bench\": \"%s\", \"impl\": \"%s\", \"cache\": \"%s\", "
+        "\"bytes\": %lu, ", first_result ? "" : ",", b->name, impl, cache,
+        (unsigned long)len);
+    if (rounds != 0) {
+        printf("\"rounds\": %lu, ", (unsigned long)rounds);
+    }
+    printf("\"ns\": %.1f, ", s.ns);
+
+    if (s.cycles < 0.0) {
+        printf("\"cycles\": null, \"cycles_per_byte\": null, ");
+    } else {
+        printf("\"cycles\": %.0f, \"cycles_per_byte\": %.3f, ", s.cycles,
+            s.cycles / (double)len);
+    }
+    printf("\"mb_per_s\": %.2f", (double)len * 1e3 / s.ns);
+    if (b->keys) {
+        printf(", \"keys\": %lu, \"keys_per_s\": %.0f",
+            (unsigned long)(len / 16), (double)(len / 16) * 1e9 / s.ns);
+    }
+    printf("}");
+
+    first_result = 0;
+    fflush(stdout);
+}
+
+static int
+setup(struct state_t *st, const struct options_t *opt)
+{
+    uint8_t xkey[64];
+    int i;
+    static const uint8_t key[32] = {
+        0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe,
+        0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+        0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7,
+        0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4
+    };
+
+    memset(st->iv, 0xa5, sizeof(st->iv));
+    st->rounds = opt->rounds;
+    st->keybits = opt->keybits;
+    for (i = 0; i < KEY_BATCH * 32; i++) {
+        st->keys[i / 32][i % 32] = (uint8_t)(key[i % 32] + i / 32);
+    }
+
+    if (rijndael_init(&st->aes, key, opt->keybits / 8) != ECRYPT_NO_ERROR) {
+        return -1;
+    }
+    if (gcm_set_key(&st->gcm, key, opt->keybits / 8) != ECRYPT_NO_ERROR) {
+        return -1;
+    }
+    if (ocb_set_key(&st->ocb, key, opt->keybits / 8) != ECRYPT_NO_ERROR) {
+        return -1;
+    }
+    /* XTS takes two keys, the second here the first with its bits
+     * flipped; there is no XTS-AES-192 */
+    if (opt->keybits != 192) {
+        for (i = 0; i < opt->keybits / 8; i++) {
+            xkey[i] = key[i];
+            xkey[opt->keybits / 8 + i] = (uint8_t)~key[i];
+        }
+        if (xts_set_key(&st->xts, xkey, opt->keybits / 4) !=
+            ECRYPT_NO_ERROR) {
+            return -1;
+        }
+    }
+    if (blowfish_init(&st->bf, key, 16) != ECRYPT_NO_ERROR) {
+        return -1;
+    }
+    if (bcrypt_hash(bcrypt_pass, sizeof(bcrypt_pass) - 1, key, BCRYPT_COST,
+        st->bcrypt) != ECRYPT_NO_ERROR) {
+        return -1;
+    }
+    for (i = 0; i < BCRYPT_BATCH; i++) {
+        st->jobs[i].pass = bcrypt_pass;
+        st->jobs[i].pass_len = sizeof(bcrypt_pass) - 1;
+        st->jobs[i].hash = st->bcrypt;
+    }
+    for (i = 0; i < SHA_BATCH; i++) {
+        st->sha_jobs[i].digest = st->digests[i];
+    }
+
+    return 0;
+}
+
+static void
+run_bench(const struct bench_t *b, const char *impl, struct state_t *st,
+    uint8_t *buf, const struct options_t *opt)
+{
+    uint32_t rounds = 0;
+    size_t len, max = opt->max_size;
+
+    if (b->run == bench_pbkdf2) {
+        /* one to eight SHA-256 output blocks; the rounds are the cost */
+        rounds = st->rounds;
+        max = max < 256 ? max : 256;
+    } else if (b->run == bench_bcrypt_verify ||
+        b->run == bench_bcrypt_verify_batch) {
+        /* up to BCRYPT_BATCH passwords; the rounds are the cost */
+        rounds = (uint32_t)1 << BCRYPT_COST;
+        max = max < BCRYPT_BATCH * 16 ? max : BCRYPT_BATCH * 16;
+    } else if (b->keys) {
+        /* up to 4096 keys; more only repeats the same work */
+        max = max < KEY_MAX_SIZE ? max : KEY_MAX_SIZE;
+    }
+
+    for (len = MIN_SIZE; len <= max; len *= 4) {
+        if (opt->warm) {
+            report(b, impl, "warm", len, rounds,
+                run_warm(b, st, buf, len, opt->min_time));
+        }
+        if (opt->cold) {
+            report(b, impl, "cold", len, rounds,
+                run_cold(b, st, buf, len));
+        }
+    }
+}
+
+static size_t
+parse_size(const char *s)
+{
+    char *end;
+    unsigned long v = strtoul(s, &end, 10);
+
+    switch (*end) {
+    case 'k': case 'K':
+        return (size_t)v << 10;
+    case 'm': case 'M':
+        return (size_t)v << 20;
+    }
+
+    return (size_t)v;
+}
+
+static void
+usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-f filter] [-s max_size] [-t seconds] "
+        "[-k 128|192|256]\n\t[-r pbkdf2_rounds] [-w | -c]\n\n"
+        "\t-f\tonly benchmarks whose name contains filter\n"
+        "\t-s\tlargest message size, e.g. 4M (default 64M)\n"
+        "\t-t\ttime spent on each warm measurement (default 0.2)\n"
+        "\t-k\tAES key size (default 128)\n"
+        "\t-r\tPBKDF2 iteration count (default 1000)\n"
+        "\t-w\twarm caches only\n"
+        "\t-c\tcold caches only\n", argv0);
+}
+
+int main(int argc, char* argv[])
+{
+    static const int impls[] = {
+        RIJNDAEL_IMPL_TABLE, RIJNDAEL_IMPL_AESNI, RIJNDAEL_IMPL_VPERM,
+        RIJNDAEL_IMPL_VAES256, RIJNDAEL_IMPL_VAES512
+    };
+    static const int bf_impls[] = {
+        BLOWFISH_IMPL_SCALAR, BLOWFISH_IMPL_AVX2
+    };
+    static const int sha_impls[] = {
+        SHA256_IMPL_SCALAR, SHA256_IMPL_SHANI
+    };
+    static const int sha_multi_impls[] = {
+        SHA256_MULTI_SERIAL, SHA256_MULTI_AVX2, SHA256_MULTI_AVX512
+    };
+    struct options_t opt;
+    struct state_t *st;
+    uint8_t *buf;
+    size_t b, i, j;
+    char impl[32];
+
+    opt.filter = NULL;
+    opt.max_size = MAX_SIZE;
+    opt.min_time = 0.2;
+    opt.warm = 1;
+    opt.cold = 1;
+    opt.keybits = 128;
+    opt.rounds = 1000;
+
+    for (i = 1; i < (size_t)argc; i++) {
+        if (strcmp(argv[i], "-w") == 0) {
+            opt.cold = 0;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            opt.warm = 0;
+        } else if (i + 1 < (size_t)argc && strcmp(argv[i], "-f") == 0) {
+            opt.filter = argv[++i];
+        } else if (i + 1 < (size_t)argc && strcmp(argv[i], "-s") == 0) {
+            opt.max_size = parse_size(argv[++i]);
+        } else if (i + 1 < (size_t)argc && strcmp(argv[i], "-t") == 0) {
+            opt.min_time = atof(argv[++i]);
+        } else if (i + 1 < (size_t)argc && strcmp(argv[i], "-k") == 0) {
+            opt.keybits = atoi(argv[++i]);
+        } else if (i + 1 < (size_t)argc && strcmp(argv[i], "-r") == 0) {
+            opt.rounds = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((opt.keybits != 128 && opt.keybits != 192 && opt.keybits != 256) ||
+        opt.max_size < MIN_SIZE || opt.max_size > ((size_t)1 << 31) ||
+        opt.rounds == 0 || !(opt.min_time > 0.0)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    st = (struct state_t *)calloc(1, sizeof(*st));
+    buf = (uint8_t *)calloc(1, opt.max_size);
+    evict_buf = opt.cold ? (uint8_t *)calloc(1, EVICT_SIZE) : NULL;
+    if (st == NULL || buf == NULL || (opt.cold && evict_buf == NULL)) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("{\n  \"aes_key_bits\": %d,\n  \"cycle_counter\": %s,\n"
+        "  \"results\": [", opt.keybits,
+#if defined(HAVE_TSC)
+        "\"tsc\""
+#else
+        "null"
+#endif
+        );
+
+    for (b = 0; b < sizeof(benches) / sizeof(benches[0]); b++) {
+        if (opt.filter != NULL && strstr(benches[b].name, opt.filter) == NULL) {
+            continue;
+        }
+        if (opt.keybits == 192 && strstr(benches[b].name, "-xts-") != NULL) {
+            continue;
+        }
+
+        if (benches[b].impls == BENCH_PORTABLE) {
+            if (setup(st, &opt) != 0) {
+                fprintf(stderr, "key setup failed\n");
+                return EXIT_FAILURE;
+            }
+            run_bench(&benches[b], "portable", st, buf, &opt);
+            continue;
+        }
+
+        if (benches[b].impls == BENCH_BLOWFISH) {
+            if (setup(st, &opt) != 0) {
+                fprintf(stderr, "key setup failed\n");
+                return EXIT_FAILURE;
+            }
+            for (i = 0; i < sizeof(bf_impls) / sizeof(bf_impls[0]); i++) {
+                if (blowfish_select_impl(bf_impls[i]) == ECRYPT_NO_ERROR) {
+                    run_bench(&benches[b], blowfish_impl_name(), st, buf,
+                        &opt);
+                }
+            }
+            continue;
+        }
+
+        if (benches[b].impls == BENCH_SHA256) {
+            if (setup(st, &opt) != 0) {
+                fprintf(stderr, "key setup failed\n");
+                return EXIT_FAILURE;
+            }
+            for (i = 0; i < sizeof(sha_impls) / sizeof(sha_impls[0]); i++) {
+                if (sha256_select_impl(sha_impls[i]) == ECRYPT_NO_ERROR) {
+                    run_bench(&benches[b], sha256_impl_name(), st, buf,
+                        &opt);
+                }
+            }
+            sha256_select_impl(SHA256_IMPL_AUTO);
+            continue;
+        }
+
+        /* serially under each compression function, then in lanes */
+        if (benches[b].impls == BENCH_SHA256_MULTI) {
+            if (setup(st, &opt) != 0) {
+                fprintf(stderr, "key setup failed\n");
+                return EXIT_FAILURE;
+            }
+            for (i = 0; i < sizeof(sha_multi_impls) /
+                sizeof(sha_multi_impls[0]); i++) {
+                if (sha256_multi_select_impl(sha_multi_impls[i]) !=
+                    ECRYPT_NO_ERROR) {
+                    continue;
+                }
+                if (sha_multi_impls[i] != SHA256_MULTI_SERIAL) {
+                    run_bench(&benches[b], sha256_multi_impl_name(), st, buf,
+                        &opt);
+                    continue;
+                }
+                for (j = 0; j < sizeof(sha_impls) / sizeof(sha_impls[0]);
+                    j++) {
+                    if (sha256_select_impl(sha_impls[j]) == ECRYPT_NO_ERROR) {
+                        snprintf(impl, sizeof(impl), "serial/%s",
+                            sha256_impl_name());
+                        run_bench(&benches[b], impl, st, buf, &opt);
+                    }
+                }
+                sha256_select_impl(SHA256_IMPL_AUTO);
+            }
+            sha256_multi_select_impl(SHA256_MULTI_AUTO);
+            continue;
+        }
+
+        /* contexts stay with the implementation they were keyed with */
+        for (i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+            if (rijndael_select_impl(impls[i]) != ECRYPT_NO_ERROR) {
+                continue;
+            }
+            if (setup(st, &opt) != 0) {
+                fprintf(stderr, "key setup failed\n");
+                return EXIT_FAILURE;
+            }
+
+            if (benches[b].run == bench_aes_gcm_encrypt) {
+                snprintf(impl, sizeof(impl), "%s/%s",
+                    rijndael_impl_name(&st->aes), gcm_impl_name(&st->gcm));
+            } else {
+                snprintf(impl, sizeof(impl), "%s",
+                    rijndael_impl_name(&st->aes));
+            }
+            run_bench(&benches[b], impl, st, buf, &opt);
+        }
+    }
+
+    printf("\n  ]\n}\n");
+
+    rijndael_select_impl(RIJNDAEL_IMPL_AUTO);
+    blowfish_select_impl(BLOWFISH_IMPL_AUTO);
+    rijndael_release(&st->aes);
+    gcm_release(&st->gcm);
+    ocb_release(&st->ocb);
+    xts_release(&st->xts);
+    blowfish_end(&st->bf);
+    free(evict_buf);
+    free(buf);
+    free(st);
+
+    return EXIT_SUCCESS;
+}
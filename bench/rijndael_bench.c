@@ -0,0 +1,114 @@
+/* Single-block latency of the AES code, per implementation and key size.
+ * Every block is encrypted from the output of the one before, so the
+ * numbers are latency, not throughput.  "generic" goes through
+ * rijndaelEncrypt, which runs the block function with the round count
+ * passed at run time; "sized" is rijndael_encrypt on a context keyed with
+ * rijndael_set_key, which uses the copy specialised for its key size. */
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ecrypt/rijndael.h>
+
+#define BLOCKS		(1 << 16)
+#define RUNS		(50)
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* best of RUNS, in nanoseconds per block */
+static double
+time_generic(const uint32_t *rk, int Nr, uint8_t *block)
+{
+    double best = 0.0, t;
+    int run, i;
+
+    for (run = 0; run < RUNS; run++) {
+        t = now();
+        for (i = 0; i < BLOCKS; i++) {
+            rijndaelEncrypt(rk, Nr, block, block);
+        }
+        t = now() - t;
+        if (run == 0 || t < best) {
+            best = t;
+        }
+    }
+
+    return best * 1e9 / BLOCKS;
+}
+
+static double
+time_sized(rijndael_ctx *ctx, uint8_t *block)
+{
+    double best = 0.0, t;
+    int run, i;
+
+    for (run = 0; run < RUNS; run++) {
+        t = now();
+        for (i = 0; i < BLOCKS; i++) {
+            rijndael_encrypt(ctx, block, block);
+        }
+        t = now() - t;
+        if (run == 0 || t < best) {
+            best = t;
+        }
+    }
+
+    return best * 1e9 / BLOCKS;
+}
+
+int main(void)
+{
+    static const int impls[] = {
+        RIJNDAEL_IMPL_TABLE, RIJNDAEL_IMPL_AESNI, RIJNDAEL_IMPL_VPERM,
+        RIJNDAEL_IMPL_VAES256, RIJNDAEL_IMPL_VAES512
+    };
+    uint32_t rk[4*(AES_MAXROUNDS + 1)];
+    uint8_t key[32], block[16];
+    rijndael_ctx ctx;
+    double generic, sized;
+    size_t i;
+    int bits, Nr;
+
+    for (i = 0; i < sizeof(key); i++) {
+        key[i] = (uint8_t)(i * 7 + 1);
+    }
+    memset(block, 0, sizeof(block));
+
+    printf("%-8s %5s %12s %12s %8s\n", "impl", "key", "generic ns",
+        "sized ns", "speedup");
+
+    for (i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+        if (rijndael_select_impl(impls[i]) != ECRYPT_NO_ERROR) {
+            continue;
+        }
+
+        for (bits = 128; bits <= 256; bits += 64) {
+            Nr = rijndaelKeySetupEnc(rk, key, bits);
+            if (Nr == 0 || rijndael_set_key(&ctx, key, bits) != 0) {
+                fprintf(stderr, "key setup failed\n");
+                return EXIT_FAILURE;
+            }
+
+            generic = time_generic(rk, Nr, block);
+            sized = time_sized(&ctx, block);
+            printf("%-8s %5d %12.2f %12.2f %7.2fx\n",
+                rijndael_impl_name(&ctx), bits, generic, sized,
+                generic / sized);
+        }
+    }
+
+    rijndael_select_impl(RIJNDAEL_IMPL_AUTO);
+    rijndael_release(&ctx);
+
+    return EXIT_SUCCESS;
+}
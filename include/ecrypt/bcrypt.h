@@ -0,0 +1,102 @@
+#ifndef ECRYPT_BCRYPT_H
+#define ECRYPT_BCRYPT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "global.h"
+
+/* "$2b$", two cost digits, "$", 22 characters of salt and 31 of hash */
+#define BCRYPT_HASH_LENGTH		(60)
+
+/* raw salt bytes, before encoding */
+#define BCRYPT_SALT_LENGTH		(16)
+
+/* log2 of the number of key schedule rounds */
+#define BCRYPT_MIN_COST			(4)
+#define BCRYPT_MAX_COST			(31)
+
+/* bytes of password that count; the rest is ignored, as everywhere else */
+#define BCRYPT_MAX_PASSWORD		(72)
+
+/*
+* bcrypt (Provos and Mazieres, 1999): EksBlowfish, a Blowfish key schedule
+* made expensive on purpose, over the password and a 128-bit salt.  Hashes
+* are the usual modular crypt strings, "$2b$10$" then salt and hash in
+* bcrypt's own base64, and interoperate with OpenBSD and the libraries
+* derived from it.  "$2a$" and "$2y$" hashes are verified the same way as
+* "$2b$".
+*
+* The password is taken as a C string would be: its bytes followed by a
+* zero byte, and only the first BCRYPT_MAX_PASSWORD bytes of that are used.
+*/
+
+/* bcrypt_hash:
+ *
+ * description:
+ *     Hashes a password for storage.
+ *
+ * inputs:
+ *     pass: the password.
+ *     pass_len: length of pass in bytes.
+ *     salt: BCRYPT_SALT_LENGTH random bytes, or NULL to draw them from
+ *         drbg_random.  Use a new salt for every hash.
+ *     cost: BCRYPT_MIN_COST to BCRYPT_MAX_COST; every step doubles the
+ *         work.  Pick the largest the login path can afford, 10 or more.
+ *     out: receives the hash, BCRYPT_HASH_LENGTH characters plus a
+ *         terminating zero.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
+int bcrypt_hash(const uint8_t *pass, size_t pass_len, const uint8_t *salt,
+    int cost, char *out);
+
+/* bcrypt_verify:
+ *
+ * description:
+ *     Checks a password against a stored hash, comparing the result in
+ *     constant time.
+ *
+ * inputs:
+ *     pass: the password.
+ *     pass_len: length of pass in bytes.
+ *     hash: the stored hash, zero-terminated.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR if the password matches, ECRYPT_AUTH_FAILED if
+ *         it does not, or ECRYPT_INVALID_PARAMETERS if hash is not a
+ *         bcrypt hash.
+ *****************************************************************************/
+int bcrypt_verify(const uint8_t *pass, size_t pass_len, const char *hash);
+
+/* one password of a bcrypt_verify_batch call */
+struct bcrypt_batch_t {
+    const uint8_t *pass;
+    size_t pass_len;
+    const char *hash;		/* zero-terminated */
+    int result;			/* set to what bcrypt_verify would return */
+};
+
+/* bcrypt_verify_batch:
+ *
+ * description:
+ *     bcrypt_verify for n passwords at once, as after an outage when every
+ *     client logs in again.  The jobs are spread over worker threads, and
+ *     each thread runs the key schedules of up to four jobs side by side,
+ *     so that one job's chain of S-box lookups overlaps with the others'.
+ *     Jobs interleave only with neighbours of the same cost, so keep those
+ *     together.
+ *
+ * inputs:
+ *     jobs: n (password, hash) pairs; each job's result is filled in.
+ *     n: the number of jobs.
+ *     workers: number of threads to use, including the calling one.  0
+ *         means one per online processor.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR once every job has its result, or an error code
+ *         from global.h if the arguments are unusable.
+ *****************************************************************************/
+int bcrypt_verify_batch(struct bcrypt_batch_t *jobs, size_t n, int workers);
+
+#endif /* ECRYPT_BCRYPT_H */
@@ -4,17 +4,52 @@
 /* fixed width types are a must in this context */
 #include <stdint.h>
 #include <stdlib.h>
+#include <sys/uio.h>
 
 #include "global.h"
 
 #define BLOWFISH_P_LENGTH		(18)
 #define BLOWFISH_S_LENGTH		(1024)
 
+/* Implementations of the bulk functions, see blowfish_select_impl. */
+#define BLOWFISH_IMPL_AUTO		(0)
+#define BLOWFISH_IMPL_SCALAR		(1)
+#define BLOWFISH_IMPL_AVX2		(2)
+
 struct blowfish_context_t {
 	uint32_t P[BLOWFISH_P_LENGTH];
 	uint32_t S[BLOWFISH_S_LENGTH];
 };
 
+/* blowfish_select_impl:
+ *
+ * description:
+ *     Chooses the code used for ECB, CBC decryption and CTR, the modes
+ *     where blocks do not depend on each other.  By default
+ *     (BLOWFISH_IMPL_AUTO) eight blocks at a time are run through AVX2
+ *     registers, with the S-box lookups done by gather instructions, where
+ *     the processor has them; otherwise (BLOWFISH_IMPL_SCALAR) four blocks
+ *     are interleaved in plain C.  CBC encryption is serial whatever is
+ *     chosen.  Contexts are not tied to an implementation, and all of them
+ *     produce the same output, so this is only useful for testing and
+ *     benchmarking.  Not safe to call while other threads are encrypting.
+ *
+ * inputs:
+ *     impl: one of the BLOWFISH_IMPL_* values.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or ECRYPT_INVALID_PARAMETERS if the running
+ *         processor (or this build) cannot provide that implementation.
+ *****************************************************************************/
+int blowfish_select_impl(int impl);
+
+/* blowfish_impl_name:
+ *
+ * description:
+ *     Short name ("scalar", "avx2") of the implementation in use.
+ *****************************************************************************/
+const char* blowfish_impl_name(void);
+
 /* blowfish_end:
  *
  * description:
@@ -49,6 +84,29 @@ int blowfish_end(struct blowfish_context_t* context);
 int blowfish_init(struct blowfish_context_t* ctx, const uint8_t* key,
     uint32_t klen);
 
+/* blowfish_init_multi:
+ *
+ * description:
+ *     Keys n contexts, one key each, as n calls to blowfish_init would.
+ *     The key schedules run four at a time with their rounds interleaved,
+ *     so that each one's chain of S-box lookups overlaps with the others',
+ *     which makes this several times cheaper per key than keying the
+ *     contexts one by one.  For servers that set up a key per session and
+ *     can gather a few sessions before keying them.
+ *
+ * inputs:
+ *     ctx: an array of n pre-allocated contexts.
+ *     keys: n raw keys, all of length klen.
+ *     klen: length of each key in bytes; between 4 and 56.
+ *     n: the number of keys.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h, in which case
+ *         no context has been keyed.
+ *****************************************************************************/
+int blowfish_init_multi(struct blowfish_context_t* ctx,
+    const uint8_t* const* keys, uint32_t klen, size_t n);
+
 /* blowfish_decrypt:
  *
  * description:
@@ -67,7 +125,36 @@ int blowfish_init(struct blowfish_context_t* ctx, const uint8_t* key,
  *     int: error code.  If everything went well, should return BF_NO_ERROR
  *****************************************************************************/
 int blowfish_decrypt(struct blowfish_context_t* context, const uint8_t* iv, 
-    const uint8_t* ct, uint32_t ct_len, uint8_t* out);
+    const uint8_t* ct, size_t ct_len, uint8_t* out);
+
+/* blowfish_decrypt_mt:
+ *
+ * description:
+ *     blowfish_decrypt for large buffers, such as whole archives, spread
+ *     over several threads.  A CBC plaintext block only depends on two
+ *     ciphertext blocks, so the ciphertext is cut into one range per thread
+ *     (a multiple of 64 bytes), each started with the last ciphertext block
+ *     of the range before it.  The output is byte-for-byte what
+ *     blowfish_decrypt produces.  Buffers too small to be worth a thread
+ *     are processed on the calling thread.
+ *
+ * inputs:
+ *     context: a context created from the bf_init function; it is only
+ *         read, so sharing it between threads is safe.
+ *     iv: the initialization vector, 8 bytes.
+ *     ct: the ciphertext.
+ *     ct_len: the length of ct; ct_len % 8 == 0 is tested.
+ *     out: receives ct_len bytes of plaintext.  May be the same as ct.
+ *     workers: number of threads to use, including the calling one.  0
+ *         means one per online processor, 1 keeps it all on the caller.
+ *         No more than 64 are used.
+ *
+ * outputs:
+ *     int: error code.  If everything went well, returns ECRYPT_NO_ERROR.
+ *****************************************************************************/
+int blowfish_decrypt_mt(const struct blowfish_context_t* context,
+    const uint8_t* iv, const uint8_t* ct, size_t ct_len, uint8_t* out,
+    int workers);
 
 /* blowfish_encrypt:
  *
@@ -87,7 +174,7 @@ int blowfish_decrypt(struct blowfish_context_t* context, const uint8_t* iv,
  *     int: error code.  If everything went well, should return BF_NO_ERROR
  *****************************************************************************/
 int blowfish_encrypt(struct blowfish_context_t* context, const uint8_t* iv,
-    const uint8_t* pt, uint32_t pt_len, uint8_t* out);
+    const uint8_t* pt, size_t pt_len, uint8_t* out);
 
 /* blowfish_decrypt_ecb:
  *
@@ -106,7 +193,7 @@ int blowfish_encrypt(struct blowfish_context_t* context, const uint8_t* iv,
  *     int: error code.  If everything went well, should return BF_NO_ERROR
  *****************************************************************************/
 int blowfish_decrypt_ecb(struct blowfish_context_t* context, const uint8_t* ct,
-    uint32_t ct_len, uint8_t* out);
+    size_t ct_len, uint8_t* out);
 
 /* blowfish_encrypt_ecb:
  *
@@ -125,6 +212,165 @@ int blowfish_decrypt_ecb(struct blowfish_context_t* context, const uint8_t* ct,
  *     int: error code.  If everything went well, should return BF_NO_ERROR
  *****************************************************************************/
 int blowfish_encrypt_ecb(struct blowfish_context_t* context, const uint8_t* pt,
-  uint32_t pt_len, uint8_t* out);
+  size_t pt_len, uint8_t* out);
+
+/* blowfish_decrypt_iov:
+ *
+ * description:
+ *     blowfish_decrypt over a message held in several buffers.  See
+ *     blowfish_encrypt_iov.
+ *****************************************************************************/
+int blowfish_decrypt_iov(struct blowfish_context_t* context,
+    const uint8_t* iv, const struct iovec* ct, int ct_cnt,
+    const struct iovec* out, int out_cnt);
+
+/* blowfish_encrypt_iov:
+ *
+ * description:
+ *     blowfish_encrypt over a message held in several buffers, without
+ *     gathering it into one first.  Segments may be any length; a block
+ *     that straddles two of them is handled internally.
+ *
+ * inputs:
+ *     context: a context created from the bf_init function.
+ *     iv: the initialization vector, 8 bytes.
+ *     pt: pt_cnt segments of plaintext; together a multiple of 8 bytes.
+ *     out: out_cnt segments for the ciphertext, adding up to the same
+ *         length as pt but not necessarily cut in the same places.  May be
+ *         the same memory as pt.
+ *
+ * outputs:
+ *     int: error code.  If everything went well, returns ECRYPT_NO_ERROR.
+ *****************************************************************************/
+int blowfish_encrypt_iov(struct blowfish_context_t* context,
+    const uint8_t* iv, const struct iovec* pt, int pt_cnt,
+    const struct iovec* out, int out_cnt);
+
+/* blowfish_decrypt_ctr:
+ *
+ * description:
+ *     Same as blowfish_encrypt_ctr; CTR is its own inverse.
+ *****************************************************************************/
+int blowfish_decrypt_ctr(const struct blowfish_context_t* context,
+    const uint8_t* iv, const uint8_t* ct, size_t ct_len, uint8_t* out);
+
+/* blowfish_encrypt_ctr:
+ *
+ * description:
+ *     Encrypts using CTR mode.  The 8 byte counter block is incremented as
+ *     one 64-bit big-endian number after each block, the same as in
+ *     BLOWFISH_STREAM_CTR.  Blowfish's 64-bit block makes counter
+ *     collisions likely long before the counter runs out; keep a key to
+ *     well under 2^32 blocks (32 GB) in total.
+ *
+ * inputs:
+ *     context: a context created from the bf_init function.
+ *     iv: the initial counter block, 8 bytes.  Never reuse a counter value
+ *         under the same key.
+ *     pt: the plaintext.  No padding is needed.
+ *     pt_len: length of pt in bytes; any length is fine.
+ *     out: receives pt_len bytes of ciphertext.  May be the same as pt.
+ *
+ * outputs:
+ *     int: error code.  If everything went well, returns ECRYPT_NO_ERROR.
+ *****************************************************************************/
+int blowfish_encrypt_ctr(const struct blowfish_context_t* context,
+    const uint8_t* iv, const uint8_t* pt, size_t pt_len, uint8_t* out);
+
+/* blowfish_ctr_at:
+ *
+ * description:
+ *     Encrypts or decrypts len bytes that start offset bytes into a CTR
+ *     message, giving exactly the bytes blowfish_encrypt_ctr would give for
+ *     that range of the whole message.  The counter for the range is
+ *     computed directly, so reading the end of a large object costs no more
+ *     than reading its start.  Large ranges are split over several threads,
+ *     each jumping to its own counter; ranges too small to be worth a
+ *     thread are processed on the calling thread.
+ *
+ * inputs:
+ *     context: a context created from the bf_init function; it is only
+ *         read, so sharing it between threads is safe.
+ *     iv: the initial counter block of the message, 8 bytes.
+ *     offset: position of in within the message, in bytes.
+ *     in: the plaintext or ciphertext.
+ *     len: length of in in bytes; any length is fine.
+ *     out: receives len bytes.  May be the same as in.
+ *     workers: number of threads to use, including the calling one.  0
+ *         means one per online processor, 1 keeps it all on the caller.
+ *
+ * outputs:
+ *     int: error code.  If everything went well, returns ECRYPT_NO_ERROR.
+ *****************************************************************************/
+int blowfish_ctr_at(const struct blowfish_context_t* context,
+    const uint8_t* iv, uint64_t offset, const uint8_t* in, size_t len,
+    uint8_t* out, int workers);
+
+/* What a blowfish_stream_t does, see blowfish_stream_init. */
+#define BLOWFISH_STREAM_CBC_ENCRYPT	(1)
+#define BLOWFISH_STREAM_CBC_DECRYPT	(2)
+#define BLOWFISH_STREAM_CTR		(3)
+
+/* Padding for the CBC streams. */
+#define BLOWFISH_PAD_NONE		(0)
+#define BLOWFISH_PAD_PKCS7		(1)
+
+/* CBC or CTR over a message that arrives in pieces; the same as
+ * rijndael_stream_t, with 8 byte blocks.  The CTR counter is the whole 8
+ * byte block, incremented as one 64-bit big-endian number. */
+struct blowfish_stream_t {
+	const struct blowfish_context_t* ctx;
+	int mode;
+	int pad;
+	unsigned int pos;
+	uint8_t iv[8];
+	uint8_t buf[8];
+};
+
+/* blowfish_stream_init:
+ *
+ * description:
+ *     Starts a stream.  See rijndael_stream_init.
+ *
+ * inputs:
+ *     s: a pre-allocated stream.
+ *     ctx: a context created from the blowfish_init function.  Not copied,
+ *         so it has to outlive the stream.
+ *     mode: BLOWFISH_STREAM_CBC_ENCRYPT, BLOWFISH_STREAM_CBC_DECRYPT or
+ *         BLOWFISH_STREAM_CTR.
+ *     pad: BLOWFISH_PAD_PKCS7 or BLOWFISH_PAD_NONE; ignored for CTR.
+ *     iv: the initialization vector or initial counter block, 8 bytes.
+ *
+ * outputs:
+ *     int: error code.  If everything went well, returns ECRYPT_NO_ERROR.
+ *****************************************************************************/
+int blowfish_stream_init(struct blowfish_stream_t* s,
+    const struct blowfish_context_t* ctx, int mode, int pad,
+    const uint8_t* iv);
+
+/* blowfish_stream_update:
+ *
+ * description:
+ *     Processes the next piece of the message.  See rijndael_stream_update;
+ *     out needs room for in_len + 7 bytes.
+ *
+ * outputs:
+ *     int: error code.  If everything went well, returns ECRYPT_NO_ERROR.
+ *****************************************************************************/
+int blowfish_stream_update(struct blowfish_stream_t* s, const uint8_t* in,
+    size_t in_len, uint8_t* out, size_t* out_len);
+
+/* blowfish_stream_final:
+ *
+ * description:
+ *     Finishes and clears the stream, writing at most 8 bytes to out.  See
+ *     rijndael_stream_final.
+ *
+ * outputs:
+ *     int: error code.  ECRYPT_INVALID_PADDING if the padding is not valid
+ *         PKCS #7.  If everything went well, returns ECRYPT_NO_ERROR.
+ *****************************************************************************/
+int blowfish_stream_final(struct blowfish_stream_t* s, uint8_t* out,
+    size_t* out_len);
 
 #endif /* ECRYPT_BLOWFISH_H */
@@ -0,0 +1,124 @@
+#ifndef ECRYPT_DRBG_H
+#define ECRYPT_DRBG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "global.h"
+#include "rijndael.h"
+
+/* seedlen of CTR_DRBG with AES-256: one key plus one block */
+#define DRBG_SEED_LENGTH		(48)
+
+/* the most one drbg_generate call may return (2^19 bits) */
+#define DRBG_MAX_REQUEST		(65536)
+
+/* generate calls between reseeds; SP 800-90A allows up to 2^48 */
+#define DRBG_RESEED_INTERVAL		(1 << 20)
+
+/* bytes drbg_random produces per refill of a thread's buffer */
+#define DRBG_BUFFER_LENGTH		(4096)
+
+/*
+* CTR_DRBG (NIST SP 800-90A) with AES-256 and no derivation function.  The
+* entropy input is full-entropy, straight from getrandom (or /dev/urandom
+* where that is missing), so the derivation function is not needed.
+*
+* Most code wants drbg_random, which keeps one generator per thread and
+* needs no context.  A drbg_ctx of one's own is for deterministic use,
+* such as known answer tests.  A context must not be used by two threads
+* at once.
+*/
+typedef struct drbg_ctx_t {
+    rijndael_ctx aes;		/* encrypt-only, keyed with Key */
+    uint8_t ctr[16];		/* V + 1, the next counter block */
+    uint64_t reseed_counter;	/* generate calls since the last reseed */
+    int instantiated;
+} drbg_ctx;
+
+/* drbg_instantiate:
+ *
+ * description:
+ *     Seeds ctx.
+ *
+ * inputs:
+ *     ctx: a pre-allocated context.
+ *     entropy: DRBG_SEED_LENGTH bytes of entropy input, or NULL to read
+ *         them from the operating system.
+ *     entropy_len: length of entropy; DRBG_SEED_LENGTH, or 0 with NULL.
+ *     pers: personalization string, such as a device serial number.  May
+ *         be NULL if pers_len is 0.
+ *     pers_len: length of pers, at most DRBG_SEED_LENGTH.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, ECRYPT_NO_ENTROPY if the operating system had
+ *         no entropy to give, or another error code from global.h.
+ *****************************************************************************/
+int drbg_instantiate(drbg_ctx *ctx, const uint8_t *entropy,
+    size_t entropy_len, const uint8_t *pers, size_t pers_len);
+
+/* drbg_reseed:
+ *
+ * description:
+ *     Mixes fresh entropy into ctx.  drbg_generate does this by itself
+ *     every DRBG_RESEED_INTERVAL calls.
+ *
+ * inputs:
+ *     ctx: an instantiated context.
+ *     entropy, entropy_len: as for drbg_instantiate.
+ *     adin: additional input.  May be NULL if adin_len is 0.
+ *     adin_len: length of adin, at most DRBG_SEED_LENGTH.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code as for drbg_instantiate.
+ *****************************************************************************/
+int drbg_reseed(drbg_ctx *ctx, const uint8_t *entropy, size_t entropy_len,
+    const uint8_t *adin, size_t adin_len);
+
+/* drbg_generate:
+ *
+ * description:
+ *     Produces len random bytes.  The key and V are replaced before this
+ *     returns, so the output cannot be worked out again from the state
+ *     left in ctx.
+ *
+ * inputs:
+ *     ctx: an instantiated context.
+ *     out: receives len bytes.
+ *     len: at most DRBG_MAX_REQUEST.
+ *     adin: additional input.  May be NULL if adin_len is 0.
+ *     adin_len: length of adin, at most DRBG_SEED_LENGTH.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
+int drbg_generate(drbg_ctx *ctx, uint8_t *out, size_t len,
+    const uint8_t *adin, size_t adin_len);
+
+/* drbg_release:
+ *
+ * description:
+ *     Clears the state out of ctx.
+ *****************************************************************************/
+int drbg_release(drbg_ctx *ctx);
+
+/* drbg_random:
+ *
+ * description:
+ *     Fills out with random bytes for keys, IVs, nonces and salts.  Each
+ *     thread has its own generator, seeded from the operating system the
+ *     first time the thread asks and again after a fork.  Output is
+ *     generated DRBG_BUFFER_LENGTH bytes at a time, so a short request is
+ *     usually a copy out of the thread's buffer, which is wiped as it is
+ *     handed out.
+ *
+ * inputs:
+ *     out: receives len bytes.
+ *     len: any length.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or ECRYPT_NO_ENTROPY if the generator could not
+ *         be seeded; out is zeroed in that case.
+ *****************************************************************************/
+int drbg_random(uint8_t *out, size_t len);
+
+#endif /* ECRYPT_DRBG_H */
@@ -0,0 +1,224 @@
+#ifndef ECRYPT_GCM_H
+#define ECRYPT_GCM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "global.h"
+#include "rijndael.h"
+
+/* GHASH implementations, see gcm_select_impl. */
+#define GCM_IMPL_AUTO			(0)
+#define GCM_IMPL_TABLE			(1)
+#define GCM_IMPL_PCLMUL			(2)
+#define GCM_IMPL_AESNI			(3)
+#define GCM_IMPL_VAES			(4)
+
+#define GCM_BLOCK_LENGTH		(16)
+#define GCM_TAG_LENGTH			(16)
+
+/* private to the library; the GHASH functions a context was keyed for */
+struct gcm_impl_t;
+
+/*
+* AES-GCM (NIST SP 800-38D).  A context is keyed once with gcm_set_key and
+* can then be used for any number of messages, one at a time:
+*
+*     gcm_init, gcm_aad (any number of times), gcm_encrypt_update (any
+*     number of times), gcm_encrypt_final
+*
+* and the same with the decrypt functions.  Data may be split at any byte
+* boundary between calls.
+*/
+typedef struct gcm_ctx_t {
+    rijndael_ctx aes;		/* encrypt-only key schedule */
+    uint64_t Htable[16][2];	/* multiples or powers of the hash key */
+    uint8_t J0[16];		/* pre-counter block, masks the tag */
+    uint8_t ctr[16];		/* next counter block */
+    uint8_t X[16];		/* running GHASH value */
+    uint8_t ks[16];		/* keystream of the current partial block */
+    uint64_t aad_len;		/* bytes of AAD hashed so far */
+    uint64_t text_len;		/* bytes of text processed so far */
+    unsigned int pos;		/* bytes used of the current block */
+    int state;			/* where in a message the context is */
+    const struct gcm_impl_t *impl;	/* set by gcm_set_key */
+} gcm_ctx;
+
+/* gcm_select_impl:
+ *
+ * description:
+ *     Chooses the GHASH code used by contexts keyed from now on.  By
+ *     default (GCM_IMPL_AUTO) PCLMULQDQ is used where available, stitched
+ *     into the AES-NI counter mode code (GCM_IMPL_AESNI) when the block
+ *     cipher is AES-NI too, or VPCLMULQDQ stitched into the VAES code
+ *     (GCM_IMPL_VAES) when the block cipher is one of the VAES
+ *     implementations; the register width follows the block cipher's.
+ *     The portable 4-bit table code is the last
+ *     resort; note that it is not constant-time.  Only useful for testing
+ *     and benchmarking, from a single thread.
+ *
+ * inputs:
+ *     impl: one of the GCM_IMPL_* values.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or ECRYPT_INVALID_PARAMETERS if the running
+ *         processor (or this build) cannot provide that implementation.
+ *****************************************************************************/
+int gcm_select_impl(int impl);
+
+/* gcm_impl_name:
+ *
+ * description:
+ *     Short name ("table", "pclmul", "aesni", "vaes-avx2", "vaes-avx512")
+ *     of the GHASH implementation ctx was keyed with, or of the one
+ *     gcm_set_key would prefer if ctx is NULL.
+ *****************************************************************************/
+const char *gcm_impl_name(const gcm_ctx *ctx);
+
+/* gcm_set_key:
+ *
+ * description:
+ *     Keys ctx with an encrypt-only AES schedule (GCM never runs the
+ *     inverse cipher) and derives the GHASH tables from it.
+ *
+ * inputs:
+ *     ctx: a pre-allocated context.
+ *     key: the raw AES key.
+ *     klen: length of key in bytes; 16, 24 or 32.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
+int gcm_set_key(gcm_ctx *ctx, const uint8_t *key, uint32_t klen);
+
+/* gcm_release:
+ *
+ * description:
+ *     Clears the key material and all message state out of ctx.
+ *****************************************************************************/
+int gcm_release(gcm_ctx *ctx);
+
+/* gcm_init:
+ *
+ * description:
+ *     Starts a new message, abandoning any message in progress.  Never use
+ *     an IV twice with the same key.
+ *
+ * inputs:
+ *     ctx: a context keyed with gcm_set_key.
+ *     iv: the initialization vector.
+ *     iv_len: length of iv in bytes, at least 1.  12 is the recommended,
+ *         and fastest, size; others are hashed into a counter block.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
+int gcm_init(gcm_ctx *ctx, const uint8_t *iv, size_t iv_len);
+
+/* gcm_aad:
+ *
+ * description:
+ *     Feeds additional authenticated data into the current message.  All
+ *     of it has to come before the first update call.
+ *
+ * inputs:
+ *     ctx: a context started with gcm_init.
+ *     aad: the data; authenticated, but not encrypted.
+ *     aad_len: length of aad in bytes.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or ECRYPT_INVALID_PARAMETERS if the message
+ *         has not been started or is already past its AAD.
+ *****************************************************************************/
+int gcm_aad(gcm_ctx *ctx, const uint8_t *aad, size_t aad_len);
+
+/* gcm_encrypt_update:
+ *
+ * description:
+ *     Encrypts the next part of the message.  Output is produced
+ *     immediately, byte for byte, so nothing is held back between calls.
+ *
+ * inputs:
+ *     ctx: a context started with gcm_init.
+ *     pt: the plaintext.
+ *     pt_len: length of pt in bytes.  A message holds at most 2^36 - 32
+ *         bytes in total.
+ *     out: receives pt_len bytes of ciphertext.  May be the same as pt.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
+int gcm_encrypt_update(gcm_ctx *ctx, const uint8_t *pt, size_t pt_len,
+    uint8_t *out);
+
+/* gcm_encrypt_final:
+ *
+ * description:
+ *     Finishes the message and produces its authentication tag.
+ *
+ * inputs:
+ *     ctx: a context started with gcm_init.
+ *     tag: receives the tag.
+ *     tag_len: bytes of tag wanted; 4, 8, or 12 to 16.  Use 16 unless the
+ *         protocol says otherwise.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
+int gcm_encrypt_final(gcm_ctx *ctx, uint8_t *tag, size_t tag_len);
+
+/* gcm_decrypt_update:
+ *
+ * description:
+ *     Decrypts the next part of the message.  The plaintext is not
+ *     authentic until gcm_decrypt_final says so; do not act on it before.
+ *
+ * inputs:
+ *     ctx: a context started with gcm_init.
+ *     ct: the ciphertext.
+ *     ct_len: length of ct in bytes.
+ *     out: receives ct_len bytes of plaintext.  May be the same as ct.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
+int gcm_decrypt_update(gcm_ctx *ctx, const uint8_t *ct, size_t ct_len,
+    uint8_t *out);
+
+/* gcm_decrypt_final:
+ *
+ * description:
+ *     Finishes the message and checks its tag, in constant time.
+ *
+ * inputs:
+ *     ctx: a context started with gcm_init.
+ *     tag: the tag received with the message.
+ *     tag_len: length of tag; see gcm_encrypt_final.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR if the message is authentic, ECRYPT_AUTH_FAILED
+ *         if it is not, or another error code from global.h.
+ *****************************************************************************/
+int gcm_decrypt_final(gcm_ctx *ctx, const uint8_t *tag, size_t tag_len);
+
+/* gcm_encrypt:
+ *
+ * description:
+ *     A whole message in one call: gcm_init, gcm_aad, gcm_encrypt_update
+ *     and gcm_encrypt_final.
+ *****************************************************************************/
+int gcm_encrypt(gcm_ctx *ctx, const uint8_t *iv, size_t iv_len,
+    const uint8_t *aad, size_t aad_len, const uint8_t *pt, size_t pt_len,
+    uint8_t *out, uint8_t *tag, size_t tag_len);
+
+/* gcm_decrypt:
+ *
+ * description:
+ *     A whole message in one call: gcm_init, gcm_aad, gcm_decrypt_update
+ *     and gcm_decrypt_final.  If the tag does not match, out is zeroed
+ *     before ECRYPT_AUTH_FAILED is returned.
+ *****************************************************************************/
+int gcm_decrypt(gcm_ctx *ctx, const uint8_t *iv, size_t iv_len,
+    const uint8_t *aad, size_t aad_len, const uint8_t *ct, size_t ct_len,
+    uint8_t *out, const uint8_t *tag, size_t tag_len);
+
+#endif /* ECRYPT_GCM_H */
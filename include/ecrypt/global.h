@@ -6,6 +6,9 @@
 #define ECRYPT_INVALID_LENGTH		(2)
 #define ECRYPT_NULL_PTR			(3)
 #define ECRYPT_INVALID_PARAMETERS	(4)
+#define ECRYPT_AUTH_FAILED		(5)
+#define ECRYPT_NO_ENTROPY		(6)
+#define ECRYPT_INVALID_PADDING		(7)
 
 #define AES_MAXKEYBITS			(256)
 #define AES_MAXKEYBYTES			(AES_MAXKEYBITS/8)
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 
 #include "global.h"
+#include "sha256.h"
 
 /* pbkdf2_hmac_sha256
  *
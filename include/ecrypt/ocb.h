@@ -0,0 +1,103 @@
+#ifndef ECRYPT_OCB_H
+#define ECRYPT_OCB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "global.h"
+#include "rijndael.h"
+
+#define OCB_BLOCK_LENGTH		(16)
+#define OCB_TAG_LENGTH			(16)
+#define OCB_MAX_NONCE_LENGTH		(15)
+
+/* L_i for i up to this, enough for any message that fits in memory */
+#define OCB_L_COUNT			(64)
+
+/*
+* AES-OCB3 (RFC 7253).  Each block is encrypted independently under its
+* own offset and the plaintext is authenticated with a plain XOR checksum,
+* so a message costs one AES call per block plus a few more per message,
+* and nothing besides AES has to be fast.  A context is keyed once with
+* ocb_set_key and can then be used for any number of messages.
+* ocb_encrypt and ocb_decrypt only read it, so one keyed context may be
+* shared between threads.
+*
+* Never use a nonce twice with the same key.
+*/
+typedef struct ocb_ctx_t {
+    rijndael_ctx aes;		/* both schedules; decryption runs AES^-1 */
+    uint8_t L_star[16];		/* E(0) */
+    uint8_t L_dollar[16];	/* double(L_star) */
+    uint8_t L[OCB_L_COUNT][16];	/* L_0 = double(L_dollar), doubled on */
+} ocb_ctx;
+
+/* ocb_set_key:
+ *
+ * description:
+ *     Keys ctx and works out the L table, once per key.
+ *
+ * inputs:
+ *     ctx: a pre-allocated context.
+ *     key: the raw AES key.
+ *     klen: length of key in bytes; 16, 24 or 32.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
+int ocb_set_key(ocb_ctx *ctx, const uint8_t *key, uint32_t klen);
+
+/* ocb_release:
+ *
+ * description:
+ *     Clears the key material out of ctx.
+ *****************************************************************************/
+int ocb_release(ocb_ctx *ctx);
+
+/* ocb_encrypt:
+ *
+ * description:
+ *     Encrypts and authenticates a whole message.  Blocks are processed
+ *     several at a time, interleaved through the AES code.
+ *
+ * inputs:
+ *     ctx: a context keyed with ocb_set_key.
+ *     nonce: the nonce.
+ *     nonce_len: length of nonce in bytes, 1 to OCB_MAX_NONCE_LENGTH; 12
+ *         is the usual size.
+ *     aad: data that is authenticated, but not encrypted.  May be NULL if
+ *         aad_len is 0.
+ *     aad_len: length of aad in bytes.
+ *     pt: the plaintext.  May be NULL if pt_len is 0.
+ *     pt_len: length of pt in bytes.
+ *     out: receives pt_len bytes of ciphertext.  May be the same as pt.
+ *     tag: receives the tag.
+ *     tag_len: length of tag, 1 to OCB_TAG_LENGTH.  The tag length is
+ *         part of the nonce, so both sides have to agree on it.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
+int ocb_encrypt(ocb_ctx *ctx, const uint8_t *nonce, size_t nonce_len,
+    const uint8_t *aad, size_t aad_len, const uint8_t *pt, size_t pt_len,
+    uint8_t *out, uint8_t *tag, size_t tag_len);
+
+/* ocb_decrypt:
+ *
+ * description:
+ *     Decrypts a whole message and checks its tag, in constant time.  If
+ *     the tag does not match, out is zeroed before ECRYPT_AUTH_FAILED is
+ *     returned.
+ *
+ * inputs:
+ *     The same as ocb_encrypt, with the ciphertext in ct and the tag that
+ *     came with it in tag.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR if the message is authentic, ECRYPT_AUTH_FAILED
+ *         if it is not, or another error code from global.h.
+ *****************************************************************************/
+int ocb_decrypt(ocb_ctx *ctx, const uint8_t *nonce, size_t nonce_len,
+    const uint8_t *aad, size_t aad_len, const uint8_t *ct, size_t ct_len,
+    uint8_t *out, const uint8_t *tag, size_t tag_len);
+
+#endif /* ECRYPT_OCB_H */
@@ -1,48 +1,479 @@
 #ifndef ECRYPT_RIJNDAEL_H
 #define ECRYPT_RIJNDAEL_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include <sys/uio.h>
 #include "global.h"
 
+/* Block cipher implementations, see rijndael_select_impl. */
+#define RIJNDAEL_IMPL_AUTO		(0)
+#define RIJNDAEL_IMPL_TABLE		(1)
+#define RIJNDAEL_IMPL_AESNI		(2)
+#define RIJNDAEL_IMPL_VPERM		(3)
+#define RIJNDAEL_IMPL_VAES256		(4)
+#define RIJNDAEL_IMPL_VAES512		(5)
+
+/* private to the library; the block functions a context was keyed for */
+struct rijndael_impl_t;
+
 /*  The structure for key information */
-typedef struct {
+typedef struct rijndael_ctx_t {
     int enc_only;	/* context contains only encrypt schedule */
     int Nr;		/* key-length-dependent number of rounds */
     uint32_t ek[4*(AES_MAXROUNDS + 1)];	/* encrypt key schedule */
     uint32_t dk[4*(AES_MAXROUNDS + 1)];	/* decrypt key schedule */
+    const struct rijndael_impl_t *impl;	/* set by rijndael_set_key */
 } rijndael_ctx;
 
-struct rijndael_ctx_t {
-    int enc_only;
-    int Nr;
-    uint32_t ek[4*(AES_MAXROUNDS+1)];
-    uint32_t dk[4*(AES_MAXROUNDS+1)];
-};
-
 int rijndael_set_key(rijndael_ctx *, const uint8_t *, int);
 int rijndael_set_key_enc_only(rijndael_ctx *, const uint8_t *, int);
 void rijndael_decrypt(rijndael_ctx *, const uint8_t *, uint8_t *);
 void rijndael_encrypt(rijndael_ctx *, const uint8_t *, uint8_t *);
 
+/* rijndael_select_impl:
+ *
+ * description:
+ *     Chooses the block cipher code used by contexts keyed from now on.  By
+ *     default (RIJNDAEL_IMPL_AUTO) the processor is probed once and AES-NI
+ *     is used where available, with CTR and CBC decryption moved onto VAES
+ *     in 512-bit (RIJNDAEL_IMPL_VAES512, needs AVX-512) or 256-bit
+ *     (RIJNDAEL_IMPL_VAES256, needs AVX2) registers when the processor has
+ *     them.  Without AES-NI, the constant-time SSSE3 code
+ *     (RIJNDAEL_IMPL_VPERM) is preferred, and the portable T-table code is
+ *     the last resort.  Contexts that are already keyed keep what they were
+ *     keyed with.  Every implementation produces identical key schedules, so
+ *     this is only useful for testing and benchmarking, and must not be
+ *     called while other threads are using the library.
+ *
+ * inputs:
+ *     impl: one of the RIJNDAEL_IMPL_* values.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or ECRYPT_INVALID_PARAMETERS if the running
+ *         processor (or this build) cannot provide that implementation.
+ *****************************************************************************/
+int rijndael_select_impl(int impl);
+
+/* rijndael_impl_name:
+ *
+ * description:
+ *     Short name ("table", "aesni", "vperm", "vaes-avx2", "vaes-avx512") of
+ *     the implementation ctx was keyed with, or of the one rijndael_set_key
+ *     would pick if ctx is NULL.
+ *****************************************************************************/
+const char *rijndael_impl_name(const rijndael_ctx *ctx);
+
 int rijndaelKeySetupEnc(uint32_t *, const uint8_t *, int);
 int rijndaelKeySetupDec(uint32_t *, const uint8_t *, int);
 void rijndaelEncrypt(const uint32_t *, int, const uint8_t *, uint8_t *);
 
-/* TODO:
-* Functions to match the blowfish code to make things more consistent.
-*/
+/* rijndael_init:
+ *
+ * description:
+ *     Keys ctx for both encryption and decryption, like blowfish_init does
+ *     for the blowfish code.
+ *
+ * inputs:
+ *     ctx: a pre-allocated context.
+ *     key: the raw AES key.
+ *     klen: length of key in bytes; 16, 24 or 32.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
 int rijndael_init(struct rijndael_ctx_t *ctx, const uint8_t *key,
     uint32_t klen);
+
+/* rijndael_release:
+ *
+ * description:
+ *     Clears the key schedules held by ctx.
+ *****************************************************************************/
 int rijndael_release(struct rijndael_ctx_t *ctx);
-int rijndael_decrypt_cbc(struct rijndael_ctx_t *ctx, uint64_t iv,
-    const uint8_t* ct, uint32_t ct_len, uint8_t* out);
-int rijndael_encrypt_cbc(struct rijndael_ctx_t *ctx, uint64_t iv,
-    const uint8_t* pt, uint32_t pt_len, uint8_t* out);
-
-/* TODO: Encrypt and decrypt using the CTR mode of operation. */
-int rijndael_decrypt_ctr(struct rijndael_ctx_t *ctx, uint64_t iv,
-    const uint8_t *ct, uint32_t ct_len, uint8_t* out);
-int rijndael_encrypt_ctr(struct rijndael_ctx_t *ctx, uint64_t iv,
-    const uint8_t* pt, uint32_t pt_len, uint8_t* out);
+
+/* rijndael_decrypt_cbc:
+ *
+ * description:
+ *     Decrypts using the Chain-Block-Cipher mode.  Unlike encryption, the
+ *     block decryptions do not depend on each other, so several blocks are
+ *     decrypted side by side.
+ *
+ * inputs:
+ *     ctx: a context keyed for decryption (not encrypt-only).
+ *     iv: the initialization vector, 16 bytes.
+ *     ct: the ciphertext.
+ *     ct_len: length of ct; ct_len % 16 == 0 is tested.
+ *     out: receives ct_len bytes of plaintext.  May be the same buffer as
+ *         ct for in-place decryption.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
+int rijndael_decrypt_cbc(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const uint8_t* ct, size_t ct_len, uint8_t* out);
+
+/* rijndael_encrypt_cbc:
+ *
+ * description:
+ *     Encrypts using the Chain-Block-Cipher mode.
+ *
+ * inputs:
+ *     ctx: a keyed context.
+ *     iv: the initialization vector, 16 bytes.
+ *     pt: the plaintext; should already be padded.
+ *     pt_len: length of pt; pt_len % 16 == 0 is tested.
+ *     out: receives pt_len bytes of ciphertext.  May be the same as pt.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
+int rijndael_encrypt_cbc(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const uint8_t* pt, size_t pt_len, uint8_t* out);
+
+/* rijndael_decrypt_ctr:
+ *
+ * description:
+ *     Decrypts using the CTR mode of operation.  Since CTR only ever runs
+ *     the block cipher forwards, this is the same as rijndael_encrypt_ctr.
+ *****************************************************************************/
+int rijndael_decrypt_ctr(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const uint8_t *ct, size_t ct_len, uint8_t* out);
+
+/* rijndael_encrypt_ctr:
+ *
+ * description:
+ *     Encrypts using the CTR mode of operation (NIST SP 800-38A).  The
+ *     whole 16 byte counter block is incremented as one big-endian number
+ *     after each block.  Keystream is generated several blocks at a time.
+ *
+ * inputs:
+ *     ctx: a context keyed with rijndael_init or rijndael_set_key.  An
+ *         encrypt-only context is enough.
+ *     iv: the initial counter block, 16 bytes.  Never reuse a counter
+ *         value under the same key.
+ *     pt: the plaintext.  No padding is needed.
+ *     pt_len: length of pt in bytes; any length is fine.
+ *     out: receives pt_len bytes of ciphertext.  May be the same as pt.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or ECRYPT_NULL_PTR.
+ *****************************************************************************/
+int rijndael_encrypt_ctr(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const uint8_t* pt, size_t pt_len, uint8_t* out);
+
+/* rijndael_decrypt_ctr_mt:
+ *
+ * description:
+ *     Same as rijndael_encrypt_ctr_mt; CTR is its own inverse.
+ *****************************************************************************/
+int rijndael_decrypt_ctr_mt(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const uint8_t *ct, size_t ct_len, uint8_t *out, int workers);
+
+/* rijndael_encrypt_ctr_mt:
+ *
+ * description:
+ *     rijndael_encrypt_ctr for large buffers, spread over several threads.
+ *     Each thread gets its own range of counter blocks (a multiple of 64
+ *     bytes) and computes its starting counter directly, so the output is
+ *     byte-for-byte what rijndael_encrypt_ctr produces.  Buffers too small
+ *     to be worth a thread are processed on the calling thread.
+ *
+ * inputs:
+ *     ctx: a keyed context; it is only read, so sharing it is safe.
+ *     iv: the initial counter block, 16 bytes.
+ *     pt: the plaintext.
+ *     pt_len: length of pt in bytes; any length is fine.
+ *     out: receives pt_len bytes of ciphertext.  May be the same as pt.
+ *     workers: number of threads to use, including the calling one.  0
+ *         means one per online processor.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
+int rijndael_encrypt_ctr_mt(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const uint8_t *pt, size_t pt_len, uint8_t *out, int workers);
+
+/* What a rijndael_stream_t does, see rijndael_stream_init. */
+#define RIJNDAEL_STREAM_CBC_ENCRYPT	(1)
+#define RIJNDAEL_STREAM_CBC_DECRYPT	(2)
+#define RIJNDAEL_STREAM_CTR		(3)
+
+/* Padding for the CBC streams. */
+#define RIJNDAEL_PAD_NONE		(0)
+#define RIJNDAEL_PAD_PKCS7		(1)
+
+/*
+* CBC or CTR over a message that arrives in pieces, such as socket reads:
+*
+*     rijndael_stream_init, rijndael_stream_update (any number of times),
+*     rijndael_stream_final
+*
+* The chaining value or counter and at most one block of data are kept
+* between calls, so memory use does not grow with the message.  Pieces may
+* be any size; the output is the same as the one-shot functions give for
+* the whole message.
+*/
+struct rijndael_stream_t {
+    const rijndael_ctx *ctx;	/* the key; not copied */
+    int mode;			/* RIJNDAEL_STREAM_*, 0 once finished */
+    int pad;			/* RIJNDAEL_PAD_* */
+    unsigned int pos;		/* CBC: bytes held in buf; CTR: keystream
+				 * bytes left unused at the end of buf */
+    uint8_t iv[16];		/* chaining value, or next counter block */
+    uint8_t buf[16];
+};
+
+/* rijndael_stream_init:
+ *
+ * description:
+ *     Starts a stream.
+ *
+ * inputs:
+ *     s: a pre-allocated stream.
+ *     ctx: a keyed context, which has to outlive the stream.  Decryption
+ *         needs the decrypt schedule; the others work with an encrypt-only
+ *         context.
+ *     mode: RIJNDAEL_STREAM_CBC_ENCRYPT, RIJNDAEL_STREAM_CBC_DECRYPT or
+ *         RIJNDAEL_STREAM_CTR.
+ *     pad: RIJNDAEL_PAD_PKCS7 to add padding in rijndael_stream_final when
+ *         encrypting and check and remove it when decrypting, or
+ *         RIJNDAEL_PAD_NONE.  Ignored for CTR, which never pads.
+ *     iv: the initialization vector or initial counter block, 16 bytes.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
+int rijndael_stream_init(struct rijndael_stream_t *s, const rijndael_ctx *ctx,
+    int mode, int pad, const uint8_t *iv);
+
+/* rijndael_stream_update:
+ *
+ * description:
+ *     Processes the next piece of the message.  CTR output matches the
+ *     input byte for byte.  CBC writes whole blocks only and keeps the
+ *     rest for the next call; when decrypting with padding, the last whole
+ *     block seen is kept back too, for rijndael_stream_final.
+ *
+ * inputs:
+ *     s: a stream started with rijndael_stream_init.
+ *     in: the next in_len bytes of the message.
+ *     in_len: any length, including 0.
+ *     out: receives the output; room for in_len + 15 bytes is always
+ *         enough.  For CTR it may be the same as in.  For CBC it may be
+ *         the same as in only while every piece so far has been a whole
+ *         number of blocks, and not when decrypting with padding.
+ *     out_len: receives the number of bytes written to out.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
+int rijndael_stream_update(struct rijndael_stream_t *s, const uint8_t *in,
+    size_t in_len, uint8_t *out, size_t *out_len);
+
+/* rijndael_stream_final:
+ *
+ * description:
+ *     Finishes the stream and clears it; it has to be started again with
+ *     rijndael_stream_init before it can be used.
+ *
+ * inputs:
+ *     s: a stream started with rijndael_stream_init.
+ *     out: receives the last output, at most 16 bytes: the padded last
+ *         block when encrypting, or the unpadded end of the plaintext when
+ *         decrypting.
+ *     out_len: receives the number of bytes written to out.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, ECRYPT_INVALID_LENGTH if the message did not
+ *         end on a block boundary (CBC without padding, or any CBC
+ *         decryption), ECRYPT_INVALID_PADDING if the padding is not valid
+ *         PKCS #7, or another error code from global.h.
+ *****************************************************************************/
+int rijndael_stream_final(struct rijndael_stream_t *s, uint8_t *out,
+    size_t *out_len);
+
+/* rijndael_decrypt_cbc_iov:
+ *
+ * description:
+ *     rijndael_decrypt_cbc over a message held in several buffers.  See
+ *     rijndael_encrypt_cbc_iov.
+ *****************************************************************************/
+int rijndael_decrypt_cbc_iov(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const struct iovec *ct, int ct_cnt, const struct iovec *out, int out_cnt);
+
+/* rijndael_encrypt_cbc_iov:
+ *
+ * description:
+ *     rijndael_encrypt_cbc over a message held in several buffers, such as
+ *     a chain of network buffers, without gathering it into one first.
+ *     Segments may be any length; a block that straddles two of them is
+ *     handled internally.
+ *
+ * inputs:
+ *     ctx: a keyed context.
+ *     iv: the initialization vector, 16 bytes.
+ *     pt: pt_cnt segments of plaintext, which together should already be
+ *         padded to a multiple of 16 bytes.
+ *     out: out_cnt segments that receive the ciphertext.  They have to add
+ *         up to the same length as pt, but need not be cut in the same
+ *         places.  May be the same memory as pt.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, ECRYPT_INVALID_LENGTH if the lengths are wrong,
+ *         or another error code from global.h.
+ *****************************************************************************/
+int rijndael_encrypt_cbc_iov(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const struct iovec *pt, int pt_cnt, const struct iovec *out, int out_cnt);
+
+/* rijndael_decrypt_ctr_iov:
+ *
+ * description:
+ *     Same as rijndael_encrypt_ctr_iov; CTR is its own inverse.
+ *****************************************************************************/
+int rijndael_decrypt_ctr_iov(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const struct iovec *ct, int ct_cnt, const struct iovec *out, int out_cnt);
+
+/* rijndael_encrypt_ctr_iov:
+ *
+ * description:
+ *     rijndael_encrypt_ctr over a message held in several buffers.  The
+ *     total length can be anything; otherwise as rijndael_encrypt_cbc_iov.
+ *****************************************************************************/
+int rijndael_encrypt_ctr_iov(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const struct iovec *pt, int pt_cnt, const struct iovec *out, int out_cnt);
+
+/* one block of a rijndael_encrypt_batch/rijndael_decrypt_batch call */
+struct rijndael_batch_t {
+    const rijndael_ctx *ctx;	/* the key for this block */
+    const uint8_t *in;		/* 16 bytes */
+    uint8_t *out;		/* 16 bytes; may be the same as in */
+};
+
+/* rijndael_decrypt_batch:
+ *
+ * description:
+ *     rijndael_encrypt_batch, with rijndael_decrypt for every job.  Every
+ *     context needs its decrypt schedule.
+ *****************************************************************************/
+int rijndael_decrypt_batch(const struct rijndael_batch_t *jobs, size_t n);
+
+/* rijndael_encrypt_batch:
+ *
+ * description:
+ *     rijndael_encrypt on n blocks, each under its own key, such as one
+ *     record per row in a column encrypted with per-record keys.  The
+ *     blocks go through the cipher rounds side by side, so the work for
+ *     one key overlaps with the others the same way consecutive blocks of
+ *     a bulk mode do.  Keep neighbouring jobs at the same key size; runs
+ *     of mixed sizes are processed separately.  Pair this with
+ *     rijndael_cache_get to take the key expansion out of the loop too.
+ *
+ * inputs:
+ *     jobs: n (context, input, output) triples.  An output may only
+ *         overlap its own input.
+ *     n: the number of jobs.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h, in which case
+ *         nothing has been written.
+ *****************************************************************************/
+int rijndael_encrypt_batch(const struct rijndael_batch_t *jobs, size_t n);
+
+/* rijndael_init_enc_only_multi:
+ *
+ * description:
+ *     Keys n contexts for encryption only, one key each, as n calls to
+ *     rijndael_set_key_enc_only would.  With AES-NI and vperm the key
+ *     expansions run side by side, which makes this cheaper per key than
+ *     keying the contexts one at a time.  For workloads that derive a key per
+ *     message and can gather a few messages before keying them.
+ *
+ * inputs:
+ *     ctx: an array of n pre-allocated contexts.
+ *     keys: n raw AES keys, all of length klen.
+ *     klen: length of each key in bytes; 16, 24 or 32.
+ *     n: the number of keys.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h, in which case
+ *         no context has been keyed.
+ *****************************************************************************/
+int rijndael_init_enc_only_multi(struct rijndael_ctx_t *ctx,
+    const uint8_t *const *keys, uint32_t klen, size_t n);
+
+/* rijndael_encrypt_oneshot:
+ *
+ * description:
+ *     Expands key and encrypts pt with it block by block (ECB), for a key
+ *     that is only ever used once.  No context is kept and no decrypt
+ *     schedule is made, so this costs one encrypt-only key expansion on
+ *     top of the blocks; the round keys are wiped before returning.
+ *
+ * inputs:
+ *     key: the raw AES key.
+ *     klen: length of key in bytes; 16, 24 or 32.
+ *     pt: the blocks to encrypt.
+ *     pt_len: length of pt; pt_len % 16 == 0 is tested.
+ *     out: receives pt_len bytes.  May be the same as pt.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
+int rijndael_encrypt_oneshot(const uint8_t *key, uint32_t klen,
+    const uint8_t *pt, size_t pt_len, uint8_t *out);
+
+/* private to the library; see rijndael_cache_create */
+struct rijndael_cache_t;
+
+/* rijndael_cache_create:
+ *
+ * description:
+ *     Creates a cache of expanded key schedules, for callers that juggle
+ *     many keys and would otherwise run the key expansion on every
+ *     request.  Keys are looked up by a keyed SipHash digest.  A cached
+ *     key holds only its encrypt schedule until the first decrypting
+ *     lookup, which derives the decrypt schedule from it once.  When the
+ *     cache is full, the least recently used key is dropped.  The cache
+ *     may be shared between threads.
+ *
+ * inputs:
+ *     capacity: how many keys to keep, at least 1.  Rounded up a little
+ *         so that it divides evenly between the internal locks.
+ *
+ * outputs:
+ *     struct rijndael_cache_t*: the new cache, or NULL if out of memory or
+ *         capacity is 0.
+ *****************************************************************************/
+struct rijndael_cache_t *rijndael_cache_create(size_t capacity);
+
+/* rijndael_cache_destroy:
+ *
+ * description:
+ *     Clears every schedule held in cache and frees it.  Contexts handed
+ *     out by rijndael_cache_get are copies and stay usable.
+ *****************************************************************************/
+void rijndael_cache_destroy(struct rijndael_cache_t *cache);
+
+/* rijndael_cache_get:
+ *
+ * description:
+ *     Keys ctx from the cache, expanding and inserting key on a miss.  The
+ *     result is the same as rijndael_set_key (or rijndael_set_key_enc_only
+ *     when decrypt is 0) would give, but ctx receives a copy of the round
+ *     keys instead of running the key expansion.
+ *
+ * inputs:
+ *     cache: a cache from rijndael_cache_create.
+ *     key: the raw AES key.
+ *     klen: length of key in bytes; 16, 24 or 32.
+ *     decrypt: nonzero if ctx will be used to decrypt.
+ *     ctx: a pre-allocated context to key.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
+int rijndael_cache_get(struct rijndael_cache_t *cache, const uint8_t *key,
+    uint32_t klen, int decrypt, rijndael_ctx *ctx);
 
 #endif /* ECRYPT_RIJNDAEL_H */
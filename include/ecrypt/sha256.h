@@ -0,0 +1,150 @@
+#ifndef ECRYPT_SHA256_H
+#define ECRYPT_SHA256_H
+
+/* fixed width types are a must in this context */
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "global.h"
+
+#define SHA256_BLOCK_SIZE		(64)
+#define SHA256_DIGEST_LENGTH		(32)
+
+/* Implementations of the SHA-256 compression function, see
+ * sha256_select_impl. */
+#define SHA256_IMPL_AUTO		(0)
+#define SHA256_IMPL_SCALAR		(1)
+#define SHA256_IMPL_SHANI		(2)
+
+/* Implementations of sha256_multi, see sha256_multi_select_impl. */
+#define SHA256_MULTI_AUTO		(0)
+#define SHA256_MULTI_SERIAL		(1)
+#define SHA256_MULTI_AVX2		(2)
+#define SHA256_MULTI_AVX512		(3)
+
+/* the state of one hash in progress; see sha256_init */
+struct sha256_context_t {
+    uint32_t datalen;
+    uint32_t state[8];
+    uint32_t bitlen[2];
+    uint8_t data[64];
+};
+
+/* sha256_select_impl:
+ *
+ * description:
+ *     Chooses the SHA-256 compression function under sha256_update,
+ *     sha256_finalize and pbkdf2_hmac_sha256.  By default
+ *     (SHA256_IMPL_AUTO) that is the SHA extensions where the processor
+ *     has them (SHA256_IMPL_SHANI), otherwise portable C
+ *     (SHA256_IMPL_SCALAR).  All of them produce the same output, so this
+ *     is only useful for testing and benchmarking, and not while other
+ *     threads are hashing.
+ *
+ * inputs:
+ *     impl: one of the SHA256_IMPL_* values.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or ECRYPT_INVALID_PARAMETERS if the running
+ *         processor (or this build) cannot provide that implementation.
+ *****************************************************************************/
+int sha256_select_impl(int impl);
+
+/* sha256_impl_name:
+ *
+ * description:
+ *     Short name ("scalar", "shani") of the implementation in use.
+ *****************************************************************************/
+const char* sha256_impl_name(void);
+
+/* sha256_init:
+ *
+ * description:
+ *     Starts a new hash.
+ *
+ * inputs:
+ *     ctx: a pre-allocated context.
+ *****************************************************************************/
+void sha256_init(struct sha256_context_t* ctx);
+
+/* sha256_update:
+ *
+ * description:
+ *     Adds len bytes of message to the hash.  Call as often as needed.
+ *
+ * inputs:
+ *     ctx: a context started with sha256_init.
+ *     data: the next part of the message.
+ *     len: length of data in bytes.
+ *****************************************************************************/
+void sha256_update(struct sha256_context_t* ctx, const uint8_t* data,
+    size_t len);
+
+/* sha256_finalize:
+ *
+ * description:
+ *     Pads the message and writes out its hash.  The context has to go
+ *     through sha256_init again before it is reused.
+ *
+ * inputs:
+ *     ctx: a context started with sha256_init.
+ *     hash: receives SHA256_DIGEST_LENGTH bytes.
+ *****************************************************************************/
+void sha256_finalize(struct sha256_context_t* ctx, uint8_t* hash);
+
+/* one message of a sha256_multi call */
+struct sha256_batch_t {
+    const uint8_t* msg;
+    size_t len;
+    uint8_t* digest;		/* receives SHA256_DIGEST_LENGTH bytes */
+};
+
+/* sha256_multi_select_impl:
+ *
+ * description:
+ *     Chooses how sha256_multi runs.  SHA256_MULTI_AVX2 and
+ *     SHA256_MULTI_AVX512 hash 8 or 16 messages side by side, one per
+ *     32-bit lane of a vector register; SHA256_MULTI_SERIAL hashes them
+ *     one after the other with the function sha256_select_impl chose.  By
+ *     default (SHA256_MULTI_AUTO) the widest the processor supports is
+ *     used, unless it has the SHA extensions and only AVX2, where serial
+ *     hashing is faster.  Like sha256_select_impl, not to be called while
+ *     other threads are hashing.
+ *
+ * inputs:
+ *     impl: one of the SHA256_MULTI_* values.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or ECRYPT_INVALID_PARAMETERS if the running
+ *         processor (or this build) cannot provide that implementation.
+ *****************************************************************************/
+int sha256_multi_select_impl(int impl);
+
+/* sha256_multi_impl_name:
+ *
+ * description:
+ *     Short name ("serial", "avx2", "avx512") of the implementation in use.
+ *****************************************************************************/
+const char* sha256_multi_impl_name(void);
+
+/* sha256_multi:
+ *
+ * description:
+ *     Hashes n independent messages, such as the objects of a content
+ *     addressed store.  Each vector lane takes the next message as soon as
+ *     it has finished its last one, so messages of different lengths keep
+ *     every lane busy; once there are not enough messages left to fill
+ *     half the lanes, the rest are finished one at a time.
+ *
+ * inputs:
+ *     jobs: n (message, length, digest) triples.  Digests must not overlap
+ *         any message.
+ *     n: the number of jobs.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h, in which case
+ *         no digest has been written.
+ *****************************************************************************/
+int sha256_multi(const struct sha256_batch_t* jobs, size_t n);
+
+#endif /* ECRYPT_SHA256_H */
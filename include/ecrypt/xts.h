@@ -0,0 +1,101 @@
+#ifndef ECRYPT_XTS_H
+#define ECRYPT_XTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "global.h"
+#include "rijndael.h"
+
+#define XTS_BLOCK_LENGTH		(16)
+
+/* the longest data unit IEEE 1619 allows, 2^20 blocks */
+#define XTS_MAX_SECTOR_LENGTH		(16 * 1024 * 1024)
+
+/*
+* XTS-AES (IEEE 1619, NIST SP 800-38E), for encrypting storage in place.
+* A sector (data unit) is encrypted under its sector number, so equal
+* plaintext in different sectors gives different ciphertext and no IV has
+* to be stored.  Sectors need not be a multiple of 16 bytes; a partial
+* last block is handled with ciphertext stealing.
+*
+* XTS does not authenticate anything.  Changing a ciphertext block
+* garbles just that block of the plaintext, undetected.
+*/
+typedef struct xts_ctx_t {
+    rijndael_ctx data;		/* the first half of the key */
+    rijndael_ctx tweak;		/* the second half; encrypt-only */
+} xts_ctx;
+
+/* xts_set_key:
+ *
+ * description:
+ *     Keys ctx with the two AES keys XTS needs, given as one string.
+ *
+ * inputs:
+ *     ctx: a pre-allocated context.
+ *     key: the data key followed by the tweak key.
+ *     klen: length of key in bytes; 32 for XTS-AES-128 or 64 for
+ *         XTS-AES-256.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, ECRYPT_INVALID_PARAMETERS if the two halves
+ *         of key are equal (SP 800-38E forbids it), or another error code
+ *         from global.h.
+ *****************************************************************************/
+int xts_set_key(xts_ctx *ctx, const uint8_t *key, uint32_t klen);
+
+/* xts_release:
+ *
+ * description:
+ *     Clears the key material out of ctx.
+ *****************************************************************************/
+int xts_release(xts_ctx *ctx);
+
+/* xts_encrypt_sectors:
+ *
+ * description:
+ *     Encrypts a run of consecutive sectors of the same size.  The tweaks
+ *     of several sectors are worked out together, and the blocks of a
+ *     sector go through the cipher several at a time.
+ *
+ * inputs:
+ *     ctx: a context keyed with xts_set_key.
+ *     sector: number of the first sector; the next one is sector + 1.  It
+ *         becomes the tweak as a 16 byte little-endian number.
+ *     sector_len: bytes per sector, 16 to XTS_MAX_SECTOR_LENGTH.
+ *     pt: the plaintext.
+ *     pt_len: length of pt; a multiple of sector_len.
+ *     out: receives pt_len bytes of ciphertext.  May be the same as pt.
+ *
+ * outputs:
+ *     int: ECRYPT_NO_ERROR, or an error code from global.h.
+ *****************************************************************************/
+int xts_encrypt_sectors(xts_ctx *ctx, uint64_t sector, size_t sector_len,
+    const uint8_t *pt, size_t pt_len, uint8_t *out);
+
+/* xts_decrypt_sectors:
+ *
+ * description:
+ *     The inverse of xts_encrypt_sectors, with the same inputs.
+ *****************************************************************************/
+int xts_decrypt_sectors(xts_ctx *ctx, uint64_t sector, size_t sector_len,
+    const uint8_t *ct, size_t ct_len, uint8_t *out);
+
+/* xts_encrypt_sector:
+ *
+ * description:
+ *     Encrypts one sector of pt_len bytes; xts_encrypt_sectors with
+ *     sector_len == pt_len.
+ *****************************************************************************/
+int xts_encrypt_sector(xts_ctx *ctx, uint64_t sector, const uint8_t *pt,
+    size_t pt_len, uint8_t *out);
+
+/* xts_decrypt_sector:
+ *
+ * description:
+ *     Decrypts one sector of ct_len bytes.
+ *****************************************************************************/
+int xts_decrypt_sector(xts_ctx *ctx, uint64_t sector, const uint8_t *ct,
+    size_t ct_len, uint8_t *out);
+
+#endif /* ECRYPT_XTS_H */
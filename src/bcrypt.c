@@ -0,0 +1,412 @@
+#include <string.h>
+
+#include <ecrypt/bcrypt.h>
+#include <ecrypt/drbg.h>
+#include "blowfish_impl.h"
+#include "thread.h"
+
+/* how many EksBlowfish instances a thread runs side by side */
+#define BCRYPT_LANES		BLOWFISH_KEY_LANES
+
+/* "OrpheanBeholderScryDoubt", encrypted 64 times to make the hash */
+static const uint32_t _bcrypt_magic[6] = {
+    0x4F727068, 0x65616E42, 0x65686F6C, 0x64657253, 0x63727944, 0x6F756274
+};
+
+static const char _bcrypt_b64[] =
+    "./ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+
+/* one hash being computed */
+struct _bcrypt_state_t {
+    struct blowfish_context_t ctx;
+    uint32_t key[18];		/* the password as subkey words */
+    uint32_t salt[18];		/* the salt, the same way */
+    uint8_t salt_raw[BCRYPT_SALT_LENGTH];
+    uint8_t hash[24];		/* the encrypted magic, 23 bytes of it used */
+    int cost;
+    char minor;			/* the letter after "$2" */
+};
+
+static void
+_bcrypt_set_key(struct _bcrypt_state_t *st, const uint8_t *pass,
+    size_t pass_len)
+{
+    uint8_t key[BCRYPT_MAX_PASSWORD];
+    size_t len;
+
+    /* the password as a C string, terminator included, cut to 72 bytes */
+    if (pass_len < BCRYPT_MAX_PASSWORD) {
+        memcpy(key, pass, pass_len);
+        key[pass_len] = 0;
+        len = pass_len + 1;
+    } else {
+        memcpy(key, pass, BCRYPT_MAX_PASSWORD);
+        len = BCRYPT_MAX_PASSWORD;
+    }
+    _blowfish_key_words(key, len, st->key);
+    memset(key, 0, sizeof(key));
+}
+
+/* EksBlowfish and the encryption of the magic, n lanes of the same cost */
+BLOWFISH_INLINE void
+_bcrypt_run_n(struct _bcrypt_state_t *const *st, int n)
+{
+    struct blowfish_context_t *ctx[BCRYPT_LANES];
+    const uint32_t *key[BCRYPT_LANES], *salt[BCRYPT_LANES];
+    uint32_t l[BCRYPT_LANES], r[BCRYPT_LANES];
+    uint64_t rounds;
+    int i, j, k;
+
+    for (k = 0; k < n; k++) {
+        ctx[k] = &st[k]->ctx;
+        key[k] = st[k]->key;
+        salt[k] = st[k]->salt;
+        memcpy(ctx[k], &_blowfish_pi, sizeof(_blowfish_pi));
+    }
+
+    /* ExpandKey(state, salt, key), then 2^cost times with a zero salt and
+     * the password and salt taking turns as the key */
+    _blowfish_expand_keys(ctx, key, salt, n);
+    for (rounds = (uint64_t)1 << st[0]->cost; rounds > 0; rounds--) {
+        _blowfish_expand_keys(ctx, key, NULL, n);
+        _blowfish_expand_keys(ctx, salt, NULL, n);
+    }
+
+    for (j = 0; j < 6; j += 2) {
+        for (k = 0; k < n; k++) {
+            l[k] = _bcrypt_magic[j];
+            r[k] = _bcrypt_magic[j+1];
+        }
+        for (i = 0; i < 64; i++) {
+            _blowfish_encrypt_keys(ctx, l, r, n);
+        }
+        for (k = 0; k < n; k++) {
+            BF_STORE32(&st[k]->hash[j*4], l[k]);
+            BF_STORE32(&st[k]->hash[j*4 + 4], r[k]);
+        }
+    }
+}
+
+static void
+_bcrypt_run(struct _bcrypt_state_t *st)
+{
+    _bcrypt_run_n(&st, 1);
+}
+
+static void
+_bcrypt_run_lanes(struct _bcrypt_state_t *const *st)
+{
+    _bcrypt_run_n(st, BCRYPT_LANES);
+}
+
+/* bcrypt's base64: its own alphabet, no padding */
+static void
+_bcrypt_encode(const uint8_t *in, size_t len, char *out)
+{
+    uint32_t c;
+    size_t i;
+
+    for (i = 0; i < len; i += 3) {
+        c = (uint32_t)in[i] << 16;
+        if (i + 1 < len) {
+            c |= (uint32_t)in[i+1] << 8;
+        }
+        if (i + 2 < len) {
+            c |= in[i+2];
+        }
+
+        *out++ = _bcrypt_b64[(c >> 18) & 0x3f];
+        *out++ = _bcrypt_b64[(c >> 12) & 0x3f];
+        if (i + 1 < len) {
+            *out++ = _bcrypt_b64[(c >> 6) & 0x3f];
+        }
+        if (i + 2 < len) {
+            *out++ = _bcrypt_b64[c & 0x3f];
+        }
+    }
+}
+
+static int
+_bcrypt_b64_value(char ch)
+{
+    const char *p;
+
+    if (ch == 0) {
+        return -1;
+    }
+
+    p = strchr(_bcrypt_b64, ch);
+    return p != NULL ? (int)(p - _bcrypt_b64) : -1;
+}
+
+/* the 16 salt bytes from their 22 characters; the last one has 4 unused
+ * bits, which are ignored */
+static int
+_bcrypt_decode_salt(const char *in, uint8_t *out)
+{
+    uint32_t c;
+    int i, j, v;
+
+    for (i = 0, j = 0; i < 22; i += 4) {
+        c = 0;
+        for (v = 0; v < 4; v++) {
+            c <<= 6;
+            if (i + v < 22) {
+                if (_bcrypt_b64_value(in[i+v]) < 0) {
+                    return ECRYPT_INVALID_PARAMETERS;
+                }
+                c |= (uint32_t)_bcrypt_b64_value(in[i+v]);
+            }
+        }
+
+        out[j++] = (uint8_t)(c >> 16);
+        if (j < BCRYPT_SALT_LENGTH) {
+            out[j++] = (uint8_t)(c >> 8);
+            out[j++] = (uint8_t)c;
+        }
+    }
+
+    return ECRYPT_NO_ERROR;
+}
+
+/* the cost, salt and variant out of a "$2b$10$..." string */
+static int
+_bcrypt_parse(const char *hash, struct _bcrypt_state_t *st)
+{
+    if (strlen(hash) != BCRYPT_HASH_LENGTH || hash[0] != '$' ||
+        hash[1] != '2' || hash[3] != '$' || hash[6] != '$') {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    if (hash[2] != 'a' && hash[2] != 'b' && hash[2] != 'y') {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    if (hash[4] < '0' || hash[4] > '9' || hash[5] < '0' || hash[5] > '9') {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    st->minor = hash[2];
+    st->cost = (hash[4] - '0') * 10 + (hash[5] - '0');
+    if (st->cost < BCRYPT_MIN_COST || st->cost > BCRYPT_MAX_COST) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    if (_bcrypt_decode_salt(hash + 7, st->salt_raw) != ECRYPT_NO_ERROR) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+    _blowfish_key_words(st->salt_raw, BCRYPT_SALT_LENGTH, st->salt);
+
+    return ECRYPT_NO_ERROR;
+}
+
+/* the finished hash as a string, BCRYPT_HASH_LENGTH + 1 bytes */
+static void
+_bcrypt_format(const struct _bcrypt_state_t *st, char *out)
+{
+    out[0] = '$';
+    out[1] = '2';
+    out[2] = st->minor;
+    out[3] = '$';
+    out[4] = (char)('0' + st->cost / 10);
+    out[5] = (char)('0' + st->cost % 10);
+    out[6] = '$';
+    _bcrypt_encode(st->salt_raw, BCRYPT_SALT_LENGTH, out + 7);
+    _bcrypt_encode(st->hash, 23, out + 29);
+    out[BCRYPT_HASH_LENGTH] = 0;
+}
+
+/* the computed hash against the stored one, without an early exit */
+static int
+_bcrypt_compare(const struct _bcrypt_state_t *st, const char *hash)
+{
+    char mine[BCRYPT_HASH_LENGTH + 1];
+    uint8_t diff = 0;
+    int i;
+
+    _bcrypt_format(st, mine);
+    for (i = 0; i < BCRYPT_HASH_LENGTH; i++) {
+        diff |= (uint8_t)(mine[i] ^ hash[i]);
+    }
+    memset(mine, 0, sizeof(mine));
+
+    return diff == 0 ? ECRYPT_NO_ERROR : ECRYPT_AUTH_FAILED;
+}
+
+int
+bcrypt_hash(const uint8_t *pass, size_t pass_len, const uint8_t *salt,
+    int cost, char *out)
+{
+    struct _bcrypt_state_t st;
+    int result;
+
+    if (out == NULL || (pass == NULL && pass_len > 0)) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (cost < BCRYPT_MIN_COST || cost > BCRYPT_MAX_COST) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    if (salt != NULL) {
+        memcpy(st.salt_raw, salt, BCRYPT_SALT_LENGTH);
+    } else {
+        result = drbg_random(st.salt_raw, BCRYPT_SALT_LENGTH);
+        if (result != ECRYPT_NO_ERROR) {
+            return result;
+        }
+    }
+
+    st.minor = 'b';
+    st.cost = cost;
+    _blowfish_key_words(st.salt_raw, BCRYPT_SALT_LENGTH, st.salt);
+    _bcrypt_set_key(&st, pass, pass_len);
+    _bcrypt_run(&st);
+    _bcrypt_format(&st, out);
+    memset(&st, 0, sizeof(st));
+
+    return ECRYPT_NO_ERROR;
+}
+
+int
+bcrypt_verify(const uint8_t *pass, size_t pass_len, const char *hash)
+{
+    struct _bcrypt_state_t st;
+    int result;
+
+    if (hash == NULL || (pass == NULL && pass_len > 0)) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    result = _bcrypt_parse(hash, &st);
+    if (result == ECRYPT_NO_ERROR) {
+        _bcrypt_set_key(&st, pass, pass_len);
+        _bcrypt_run(&st);
+        result = _bcrypt_compare(&st, hash);
+    }
+    memset(&st, 0, sizeof(st));
+
+    return result;
+}
+
+struct _bcrypt_batch_job_t {
+    struct bcrypt_batch_t *jobs;
+    size_t n;
+    size_t share;		/* jobs per worker */
+};
+
+/*
+* Runs the group st[0..count) and fills in its results.  A group of one
+* runs alone; a partial group runs with its last state repeated in the
+* unused lanes, which costs no more than a full one.
+*/
+static void
+_bcrypt_batch_group(struct _bcrypt_state_t *const *st,
+    struct bcrypt_batch_t *const *job, int count)
+{
+    struct _bcrypt_state_t *lane[BCRYPT_LANES];
+    struct _bcrypt_state_t spare[BCRYPT_LANES - 1];
+    int k;
+
+    if (count == 1) {
+        _bcrypt_run(st[0]);
+    } else {
+        for (k = 0; k < BCRYPT_LANES; k++) {
+            if (k < count) {
+                lane[k] = st[k];
+            } else {
+                spare[k - count] = *st[count - 1];
+                lane[k] = &spare[k - count];
+            }
+        }
+        _bcrypt_run_lanes(lane);
+        memset(spare, 0, sizeof(spare[0]) * (BCRYPT_LANES - count));
+    }
+
+    for (k = 0; k < count; k++) {
+        job[k]->result = _bcrypt_compare(st[k], job[k]->hash);
+    }
+}
+
+static void
+_bcrypt_batch_worker(void *arg, int index, int count)
+{
+    struct _bcrypt_batch_job_t *batch = (struct _bcrypt_batch_job_t *)arg;
+    struct _bcrypt_state_t st[BCRYPT_LANES];
+    struct _bcrypt_state_t *group[BCRYPT_LANES];
+    struct bcrypt_batch_t *job[BCRYPT_LANES];
+    struct bcrypt_batch_t *j;
+    size_t i, end;
+    int n = 0;
+
+    (void)count;
+
+    i = batch->share * (size_t)index;
+    end = i + batch->share < batch->n ? i + batch->share : batch->n;
+
+    for (; i < end; i++) {
+        j = &batch->jobs[i];
+        if (j->hash == NULL || (j->pass == NULL && j->pass_len > 0)) {
+            j->result = ECRYPT_NULL_PTR;
+            continue;
+        }
+
+        /* neighbours of one cost share a group; anything else closes it */
+        j->result = _bcrypt_parse(j->hash, &st[n]);
+        if (j->result != ECRYPT_NO_ERROR) {
+            continue;
+        }
+        if (n > 0 && st[n].cost != st[0].cost) {
+            _bcrypt_batch_group(group, job, n);
+            st[0] = st[n];
+            n = 0;
+        }
+
+        _bcrypt_set_key(&st[n], j->pass, j->pass_len);
+        group[n] = &st[n];
+        job[n] = j;
+        if (++n == BCRYPT_LANES) {
+            _bcrypt_batch_group(group, job, n);
+            n = 0;
+        }
+    }
+
+    if (n > 0) {
+        _bcrypt_batch_group(group, job, n);
+    }
+    memset(st, 0, sizeof(st));
+}
+
+int
+bcrypt_verify_batch(struct bcrypt_batch_t *jobs, size_t n, int workers)
+{
+    struct _bcrypt_batch_job_t batch;
+
+    if (jobs == NULL && n > 0) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (workers < 0) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    if (n == 0) {
+        return ECRYPT_NO_ERROR;
+    }
+
+    if (workers == 0) {
+        workers = _ecrypt_default_workers();
+    }
+
+    /* every job is milliseconds of work, so one is enough for a thread */
+    if ((size_t)workers > n) {
+        workers = (int)n;
+    }
+
+    batch.jobs = jobs;
+    batch.n = n;
+    batch.share = (n + workers - 1) / workers;
+    _ecrypt_run_workers(workers, _bcrypt_batch_worker, &batch);
+
+    return ECRYPT_NO_ERROR;
+}
@@ -1,17 +1,25 @@
 #include <ecrypt/blowfish.h>
+#include <pthread.h>
 #include <string.h>
 
-/* P box for blowfish encryption */
-const uint32_t DEFAULT_P[18] = {
-    0x243F6A88L, 0x85A308D3L, 0x13198A2EL, 0x03707344L,
-    0xA4093822L, 0x299F31D0L, 0x082EFA98L, 0xEC4E6C89L,
-    0x452821E6L, 0x38D01377L, 0xBE5466CFL, 0x34E90C6CL,
-    0xC0AC29B7L, 0xC97C50DDL, 0x3F84D5B5L, 0xB5470917L,
-    0x9216D5D9L, 0x8979FB1B
-};
+#include "blowfish_impl.h"
+#include "cpu.h"
+#include "stream.h"
+#include "thread.h"
 
-/* S box for blowfish encryption */
-const uint32_t DEFAULT_S[4][256] = {
+/* The initial subkeys and S-boxes, the hexadecimal digits of pi, laid out
+ * as a context, so that keying starts with a single copy of the lot. */
+BLOWFISH_ALIGNED const struct blowfish_context_t _blowfish_pi = {
+    /* P */
+    {
+        0x243F6A88L, 0x85A308D3L, 0x13198A2EL, 0x03707344L,
+        0xA4093822L, 0x299F31D0L, 0x082EFA98L, 0xEC4E6C89L,
+        0x452821E6L, 0x38D01377L, 0xBE5466CFL, 0x34E90C6CL,
+        0xC0AC29B7L, 0xC97C50DDL, 0x3F84D5B5L, 0xB5470917L,
+        0x9216D5D9L, 0x8979FB1B
+    },
+
+    /* S[0] */
     {
         0xD1310BA6L, 0x98DFB5ACL, 0x2FFD72DBL, 0xD01ADFB7L,
         0xB8E1AFEDL, 0x6A267E96L, 0xBA7C9045L, 0xF12C7F99L,
@@ -76,8 +84,9 @@ const uint32_t DEFAULT_S[4][256] = {
         0xD60F573FL, 0xBC9BC6E4L, 0x2B60A476L, 0x81E67400L,
         0x08BA6FB5L, 0x571BE91FL, 0xF296EC6BL, 0x2A0DD915L,
         0xB6636521L, 0xE7B9F9B6L, 0xFF34052EL, 0xC5855664L,
-        0x53B02D5DL, 0xA99F8FA1L, 0x08BA4799L, 0x6E85076AL
-    }, {
+        0x53B02D5DL, 0xA99F8FA1L, 0x08BA4799L, 0x6E85076AL,
+
+        /* S[1] */
         0x4B7A70E9L, 0xB5B32944L, 0xDB75092EL, 0xC4192623L,
         0xAD6EA6B0L, 0x49A7DF7DL, 0x9CEE60B8L, 0x8FEDB266L,
         0xECAA8C71L, 0x699A17FFL, 0x5664526CL, 0xC2B19EE1L,
@@ -141,8 +150,9 @@ const uint32_t DEFAULT_S[4][256] = {
         0x9E447A2EL, 0xC3453484L, 0xFDD56705L, 0x0E1E9EC9L,
         0xDB73DBD3L, 0x105588CDL, 0x675FDA79L, 0xE3674340L,
         0xC5C43465L, 0x713E38D8L, 0x3D28F89EL, 0xF16DFF20L,
-        0x153E21E7L, 0x8FB03D4AL, 0xE6E39F2BL, 0xDB83ADF7L
-    }, {
+        0x153E21E7L, 0x8FB03D4AL, 0xE6E39F2BL, 0xDB83ADF7L,
+
+        /* S[2] */
         0xE93D5A68L, 0x948140F7L, 0xF64C261CL, 0x94692934L,
         0x411520F7L, 0x7602D4F7L, 0xBCF46B2EL, 0xD4A20068L,
         0xD4082471L, 0x3320F46AL, 0x43B7D4B7L, 0x500061AFL,
@@ -206,8 +216,9 @@ const uint32_t DEFAULT_S[4][256] = {
         0xED545578L, 0x08FCA5B5L, 0xD83D7CD3L, 0x4DAD0FC4L,
         0x1E50EF5EL, 0xB161E6F8L, 0xA28514D9L, 0x6C51133CL,
         0x6FD5C7E7L, 0x56E14EC4L, 0x362ABFCEL, 0xDDC6C837L,
-        0xD79A3234L, 0x92638212L, 0x670EFA8EL, 0x406000E0L
-    }, {
+        0xD79A3234L, 0x92638212L, 0x670EFA8EL, 0x406000E0L,
+
+        /* S[3] */
         0x3A39CE37L, 0xD3FAF5CFL, 0xABC27737L, 0x5AC52D1BL,
         0x5CB0679EL, 0x4FA33742L, 0xD3822740L, 0x99BC9BBEL,
         0xD5118E9DL, 0xBF0F7315L, 0xD62D1C7EL, 0xC700C47BL,
@@ -280,67 +291,60 @@ static int _blowfish_f(struct blowfish_context_t* ctx,
   uint32_t x, uint32_t* out);
 static int _blowfish_block_encrypt(struct blowfish_context_t* ctx,
   uint32_t* l, uint32_t* r);
-static int _blowfish_block_decrypt(struct blowfish_context_t* ctx,
-  uint32_t* l, uint32_t* r);
 static int _blowfish_block_to_bytes(uint32_t l, uint32_t r, uint8_t* out);
 static int _blowfish_bytes_to_block(const uint8_t* in,
   uint32_t* l, uint32_t* r);
+static const struct blowfish_impl_t* _blowfish_current_impl(void);
+
+/* The bulk functions behind _blowfish_scalar_impl. */
+static void _blowfish_scalar_encrypt(const struct blowfish_context_t* ctx,
+  const uint8_t* in, uint8_t* out, size_t blocks);
+static void _blowfish_scalar_decrypt(const struct blowfish_context_t* ctx,
+  const uint8_t* in, uint8_t* out, size_t blocks);
+static void _blowfish_scalar_cbc_dec(const struct blowfish_context_t* ctx,
+  uint8_t* iv, const uint8_t* in, uint8_t* out, size_t blocks);
+static void _blowfish_scalar_ctr(const struct blowfish_context_t* ctx,
+  uint8_t* ctr, const uint8_t* in, uint8_t* out, size_t blocks);
+
+const struct blowfish_impl_t _blowfish_scalar_impl = {
+    "scalar",
+    _blowfish_scalar_encrypt,
+    _blowfish_scalar_decrypt,
+    _blowfish_scalar_cbc_dec,
+    _blowfish_scalar_ctr
+};
+
+/* The implementation the bulk functions use.  Picked once, on first use
+ * from any thread, unless blowfish_select_impl has chosen one. */
+static const struct blowfish_impl_t* _blowfish_impl = NULL;
+static pthread_once_t _blowfish_impl_once = PTHREAD_ONCE_INIT;
 
 int blowfish_decrypt(struct blowfish_context_t* ctx, const uint8_t* iv,
-  const uint8_t* ct, uint32_t ct_len, uint8_t* out)
+  const uint8_t* ct, size_t ct_len, uint8_t* out)
 {
-    uint8_t buf[8];
-    uint32_t rl, rr;        /* actual result values */
-    uint32_t tl, tr;        /* temporary result values */
-    uint32_t ivl, ivr;      /* actual iv values */
-    uint32_t tivl, tivr;    /* temporary iv values */
-    uint32_t i;             /* and a loop counter. */
+    uint8_t chain[8];
 
     /* ensure that the input is padded to the proper length before-hand. */
     if (ct_len % 8 != 0) {
         return ECRYPT_INVALID_LENGTH;
     }
 
-    /* clear the stack-allocated buffer, there are probably situations
-     * where it wouldn't be zeroed when it was given to you. */
-    memset(buf, 0, 8);
-
-    /* go ahead and do my conversion from iv buffer to iv blocks, it
-     * will be the only time in the program that it has to be done. */
-    tl = tr = rl = rr = ivl = ivr = 0x00000000L;
-    _blowfish_bytes_to_block(iv, &ivl, &ivr);
-
-    for (i = 0; i < ct_len / 8; i++) {
-        _blowfish_bytes_to_block(&ct[i*8], &tl, &tr);
-        tivl = tl;
-        tivr = tr;
-
-        _blowfish_block_decrypt(ctx, &tl, &tr);
-        rl = tl ^ ivl;
-        rr = tr ^ ivr;
-
-        _blowfish_block_to_bytes(rl, rr, buf);
-
-        memcpy(&out[i*8], buf, 8);
-
-        ivl = tivl;
-        ivr = tivr;
-    }
-
-    /* clear the stack data that we used */
-    memset(buf, 0, 8);
-    ivl = ivr = tl = tr = rl = rr = 0;
+    /* the blocks are independent of each other here, so this goes through
+     * the multi-block code; the iv is a copy because it gets advanced. */
+    memcpy(chain, iv, 8);
+    _blowfish_current_impl()->cbc_dec(ctx, chain, ct, out, ct_len / 8);
+    memset(chain, 0, 8);
 
     return ECRYPT_NO_ERROR;
 }
 
 int blowfish_encrypt(struct blowfish_context_t* ctx, const uint8_t* iv,
-  const uint8_t* pt, uint32_t pt_len, uint8_t* out)
+  const uint8_t* pt, size_t pt_len, uint8_t* out)
 {
     uint8_t buf[8];
     uint32_t tl, tr;
     uint32_t ivl, ivr;
-    uint32_t i;
+    size_t i;
 
     if (pt_len % 8 != 0) {
         return ECRYPT_INVALID_LENGTH;
@@ -374,31 +378,17 @@ int blowfish_encrypt(struct blowfish_context_t* ctx, const uint8_t* iv,
 }
 
 int blowfish_decrypt_ecb(struct blowfish_context_t* ctx, const uint8_t* ct,
-  uint32_t ct_len, uint8_t* out)
+  size_t ct_len, uint8_t* out)
 {
-    uint32_t i;
-    uint32_t tl, tr;
-
-    for (i = 0; i < ct_len / 8; i++) {
-        _blowfish_bytes_to_block(&ct[i*8], &tl, &tr);
-        _blowfish_block_decrypt(ctx, &tl, &tr);
-        _blowfish_block_to_bytes(tl, tr, &out[i*8]);
-    }
+    _blowfish_current_impl()->decrypt(ctx, ct, out, ct_len / 8);
 
     return ECRYPT_UNTESTED;
 }
 
 int blowfish_encrypt_ecb(struct blowfish_context_t* ctx, const uint8_t* pt,
-  uint32_t pt_len, uint8_t* out)
+  size_t pt_len, uint8_t* out)
 {
-    uint32_t i;
-    uint32_t tl, tr;
-
-    for (i = 0; i < pt_len / 8; i++) {
-        _blowfish_bytes_to_block(&pt[i*8], &tl, &tr);
-        _blowfish_block_encrypt(ctx, &tl, &tr);
-        _blowfish_block_to_bytes(tl, tr, &out[i*8]);
-    }
+    _blowfish_current_impl()->encrypt(ctx, pt, out, pt_len / 8);
 
     return ECRYPT_UNTESTED;
 }
@@ -406,15 +396,51 @@ int blowfish_encrypt_ecb(struct blowfish_context_t* ctx, const uint8_t* pt,
 int blowfish_init(struct blowfish_context_t* ctx, const uint8_t* key,
   uint32_t length)
 {
-    int32_t i, j, k;
-    uint32_t data = 0;
-    uint32_t dl, dr;
+    return blowfish_init_multi(ctx, &key, length, 1);
+}
 
-    if (ctx == NULL) {
-        return ECRYPT_NULL_PTR;
+/* Keys ctx[0..n) from the n keys, n being 1 or BLOWFISH_KEY_LANES.  The
+ * tables start as a copy of _blowfish_pi, made with one memcpy rather than
+ * a word at a time. */
+BLOWFISH_INLINE void _blowfish_schedule_n(struct blowfish_context_t* ctx,
+  const uint8_t* const* keys, uint32_t length, int n)
+{
+    struct blowfish_context_t* c[BLOWFISH_KEY_LANES];
+    uint32_t words[BLOWFISH_KEY_LANES][BLOWFISH_P_LENGTH];
+    const uint32_t* w[BLOWFISH_KEY_LANES];
+    int k;
+
+    for (k = 0; k < n; k++) {
+        c[k] = &ctx[k];
+        w[k] = words[k];
+        memcpy(c[k], &_blowfish_pi, sizeof(_blowfish_pi));
+        _blowfish_key_words(keys[k], length, words[k]);
     }
 
-    if (key == NULL) {
+    _blowfish_expand_keys(c, w, NULL, n);
+    memset(words, 0, sizeof(words));
+}
+
+static void _blowfish_schedule(struct blowfish_context_t* ctx,
+  const uint8_t* key, uint32_t length)
+{
+    _blowfish_schedule_n(ctx, &key, length, 1);
+}
+
+static void _blowfish_schedule_lanes(struct blowfish_context_t* ctx,
+  const uint8_t* const* keys, uint32_t length)
+{
+    _blowfish_schedule_n(ctx, keys, length, BLOWFISH_KEY_LANES);
+}
+
+int blowfish_init_multi(struct blowfish_context_t* ctx,
+  const uint8_t* const* keys, uint32_t length, size_t n)
+{
+    struct blowfish_context_t spare[BLOWFISH_KEY_LANES];
+    const uint8_t* rest[BLOWFISH_KEY_LANES];
+    size_t i, k;
+
+    if (ctx == NULL || (keys == NULL && n > 0)) {
         return ECRYPT_NULL_PTR;
     }
 
@@ -423,58 +449,504 @@ int blowfish_init(struct blowfish_context_t* ctx, const uint8_t* key,
         return ECRYPT_INVALID_LENGTH;
     }
 
-    for (i = 0; i < 18; i++) {
-        ctx->P[i] = DEFAULT_P[i];
+    for (i = 0; i < n; i++) {
+        if (keys[i] == NULL) {
+            return ECRYPT_NULL_PTR;
+        }
+    }
+
+    /* the keys side by side in groups */
+    for (i = 0; i + BLOWFISH_KEY_LANES <= n; i += BLOWFISH_KEY_LANES) {
+        _blowfish_schedule_lanes(&ctx[i], &keys[i], length);
     }
 
-    for (i = 0; i < 4; i++) {
-        for (j = 0; j < 256; j++) {
-            ctx->S[(256 * i) + j] = DEFAULT_S[i][j];
+    /* two or three left over cost no more as a group padded out with the
+     * last key again than they do one by one */
+    if (n - i >= 2) {
+        for (k = 0; k < BLOWFISH_KEY_LANES; k++) {
+            rest[k] = keys[i + k < n ? i + k : n - 1];
         }
+        _blowfish_schedule_lanes(spare, rest, length);
+        memcpy(&ctx[i], spare, (n - i) * sizeof(spare[0]));
+        memset(spare, 0, sizeof(spare));
+    } else if (n - i == 1) {
+        _blowfish_schedule(&ctx[i], keys[i], length);
     }
 
-    j = 0;
-    for (i = 0; i < 18; i++) {
-        data = 0x00000000L;
-        for (k = 0; k < 4; k++) {
-            data = (data << 8) | key[j];
-            j++;
-            if (j >= length) {
-                j = 0;
-            }
+    return ECRYPT_NO_ERROR;
+}
+
+int blowfish_end(struct blowfish_context_t* ctx)
+{
+    memset(ctx->P, 0, BLOWFISH_P_LENGTH);
+    memset(ctx->S, 0, BLOWFISH_S_LENGTH);
+
+    return ECRYPT_NO_ERROR;
+}
+
+static const struct blowfish_impl_t* _blowfish_best_impl(void)
+{
+#if defined(ECRYPT_HAVE_AVX2)
+    if (_ecrypt_cpu_features() & ECRYPT_CPU_AVX2) {
+        return &_blowfish_avx2_impl;
+    }
+#endif
+
+    return &_blowfish_scalar_impl;
+}
+
+static void _blowfish_impl_init(void)
+{
+    _blowfish_impl = _blowfish_best_impl();
+}
+
+const struct blowfish_impl_t* _blowfish_current_impl(void)
+{
+    pthread_once(&_blowfish_impl_once, _blowfish_impl_init);
+    return _blowfish_impl;
+}
+
+int blowfish_select_impl(int impl)
+{
+    /* first, or the first use would undo the choice */
+    pthread_once(&_blowfish_impl_once, _blowfish_impl_init);
+
+    switch (impl) {
+    case BLOWFISH_IMPL_AUTO:
+        _blowfish_impl = _blowfish_best_impl();
+        return ECRYPT_NO_ERROR;
+    case BLOWFISH_IMPL_SCALAR:
+        _blowfish_impl = &_blowfish_scalar_impl;
+        return ECRYPT_NO_ERROR;
+    case BLOWFISH_IMPL_AVX2:
+#if defined(ECRYPT_HAVE_AVX2)
+        if (_ecrypt_cpu_features() & ECRYPT_CPU_AVX2) {
+            _blowfish_impl = &_blowfish_avx2_impl;
+            return ECRYPT_NO_ERROR;
         }
+#endif
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    return ECRYPT_INVALID_PARAMETERS;
+}
+
+const char* blowfish_impl_name(void)
+{
+    return _blowfish_current_impl()->name;
+}
+
+/* The stream functions.  The block functions take a non-const context but
+ * never write to it. */
+static void _blowfish_stream_cbc_enc(const void* key, uint8_t* iv,
+  const uint8_t* in, uint8_t* out, size_t blocks)
+{
+    struct blowfish_context_t* ctx = (struct blowfish_context_t*)key;
+    uint32_t tl, tr, ivl, ivr;
+    size_t i;
 
-        ctx->P[i] = ctx->P[i] ^ data;
+    _blowfish_bytes_to_block(iv, &ivl, &ivr);
+    for (i = 0; i < blocks; i++) {
+        _blowfish_bytes_to_block(&in[i*8], &tl, &tr);
+        ivl ^= tl;
+        ivr ^= tr;
+        _blowfish_block_encrypt(ctx, &ivl, &ivr);
+        _blowfish_block_to_bytes(ivl, ivr, &out[i*8]);
     }
+    _blowfish_block_to_bytes(ivl, ivr, iv);
+}
+
+static void _blowfish_stream_cbc_dec(const void* key, uint8_t* iv,
+  const uint8_t* in, uint8_t* out, size_t blocks)
+{
+    _blowfish_current_impl()->cbc_dec(
+      (const struct blowfish_context_t*)key, iv, in, out, blocks);
+}
+
+static void _blowfish_stream_ctr(const void* key, uint8_t* ctr,
+  const uint8_t* in, uint8_t* out, size_t blocks)
+{
+    _blowfish_current_impl()->ctr(
+      (const struct blowfish_context_t*)key, ctr, in, out, blocks);
+}
+
+static const struct _ecrypt_stream_ops_t _blowfish_stream_ops = {
+    8,
+    _blowfish_stream_cbc_enc,
+    _blowfish_stream_cbc_dec,
+    _blowfish_stream_ctr
+};
 
-    dl = 0x00000000L;
-    dr = 0x00000000L;
+static int _blowfish_iov(struct blowfish_context_t* ctx, const uint8_t* iv,
+  int mode, const struct iovec* in, int in_cnt, const struct iovec* out,
+  int out_cnt)
+{
+    uint8_t chain[8];
+    int result;
 
-    for (i = 0; i < 18; i += 2) {
-        _blowfish_block_encrypt(ctx, &dl, &dr);
-        ctx->P[i] = dl;
-        ctx->P[i+1] = dr;
+    if (ctx == NULL || iv == NULL) {
+        return ECRYPT_NULL_PTR;
     }
 
-    for (i = 0; i < 4; i++) {
-        for (j = 0; j < 256; j += 2) {
-            _blowfish_block_encrypt(ctx, &dl, &dr);
-            ctx->S[(i * 256) + j] = dl;
-            ctx->S[(i * 256) + (j + 1)] = dr;
+    memcpy(chain, iv, 8);
+    result = _ecrypt_stream_iov(&_blowfish_stream_ops, ctx, mode, chain, in,
+      in_cnt, out, out_cnt);
+    memset(chain, 0, 8);
+
+    return result;
+}
+
+int blowfish_decrypt_iov(struct blowfish_context_t* ctx, const uint8_t* iv,
+  const struct iovec* ct, int ct_cnt, const struct iovec* out, int out_cnt)
+{
+    return _blowfish_iov(ctx, iv, ECRYPT_STREAM_CBC_DECRYPT, ct, ct_cnt, out,
+      out_cnt);
+}
+
+int blowfish_encrypt_iov(struct blowfish_context_t* ctx, const uint8_t* iv,
+  const struct iovec* pt, int pt_cnt, const struct iovec* out, int out_cnt)
+{
+    return _blowfish_iov(ctx, iv, ECRYPT_STREAM_CBC_ENCRYPT, pt, pt_cnt, out,
+      out_cnt);
+}
+
+/* CTR.  The counter is the whole block as one 64-bit big-endian number,
+ * the same as the CTR stream, so byte n of the keystream is byte n % 8 of
+ * E(iv + n / 8) and any offset can be reached without touching the blocks
+ * before it. */
+static uint64_t _blowfish_load64(const uint8_t* in)
+{
+    uint64_t x = 0;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        x = (x << 8) | in[i];
+    }
+
+    return x;
+}
+
+static void _blowfish_store64(uint64_t x, uint8_t* out)
+{
+    int i;
+
+    for (i = 7; i >= 0; i--) {
+        out[i] = (uint8_t)x;
+        x >>= 8;
+    }
+}
+
+/* len bytes of CTR starting at byte offset of the keystream */
+static void _blowfish_ctr_range(const struct blowfish_context_t* ctx,
+  const uint8_t* iv, uint64_t offset, const uint8_t* in, uint8_t* out,
+  size_t len)
+{
+    const struct blowfish_impl_t* impl = _blowfish_current_impl();
+    uint8_t ctr[8], ks[8];
+    size_t i, n, skip;
+
+    _blowfish_store64(_blowfish_load64(iv) + offset / 8, ctr);
+
+    /* the rest of a block we start inside of, and a partial block at the
+     * end, use only as much of their keystream as they need */
+    skip = (size_t)(offset % 8);
+    if (skip != 0 && len > 0) {
+        impl->encrypt(ctx, ctr, ks, 1);
+        _blowfish_store64(_blowfish_load64(ctr) + 1, ctr);
+        n = len < 8 - skip ? len : 8 - skip;
+        for (i = 0; i < n; i++) {
+            out[i] = in[i] ^ ks[skip + i];
         }
+        in += n;
+        out += n;
+        len -= n;
     }
 
+    impl->ctr(ctx, ctr, in, out, len / 8);
+
+    n = len % 8;
+    if (n != 0) {
+        in += len - n;
+        out += len - n;
+        impl->encrypt(ctx, ctr, ks, 1);
+        for (i = 0; i < n; i++) {
+            out[i] = in[i] ^ ks[i];
+        }
+    }
+
+    memset(ctr, 0, 8);
+    memset(ks, 0, 8);
+}
+
+/* Below this many bytes per worker, starting a thread costs more than it
+ * saves.  Shares are multiples of BLOWFISH_MT_ALIGN bytes, so that threads
+ * do not write to the same cache lines. */
+#define BLOWFISH_MT_MIN_BYTES	(64 * 1024)
+#define BLOWFISH_MT_ALIGN	(64)
+
+struct _blowfish_ctr_job_t {
+    const struct blowfish_context_t* ctx;
+    const uint8_t* iv;
+    uint64_t offset;
+    const uint8_t* in;
+    uint8_t* out;
+    size_t len;
+    size_t share;		/* bytes per worker */
+};
+
+static void _blowfish_ctr_worker(void* arg, int index, int count)
+{
+    struct _blowfish_ctr_job_t* job = (struct _blowfish_ctr_job_t*)arg;
+    size_t first, n;
+
+    (void)count;
+
+    first = job->share * (size_t)index;
+    if (first >= job->len) {
+        return;
+    }
+
+    n = job->len - first;
+    if (n > job->share) {
+        n = job->share;
+    }
+
+    _blowfish_ctr_range(job->ctx, job->iv, job->offset + first,
+      job->in + first, job->out + first, n);
+}
+
+int blowfish_ctr_at(const struct blowfish_context_t* ctx, const uint8_t* iv,
+  uint64_t offset, const uint8_t* in, size_t len, uint8_t* out, int workers)
+{
+    struct _blowfish_ctr_job_t job;
+    size_t most;
+
+    if (ctx == NULL || iv == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (len > 0 && (in == NULL || out == NULL)) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (workers < 0) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    if (workers == 0) {
+        workers = _ecrypt_default_workers();
+    }
+
+    most = len / BLOWFISH_MT_MIN_BYTES;
+    if ((size_t)workers > most) {
+        workers = most > 1 ? (int)most : 1;
+    }
+
+    if (workers == 1) {
+        _blowfish_ctr_range(ctx, iv, offset, in, out, len);
+        return ECRYPT_NO_ERROR;
+    }
+
+    job.ctx = ctx;
+    job.iv = iv;
+    job.offset = offset;
+    job.in = in;
+    job.out = out;
+    job.len = len;
+    job.share = (len + workers - 1) / workers;
+    job.share = (job.share + BLOWFISH_MT_ALIGN - 1) / BLOWFISH_MT_ALIGN *
+      BLOWFISH_MT_ALIGN;
+
+    _ecrypt_run_workers(workers, _blowfish_ctr_worker, &job);
+
     return ECRYPT_NO_ERROR;
 }
 
-int blowfish_end(struct blowfish_context_t* ctx)
+/* CBC decryption splits the same way.  Every range starts from the last
+ * ciphertext block of the one before it, which is copied out before any
+ * thread starts, so that in-place decryption cannot overwrite it first.
+ * More threads than there are slots for buy nothing on a job this
+ * memory-bound. */
+#define BLOWFISH_MT_MAX_WORKERS	(64)
+
+struct _blowfish_cbc_job_t {
+    const struct blowfish_context_t* ctx;
+    const uint8_t* in;
+    uint8_t* out;
+    size_t len;
+    size_t share;		/* bytes per worker */
+    uint8_t iv[BLOWFISH_MT_MAX_WORKERS][8];	/* one per range */
+};
+
+static void _blowfish_cbc_worker(void* arg, int index, int count)
 {
-    memset(ctx->P, 0, BLOWFISH_P_LENGTH);
-    memset(ctx->S, 0, BLOWFISH_S_LENGTH);
+    struct _blowfish_cbc_job_t* job = (struct _blowfish_cbc_job_t*)arg;
+    size_t first, n;
+
+    (void)count;
+
+    first = job->share * (size_t)index;
+    if (first >= job->len) {
+        return;
+    }
+
+    n = job->len - first;
+    if (n > job->share) {
+        n = job->share;
+    }
+
+    _blowfish_current_impl()->cbc_dec(job->ctx, job->iv[index],
+      job->in + first, job->out + first, n / 8);
+}
+
+int blowfish_decrypt_mt(const struct blowfish_context_t* ctx,
+  const uint8_t* iv, const uint8_t* ct, size_t ct_len, uint8_t* out,
+  int workers)
+{
+    struct _blowfish_cbc_job_t job;
+    size_t most;
+    int i;
+
+    if (ct_len % 8 != 0) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    if (ctx == NULL || iv == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (ct_len > 0 && (ct == NULL || out == NULL)) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (workers < 0) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    if (workers == 0) {
+        workers = _ecrypt_default_workers();
+    }
+
+    most = ct_len / BLOWFISH_MT_MIN_BYTES;
+    if (most > BLOWFISH_MT_MAX_WORKERS) {
+        most = BLOWFISH_MT_MAX_WORKERS;
+    }
+    if ((size_t)workers > most) {
+        workers = most > 1 ? (int)most : 1;
+    }
+
+    job.ctx = ctx;
+    job.in = ct;
+    job.out = out;
+    job.len = ct_len;
+    job.share = (ct_len + workers - 1) / workers;
+    job.share = (job.share + BLOWFISH_MT_ALIGN - 1) / BLOWFISH_MT_ALIGN *
+      BLOWFISH_MT_ALIGN;
+
+    memcpy(job.iv[0], iv, 8);
+    for (i = 1; i < workers && job.share * (size_t)i < ct_len; i++) {
+        memcpy(job.iv[i], ct + job.share * (size_t)i - 8, 8);
+    }
+
+    if (workers == 1) {
+        _blowfish_cbc_worker(&job, 0, 1);
+    } else {
+        _ecrypt_run_workers(workers, _blowfish_cbc_worker, &job);
+    }
+    memset(job.iv, 0, sizeof(job.iv));
 
     return ECRYPT_NO_ERROR;
 }
 
+int blowfish_decrypt_ctr(const struct blowfish_context_t* ctx,
+  const uint8_t* iv, const uint8_t* ct, size_t ct_len, uint8_t* out)
+{
+    /* CTR is its own inverse */
+    return blowfish_ctr_at(ctx, iv, 0, ct, ct_len, out, 1);
+}
+
+int blowfish_encrypt_ctr(const struct blowfish_context_t* ctx,
+  const uint8_t* iv, const uint8_t* pt, size_t pt_len, uint8_t* out)
+{
+    return blowfish_ctr_at(ctx, iv, 0, pt, pt_len, out, 1);
+}
+
+static void _blowfish_stream_state(struct blowfish_stream_t* s,
+  struct _ecrypt_stream_state_t* st)
+{
+    st->mode = s->mode;
+    st->pad = s->pad;
+    st->pos = &s->pos;
+    st->iv = s->iv;
+    st->buf = s->buf;
+}
+
+int blowfish_stream_init(struct blowfish_stream_t* s,
+  const struct blowfish_context_t* ctx, int mode, int pad, const uint8_t* iv)
+{
+    if (s == NULL || ctx == NULL || iv == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (mode != BLOWFISH_STREAM_CBC_ENCRYPT &&
+      mode != BLOWFISH_STREAM_CBC_DECRYPT && mode != BLOWFISH_STREAM_CTR) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    if (pad != BLOWFISH_PAD_NONE && pad != BLOWFISH_PAD_PKCS7) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    memset(s, 0, sizeof(*s));
+    s->ctx = ctx;
+    s->mode = mode;
+    s->pad = mode == BLOWFISH_STREAM_CTR ? BLOWFISH_PAD_NONE : pad;
+    memcpy(s->iv, iv, 8);
+
+    return ECRYPT_NO_ERROR;
+}
+
+int blowfish_stream_update(struct blowfish_stream_t* s, const uint8_t* in,
+  size_t in_len, uint8_t* out, size_t* out_len)
+{
+    struct _ecrypt_stream_state_t st;
+
+    if (s == NULL || out_len == NULL ||
+      (in_len != 0 && (in == NULL || out == NULL))) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (s->mode == 0) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    _blowfish_stream_state(s, &st);
+    return _ecrypt_stream_update(&_blowfish_stream_ops, s->ctx, &st, in,
+      in_len, out, out_len);
+}
+
+int blowfish_stream_final(struct blowfish_stream_t* s, uint8_t* out,
+  size_t* out_len)
+{
+    struct _ecrypt_stream_state_t st;
+    int result;
+
+    if (s == NULL || out == NULL || out_len == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (s->mode == 0) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    _blowfish_stream_state(s, &st);
+    result = _ecrypt_stream_final(&_blowfish_stream_ops, s->ctx, &st, out,
+      out_len);
+    memset(s, 0, sizeof(*s));
+
+    return result;
+}
+
 /* private function definitions */
 int _blowfish_f(struct blowfish_context_t* ctx, uint32_t x, uint32_t* out)
 {
@@ -539,46 +1011,6 @@ int _blowfish_block_encrypt(struct blowfish_context_t* ctx,
     return ECRYPT_NO_ERROR;
 }
 
-int _blowfish_block_decrypt(struct blowfish_context_t* ctx,
-  uint32_t* l, uint32_t* r)
-{
-    /* loop counter and function call result; size doesn't matter */
-    int32_t i, result;
-    uint32_t temp, tl, tr;
-
-    /* work on temporary variables, not the real thing.. */
-    tl = l[0];
-    tr = r[0];
-    temp = 0;
-
-    for (i = 17; i > 1; i--) {
-        tl = tl ^ ctx->P[i];
-        result = _blowfish_f(ctx, tl, &temp);
-        if (result != ECRYPT_NO_ERROR) {
-            return result;
-        }
-
-        tr = temp ^ tr;
-
-        temp = tl;
-        tl = tr;
-        tr = temp;
-    }
-
-    temp = tl;
-    tl = tr;
-    tr = temp;
-
-    tr = tr ^ ctx->P[1];
-    tl = tl ^ ctx->P[0];
-
-    /* save those temporary values to the real ones at the end */
-    l[0] = tl;
-    r[0] = tr;
-
-    return ECRYPT_NO_ERROR;
-}
-
 int _blowfish_bytes_to_block(const uint8_t* in, uint32_t* l, uint32_t* r)
 {
     int i;
@@ -620,3 +1052,168 @@ int _blowfish_block_to_bytes(uint32_t l, uint32_t r, uint8_t* out)
 
     return ECRYPT_NO_ERROR;
 }
+
+/* The multi-block code.  The round macros are in blowfish_impl.h. */
+/* Encrypts the blocks l[k], r[k] for k < n, n being 1 or 4, or decrypts
+ * them: decryption is the same rounds with the subkeys taken from the other
+ * end.  Always inlined, with n and decrypt constant, so that the halves
+ * stay in registers and the subkeys are fixed offsets into ctx. */
+BLOWFISH_INLINE void _blowfish_crypt_n(const struct blowfish_context_t* ctx,
+  uint32_t* l, uint32_t* r, int n, int decrypt)
+{
+    const uint32_t* P = ctx->P;
+    const uint32_t* S = ctx->S;
+    uint32_t l0, l1, l2, l3, r0, r1, r2, r3, a, b;
+    int i;
+
+    l0 = l[0];
+    r0 = r[0];
+    l1 = l2 = l3 = r1 = r2 = r3 = 0;
+    if (n == 4) {
+        l1 = l[1]; l2 = l[2]; l3 = l[3];
+        r1 = r[1]; r2 = r[2]; r3 = r[3];
+    }
+
+    for (i = 0; i < 16; i += 2) {
+        a = P[decrypt ? 17 - i : i];
+        b = P[decrypt ? 16 - i : i + 1];
+        BF_ROUND(S, l0, r0, a);
+        if (n == 4) {
+            BF_ROUND(S, l1, r1, a);
+            BF_ROUND(S, l2, r2, a);
+            BF_ROUND(S, l3, r3, a);
+        }
+        BF_ROUND(S, r0, l0, b);
+        if (n == 4) {
+            BF_ROUND(S, r1, l1, b);
+            BF_ROUND(S, r2, l2, b);
+            BF_ROUND(S, r3, l3, b);
+        }
+    }
+
+    a = P[decrypt ? 1 : 16];
+    b = P[decrypt ? 0 : 17];
+    l[0] = r0 ^ b;
+    r[0] = l0 ^ a;
+    if (n == 4) {
+        l[1] = r1 ^ b; l[2] = r2 ^ b; l[3] = r3 ^ b;
+        r[1] = l1 ^ a; r[2] = l2 ^ a; r[3] = l3 ^ a;
+    }
+}
+
+static void _blowfish_scalar_ecb(const struct blowfish_context_t* ctx,
+  const uint8_t* in, uint8_t* out, size_t blocks, int decrypt)
+{
+    uint32_t l[4], r[4];
+    int k;
+
+    for (; blocks >= 4; blocks -= 4, in += 32, out += 32) {
+        for (k = 0; k < 4; k++) {
+            l[k] = BF_LOAD32(&in[k*8]);
+            r[k] = BF_LOAD32(&in[k*8 + 4]);
+        }
+        _blowfish_crypt_n(ctx, l, r, 4, decrypt);
+        for (k = 0; k < 4; k++) {
+            BF_STORE32(&out[k*8], l[k]);
+            BF_STORE32(&out[k*8 + 4], r[k]);
+        }
+    }
+
+    for (; blocks > 0; blocks--, in += 8, out += 8) {
+        l[0] = BF_LOAD32(in);
+        r[0] = BF_LOAD32(in + 4);
+        _blowfish_crypt_n(ctx, l, r, 1, decrypt);
+        BF_STORE32(out, l[0]);
+        BF_STORE32(out + 4, r[0]);
+    }
+}
+
+void _blowfish_scalar_encrypt(const struct blowfish_context_t* ctx,
+  const uint8_t* in, uint8_t* out, size_t blocks)
+{
+    _blowfish_scalar_ecb(ctx, in, out, blocks, 0);
+}
+
+void _blowfish_scalar_decrypt(const struct blowfish_context_t* ctx,
+  const uint8_t* in, uint8_t* out, size_t blocks)
+{
+    _blowfish_scalar_ecb(ctx, in, out, blocks, 1);
+}
+
+void _blowfish_scalar_cbc_dec(const struct blowfish_context_t* ctx,
+  uint8_t* iv, const uint8_t* in, uint8_t* out, size_t blocks)
+{
+    uint32_t l[4], r[4], cl[5], cr[5];
+    int k;
+
+    /* cl[0], cr[0] is the block before the group, the iv to begin with */
+    cl[0] = BF_LOAD32(iv);
+    cr[0] = BF_LOAD32(iv + 4);
+
+    for (; blocks >= 4; blocks -= 4, in += 32, out += 32) {
+        for (k = 0; k < 4; k++) {
+            l[k] = cl[k+1] = BF_LOAD32(&in[k*8]);
+            r[k] = cr[k+1] = BF_LOAD32(&in[k*8 + 4]);
+        }
+        _blowfish_crypt_n(ctx, l, r, 4, 1);
+        for (k = 0; k < 4; k++) {
+            BF_STORE32(&out[k*8], l[k] ^ cl[k]);
+            BF_STORE32(&out[k*8 + 4], r[k] ^ cr[k]);
+        }
+        cl[0] = cl[4];
+        cr[0] = cr[4];
+    }
+
+    for (; blocks > 0; blocks--, in += 8, out += 8) {
+        l[0] = cl[1] = BF_LOAD32(in);
+        r[0] = cr[1] = BF_LOAD32(in + 4);
+        _blowfish_crypt_n(ctx, l, r, 1, 1);
+        BF_STORE32(out, l[0] ^ cl[0]);
+        BF_STORE32(out + 4, r[0] ^ cr[0]);
+        cl[0] = cl[1];
+        cr[0] = cr[1];
+    }
+
+    BF_STORE32(iv, cl[0]);
+    BF_STORE32(iv + 4, cr[0]);
+}
+
+void _blowfish_scalar_ctr(const struct blowfish_context_t* ctx,
+  uint8_t* ctr, const uint8_t* in, uint8_t* out, size_t blocks)
+{
+    uint32_t l[4], r[4], cl, cr;
+    size_t i;
+    int k, n;
+
+    cl = BF_LOAD32(ctr);
+    cr = BF_LOAD32(ctr + 4);
+
+    while (blocks > 0) {
+        n = blocks >= 4 ? 4 : 1;
+        for (k = 0; k < n; k++) {
+            l[k] = cl;
+            r[k] = cr;
+            if (++cr == 0) {
+                cl++;
+            }
+        }
+
+        if (n == 4) {
+            _blowfish_crypt_n(ctx, l, r, 4, 0);
+        } else {
+            _blowfish_crypt_n(ctx, l, r, 1, 0);
+        }
+
+        for (k = 0; k < n; k++) {
+            i = (size_t)k * 8;
+            BF_STORE32(&out[i], l[k] ^ BF_LOAD32(&in[i]));
+            BF_STORE32(&out[i + 4], r[k] ^ BF_LOAD32(&in[i + 4]));
+        }
+        in += n * 8;
+        out += n * 8;
+        blocks -= n;
+    }
+
+    BF_STORE32(ctr, cl);
+    BF_STORE32(ctr + 4, cr);
+}
@@ -0,0 +1,245 @@
+#include <immintrin.h>
+
+#include "blowfish_impl.h"
+
+/* Eight Blowfish blocks side by side in AVX2 registers, one 32-bit lane per
+ * block and a register for each half.  F is four vpgatherdd lookups into
+ * ctx->S per round.  Two groups of eight are kept in flight where there is
+ * enough data, which hides most of the gather latency.
+ *
+ * Loading splits blocks 0-3 and 4-7 into halves with shufps, which leaves
+ * the lanes in the order 0 1 4 5 | 2 3 6 7; unpacking them again puts the
+ * blocks back where they came from, so only the CTR counters need to know
+ * about it. */
+
+/* byte swaps every 32-bit word */
+#define BF_AVX2_BSWAP \
+  _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, \
+  3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)
+
+#define BF_AVX2_GATHER(S, idx) \
+  _mm256_i32gather_epi32((const int*)(S), (idx), 4)
+
+static inline __m256i _bf_avx2_f(const uint32_t* S, __m256i x)
+{
+    const __m256i m = _mm256_set1_epi32(0xff);
+    __m256i a, b, c, d;
+
+    a = BF_AVX2_GATHER(S, _mm256_srli_epi32(x, 24));
+    b = BF_AVX2_GATHER(S + 256,
+      _mm256_and_si256(_mm256_srli_epi32(x, 16), m));
+    c = BF_AVX2_GATHER(S + 512, _mm256_and_si256(_mm256_srli_epi32(x, 8), m));
+    d = BF_AVX2_GATHER(S + 768, _mm256_and_si256(x, m));
+
+    return _mm256_add_epi32(_mm256_xor_si256(_mm256_add_epi32(a, b), c), d);
+}
+
+/* n groups, n being 1 or 2; the same subkey order trick as
+ * _blowfish_crypt_n in blowfish.c */
+BLOWFISH_INLINE void _bf_avx2_crypt(const struct blowfish_context_t* ctx,
+  __m256i* l, __m256i* r, int n, int decrypt)
+{
+    const uint32_t* P = ctx->P;
+    const uint32_t* S = ctx->S;
+    __m256i a, b, t;
+    int i, k;
+
+    for (i = 0; i < 16; i += 2) {
+        a = _mm256_set1_epi32((int)P[decrypt ? 17 - i : i]);
+        b = _mm256_set1_epi32((int)P[decrypt ? 16 - i : i + 1]);
+        for (k = 0; k < n; k++) {
+            l[k] = _mm256_xor_si256(l[k], a);
+            r[k] = _mm256_xor_si256(r[k], _bf_avx2_f(S, l[k]));
+        }
+        for (k = 0; k < n; k++) {
+            r[k] = _mm256_xor_si256(r[k], b);
+            l[k] = _mm256_xor_si256(l[k], _bf_avx2_f(S, r[k]));
+        }
+    }
+
+    a = _mm256_set1_epi32((int)P[decrypt ? 0 : 17]);
+    b = _mm256_set1_epi32((int)P[decrypt ? 1 : 16]);
+    for (k = 0; k < n; k++) {
+        t = l[k];
+        l[k] = _mm256_xor_si256(r[k], a);
+        r[k] = _mm256_xor_si256(t, b);
+    }
+}
+
+/* 64 bytes as they are in memory to the halves of eight blocks */
+static inline void _bf_avx2_split(__m256i x, __m256i y, __m256i* l,
+  __m256i* r)
+{
+    x = _mm256_shuffle_epi8(x, BF_AVX2_BSWAP);
+    y = _mm256_shuffle_epi8(y, BF_AVX2_BSWAP);
+    *l = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(x),
+      _mm256_castsi256_ps(y), _MM_SHUFFLE(2, 0, 2, 0)));
+    *r = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(x),
+      _mm256_castsi256_ps(y), _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+/* and back */
+static inline void _bf_avx2_join(__m256i l, __m256i r, __m256i* x,
+  __m256i* y)
+{
+    *x = _mm256_shuffle_epi8(_mm256_unpacklo_epi32(l, r), BF_AVX2_BSWAP);
+    *y = _mm256_shuffle_epi8(_mm256_unpackhi_epi32(l, r), BF_AVX2_BSWAP);
+}
+
+#define BF_AVX2_LOAD(p) _mm256_loadu_si256((const __m256i*)(p))
+#define BF_AVX2_STORE(p, v) _mm256_storeu_si256((__m256i*)(p), (v))
+
+BLOWFISH_INLINE void _bf_avx2_ecb(const struct blowfish_context_t* ctx,
+  const uint8_t* in, uint8_t* out, size_t blocks, int decrypt)
+{
+    __m256i l[2], r[2], x, y;
+    int k, n;
+
+    while (blocks >= 8) {
+        n = blocks >= 16 ? 2 : 1;
+        for (k = 0; k < n; k++) {
+            _bf_avx2_split(BF_AVX2_LOAD(in + k*64),
+              BF_AVX2_LOAD(in + k*64 + 32), &l[k], &r[k]);
+        }
+        if (n == 2) {
+            _bf_avx2_crypt(ctx, l, r, 2, decrypt);
+        } else {
+            _bf_avx2_crypt(ctx, l, r, 1, decrypt);
+        }
+        for (k = 0; k < n; k++) {
+            _bf_avx2_join(l[k], r[k], &x, &y);
+            BF_AVX2_STORE(out + k*64, x);
+            BF_AVX2_STORE(out + k*64 + 32, y);
+        }
+        in += n * 64;
+        out += n * 64;
+        blocks -= n * 8;
+    }
+
+    if (blocks > 0) {
+        if (decrypt) {
+            _blowfish_scalar_impl.decrypt(ctx, in, out, blocks);
+        } else {
+            _blowfish_scalar_impl.encrypt(ctx, in, out, blocks);
+        }
+    }
+}
+
+static void _blowfish_avx2_encrypt(const struct blowfish_context_t* ctx,
+  const uint8_t* in, uint8_t* out, size_t blocks)
+{
+    _bf_avx2_ecb(ctx, in, out, blocks, 0);
+}
+
+static void _blowfish_avx2_decrypt(const struct blowfish_context_t* ctx,
+  const uint8_t* in, uint8_t* out, size_t blocks)
+{
+    _bf_avx2_ecb(ctx, in, out, blocks, 1);
+}
+
+/* The ciphertext of each group is kept as loaded.  The blocks to XOR into
+ * its plaintext are the same registers moved up by one block, with the
+ * last block of the previous group (or the iv) moved in at the bottom. */
+static void _blowfish_avx2_cbc_dec(const struct blowfish_context_t* ctx,
+  uint8_t* iv, const uint8_t* in, uint8_t* out, size_t blocks)
+{
+    __m256i l[2], r[2], c[4], prev, x, y;
+    int k, n;
+
+    prev = _mm256_castsi128_si256(_mm_loadl_epi64((const __m128i*)iv));
+
+    while (blocks >= 8) {
+        n = blocks >= 16 ? 2 : 1;
+        for (k = 0; k < n; k++) {
+            c[2*k] = BF_AVX2_LOAD(in + k*64);
+            c[2*k + 1] = BF_AVX2_LOAD(in + k*64 + 32);
+            _bf_avx2_split(c[2*k], c[2*k + 1], &l[k], &r[k]);
+        }
+        if (n == 2) {
+            _bf_avx2_crypt(ctx, l, r, 2, 1);
+        } else {
+            _bf_avx2_crypt(ctx, l, r, 1, 1);
+        }
+        for (k = 0; k < 2*n; k++) {
+            /* c[k] as blocks j-1, j, j+1, j+2 with block j-1 from prev */
+            x = _mm256_blend_epi32(
+              _mm256_permute4x64_epi64(c[k], _MM_SHUFFLE(2, 1, 0, 0)),
+              prev, 0x03);
+            prev = _mm256_permute4x64_epi64(c[k], _MM_SHUFFLE(3, 3, 3, 3));
+            c[k] = x;
+        }
+        for (k = 0; k < n; k++) {
+            _bf_avx2_join(l[k], r[k], &x, &y);
+            BF_AVX2_STORE(out + k*64, _mm256_xor_si256(x, c[2*k]));
+            BF_AVX2_STORE(out + k*64 + 32, _mm256_xor_si256(y, c[2*k + 1]));
+        }
+        in += n * 64;
+        out += n * 64;
+        blocks -= n * 8;
+    }
+
+    _mm_storel_epi64((__m128i*)iv, _mm256_castsi256_si128(prev));
+    if (blocks > 0) {
+        _blowfish_scalar_impl.cbc_dec(ctx, iv, in, out, blocks);
+    }
+}
+
+static void _blowfish_avx2_ctr(const struct blowfish_context_t* ctx,
+  uint8_t* ctr, const uint8_t* in, uint8_t* out, size_t blocks)
+{
+    /* block offsets in lane order, biased for an unsigned compare */
+    const __m256i off = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+    const __m256i bias = _mm256_set1_epi32((int)0x80000000u);
+    __m256i l[2], r[2], x, y;
+    uint64_t c;
+    int k, n;
+
+    c = ((uint64_t)ctr[0] << 56) | ((uint64_t)ctr[1] << 48) |
+      ((uint64_t)ctr[2] << 40) | ((uint64_t)ctr[3] << 32) |
+      ((uint64_t)ctr[4] << 24) | ((uint64_t)ctr[5] << 16) |
+      ((uint64_t)ctr[6] << 8) | (uint64_t)ctr[7];
+
+    while (blocks >= 8) {
+        n = blocks >= 16 ? 2 : 1;
+        for (k = 0; k < n; k++) {
+            /* low halves c + offset; where that wrapped (came out below
+             * the offset) the high half takes the carry */
+            r[k] = _mm256_add_epi32(_mm256_set1_epi32((int)(uint32_t)c),
+              off);
+            l[k] = _mm256_sub_epi32(_mm256_set1_epi32((int)(c >> 32)),
+              _mm256_cmpgt_epi32(_mm256_xor_si256(off, bias),
+              _mm256_xor_si256(r[k], bias)));
+            c += 8;
+        }
+        if (n == 2) {
+            _bf_avx2_crypt(ctx, l, r, 2, 0);
+        } else {
+            _bf_avx2_crypt(ctx, l, r, 1, 0);
+        }
+        for (k = 0; k < n; k++) {
+            _bf_avx2_join(l[k], r[k], &x, &y);
+            BF_AVX2_STORE(out + k*64,
+              _mm256_xor_si256(x, BF_AVX2_LOAD(in + k*64)));
+            BF_AVX2_STORE(out + k*64 + 32,
+              _mm256_xor_si256(y, BF_AVX2_LOAD(in + k*64 + 32)));
+        }
+        in += n * 64;
+        out += n * 64;
+        blocks -= n * 8;
+    }
+
+    for (k = 0; k < 8; k++) {
+        ctr[k] = (uint8_t)(c >> (56 - 8*k));
+    }
+    if (blocks > 0) {
+        _blowfish_scalar_impl.ctr(ctx, ctr, in, out, blocks);
+    }
+}
+
+const struct blowfish_impl_t _blowfish_avx2_impl = {
+    "avx2",
+    _blowfish_avx2_encrypt,
+    _blowfish_avx2_decrypt,
+    _blowfish_avx2_cbc_dec,
+    _blowfish_avx2_ctr
+};
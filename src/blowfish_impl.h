@@ -0,0 +1,196 @@
+#ifndef ECRYPT_BLOWFISH_IMPL_H
+#define ECRYPT_BLOWFISH_IMPL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ecrypt/blowfish.h>
+
+/* Private to the library.  The bulk block functions of one Blowfish
+ * implementation; blowfish.c runs every mode without a dependency between
+ * blocks (ECB, CBC decryption and CTR) through the current one.  The key
+ * schedule is the same for all of them, so unlike AES a context is not tied
+ * to the implementation it was keyed under.  All functions work on whole
+ * 8 byte blocks, read every block of a group before writing any output, and
+ * so allow in == out. */
+struct blowfish_impl_t {
+    const char* name;
+
+    /* ECB, block by block */
+    void (*encrypt)(const struct blowfish_context_t* ctx, const uint8_t* in,
+      uint8_t* out, size_t blocks);
+    void (*decrypt)(const struct blowfish_context_t* ctx, const uint8_t* in,
+      uint8_t* out, size_t blocks);
+
+    /* CBC decryption; iv is replaced by the last ciphertext block */
+    void (*cbc_dec)(const struct blowfish_context_t* ctx, uint8_t* iv,
+      const uint8_t* in, uint8_t* out, size_t blocks);
+
+    /* out = in ^ E(ctr), the counter being the whole block as one 64-bit
+     * big-endian number; ctr is left at the first unused counter block */
+    void (*ctr)(const struct blowfish_context_t* ctx, uint8_t* ctr,
+      const uint8_t* in, uint8_t* out, size_t blocks);
+};
+
+/* for the round functions, which only pay off laid out in their callers */
+#if defined(__GNUC__)
+#define BLOWFISH_INLINE		static inline __attribute__((always_inline))
+#else
+#define BLOWFISH_INLINE		static inline
+#endif
+
+/* for _blowfish_pi, which every key setup copies in one go */
+#if defined(__GNUC__)
+#define BLOWFISH_ALIGNED	__attribute__((aligned(64)))
+#else
+#define BLOWFISH_ALIGNED
+#endif
+
+/* A block is two big-endian words.  F is written out as a macro so that
+ * the rounds of several blocks (or keys) can be interleaved, each one's
+ * chain of S-box lookups hiding the latency of the others'. */
+#define BF_LOAD32(p) \
+  (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | \
+  ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3])
+
+#define BF_STORE32(p, v) do { \
+    (p)[0] = (uint8_t)((v) >> 24); \
+    (p)[1] = (uint8_t)((v) >> 16); \
+    (p)[2] = (uint8_t)((v) >> 8); \
+    (p)[3] = (uint8_t)(v); \
+} while (0)
+
+#define BF_F(S, x) \
+  ((((S)[(x) >> 24] + (S)[256 + (((x) >> 16) & 0xff)]) ^ \
+  (S)[512 + (((x) >> 8) & 0xff)]) + (S)[768 + ((x) & 0xff)])
+
+/* one round without the swap: a ^= subkey, b ^= F(a) */
+#define BF_ROUND(S, a, b, k) do { \
+    (a) ^= (k); \
+    (b) ^= BF_F(S, a); \
+} while (0)
+
+/* the initial subkeys and S-boxes, the digits of pi; blowfish.c */
+extern const struct blowfish_context_t _blowfish_pi;
+
+/* 18 big-endian words from len bytes of key, going round as often as
+ * needed: what the key schedule XORs into P */
+BLOWFISH_INLINE void _blowfish_key_words(const uint8_t* key, size_t len,
+  uint32_t* w)
+{
+    size_t i, j = 0;
+    int k;
+
+    for (i = 0; i < BLOWFISH_P_LENGTH; i++) {
+        w[i] = 0;
+        for (k = 0; k < 4; k++) {
+            w[i] = (w[i] << 8) | key[j];
+            j = j + 1 < len ? j + 1 : 0;
+        }
+    }
+}
+
+/* how many keys the key schedule code works on side by side */
+#define BLOWFISH_KEY_LANES	(4)
+
+/* Encrypts (l[k], r[k]) under ctx[k] for n independent keys, n being 1 or
+ * BLOWFISH_KEY_LANES.  Every key has its own tables here, so the lookups
+ * go through the context pointers, which leaves enough registers for all
+ * the halves. */
+BLOWFISH_INLINE void _blowfish_encrypt_keys(
+  struct blowfish_context_t* const* ctx, uint32_t* l, uint32_t* r, int n)
+{
+    const struct blowfish_context_t *c0, *c1, *c2, *c3;
+    uint32_t l0, l1, l2, l3, r0, r1, r2, r3;
+    int i;
+
+    c0 = c1 = c2 = c3 = ctx[0];
+    l0 = l[0];
+    r0 = r[0];
+    l1 = l2 = l3 = r1 = r2 = r3 = 0;
+    if (n == 4) {
+        c1 = ctx[1];
+        c2 = ctx[2];
+        c3 = ctx[3];
+        l1 = l[1]; l2 = l[2]; l3 = l[3];
+        r1 = r[1]; r2 = r[2]; r3 = r[3];
+    }
+
+    for (i = 0; i < 16; i += 2) {
+        BF_ROUND(c0->S, l0, r0, c0->P[i]);
+        if (n == 4) {
+            BF_ROUND(c1->S, l1, r1, c1->P[i]);
+            BF_ROUND(c2->S, l2, r2, c2->P[i]);
+            BF_ROUND(c3->S, l3, r3, c3->P[i]);
+        }
+        BF_ROUND(c0->S, r0, l0, c0->P[i+1]);
+        if (n == 4) {
+            BF_ROUND(c1->S, r1, l1, c1->P[i+1]);
+            BF_ROUND(c2->S, r2, l2, c2->P[i+1]);
+            BF_ROUND(c3->S, r3, l3, c3->P[i+1]);
+        }
+    }
+
+    l[0] = r0 ^ c0->P[17];
+    r[0] = l0 ^ c0->P[16];
+    if (n == 4) {
+        l[1] = r1 ^ c1->P[17]; l[2] = r2 ^ c2->P[17]; l[3] = r3 ^ c3->P[17];
+        r[1] = l1 ^ c1->P[16]; r[2] = l2 ^ c2->P[16]; r[3] = l3 ^ c3->P[16];
+    }
+}
+
+/* The key schedule of n keys at once, n as above, on contexts that already
+ * hold their starting tables: P is XORed with the 18 words key[k], then
+ * every subkey and S-box entry is replaced, two at a time, by the
+ * encryption of the two before.  With salt (bcrypt's ExpandKey) the block
+ * is first XORed with the next two of the four words salt[k]; plain
+ * Blowfish passes NULL. */
+BLOWFISH_INLINE void _blowfish_expand_keys(
+  struct blowfish_context_t* const* ctx, const uint32_t* const* key,
+  const uint32_t* const* salt, int n)
+{
+    uint32_t l[BLOWFISH_KEY_LANES], r[BLOWFISH_KEY_LANES];
+    int i, k;
+
+    for (k = 0; k < n; k++) {
+        for (i = 0; i < BLOWFISH_P_LENGTH; i++) {
+            ctx[k]->P[i] ^= key[k][i];
+        }
+        l[k] = r[k] = 0;
+    }
+
+    for (i = 0; i < BLOWFISH_P_LENGTH; i += 2) {
+        for (k = 0; k < n && salt != NULL; k++) {
+            l[k] ^= salt[k][i & 3];
+            r[k] ^= salt[k][(i + 1) & 3];
+        }
+        _blowfish_encrypt_keys(ctx, l, r, n);
+        for (k = 0; k < n; k++) {
+            ctx[k]->P[i] = l[k];
+            ctx[k]->P[i+1] = r[k];
+        }
+    }
+
+    /* the salt words carry on from P, which ends on word 18 % 4 == 2 */
+    for (i = 0; i < BLOWFISH_S_LENGTH; i += 2) {
+        for (k = 0; k < n && salt != NULL; k++) {
+            l[k] ^= salt[k][(i + 2) & 3];
+            r[k] ^= salt[k][(i + 3) & 3];
+        }
+        _blowfish_encrypt_keys(ctx, l, r, n);
+        for (k = 0; k < n; k++) {
+            ctx[k]->S[i] = l[k];
+            ctx[k]->S[i+1] = r[k];
+        }
+    }
+}
+
+/* portable code, four blocks interleaved; blowfish.c */
+extern const struct blowfish_impl_t _blowfish_scalar_impl;
+
+#if defined(ECRYPT_HAVE_AVX2)
+/* eight blocks per register with the S-box lookups done by vpgatherdd;
+ * blowfish_avx2.c.  Groups of less than eight go to the scalar code. */
+extern const struct blowfish_impl_t _blowfish_avx2_impl;
+#endif
+
+#endif /* ECRYPT_BLOWFISH_IMPL_H */
@@ -0,0 +1,124 @@
+#include "cpu.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define ECRYPT_CPU_X86
+
+/* leaf 7 bits that older cpuid.h headers do not name yet */
+#ifndef bit_VAES
+#define bit_VAES	(1 << 9)
+#endif
+#ifndef bit_VPCLMULQDQ
+#define bit_VPCLMULQDQ	(1 << 10)
+#endif
+#ifndef bit_SHA
+#define bit_SHA		(1 << 29)
+#endif
+#endif
+
+/* the probe is cheap, but there is no reason to run CPUID on every call.
+ * racing threads will all compute and store the same value. */
+static volatile int _ecrypt_cpu_probed = 0;
+static volatile uint32_t _ecrypt_cpu_flags = 0;
+
+static uint32_t _ecrypt_cpu_probe(void);
+
+uint32_t _ecrypt_cpu_features(void)
+{
+    if (!_ecrypt_cpu_probed) {
+        _ecrypt_cpu_flags = _ecrypt_cpu_probe();
+        _ecrypt_cpu_probed = 1;
+    }
+
+    return _ecrypt_cpu_flags;
+}
+
+#if defined(ECRYPT_CPU_X86)
+/* which register files the operating system saves on a context switch */
+static uint32_t _ecrypt_cpu_xcr0(void)
+{
+    uint32_t lo, hi;
+
+    __asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return lo;
+}
+
+static uint32_t _ecrypt_cpu_probe(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    uint32_t flags = 0, xcr0 = 0;
+    int avx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+
+    if (ecx & bit_SSSE3) {
+        flags |= ECRYPT_CPU_SSSE3;
+    }
+
+    if (ecx & bit_SSE4_1) {
+        flags |= ECRYPT_CPU_SSE41;
+    }
+
+    /* every AES-NI code path also leans on pshufb for byte swapping */
+    if ((ecx & bit_AES) && (flags & ECRYPT_CPU_SSSE3)) {
+        flags |= ECRYPT_CPU_AESNI;
+    }
+
+    /* same for the carry-less multiply code */
+    if ((ecx & bit_PCLMUL) && (flags & ECRYPT_CPU_SSSE3)) {
+        flags |= ECRYPT_CPU_PCLMUL;
+    }
+
+    /*
+    * The wide registers are only usable if the operating system saves
+    * them: the YMM upper halves (XCR0 bits 1 and 2), and for AVX-512 the
+    * opmask and ZMM state as well (bits 5 to 7).
+    */
+    avx = (ecx & bit_OSXSAVE) && (ecx & bit_AVX);
+    if (avx) {
+        xcr0 = _ecrypt_cpu_xcr0();
+    }
+
+    /* the SHA extensions are plain SSE and need no XCR0 bits; the code
+    * around them uses pshufb and pblendw */
+    if ((flags & ECRYPT_CPU_SSE41) && (flags & ECRYPT_CPU_SSSE3) &&
+        __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA)) {
+        flags |= ECRYPT_CPU_SHA;
+    }
+
+    if (!avx || (xcr0 & 0x06) != 0x06 ||
+        !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return flags;
+    }
+
+    if (ebx & bit_AVX2) {
+        flags |= ECRYPT_CPU_AVX2;
+    }
+
+    if ((ebx & bit_AVX512F) && (ebx & bit_AVX512BW) &&
+        (ebx & bit_AVX512VL) && (xcr0 & 0xe6) == 0xe6 &&
+        (flags & ECRYPT_CPU_AVX2)) {
+        flags |= ECRYPT_CPU_AVX512;
+    }
+
+    /* the wide code falls back on AES-NI and PCLMULQDQ for odd blocks */
+    if ((ecx & bit_VAES) && (flags & ECRYPT_CPU_AVX2) &&
+        (flags & ECRYPT_CPU_AESNI)) {
+        flags |= ECRYPT_CPU_VAES;
+    }
+
+    if ((ecx & bit_VPCLMULQDQ) && (flags & ECRYPT_CPU_AVX2) &&
+        (flags & ECRYPT_CPU_PCLMUL)) {
+        flags |= ECRYPT_CPU_VPCLMUL;
+    }
+
+    return flags;
+}
+#else
+static uint32_t _ecrypt_cpu_probe(void)
+{
+    return 0;
+}
+#endif
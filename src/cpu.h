@@ -0,0 +1,28 @@
+#ifndef ECRYPT_CPU_H
+#define ECRYPT_CPU_H
+
+#include <stdint.h>
+
+/* Instruction set extensions the library knows how to take advantage of.
+ * Only what the running processor (and operating system) actually supports
+ * is ever reported, so a set bit means the matching code path is safe. */
+#define ECRYPT_CPU_SSSE3		(1u << 0)
+#define ECRYPT_CPU_SSE41		(1u << 1)
+#define ECRYPT_CPU_AESNI		(1u << 2)
+#define ECRYPT_CPU_PCLMUL		(1u << 3)
+#define ECRYPT_CPU_AVX2			(1u << 4)
+#define ECRYPT_CPU_AVX512		(1u << 5)	/* F, BW and VL */
+#define ECRYPT_CPU_VAES			(1u << 6)
+#define ECRYPT_CPU_VPCLMUL		(1u << 7)
+#define ECRYPT_CPU_SHA			(1u << 8)	/* SHA-256 only */
+
+/* _ecrypt_cpu_features:
+ *
+ * description:
+ *     Probes the processor once and returns the ECRYPT_CPU_* bits it
+ *     supports.  Always returns 0 on architectures we have no special code
+ *     for, which makes every caller fall back to the portable C paths.
+ *****************************************************************************/
+uint32_t _ecrypt_cpu_features(void);
+
+#endif /* ECRYPT_CPU_H */
@@ -0,0 +1,364 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(ECRYPT_HAVE_GETRANDOM)
+#include <sys/random.h>
+#endif
+
+#include <ecrypt/drbg.h>
+#include "rijndael_impl.h"
+
+/* one generator and its output buffer per thread, for drbg_random */
+struct _drbg_thread_t {
+    drbg_ctx ctx;
+    unsigned long forks;	/* _drbg_forks when ctx was seeded */
+    size_t pos;			/* bytes of buf already handed out */
+    uint8_t buf[DRBG_BUFFER_LENGTH];
+};
+
+static pthread_once_t _drbg_once = PTHREAD_ONCE_INIT;
+static pthread_key_t _drbg_key;
+static int _drbg_key_ok = 0;
+
+/*
+* Bumped in the child after a fork, which would otherwise leave parent and
+* child with the same state and so the same output.  Checking a counter
+* costs nothing; calling getpid on every request would cost a syscall.
+*/
+static volatile unsigned long _drbg_forks = 0;
+
+/* DRBG_SEED_LENGTH bytes of entropy input from the operating system */
+static int
+_drbg_entropy(uint8_t *buf)
+{
+    size_t got = 0;
+    ssize_t n;
+    int fd;
+
+#if defined(ECRYPT_HAVE_GETRANDOM)
+    while (got < DRBG_SEED_LENGTH) {
+        n = getrandom(buf + got, DRBG_SEED_LENGTH - got, 0);
+        if (n > 0) {
+            got += (size_t)n;
+        } else if (n < 0 && errno != EINTR) {
+            break;
+        }
+    }
+    if (got == DRBG_SEED_LENGTH) {
+        return ECRYPT_NO_ERROR;
+    }
+    got = 0;
+#endif
+
+    /* kernels older than getrandom, or seccomp policies that forbid it */
+    fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0) {
+        return ECRYPT_NO_ENTROPY;
+    }
+    while (got < DRBG_SEED_LENGTH) {
+        n = read(fd, buf + got, DRBG_SEED_LENGTH - got);
+        if (n > 0) {
+            got += (size_t)n;
+        } else if (n == 0 || errno != EINTR) {
+            break;
+        }
+    }
+    close(fd);
+
+    return got == DRBG_SEED_LENGTH ? ECRYPT_NO_ERROR : ECRYPT_NO_ENTROPY;
+}
+
+/* ctr += 1, as one 128-bit big-endian number */
+static void
+_drbg_inc128(uint8_t *ctr)
+{
+    int i;
+
+    for (i = 15; i >= 0 && ++ctr[i] == 0; i--) {
+    }
+}
+
+/*
+* CTR_DRBG_Update (SP 800-90A, 10.2.1.2): three blocks of keystream, XORed
+* with provided (DRBG_SEED_LENGTH bytes), become the new Key and V.
+*/
+static void
+_drbg_update(drbg_ctx *ctx, const uint8_t *provided)
+{
+    uint8_t temp[DRBG_SEED_LENGTH];
+    int i;
+
+    memset(temp, 0, sizeof(temp));
+    ctx->aes.impl->ctr(ctx->aes.ek, ctx->aes.Nr, ctx->ctr, temp, temp, 3);
+    for (i = 0; i < DRBG_SEED_LENGTH; i++) {
+        temp[i] ^= provided[i];
+    }
+
+    rijndael_set_key_enc_only(&ctx->aes, temp, 256);
+    memcpy(ctx->ctr, temp + 32, 16);
+    _drbg_inc128(ctx->ctr);
+
+    memset(temp, 0, sizeof(temp));
+}
+
+/* entropy_input XOR the other input, padded with zeros */
+static int
+_drbg_seed_material(uint8_t *seed, const uint8_t *entropy,
+    size_t entropy_len, const uint8_t *in, size_t in_len)
+{
+    size_t i;
+    int err;
+
+    if ((entropy == NULL && entropy_len != 0) || (in == NULL && in_len != 0)) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if ((entropy != NULL && entropy_len != DRBG_SEED_LENGTH) ||
+        in_len > DRBG_SEED_LENGTH) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    if (entropy != NULL) {
+        memcpy(seed, entropy, DRBG_SEED_LENGTH);
+    } else if ((err = _drbg_entropy(seed)) != ECRYPT_NO_ERROR) {
+        return err;
+    }
+
+    for (i = 0; i < in_len; i++) {
+        seed[i] ^= in[i];
+    }
+
+    return ECRYPT_NO_ERROR;
+}
+
+int
+drbg_instantiate(drbg_ctx *ctx, const uint8_t *entropy, size_t entropy_len,
+    const uint8_t *pers, size_t pers_len)
+{
+    uint8_t seed[DRBG_SEED_LENGTH];
+    int err;
+
+    if (ctx == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    err = _drbg_seed_material(seed, entropy, entropy_len, pers, pers_len);
+    if (err != ECRYPT_NO_ERROR) {
+        return err;
+    }
+
+    /* Key = 0, V = 0 */
+    memset(ctx, 0, sizeof(*ctx));
+    rijndael_set_key_enc_only(&ctx->aes, ctx->ctr, 256);
+    ctx->ctr[15] = 1;
+
+    _drbg_update(ctx, seed);
+    ctx->reseed_counter = 1;
+    ctx->instantiated = 1;
+
+    memset(seed, 0, sizeof(seed));
+    return ECRYPT_NO_ERROR;
+}
+
+int
+drbg_reseed(drbg_ctx *ctx, const uint8_t *entropy, size_t entropy_len,
+    const uint8_t *adin, size_t adin_len)
+{
+    uint8_t seed[DRBG_SEED_LENGTH];
+    int err;
+
+    if (ctx == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (!ctx->instantiated) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    err = _drbg_seed_material(seed, entropy, entropy_len, adin, adin_len);
+    if (err != ECRYPT_NO_ERROR) {
+        return err;
+    }
+
+    _drbg_update(ctx, seed);
+    ctx->reseed_counter = 1;
+
+    memset(seed, 0, sizeof(seed));
+    return ECRYPT_NO_ERROR;
+}
+
+int
+drbg_generate(drbg_ctx *ctx, uint8_t *out, size_t len, const uint8_t *adin,
+    size_t adin_len)
+{
+    uint8_t extra[DRBG_SEED_LENGTH], block[16];
+    size_t blocks = len / 16;
+    int err;
+
+    if (ctx == NULL || (out == NULL && len != 0) ||
+        (adin == NULL && adin_len != 0)) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (!ctx->instantiated) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    if (len > DRBG_MAX_REQUEST || adin_len > DRBG_SEED_LENGTH) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    if (ctx->reseed_counter > DRBG_RESEED_INTERVAL) {
+        err = drbg_reseed(ctx, NULL, 0, NULL, 0);
+        if (err != ECRYPT_NO_ERROR) {
+            return err;
+        }
+    }
+
+    memset(extra, 0, sizeof(extra));
+    if (adin_len > 0) {
+        memcpy(extra, adin, adin_len);
+        _drbg_update(ctx, extra);
+    }
+
+    /* the output is the keystream for V + 1, V + 2, ... */
+    memset(out, 0, 16 * blocks);
+    ctx->aes.impl->ctr(ctx->aes.ek, ctx->aes.Nr, ctx->ctr, out, out, blocks);
+    if (len % 16 != 0) {
+        memset(block, 0, sizeof(block));
+        ctx->aes.impl->ctr(ctx->aes.ek, ctx->aes.Nr, ctx->ctr, block, block,
+            1);
+        memcpy(out + 16 * blocks, block, len % 16);
+        memset(block, 0, sizeof(block));
+    }
+
+    _drbg_update(ctx, extra);
+    ctx->reseed_counter++;
+
+    memset(extra, 0, sizeof(extra));
+    return ECRYPT_NO_ERROR;
+}
+
+int
+drbg_release(drbg_ctx *ctx)
+{
+    if (ctx == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    return ECRYPT_NO_ERROR;
+}
+
+static void
+_drbg_thread_free(void *p)
+{
+    memset(p, 0, sizeof(struct _drbg_thread_t));
+    free(p);
+}
+
+static void
+_drbg_atfork_child(void)
+{
+    _drbg_forks++;
+}
+
+static void
+_drbg_init_once(void)
+{
+    _drbg_key_ok = pthread_key_create(&_drbg_key, _drbg_thread_free) == 0;
+    pthread_atfork(NULL, NULL, _drbg_atfork_child);
+}
+
+/* the calling thread's generator, seeded; NULL if that cannot be done */
+static struct _drbg_thread_t *
+_drbg_thread(void)
+{
+    struct _drbg_thread_t *t;
+
+    pthread_once(&_drbg_once, _drbg_init_once);
+    if (!_drbg_key_ok) {
+        return NULL;
+    }
+
+    t = (struct _drbg_thread_t *)pthread_getspecific(_drbg_key);
+    if (t == NULL) {
+        t = (struct _drbg_thread_t *)calloc(1, sizeof(*t));
+        if (t == NULL) {
+            return NULL;
+        }
+        if (pthread_setspecific(_drbg_key, t) != 0) {
+            free(t);
+            return NULL;
+        }
+    }
+
+    if (!t->ctx.instantiated || t->forks != _drbg_forks) {
+        if (drbg_instantiate(&t->ctx, NULL, 0, NULL, 0) != ECRYPT_NO_ERROR) {
+            return NULL;
+        }
+        t->forks = _drbg_forks;
+        memset(t->buf, 0, sizeof(t->buf));
+        t->pos = sizeof(t->buf);
+    }
+
+    return t;
+}
+
+int
+drbg_random(uint8_t *out, size_t len)
+{
+    struct _drbg_thread_t *t;
+    uint8_t *p = out;
+    size_t left = len, n;
+
+    if (out == NULL && len != 0) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if ((t = _drbg_thread()) == NULL) {
+        memset(out, 0, len);
+        return ECRYPT_NO_ENTROPY;
+    }
+
+    while (left > 0) {
+        /* big requests skip the buffer */
+        if (t->pos == sizeof(t->buf) && left >= sizeof(t->buf)) {
+            n = left < DRBG_MAX_REQUEST ? left : DRBG_MAX_REQUEST;
+            if (drbg_generate(&t->ctx, p, n, NULL, 0) != ECRYPT_NO_ERROR) {
+                break;
+            }
+            p += n;
+            left -= n;
+            continue;
+        }
+
+        if (t->pos == sizeof(t->buf)) {
+            if (drbg_generate(&t->ctx, t->buf, sizeof(t->buf), NULL, 0) !=
+                ECRYPT_NO_ERROR) {
+                break;
+            }
+            t->pos = 0;
+        }
+
+        /* what is handed out is wiped, so it cannot be given twice */
+        n = sizeof(t->buf) - t->pos;
+        n = left < n ? left : n;
+        memcpy(p, t->buf + t->pos, n);
+        memset(t->buf + t->pos, 0, n);
+        t->pos += n;
+        p += n;
+        left -= n;
+    }
+
+    if (left > 0) {
+        memset(out, 0, len);
+        return ECRYPT_NO_ENTROPY;
+    }
+
+    return ECRYPT_NO_ERROR;
+}
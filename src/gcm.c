@@ -0,0 +1,660 @@
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <ecrypt/gcm.h>
+#include "cpu.h"
+#include "gcm_impl.h"
+#include "rijndael_impl.h"
+
+/* where a context is in a message */
+#define GCM_STATE_IDLE		(0)	/* keyed, no message started */
+#define GCM_STATE_AAD		(1)	/* started, still taking AAD */
+#define GCM_STATE_TEXT		(2)	/* taking plaintext or ciphertext */
+
+/* SP 800-38D: at most 2^39 - 256 bits of text per message */
+#define GCM_MAX_TEXT		((((uint64_t)1) << 36) - 32)
+
+/*
+* Without a stitched implementation, CTR and GHASH take turns over chunks
+* this size, so the data is still only brought into the cache once.
+*/
+#define GCM_CHUNK_BLOCKS	(32)
+
+/* the GHASH code gcm_set_key hands out, resolved once on first use */
+static const struct gcm_impl_t *_gcm_impl = NULL;
+static pthread_once_t _gcm_impl_once = PTHREAD_ONCE_INIT;
+
+static void _gcm_table_init(uint64_t (*Htable)[2], const uint8_t *H);
+static void _gcm_table_ghash(const uint64_t (*Htable)[2], uint8_t *X,
+    const uint8_t *in, size_t blocks);
+
+const struct gcm_impl_t _gcm_table_impl = {
+    "table",
+    _gcm_table_init,
+    _gcm_table_ghash,
+    NULL,
+    NULL
+};
+
+static uint64_t
+_gcm_load_be64(const uint8_t *p)
+{
+    return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) |
+        ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32) |
+        ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) |
+        ((uint64_t)p[6] << 8) | (uint64_t)p[7];
+}
+
+static void
+_gcm_store_be64(uint8_t *p, uint64_t v)
+{
+    int i;
+
+    for (i = 7; i >= 0; i--) {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+/*
+* The 4-bit method from Shoup, as described in the GCM specification:
+* Htable[n] = n * H for every 4-bit n, and the product is built a nibble
+* at a time, folding the bits shifted out back in through rem_4bit.
+* Htable[i][0] holds the first 64 bits of the field element.
+*/
+static const uint64_t rem_4bit[16] = {
+    (uint64_t)0x0000 << 48, (uint64_t)0x1c20 << 48,
+    (uint64_t)0x3840 << 48, (uint64_t)0x2460 << 48,
+    (uint64_t)0x7080 << 48, (uint64_t)0x6ca0 << 48,
+    (uint64_t)0x48c0 << 48, (uint64_t)0x54e0 << 48,
+    (uint64_t)0xe100 << 48, (uint64_t)0xfd20 << 48,
+    (uint64_t)0xd940 << 48, (uint64_t)0xc560 << 48,
+    (uint64_t)0x9180 << 48, (uint64_t)0x8da0 << 48,
+    (uint64_t)0xa9c0 << 48, (uint64_t)0xb5e0 << 48
+};
+
+static void
+_gcm_table_init(uint64_t (*Htable)[2], const uint8_t *H)
+{
+    uint64_t hi, lo, t;
+    int i, j;
+
+    hi = _gcm_load_be64(H);
+    lo = _gcm_load_be64(H + 8);
+
+    /* Htable[8] = H, and each halving is a multiplication by x */
+    Htable[0][0] = Htable[0][1] = 0;
+    for (i = 8; i > 0; i >>= 1) {
+        Htable[i][0] = hi;
+        Htable[i][1] = lo;
+
+        t = ((uint64_t)0xe1 << 56) & (0 - (lo & 1));
+        lo = (hi << 63) | (lo >> 1);
+        hi = (hi >> 1) ^ t;
+    }
+
+    /* the rest are sums of those four */
+    for (i = 2; i < 16; i <<= 1) {
+        for (j = 1; j < i; j++) {
+            Htable[i + j][0] = Htable[i][0] ^ Htable[j][0];
+            Htable[i + j][1] = Htable[i][1] ^ Htable[j][1];
+        }
+    }
+}
+
+static void
+_gcm_table_gmult(const uint64_t (*Htable)[2], uint8_t *X)
+{
+    uint64_t hi, lo, rem;
+    int i, n;
+
+    hi = lo = 0;
+    for (i = 15; i >= 0; i--) {
+        /* low nibble, then high nibble, shifting Z by 4 before each */
+        n = X[i] & 0x0f;
+        rem = lo & 0x0f;
+        lo = (hi << 60) | (lo >> 4);
+        hi = (hi >> 4) ^ rem_4bit[rem];
+        hi ^= Htable[n][0];
+        lo ^= Htable[n][1];
+
+        n = X[i] >> 4;
+        rem = lo & 0x0f;
+        lo = (hi << 60) | (lo >> 4);
+        hi = (hi >> 4) ^ rem_4bit[rem];
+        hi ^= Htable[n][0];
+        lo ^= Htable[n][1];
+    }
+
+    _gcm_store_be64(X, hi);
+    _gcm_store_be64(X + 8, lo);
+}
+
+static void
+_gcm_table_ghash(const uint64_t (*Htable)[2], uint8_t *X, const uint8_t *in,
+    size_t blocks)
+{
+    int i;
+
+    for (; blocks > 0; blocks--) {
+        for (i = 0; i < 16; i++) {
+            X[i] ^= in[i];
+        }
+        _gcm_table_gmult(Htable, X);
+        in += 16;
+    }
+}
+
+static const struct gcm_impl_t *
+_gcm_best_impl(void)
+{
+#if defined(ECRYPT_HAVE_VAES)
+    if ((_ecrypt_cpu_features() & ECRYPT_CPU_VAES) &&
+        (_ecrypt_cpu_features() & ECRYPT_CPU_VPCLMUL)) {
+        return (_ecrypt_cpu_features() & ECRYPT_CPU_AVX512) ?
+            &_gcm_vaes512_impl : &_gcm_vaes256_impl;
+    }
+#endif
+
+#if defined(ECRYPT_HAVE_PCLMUL)
+    if (_ecrypt_cpu_features() & ECRYPT_CPU_PCLMUL) {
+        return &_gcm_aesni_impl;
+    }
+#endif
+
+    return &_gcm_table_impl;
+}
+
+static void
+_gcm_impl_init(void)
+{
+    _gcm_impl = _gcm_best_impl();
+}
+
+static const struct gcm_impl_t *
+_gcm_current_impl(void)
+{
+    pthread_once(&_gcm_impl_once, _gcm_impl_init);
+    return _gcm_impl;
+}
+
+int
+gcm_select_impl(int impl)
+{
+    /* before the choice is stored, so that no first use overwrites it */
+    pthread_once(&_gcm_impl_once, _gcm_impl_init);
+
+    switch (impl) {
+    case GCM_IMPL_AUTO:
+        _gcm_impl = _gcm_best_impl();
+        return ECRYPT_NO_ERROR;
+    case GCM_IMPL_TABLE:
+        _gcm_impl = &_gcm_table_impl;
+        return ECRYPT_NO_ERROR;
+    case GCM_IMPL_PCLMUL:
+    case GCM_IMPL_AESNI:
+#if defined(ECRYPT_HAVE_PCLMUL)
+        if (_ecrypt_cpu_features() & ECRYPT_CPU_PCLMUL) {
+            _gcm_impl = impl == GCM_IMPL_AESNI ? &_gcm_aesni_impl :
+                &_gcm_pclmul_impl;
+            return ECRYPT_NO_ERROR;
+        }
+#endif
+        return ECRYPT_INVALID_PARAMETERS;
+    case GCM_IMPL_VAES:
+#if defined(ECRYPT_HAVE_VAES)
+        if ((_ecrypt_cpu_features() & ECRYPT_CPU_VAES) &&
+            (_ecrypt_cpu_features() & ECRYPT_CPU_VPCLMUL)) {
+            _gcm_impl = (_ecrypt_cpu_features() & ECRYPT_CPU_AVX512) ?
+                &_gcm_vaes512_impl : &_gcm_vaes256_impl;
+            return ECRYPT_NO_ERROR;
+        }
+#endif
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    return ECRYPT_INVALID_PARAMETERS;
+}
+
+/*
+* The stitched code runs the AES rounds itself, so it has to match the
+* block cipher code of the context: VAES of the same width for the VAES
+* tables, AES-NI for AES-NI or the other VAES width, and plain PCLMULQDQ
+* for anything else.
+*/
+static const struct gcm_impl_t *
+_gcm_stitched_impl(const struct gcm_impl_t *impl,
+    const struct rijndael_impl_t *aes)
+{
+#if defined(ECRYPT_HAVE_VAES)
+    if (impl == &_gcm_vaes512_impl || impl == &_gcm_vaes256_impl) {
+        if (aes->base == &_rijndael_vaes512_impl) {
+            return &_gcm_vaes512_impl;
+        }
+        if (aes->base == &_rijndael_vaes256_impl) {
+            return &_gcm_vaes256_impl;
+        }
+        impl = &_gcm_aesni_impl;
+    }
+
+    if (impl == &_gcm_aesni_impl &&
+        (aes->base == &_rijndael_vaes512_impl ||
+        aes->base == &_rijndael_vaes256_impl)) {
+        return impl;
+    }
+#endif
+
+#if defined(ECRYPT_HAVE_PCLMUL) && defined(ECRYPT_HAVE_AESNI)
+    if (impl == &_gcm_aesni_impl && aes->base != &_rijndael_aesni_impl) {
+        impl = &_gcm_pclmul_impl;
+    }
+#endif
+
+    return impl;
+}
+
+const char *
+gcm_impl_name(const gcm_ctx *ctx)
+{
+    if (ctx != NULL && ctx->impl != NULL) {
+        return ctx->impl->name;
+    }
+
+    return _gcm_current_impl()->name;
+}
+
+int
+gcm_set_key(gcm_ctx *ctx, const uint8_t *key, uint32_t klen)
+{
+    const struct gcm_impl_t *impl;
+    uint8_t H[16];
+
+    if (ctx == NULL || key == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (klen != 16 && klen != 24 && klen != 32) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    if (rijndael_set_key_enc_only(&ctx->aes, key, klen * 8) != 0) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    impl = _gcm_stitched_impl(_gcm_current_impl(), ctx->aes.impl);
+
+    memset(H, 0, sizeof(H));
+    rijndael_encrypt(&ctx->aes, H, H);
+    impl->init(ctx->Htable, H);
+    ctx->impl = impl;
+    ctx->state = GCM_STATE_IDLE;
+
+    memset(H, 0, sizeof(H));
+    return ECRYPT_NO_ERROR;
+}
+
+int
+gcm_release(gcm_ctx *ctx)
+{
+    if (ctx == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    return ECRYPT_NO_ERROR;
+}
+
+/* the counter only ever increments its low 32 bits */
+static void
+_gcm_inc32(uint8_t *ctr)
+{
+    int i;
+
+    for (i = 15; i >= 12 && ++ctr[i] == 0; i--) {
+    }
+}
+
+/* X *= H, after a partial block has been XORed into it */
+static void
+_gcm_flush(gcm_ctx *ctx)
+{
+    static const uint8_t zero[16] = { 0 };
+
+    if (ctx->pos != 0) {
+        ctx->impl->ghash(ctx->Htable, ctx->X, zero, 1);
+        ctx->pos = 0;
+    }
+}
+
+/* hashes data that does not line up with blocks; ctx->pos tracks where */
+static void
+_gcm_hash_bytes(gcm_ctx *ctx, const uint8_t *in, size_t len)
+{
+    size_t blocks;
+
+    for (; len > 0 && ctx->pos != 0; len--) {
+        ctx->X[ctx->pos++] ^= *in++;
+        if (ctx->pos == 16) {
+            _gcm_flush(ctx);
+        }
+    }
+
+    blocks = len / 16;
+    ctx->impl->ghash(ctx->Htable, ctx->X, in, blocks);
+    in += 16 * blocks;
+    len -= 16 * blocks;
+
+    for (; len > 0; len--) {
+        ctx->X[ctx->pos++] ^= *in++;
+    }
+}
+
+/* en/decrypts up to a block boundary with the keystream left in ctx->ks */
+static void
+_gcm_crypt_bytes(gcm_ctx *ctx, const uint8_t *in, uint8_t *out, size_t len,
+    int decrypt)
+{
+    uint8_t c;
+
+    for (; len > 0; len--) {
+        c = decrypt ? *in : (uint8_t)(*in ^ ctx->ks[ctx->pos]);
+        *out++ = (uint8_t)(*in++ ^ ctx->ks[ctx->pos]);
+        ctx->X[ctx->pos++] ^= c;
+    }
+
+    if (ctx->pos == 16) {
+        _gcm_flush(ctx);
+    }
+}
+
+static void
+_gcm_crypt_blocks(gcm_ctx *ctx, const uint8_t *in, uint8_t *out,
+    size_t blocks, int decrypt)
+{
+    const struct rijndael_impl_t *aes = ctx->aes.impl;
+    uint8_t top[12];
+    uint64_t room;
+    size_t n, m;
+
+    while (blocks > 0) {
+        /* never let the whole-block code carry out of the low 32 bits */
+        room = ((uint64_t)1 << 32) - (((uint64_t)ctx->ctr[12] << 24) |
+            ((uint64_t)ctx->ctr[13] << 16) | ((uint64_t)ctx->ctr[14] << 8) |
+            (uint64_t)ctx->ctr[15]);
+        n = (uint64_t)blocks > room ? (size_t)room : blocks;
+        memcpy(top, ctx->ctr, 12);
+
+        if (ctx->impl->encrypt != NULL) {
+            (decrypt ? ctx->impl->decrypt : ctx->impl->encrypt)(ctx->aes.ek,
+                ctx->aes.Nr, ctx->Htable, ctx->X, ctx->ctr, in, out, n);
+        } else {
+            for (m = 0; m < n; m += GCM_CHUNK_BLOCKS) {
+                size_t c = n - m < GCM_CHUNK_BLOCKS ? n - m :
+                    GCM_CHUNK_BLOCKS;
+
+                if (decrypt) {
+                    ctx->impl->ghash(ctx->Htable, ctx->X, in + 16 * m, c);
+                }
+                aes->ctr(ctx->aes.ek, ctx->aes.Nr, ctx->ctr, in + 16 * m,
+                    out + 16 * m, c);
+                if (!decrypt) {
+                    ctx->impl->ghash(ctx->Htable, ctx->X, out + 16 * m, c);
+                }
+            }
+        }
+
+        if ((uint64_t)n == room) {
+            memcpy(ctx->ctr, top, 12);
+        }
+
+        in += 16 * n;
+        out += 16 * n;
+        blocks -= n;
+    }
+}
+
+int
+gcm_init(gcm_ctx *ctx, const uint8_t *iv, size_t iv_len)
+{
+    uint8_t len[16];
+
+    if (ctx == NULL || iv == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (ctx->impl == NULL) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    if (iv_len == 0) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    memset(ctx->X, 0, sizeof(ctx->X));
+    ctx->pos = 0;
+
+    if (iv_len == 12) {
+        memcpy(ctx->J0, iv, 12);
+        ctx->J0[12] = ctx->J0[13] = ctx->J0[14] = 0;
+        ctx->J0[15] = 1;
+    } else {
+        /* J0 = GHASH(IV || 0-padding || [0]64 || [len(IV)]64) */
+        _gcm_hash_bytes(ctx, iv, iv_len);
+        _gcm_flush(ctx);
+        memset(len, 0, 8);
+        _gcm_store_be64(len + 8, (uint64_t)iv_len * 8);
+        ctx->impl->ghash(ctx->Htable, ctx->X, len, 1);
+
+        memcpy(ctx->J0, ctx->X, 16);
+        memset(ctx->X, 0, sizeof(ctx->X));
+    }
+
+    memcpy(ctx->ctr, ctx->J0, 16);
+    _gcm_inc32(ctx->ctr);
+    memset(ctx->ks, 0, sizeof(ctx->ks));
+    ctx->aad_len = 0;
+    ctx->text_len = 0;
+    ctx->state = GCM_STATE_AAD;
+
+    return ECRYPT_NO_ERROR;
+}
+
+int
+gcm_aad(gcm_ctx *ctx, const uint8_t *aad, size_t aad_len)
+{
+    if (ctx == NULL || (aad == NULL && aad_len > 0)) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (ctx->state != GCM_STATE_AAD) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    _gcm_hash_bytes(ctx, aad, aad_len);
+    ctx->aad_len += aad_len;
+
+    return ECRYPT_NO_ERROR;
+}
+
+static int
+_gcm_update(gcm_ctx *ctx, const uint8_t *in, size_t len, uint8_t *out,
+    int decrypt)
+{
+    size_t n, blocks;
+
+    if (ctx == NULL || (len > 0 && (in == NULL || out == NULL))) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (ctx->state == GCM_STATE_IDLE) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    if ((uint64_t)len > GCM_MAX_TEXT - ctx->text_len) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    /* the AAD is zero-padded to a whole block before the text starts */
+    if (ctx->state == GCM_STATE_AAD) {
+        _gcm_flush(ctx);
+        ctx->state = GCM_STATE_TEXT;
+    }
+    ctx->text_len += len;
+
+    /* finish the keystream block the last call started */
+    if (ctx->pos != 0) {
+        n = 16 - ctx->pos < len ? 16 - ctx->pos : len;
+        _gcm_crypt_bytes(ctx, in, out, n, decrypt);
+        in += n;
+        out += n;
+        len -= n;
+    }
+
+    blocks = len / 16;
+    _gcm_crypt_blocks(ctx, in, out, blocks, decrypt);
+    in += 16 * blocks;
+    out += 16 * blocks;
+    len -= 16 * blocks;
+
+    /* and start a new one for whatever is left */
+    if (len > 0) {
+        ctx->aes.impl->encrypt(ctx->aes.ek, ctx->aes.Nr, ctx->ctr, ctx->ks);
+        _gcm_inc32(ctx->ctr);
+        _gcm_crypt_bytes(ctx, in, out, len, decrypt);
+    }
+
+    return ECRYPT_NO_ERROR;
+}
+
+int
+gcm_encrypt_update(gcm_ctx *ctx, const uint8_t *pt, size_t pt_len,
+    uint8_t *out)
+{
+    return _gcm_update(ctx, pt, pt_len, out, 0);
+}
+
+int
+gcm_decrypt_update(gcm_ctx *ctx, const uint8_t *ct, size_t ct_len,
+    uint8_t *out)
+{
+    return _gcm_update(ctx, ct, ct_len, out, 1);
+}
+
+/* the full 16 byte tag; the message is over afterwards */
+static int
+_gcm_final(gcm_ctx *ctx, size_t tag_len, uint8_t *S)
+{
+    uint8_t len[16];
+    int i;
+
+    if (ctx->state == GCM_STATE_IDLE) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    if (tag_len != 4 && tag_len != 8 && (tag_len < 12 || tag_len > 16)) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    _gcm_flush(ctx);
+    _gcm_store_be64(len, ctx->aad_len * 8);
+    _gcm_store_be64(len + 8, ctx->text_len * 8);
+    ctx->impl->ghash(ctx->Htable, ctx->X, len, 1);
+
+    rijndael_encrypt(&ctx->aes, ctx->J0, S);
+    for (i = 0; i < 16; i++) {
+        S[i] ^= ctx->X[i];
+    }
+
+    memset(ctx->J0, 0, sizeof(ctx->J0));
+    memset(ctx->ctr, 0, sizeof(ctx->ctr));
+    memset(ctx->X, 0, sizeof(ctx->X));
+    memset(ctx->ks, 0, sizeof(ctx->ks));
+    ctx->aad_len = ctx->text_len = 0;
+    ctx->state = GCM_STATE_IDLE;
+
+    return ECRYPT_NO_ERROR;
+}
+
+int
+gcm_encrypt_final(gcm_ctx *ctx, uint8_t *tag, size_t tag_len)
+{
+    uint8_t S[16];
+    int err;
+
+    if (ctx == NULL || tag == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    err = _gcm_final(ctx, tag_len, S);
+    if (err == ECRYPT_NO_ERROR) {
+        memcpy(tag, S, tag_len);
+    }
+
+    memset(S, 0, sizeof(S));
+    return err;
+}
+
+int
+gcm_decrypt_final(gcm_ctx *ctx, const uint8_t *tag, size_t tag_len)
+{
+    uint8_t S[16], diff;
+    size_t i;
+    int err;
+
+    if (ctx == NULL || tag == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    err = _gcm_final(ctx, tag_len, S);
+    if (err != ECRYPT_NO_ERROR) {
+        return err;
+    }
+
+    /* no early exit: the time taken says nothing about where they differ */
+    diff = 0;
+    for (i = 0; i < tag_len; i++) {
+        diff |= S[i] ^ tag[i];
+    }
+
+    memset(S, 0, sizeof(S));
+    return diff == 0 ? ECRYPT_NO_ERROR : ECRYPT_AUTH_FAILED;
+}
+
+int
+gcm_encrypt(gcm_ctx *ctx, const uint8_t *iv, size_t iv_len,
+    const uint8_t *aad, size_t aad_len, const uint8_t *pt, size_t pt_len,
+    uint8_t *out, uint8_t *tag, size_t tag_len)
+{
+    int err;
+
+    if ((err = gcm_init(ctx, iv, iv_len)) != ECRYPT_NO_ERROR ||
+        (err = gcm_aad(ctx, aad, aad_len)) != ECRYPT_NO_ERROR ||
+        (err = gcm_encrypt_update(ctx, pt, pt_len, out)) != ECRYPT_NO_ERROR) {
+        return err;
+    }
+
+    return gcm_encrypt_final(ctx, tag, tag_len);
+}
+
+int
+gcm_decrypt(gcm_ctx *ctx, const uint8_t *iv, size_t iv_len,
+    const uint8_t *aad, size_t aad_len, const uint8_t *ct, size_t ct_len,
+    uint8_t *out, const uint8_t *tag, size_t tag_len)
+{
+    int err;
+
+    if ((err = gcm_init(ctx, iv, iv_len)) != ECRYPT_NO_ERROR ||
+        (err = gcm_aad(ctx, aad, aad_len)) != ECRYPT_NO_ERROR ||
+        (err = gcm_decrypt_update(ctx, ct, ct_len, out)) != ECRYPT_NO_ERROR) {
+        return err;
+    }
+
+    err = gcm_decrypt_final(ctx, tag, tag_len);
+    if (err == ECRYPT_AUTH_FAILED && ct_len > 0) {
+        memset(out, 0, ct_len);
+    }
+
+    return err;
+}
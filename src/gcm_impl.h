@@ -0,0 +1,59 @@
+#ifndef ECRYPT_GCM_IMPL_H
+#define ECRYPT_GCM_IMPL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ecrypt/gcm.h>
+
+/*
+* Private to the library.  Every gcm_ctx points at one of these tables;
+* gcm_set_key picks the fastest one the processor can run.  Unlike the
+* rijndael implementations, they do not share a layout for Htable, so a
+* context is tied to the table it was keyed with.
+*/
+struct gcm_impl_t {
+    const char *name;
+
+    /* fills Htable from the hash key H = E(0^128) */
+    void (*init)(uint64_t (*Htable)[2], const uint8_t *H);
+
+    /* X = (...((X ^ in[0]) * H ^ in[1]) * H ...) * H over whole blocks */
+    void (*ghash)(const uint64_t (*Htable)[2], uint8_t *X, const uint8_t *in,
+        size_t blocks);
+
+    /*
+    * Optional.  CTR and GHASH over whole blocks in a single pass, with
+    * ctr and X advanced as the separate code would advance them.  Callers
+    * guarantee the low 32 bits of ctr do not wrap during one call.  NULL
+    * means the mode code runs ctx->aes.impl->ctr and ghash over small
+    * chunks instead.
+    */
+    void (*encrypt)(const uint32_t *rk, int Nr, const uint64_t (*Htable)[2],
+        uint8_t *X, uint8_t *ctr, const uint8_t *in, uint8_t *out,
+        size_t blocks);
+    void (*decrypt)(const uint32_t *rk, int Nr, const uint64_t (*Htable)[2],
+        uint8_t *X, uint8_t *ctr, const uint8_t *in, uint8_t *out,
+        size_t blocks);
+};
+
+/* portable 4-bit table code from gcm.c */
+extern const struct gcm_impl_t _gcm_table_impl;
+
+#if defined(ECRYPT_HAVE_PCLMUL)
+/* PCLMULQDQ GHASH, gcm_pclmul.c */
+extern const struct gcm_impl_t _gcm_pclmul_impl;
+
+/* the same, stitched into AES-NI CTR, gcm_pclmul.c */
+extern const struct gcm_impl_t _gcm_aesni_impl;
+#endif
+
+#if defined(ECRYPT_HAVE_VAES)
+/*
+* VPCLMULQDQ GHASH stitched into VAES CTR, rijndael_vaes*.c.  Htable holds
+* H to H^8 (vaes256) or H^16 (vaes512).
+*/
+extern const struct gcm_impl_t _gcm_vaes256_impl;
+extern const struct gcm_impl_t _gcm_vaes512_impl;
+#endif
+
+#endif /* ECRYPT_GCM_IMPL_H */
@@ -0,0 +1,266 @@
+#include <string.h>
+
+#include <wmmintrin.h>
+
+#include "gcm_x86.h"
+
+static void _gcm_pclmul_init(uint64_t (*Htable)[2], const uint8_t *H);
+static void _gcm_pclmul_ghash(const uint64_t (*Htable)[2], uint8_t *X,
+    const uint8_t *in, size_t blocks);
+static void _gcm_aesni_encrypt(const uint32_t *rk, int Nr,
+    const uint64_t (*Htable)[2], uint8_t *X, uint8_t *ctr,
+    const uint8_t *in, uint8_t *out, size_t blocks);
+static void _gcm_aesni_decrypt(const uint32_t *rk, int Nr,
+    const uint64_t (*Htable)[2], uint8_t *X, uint8_t *ctr,
+    const uint8_t *in, uint8_t *out, size_t blocks);
+
+const struct gcm_impl_t _gcm_pclmul_impl = {
+    "pclmul",
+    _gcm_pclmul_init,
+    _gcm_pclmul_ghash,
+    NULL,
+    NULL
+};
+
+const struct gcm_impl_t _gcm_aesni_impl = {
+    "aesni",
+    _gcm_pclmul_init,
+    _gcm_pclmul_ghash,
+    _gcm_aesni_encrypt,
+    _gcm_aesni_decrypt
+};
+
+/* how many blocks are hashed with a single reduction; Htable holds H^1..H^8 */
+#define GCM_AGGREGATE		(8)
+
+/* x = (x ^ in[0]) * H^8 ^ in[1] * H^7 ^ ... ^ in[7] * H */
+static inline __m128i
+_gcm_ghash8(const __m128i *hp, __m128i x, const uint8_t *in)
+{
+    __m128i lo, mid, hi, c;
+    int i;
+
+    lo = mid = hi = _mm_setzero_si128();
+    for (i = 0; i < GCM_AGGREGATE; i++) {
+        c = GCM_LOAD(in + 16 * i);
+        if (i == 0) {
+            c = _mm_xor_si128(c, x);
+        }
+        _gcm_clmul_acc(c, hp[GCM_AGGREGATE - 1 - i], &lo, &mid, &hi);
+    }
+
+    return _gcm_reduce(lo, mid, hi);
+}
+
+static void
+_gcm_load_powers(__m128i *hp, const uint64_t (*Htable)[2])
+{
+    int i;
+
+    for (i = 0; i < GCM_AGGREGATE; i++) {
+        hp[i] = _mm_loadu_si128((const __m128i *)Htable[i]);
+    }
+}
+
+/* Htable[i] = H^(i+1), byte reversed */
+static void
+_gcm_pclmul_init(uint64_t (*Htable)[2], const uint8_t *H)
+{
+    __m128i h, p;
+    int i;
+
+    h = GCM_LOAD(H);
+    p = h;
+    _mm_storeu_si128((__m128i *)Htable[0], p);
+    for (i = 1; i < GCM_AGGREGATE; i++) {
+        p = _gcm_mul(p, h);
+        _mm_storeu_si128((__m128i *)Htable[i], p);
+    }
+}
+
+static void
+_gcm_pclmul_ghash(const uint64_t (*Htable)[2], uint8_t *X,
+    const uint8_t *in, size_t blocks)
+{
+    __m128i hp[GCM_AGGREGATE], x;
+
+    _gcm_load_powers(hp, Htable);
+    x = GCM_LOAD(X);
+
+    for (; blocks >= GCM_AGGREGATE; blocks -= GCM_AGGREGATE) {
+        x = _gcm_ghash8(hp, x, in);
+        in += 16 * GCM_AGGREGATE;
+    }
+
+    for (; blocks > 0; blocks--) {
+        x = _gcm_mul(_mm_xor_si128(x, GCM_LOAD(in)), hp[0]);
+        in += 16;
+    }
+
+    GCM_STORE(X, x);
+}
+
+/* one AES round on all eight counter blocks */
+#define GCM_ROUND8(op, x, k) do { \
+    (x)[0] = op((x)[0], (k)); (x)[1] = op((x)[1], (k)); \
+    (x)[2] = op((x)[2], (k)); (x)[3] = op((x)[3], (k)); \
+    (x)[4] = op((x)[4], (k)); (x)[5] = op((x)[5], (k)); \
+    (x)[6] = op((x)[6], (k)); (x)[7] = op((x)[7], (k)); \
+} while (0)
+
+/* one round, plus the GHASH multiply for block i of g */
+#define GCM_STITCH(i) do { \
+    GCM_ROUND8(_mm_aesenc_si128, b, k[(i) + 1]); \
+    _gcm_clmul_acc(GCM_LOAD(g + 16 * (i)), hp[GCM_AGGREGATE - 1 - (i)], \
+        &plo, &pmid, &phi); \
+} while (0)
+
+/*
+* Eight counter blocks go through the AES rounds while the eight blocks of
+* ciphertext in g are hashed, one carry-less multiply per round.  The two
+* instruction streams are independent, so the multiplies mostly fill the
+* gaps the AESENC latency leaves anyway.  With g == NULL only the AES half
+* runs and x comes back unchanged.  in may equal g: all of g is read
+* before out is written.
+*/
+static inline __m128i
+_gcm_aesni_stitch8(const __m128i *k, int Nr, const __m128i *hp, __m128i x,
+    const uint8_t *g, uint64_t *hi, uint64_t *lo, const uint8_t *in,
+    uint8_t *out)
+{
+    __m128i b[GCM_AGGREGATE], plo, pmid, phi;
+    int i, r;
+
+    for (i = 0; i < GCM_AGGREGATE; i++) {
+        b[i] = _mm_xor_si128(_rijndael_ctr_block(hi, lo), k[0]);
+    }
+
+    /* Nr >= 10, so all eight multiplies fit in the first eight rounds */
+    r = 1;
+    if (g != NULL) {
+        GCM_ROUND8(_mm_aesenc_si128, b, k[1]);
+        plo = pmid = phi = _mm_setzero_si128();
+        _gcm_clmul_acc(_mm_xor_si128(GCM_LOAD(g), x), hp[GCM_AGGREGATE - 1],
+            &plo, &pmid, &phi);
+        GCM_STITCH(1);
+        GCM_STITCH(2);
+        GCM_STITCH(3);
+        GCM_STITCH(4);
+        GCM_STITCH(5);
+        GCM_STITCH(6);
+        GCM_STITCH(7);
+        x = _gcm_reduce(plo, pmid, phi);
+        r = GCM_AGGREGATE + 1;
+    }
+
+    for (; r < Nr; r++) {
+        GCM_ROUND8(_mm_aesenc_si128, b, k[r]);
+    }
+    GCM_ROUND8(_mm_aesenclast_si128, b, k[Nr]);
+
+    for (i = 0; i < GCM_AGGREGATE; i++) {
+        _mm_storeu_si128((__m128i *)out + i, _mm_xor_si128(b[i],
+            _mm_loadu_si128((const __m128i *)in + i)));
+    }
+
+    return x;
+}
+
+static inline __m128i
+_gcm_aesni_block(const __m128i *k, int Nr, uint64_t *hi, uint64_t *lo,
+    const uint8_t *in, uint8_t *out)
+{
+    __m128i b;
+    int r;
+
+    b = _mm_xor_si128(_rijndael_ctr_block(hi, lo), k[0]);
+    for (r = 1; r < Nr; r++) {
+        b = _mm_aesenc_si128(b, k[r]);
+    }
+    b = _mm_xor_si128(_mm_aesenclast_si128(b, k[Nr]),
+        _mm_loadu_si128((const __m128i *)in));
+    _mm_storeu_si128((__m128i *)out, b);
+
+    return b;
+}
+
+/*
+* While encrypting, the ciphertext to hash only exists once a batch is
+* done, so each batch hashes the one before it and the last one is
+* hashed on its own at the end.
+*/
+static void
+_gcm_aesni_encrypt(const uint32_t *rk, int Nr, const uint64_t (*Htable)[2],
+    uint8_t *X, uint8_t *ctr, const uint8_t *in, uint8_t *out,
+    size_t blocks)
+{
+    __m128i k[AES_MAXROUNDS + 1], hp[GCM_AGGREGATE], x, c;
+    const uint8_t *g = NULL;
+    uint64_t hi, lo;
+
+    _rijndael_load_schedule(k, rk, Nr);
+    _gcm_load_powers(hp, Htable);
+    x = GCM_LOAD(X);
+    hi = _rijndael_load_be64(ctr);
+    lo = _rijndael_load_be64(ctr + 8);
+
+    for (; blocks >= GCM_AGGREGATE; blocks -= GCM_AGGREGATE) {
+        x = _gcm_aesni_stitch8(k, Nr, hp, x, g, &hi, &lo, in, out);
+        g = out;
+        in += 16 * GCM_AGGREGATE;
+        out += 16 * GCM_AGGREGATE;
+    }
+
+    if (g != NULL) {
+        x = _gcm_ghash8(hp, x, g);
+    }
+
+    for (; blocks > 0; blocks--) {
+        c = _gcm_aesni_block(k, Nr, &hi, &lo, in, out);
+        x = _gcm_mul(_mm_xor_si128(x,
+            _mm_shuffle_epi8(c, GCM_BSWAP128)), hp[0]);
+        in += 16;
+        out += 16;
+    }
+
+    GCM_STORE(X, x);
+    _rijndael_store_be64(ctr, hi);
+    _rijndael_store_be64(ctr + 8, lo);
+
+    memset(k, 0, sizeof(k));
+}
+
+/* decrypting, the ciphertext is there up front: hash the batch in flight */
+static void
+_gcm_aesni_decrypt(const uint32_t *rk, int Nr, const uint64_t (*Htable)[2],
+    uint8_t *X, uint8_t *ctr, const uint8_t *in, uint8_t *out,
+    size_t blocks)
+{
+    __m128i k[AES_MAXROUNDS + 1], hp[GCM_AGGREGATE], x;
+    uint64_t hi, lo;
+
+    _rijndael_load_schedule(k, rk, Nr);
+    _gcm_load_powers(hp, Htable);
+    x = GCM_LOAD(X);
+    hi = _rijndael_load_be64(ctr);
+    lo = _rijndael_load_be64(ctr + 8);
+
+    for (; blocks >= GCM_AGGREGATE; blocks -= GCM_AGGREGATE) {
+        x = _gcm_aesni_stitch8(k, Nr, hp, x, in, &hi, &lo, in, out);
+        in += 16 * GCM_AGGREGATE;
+        out += 16 * GCM_AGGREGATE;
+    }
+
+    for (; blocks > 0; blocks--) {
+        x = _gcm_mul(_mm_xor_si128(x, GCM_LOAD(in)), hp[0]);
+        _gcm_aesni_block(k, Nr, &hi, &lo, in, out);
+        in += 16;
+        out += 16;
+    }
+
+    GCM_STORE(X, x);
+    _rijndael_store_be64(ctr, hi);
+    _rijndael_store_be64(ctr + 8, lo);
+
+    memset(k, 0, sizeof(k));
+}
@@ -0,0 +1,92 @@
+#ifndef ECRYPT_GCM_X86_H
+#define ECRYPT_GCM_X86_H
+
+/*
+* GHASH helpers shared by the x86 carry-less multiply implementations.  Only
+* include this from files that are compiled with at least -mpclmul.
+*/
+#include <wmmintrin.h>
+
+#include "gcm_impl.h"
+#include "rijndael_x86.h"
+
+/*
+* GHASH works on bit-reflected field elements.  Reversing the bytes of a
+* block (and of H) turns that into a plain carry-less multiply followed by
+* a one bit shift, as in Intel's "Carry-Less Multiplication Instruction
+* and its Usage for Computing the GCM Mode" white paper.
+*/
+#define GCM_BSWAP128 \
+    _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)
+
+#define GCM_LOAD(p) \
+    _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p)), GCM_BSWAP128)
+
+#define GCM_STORE(p, x) \
+    _mm_storeu_si128((__m128i *)(p), _mm_shuffle_epi8((x), GCM_BSWAP128))
+
+/* adds a * b, unreduced, to the 256-bit sum hi:mid:lo */
+static inline void
+_gcm_clmul_acc(__m128i a, __m128i b, __m128i *lo, __m128i *mid, __m128i *hi)
+{
+    *lo = _mm_xor_si128(*lo, _mm_clmulepi64_si128(a, b, 0x00));
+    *hi = _mm_xor_si128(*hi, _mm_clmulepi64_si128(a, b, 0x11));
+    *mid = _mm_xor_si128(*mid, _mm_xor_si128(
+        _mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01)));
+}
+
+/*
+* Folds the 256-bit product back into the field.  Both the shift and the
+* reduction are linear, so any number of products can share one of these.
+*/
+static inline __m128i
+_gcm_reduce(__m128i lo, __m128i mid, __m128i hi)
+{
+    __m128i t7, t8, t9, t2, t4, t5;
+
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+    /* hi:lo <<= 1, for the bit reflection */
+    t7 = _mm_srli_epi32(lo, 31);
+    t8 = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    lo = _mm_or_si128(lo, t7);
+    hi = _mm_or_si128(hi, t8);
+    hi = _mm_or_si128(hi, t9);
+
+    /* modulo x^128 + x^7 + x^2 + x + 1 */
+    t7 = _mm_slli_epi32(lo, 31);
+    t8 = _mm_slli_epi32(lo, 30);
+    t9 = _mm_slli_epi32(lo, 25);
+    t7 = _mm_xor_si128(t7, _mm_xor_si128(t8, t9));
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    lo = _mm_xor_si128(lo, t7);
+
+    t2 = _mm_srli_epi32(lo, 1);
+    t4 = _mm_srli_epi32(lo, 2);
+    t5 = _mm_srli_epi32(lo, 7);
+    t2 = _mm_xor_si128(t2, _mm_xor_si128(t4, t5));
+    t2 = _mm_xor_si128(t2, t8);
+    lo = _mm_xor_si128(lo, t2);
+
+    return _mm_xor_si128(hi, lo);
+}
+
+static inline __m128i
+_gcm_mul(__m128i a, __m128i b)
+{
+    __m128i lo, mid, hi;
+
+    lo = mid = hi = _mm_setzero_si128();
+    _gcm_clmul_acc(a, b, &lo, &mid, &hi);
+
+    return _gcm_reduce(lo, mid, hi);
+}
+
+#endif /* ECRYPT_GCM_X86_H */
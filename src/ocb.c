@@ -0,0 +1,346 @@
+#include <stddef.h>
+#include <string.h>
+
+#include <ecrypt/ocb.h>
+#include "rijndael_impl.h"
+
+/* what _ocb_blocks does with each block */
+#define OCB_ENCRYPT		(0)
+#define OCB_DECRYPT		(1)
+#define OCB_HASH		(2)	/* sum ^= E(in ^ offset), no output */
+
+/* r = a ^ b, for one block */
+static void
+_ocb_xor(uint8_t *r, const uint8_t *a, const uint8_t *b)
+{
+    uint64_t x[2], y[2];
+
+    memcpy(x, a, 16);
+    memcpy(y, b, 16);
+    x[0] ^= y[0];
+    x[1] ^= y[1];
+    memcpy(r, x, 16);
+}
+
+/* r = 2 * a in GF(2^128); a is a big-endian number here, unlike XTS */
+static void
+_ocb_double(uint8_t *r, const uint8_t *a)
+{
+    uint8_t carry = a[0] >> 7;
+    int i;
+
+    for (i = 0; i < 15; i++) {
+        r[i] = (uint8_t)((a[i] << 1) | (a[i + 1] >> 7));
+    }
+    r[15] = (uint8_t)((a[15] << 1) ^ (0x87 & (0 - carry)));
+}
+
+/* number of trailing zero bits; i > 0 */
+static unsigned int
+_ocb_ntz(uint64_t i)
+{
+    unsigned int n = 0;
+
+    while ((i & 1) == 0) {
+        i >>= 1;
+        n++;
+    }
+
+    return n;
+}
+
+int
+ocb_set_key(ocb_ctx *ctx, const uint8_t *key, uint32_t klen)
+{
+    int i;
+
+    if (ctx == NULL || key == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (klen != 16 && klen != 24 && klen != 32) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    if (rijndael_set_key(&ctx->aes, key, klen * 8) != 0) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    rijndael_encrypt(&ctx->aes, ctx->L_star, ctx->L_star);
+    _ocb_double(ctx->L_dollar, ctx->L_star);
+    _ocb_double(ctx->L[0], ctx->L_dollar);
+    for (i = 1; i < OCB_L_COUNT; i++) {
+        _ocb_double(ctx->L[i], ctx->L[i - 1]);
+    }
+
+    return ECRYPT_NO_ERROR;
+}
+
+int
+ocb_release(ocb_ctx *ctx)
+{
+    if (ctx == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    return ECRYPT_NO_ERROR;
+}
+
+/*
+* Offset_0 from the nonce (RFC 7253, 4.2).  Ktop stays on the stack: ctx
+* is only ever read while a message is processed, so that one keyed context
+* can be shared between threads.
+*/
+static void
+_ocb_offset0(ocb_ctx *ctx, const uint8_t *nonce, size_t nonce_len,
+    size_t tag_len, uint8_t *offset)
+{
+    uint8_t N[16], Ktop[16], stretch[24];
+    unsigned int bottom, shift;
+    int i;
+
+    memset(N, 0, sizeof(N));
+    N[0] = (uint8_t)(((tag_len * 8) % 128) << 1);
+    N[15 - nonce_len] |= 1;
+    memcpy(N + 16 - nonce_len, nonce, nonce_len);
+
+    bottom = N[15] & 0x3f;
+    N[15] &= 0xc0;
+    rijndael_encrypt(&ctx->aes, N, Ktop);
+
+    /* Stretch = Ktop || (Ktop[1..64] xor Ktop[9..72]) */
+    memcpy(stretch, Ktop, 16);
+    for (i = 0; i < 8; i++) {
+        stretch[16 + i] = Ktop[i] ^ Ktop[i + 1];
+    }
+
+    /* Offset_0 = Stretch[1+bottom..128+bottom] */
+    shift = bottom % 8;
+    for (i = 0; i < 16; i++) {
+        offset[i] = stretch[i + bottom / 8];
+        if (shift != 0) {
+            offset[i] = (uint8_t)((offset[i] << shift) |
+                (stretch[i + bottom / 8 + 1] >> (8 - shift)));
+        }
+    }
+
+    memset(Ktop, 0, sizeof(Ktop));
+    memset(stretch, 0, sizeof(stretch));
+}
+
+/*
+* Whole blocks, RIJNDAEL_LANES at a time: the offsets of a group are worked
+* out first, then all its blocks go through one encrypt_multi (or
+* decrypt_multi) call, which keeps them in flight together.  index is the
+* number of blocks processed before these, offset is Offset_index on entry
+* and on return, and sum is the checksum (or, for OCB_HASH, the running
+* hash value).
+*/
+static void
+_ocb_blocks(const ocb_ctx *ctx, uint64_t *index, uint8_t *offset,
+    uint8_t *sum, const uint8_t *in, uint8_t *out, size_t blocks, int mode)
+{
+    const struct rijndael_impl_t *impl = ctx->aes.impl;
+    const uint32_t *rk[RIJNDAEL_LANES];
+    const uint8_t *tin[RIJNDAEL_LANES];
+    uint8_t *tout[RIJNDAEL_LANES];
+    uint8_t off[RIJNDAEL_LANES][16];
+    uint8_t buf[RIJNDAEL_LANES][16];
+    size_t n, j;
+
+    for (j = 0; j < RIJNDAEL_LANES; j++) {
+        rk[j] = mode == OCB_DECRYPT ? ctx->aes.dk : ctx->aes.ek;
+        tin[j] = buf[j];
+        tout[j] = buf[j];
+    }
+
+    for (; blocks > 0; blocks -= n) {
+        n = blocks < RIJNDAEL_LANES ? blocks : RIJNDAEL_LANES;
+
+        /* every input block is read before anything is written */
+        for (j = 0; j < n; j++) {
+            _ocb_xor(offset, offset, ctx->L[_ocb_ntz(++*index)]);
+            memcpy(off[j], offset, 16);
+            _ocb_xor(buf[j], in + 16 * j, offset);
+            if (mode == OCB_ENCRYPT) {
+                _ocb_xor(sum, sum, in + 16 * j);
+            }
+        }
+
+        if (mode == OCB_DECRYPT) {
+            impl->decrypt_multi(rk, ctx->aes.Nr, tin, tout, n);
+        } else {
+            impl->encrypt_multi(rk, ctx->aes.Nr, tin, tout, n);
+        }
+
+        for (j = 0; j < n; j++) {
+            if (mode == OCB_HASH) {
+                _ocb_xor(sum, sum, buf[j]);
+                continue;
+            }
+            _ocb_xor(out + 16 * j, buf[j], off[j]);
+            if (mode == OCB_DECRYPT) {
+                _ocb_xor(sum, sum, out + 16 * j);
+            }
+        }
+
+        in += 16 * n;
+        if (mode != OCB_HASH) {
+            out += 16 * n;
+        }
+    }
+
+    memset(off, 0, sizeof(off));
+    memset(buf, 0, sizeof(buf));
+}
+
+/* HASH(K, A) of RFC 7253, 4.1 */
+static void
+_ocb_hash(ocb_ctx *ctx, const uint8_t *aad, size_t aad_len,
+    uint8_t *sum)
+{
+    uint8_t offset[16], block[16];
+    uint64_t index = 0;
+    size_t tail = aad_len % 16;
+
+    memset(offset, 0, sizeof(offset));
+    memset(sum, 0, 16);
+    _ocb_blocks(ctx, &index, offset, sum, aad, NULL, aad_len / 16, OCB_HASH);
+
+    if (tail != 0) {
+        memset(block, 0, sizeof(block));
+        memcpy(block, aad + aad_len - tail, tail);
+        block[tail] = 0x80;
+        _ocb_xor(offset, offset, ctx->L_star);
+        _ocb_xor(block, block, offset);
+        rijndael_encrypt(&ctx->aes, block, block);
+        _ocb_xor(sum, sum, block);
+    }
+
+    memset(offset, 0, sizeof(offset));
+    memset(block, 0, sizeof(block));
+}
+
+/*
+* Both directions; the full tag is left in T.  The partial last block is
+* the same either way except for which side of the XOR is the plaintext.
+*/
+static int
+_ocb_crypt(ocb_ctx *ctx, const uint8_t *nonce, size_t nonce_len,
+    const uint8_t *aad, size_t aad_len, const uint8_t *in, size_t len,
+    uint8_t *out, size_t tag_len, uint8_t *T, int mode)
+{
+    uint8_t offset[16], sum[16], pad[16], hash[16];
+    uint64_t index = 0;
+    size_t tail = len % 16;
+    size_t i;
+
+    if (ctx == NULL || nonce == NULL || (aad == NULL && aad_len > 0) ||
+        ((in == NULL || out == NULL) && len > 0)) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (ctx->aes.impl == NULL) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    if (nonce_len < 1 || nonce_len > OCB_MAX_NONCE_LENGTH ||
+        tag_len < 1 || tag_len > OCB_TAG_LENGTH) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    _ocb_offset0(ctx, nonce, nonce_len, tag_len, offset);
+    memset(sum, 0, sizeof(sum));
+    _ocb_blocks(ctx, &index, offset, sum, in, out, len / 16, mode);
+
+    if (tail != 0) {
+        in += len - tail;
+        out += len - tail;
+        _ocb_xor(offset, offset, ctx->L_star);
+        rijndael_encrypt(&ctx->aes, offset, pad);
+        for (i = 0; i < tail; i++) {
+            /* the plaintext byte goes into the checksum */
+            if (mode == OCB_ENCRYPT) {
+                sum[i] ^= in[i];
+                out[i] = in[i] ^ pad[i];
+            } else {
+                out[i] = in[i] ^ pad[i];
+                sum[i] ^= out[i];
+            }
+        }
+        sum[tail] ^= 0x80;
+    }
+
+    /* Tag = E(Checksum ^ Offset ^ L_$) ^ HASH(K, A) */
+    _ocb_xor(sum, sum, offset);
+    _ocb_xor(sum, sum, ctx->L_dollar);
+    rijndael_encrypt(&ctx->aes, sum, T);
+    _ocb_hash(ctx, aad, aad_len, hash);
+    _ocb_xor(T, T, hash);
+
+    memset(offset, 0, sizeof(offset));
+    memset(sum, 0, sizeof(sum));
+    memset(pad, 0, sizeof(pad));
+    memset(hash, 0, sizeof(hash));
+    return ECRYPT_NO_ERROR;
+}
+
+int
+ocb_encrypt(ocb_ctx *ctx, const uint8_t *nonce, size_t nonce_len,
+    const uint8_t *aad, size_t aad_len, const uint8_t *pt, size_t pt_len,
+    uint8_t *out, uint8_t *tag, size_t tag_len)
+{
+    uint8_t T[16];
+    int err;
+
+    if (tag == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    err = _ocb_crypt(ctx, nonce, nonce_len, aad, aad_len, pt, pt_len, out,
+        tag_len, T, OCB_ENCRYPT);
+    if (err == ECRYPT_NO_ERROR) {
+        memcpy(tag, T, tag_len);
+    }
+
+    memset(T, 0, sizeof(T));
+    return err;
+}
+
+int
+ocb_decrypt(ocb_ctx *ctx, const uint8_t *nonce, size_t nonce_len,
+    const uint8_t *aad, size_t aad_len, const uint8_t *ct, size_t ct_len,
+    uint8_t *out, const uint8_t *tag, size_t tag_len)
+{
+    uint8_t T[16], diff;
+    size_t i;
+    int err;
+
+    if (tag == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    err = _ocb_crypt(ctx, nonce, nonce_len, aad, aad_len, ct, ct_len, out,
+        tag_len, T, OCB_DECRYPT);
+    if (err != ECRYPT_NO_ERROR) {
+        return err;
+    }
+
+    /* no early exit: the time taken says nothing about where they differ */
+    diff = 0;
+    for (i = 0; i < tag_len; i++) {
+        diff |= T[i] ^ tag[i];
+    }
+
+    memset(T, 0, sizeof(T));
+    if (diff != 0) {
+        if (ct_len > 0) {
+            memset(out, 0, ct_len);
+        }
+        return ECRYPT_AUTH_FAILED;
+    }
+
+    return ECRYPT_NO_ERROR;
+}
@@ -1,4 +1,12 @@
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+
 #include <ecrypt/rijndael.h>
+#include "cpu.h"
+#include "rijndael_impl.h"
+#include "stream.h"
+#include "thread.h"
 #include "rijndael_const.c"
 
 #define GETU32(pt) (((uint32_t)(pt)[0] << 24) ^ ((uint32_t)(pt)[1] << 16)\
@@ -12,10 +20,61 @@ int _rijndael_key_setup_enc(uint32_t *rk, const uint8_t *cipher_key,
     int keybits);
 int _rijndael_key_setup_dec(uint32_t *rk, const uint8_t *cipher_key,
     int keybits);
-void _rijndael_encrypt(const uint32_t *rk, int Nr, const uint8_t *pt,
+static int _rijndael_key_setup_enc_multi(uint32_t *const *rk,
+    const uint8_t *const *keys, int keybits, size_t n);
+static void _rijndael_invert_key(uint32_t *dk, const uint32_t *ek, int Nr);
+static void _rijndael_encrypt(const uint32_t *rk, int Nr, const uint8_t *pt,
     uint8_t *ct);
-void _rijndael_decrypt(const uint32_t *rk, int Nr, const uint8_t *ct,
+static void _rijndael_decrypt(const uint32_t *rk, int Nr, const uint8_t *ct,
     uint8_t *pt);
+static void _rijndael_encrypt_pair(const uint32_t *rk, int Nr,
+    uint32_t *a, uint32_t *b);
+static void _rijndael_encrypt_lanes(const uint32_t *rk, int Nr,
+    uint32_t s[RIJNDAEL_LANES][4], int n);
+static void _rijndael_ctr(const uint32_t *rk, int Nr, uint8_t *ctr,
+    const uint8_t *in, uint8_t *out, size_t blocks);
+static void _rijndael_decrypt_pair(const uint32_t *rk, int Nr,
+    uint32_t *a, uint32_t *b);
+static void _rijndael_decrypt_lanes(const uint32_t *rk, int Nr,
+    uint32_t s[RIJNDAEL_LANES][4], int n);
+static void _rijndael_cbc_dec(const uint32_t *rk, int Nr, uint8_t *iv,
+    const uint8_t *in, uint8_t *out, size_t blocks);
+static void _rijndael_encrypt_multi(const uint32_t *const *rk, int Nr,
+    const uint8_t *const *in, uint8_t *const *out, size_t n);
+static void _rijndael_decrypt_multi(const uint32_t *const *rk, int Nr,
+    const uint8_t *const *in, uint8_t *const *out, size_t n);
+static void _rijndael_xts_enc(const uint32_t *rk, int Nr, uint8_t *tweak,
+    const uint8_t *in, uint8_t *out, size_t blocks);
+static void _rijndael_xts_dec(const uint32_t *rk, int Nr, uint8_t *tweak,
+    const uint8_t *in, uint8_t *out, size_t blocks);
+RIJNDAEL_SIZED_DECL(_rijndael);
+
+const struct rijndael_impl_t _rijndael_table_impl = {
+    "table",
+    _rijndael_key_setup_enc,
+    _rijndael_key_setup_dec,
+    _rijndael_key_setup_enc_multi,
+    _rijndael_invert_key,
+    _rijndael_encrypt,
+    _rijndael_decrypt,
+    _rijndael_ctr,
+    _rijndael_cbc_dec,
+    _rijndael_encrypt_multi,
+    _rijndael_decrypt_multi,
+    _rijndael_xts_enc,
+    _rijndael_xts_dec,
+    &_rijndael_table_impl,
+    RIJNDAEL_SIZED_LIST(_rijndael)
+};
+
+/* what rijndael_set_key hands out; the best one the processor supports,
+ * picked exactly once by whichever thread gets there first, unless
+ * rijndael_select_impl has chosen another. */
+static const struct rijndael_impl_t *_rijndael_impl = NULL;
+static pthread_once_t _rijndael_impl_once = PTHREAD_ONCE_INIT;
+
+static const struct rijndael_impl_t *_rijndael_best_impl(void);
+static const struct rijndael_impl_t *_rijndael_current_impl(void);
 
 /**
  * Expand the cipher key into the encryption key schedule.
@@ -122,11 +181,53 @@ _rijndael_key_setup_enc(uint32_t *rk, const uint8_t *cipher_key, int keybits)
 int
 _rijndael_key_setup_dec(uint32_t *rk, const uint8_t *cipher_key, int keybits)
 {
-    int Nr, i, j;
-    uint32_t temp;
+    int Nr;
 
     /* Expand the cipher key: */
     Nr = _rijndael_key_setup_enc(rk, cipher_key, keybits);
+    _rijndael_invert_key(rk, rk, Nr);
+
+    return Nr;
+}
+
+/**
+ * One key after the other.  Interleaving the keys word by word was tried
+ * and came out slower: consecutive calls do not depend on each other, so
+ * the processor already overlaps their table lookups.
+ *
+ * @return	the number of rounds for the given cipher key size.
+ */
+static int
+_rijndael_key_setup_enc_multi(uint32_t *const *rk, const uint8_t *const *keys,
+    int keybits, size_t n)
+{
+    size_t i;
+    int Nr;
+
+    if (keybits != 128 && keybits != 192 && keybits != 256) {
+        return 0;
+    }
+
+    Nr = keybits / 32 + 6;
+    for (i = 0; i < n; i++) {
+        _rijndael_key_setup_enc(rk[i], keys[i], keybits);
+    }
+
+    return Nr;
+}
+
+/**
+ * Turn an encryption key schedule into the decryption key schedule.
+ */
+static void
+_rijndael_invert_key(uint32_t *rk, const uint32_t *ek, int Nr)
+{
+    int i, j;
+    uint32_t temp;
+
+    if (rk != ek) {
+        memcpy(rk, ek, sizeof(ek[0]) * 4 * (Nr + 1));
+    }
 
     /* Invert the order of the round keys: */
     for (i = 0, j = 4*Nr; i < j; i += 4, j -= 4) {
@@ -163,246 +264,643 @@ _rijndael_key_setup_dec(uint32_t *rk, const uint8_t *cipher_key, int keybits)
             Td2[Te1[(rk[3] >>  8) & 0xff] & 0xff] ^
             Td3[Te1[(rk[3]      ) & 0xff] & 0xff];
     }
-
-    return Nr;
 }
 
+/* load and store the cipher state of one block */
+#define STATE_LOAD(s, p) do { \
+    (s)[0] = GETU32((p)     ); (s)[1] = GETU32((p) +  4); \
+    (s)[2] = GETU32((p) +  8); (s)[3] = GETU32((p) + 12); \
+} while (0)
+
+#define STATE_STORE(p, s) do { \
+    PUTU32((p)     , (s)[0]); PUTU32((p) +  4, (s)[1]); \
+    PUTU32((p) +  8, (s)[2]); PUTU32((p) + 12, (s)[3]); \
+} while (0)
+
+/* one full encryption round of a single lane, from state s into t */
+#define TE_ROUND(t, s, rk) do { \
+    (t)[0] = Te0[((s)[0] >> 24)       ] ^ Te1[((s)[1] >> 16) & 0xff] ^ \
+             Te2[((s)[2] >>  8) & 0xff] ^ Te3[((s)[3]      ) & 0xff] ^ \
+             (rk)[0]; \
+    (t)[1] = Te0[((s)[1] >> 24)       ] ^ Te1[((s)[2] >> 16) & 0xff] ^ \
+             Te2[((s)[3] >>  8) & 0xff] ^ Te3[((s)[0]      ) & 0xff] ^ \
+             (rk)[1]; \
+    (t)[2] = Te0[((s)[2] >> 24)       ] ^ Te1[((s)[3] >> 16) & 0xff] ^ \
+             Te2[((s)[0] >>  8) & 0xff] ^ Te3[((s)[1]      ) & 0xff] ^ \
+             (rk)[2]; \
+    (t)[3] = Te0[((s)[3] >> 24)       ] ^ Te1[((s)[0] >> 16) & 0xff] ^ \
+             Te2[((s)[1] >>  8) & 0xff] ^ Te3[((s)[2]      ) & 0xff] ^ \
+             (rk)[3]; \
+} while (0)
+
+/* the last encryption round: SubBytes and ShiftRows, no MixColumns */
+#define TE_FINAL_WORD(a, b, c, d, k) \
+    ((Te2[((a) >> 24)       ] & 0xff000000) ^ \
+     (Te3[((b) >> 16) & 0xff] & 0x00ff0000) ^ \
+     (Te0[((c) >>  8) & 0xff] & 0x0000ff00) ^ \
+     (Te1[((d)      ) & 0xff] & 0x000000ff) ^ (k))
+
 /*
-* XXX: This is a disaster.  Defining the length of the array in the
-* function definition is not a standard C mechanism.  Not sure why this
-* code is in OpenBSD like this.
+* Rounds 1 to 9 are the same for every key size.  In the sized copies Nr is
+* a constant, so the two extra pairs of rounds of RIJNDAEL_ROUNDS are either
+* there or not, and a block is straight-line code.
 */
-void _rijndael_encrypt(const uint32_t *rk, int Nr, const uint8_t *pt,
+RIJNDAEL_INLINE void
+_rijndael_encrypt(const uint32_t *rk, int Nr, const uint8_t *pt,
     uint8_t *ct)
 {
-    uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
-    int r;
+    uint32_t s[4], t[4];
 
-    /*
-    * Map byte array block to cipher state
-    * and add initial round key:
-    */
-    s0 = GETU32(pt     ) ^ rk[0];
-    s1 = GETU32(pt +  4) ^ rk[1];
-    s2 = GETU32(pt +  8) ^ rk[2];
-    s3 = GETU32(pt + 12) ^ rk[3];
-
-    r = Nr >> 1;
-    while (1) {
-        t0 =
-            Te0[(s0 >> 24)       ] ^
-            Te1[(s1 >> 16) & 0xff] ^
-            Te2[(s2 >>  8) & 0xff] ^
-            Te3[(s3      ) & 0xff] ^
-            rk[4];
-        t1 =
-            Te0[(s1 >> 24)       ] ^
-            Te1[(s2 >> 16) & 0xff] ^
-            Te2[(s3 >>  8) & 0xff] ^
-            Te3[(s0      ) & 0xff] ^
-            rk[5];
-        t2 =
-            Te0[(s2 >> 24)       ] ^
-            Te1[(s3 >> 16) & 0xff] ^
-            Te2[(s0 >>  8) & 0xff] ^
-            Te3[(s1      ) & 0xff] ^
-            rk[6];
-        t3 =
-            Te0[(s3 >> 24)       ] ^
-            Te1[(s0 >> 16) & 0xff] ^
-            Te2[(s1 >>  8) & 0xff] ^
-            Te3[(s2      ) & 0xff] ^
-            rk[7];
-
-        rk += 8;
-        if (--r == 0) {
-            break;
+#define TE_STEP(t, s, r)	TE_ROUND(t, s, rk + 4*(r))
+
+    STATE_LOAD(s, pt);
+    s[0] ^= rk[0];
+    s[1] ^= rk[1];
+    s[2] ^= rk[2];
+    s[3] ^= rk[3];
+
+    RIJNDAEL_ROUNDS(TE_STEP, s, t, Nr);
+
+#undef TE_STEP
+
+    rk += 4*Nr;
+    s[0] = TE_FINAL_WORD(t[0], t[1], t[2], t[3], rk[0]);
+    s[1] = TE_FINAL_WORD(t[1], t[2], t[3], t[0], rk[1]);
+    s[2] = TE_FINAL_WORD(t[2], t[3], t[0], t[1], rk[2]);
+    s[3] = TE_FINAL_WORD(t[3], t[0], t[1], t[2], rk[3]);
+    STATE_STORE(ct, s);
+}
+
+/*
+* _rijndael_encrypt on the cipher state words of two blocks at once, each
+* with its own key schedule.  Each round is applied to both blocks before
+* moving on, so the table lookups of one can issue while the other waits.
+* Two is where this stops paying off with T-tables: every lookup is a load,
+* and with more blocks in flight the states no longer fit in registers and
+* the spills compete for the same load ports.
+*/
+RIJNDAEL_INLINE void
+_rijndael_encrypt_pair2(const uint32_t *ka, const uint32_t *kb, int Nr,
+    uint32_t *a, uint32_t *b)
+{
+    uint32_t x[2][4], y[2][4];
+
+    x[0][0] = a[0] ^ ka[0]; x[1][0] = b[0] ^ kb[0];
+    x[0][1] = a[1] ^ ka[1]; x[1][1] = b[1] ^ kb[1];
+    x[0][2] = a[2] ^ ka[2]; x[1][2] = b[2] ^ kb[2];
+    x[0][3] = a[3] ^ ka[3]; x[1][3] = b[3] ^ kb[3];
+
+#define TE_STEP2(y, x, r) do { \
+    TE_ROUND((y)[0], (x)[0], ka + 4*(r)); \
+    TE_ROUND((y)[1], (x)[1], kb + 4*(r)); \
+} while (0)
+
+    RIJNDAEL_ROUNDS(TE_STEP2, x, y, Nr);
+
+#undef TE_STEP2
+
+    ka += 4*Nr;
+    kb += 4*Nr;
+    a[0] = TE_FINAL_WORD(y[0][0], y[0][1], y[0][2], y[0][3], ka[0]);
+    a[1] = TE_FINAL_WORD(y[0][1], y[0][2], y[0][3], y[0][0], ka[1]);
+    a[2] = TE_FINAL_WORD(y[0][2], y[0][3], y[0][0], y[0][1], ka[2]);
+    a[3] = TE_FINAL_WORD(y[0][3], y[0][0], y[0][1], y[0][2], ka[3]);
+    b[0] = TE_FINAL_WORD(y[1][0], y[1][1], y[1][2], y[1][3], kb[0]);
+    b[1] = TE_FINAL_WORD(y[1][1], y[1][2], y[1][3], y[1][0], kb[1]);
+    b[2] = TE_FINAL_WORD(y[1][2], y[1][3], y[1][0], y[1][1], kb[2]);
+    b[3] = TE_FINAL_WORD(y[1][3], y[1][0], y[1][1], y[1][2], kb[3]);
+}
+
+/* the single-key case; once inlined, the two key pointers are merged */
+RIJNDAEL_INLINE void
+_rijndael_encrypt_pair(const uint32_t *rk, int Nr, uint32_t *a, uint32_t *b)
+{
+    _rijndael_encrypt_pair2(rk, rk, Nr, a, b);
+}
+
+/* encrypt n (up to RIJNDAEL_LANES) blocks held as cipher state words */
+RIJNDAEL_INLINE void
+_rijndael_encrypt_lanes(const uint32_t *rk, int Nr,
+    uint32_t s[RIJNDAEL_LANES][4], int n)
+{
+    uint32_t spare[4];
+    int b;
+
+    for (b = 0; b + 1 < n; b += 2) {
+        _rijndael_encrypt_pair(rk, Nr, s[b], s[b + 1]);
+    }
+
+    if (b < n) {
+        memcpy(spare, s[b], sizeof(spare));
+        _rijndael_encrypt_pair(rk, Nr, s[b], spare);
+    }
+}
+
+/*
+* The counter block lives in c[0..3] as big-endian words, which is exactly
+* the cipher state layout, so building the next RIJNDAEL_LANES inputs is
+* just a few word copies.  The keystream is XORed straight into out.
+*/
+RIJNDAEL_INLINE void
+_rijndael_ctr(const uint32_t *rk, int Nr, uint8_t *ctr, const uint8_t *in,
+    uint8_t *out, size_t blocks)
+{
+    uint32_t s[RIJNDAEL_LANES][4];
+    uint32_t c[4];
+    int b, n;
+
+    c[0] = GETU32(ctr     );
+    c[1] = GETU32(ctr +  4);
+    c[2] = GETU32(ctr +  8);
+    c[3] = GETU32(ctr + 12);
+
+    while (blocks > 0) {
+        n = blocks < RIJNDAEL_LANES ? (int)blocks : RIJNDAEL_LANES;
+
+        for (b = 0; b < n; b++) {
+            s[b][0] = c[0];
+            s[b][1] = c[1];
+            s[b][2] = c[2];
+            s[b][3] = c[3];
+
+            if (++c[3] == 0 && ++c[2] == 0 && ++c[1] == 0) {
+                ++c[0];
+            }
         }
 
-        s0 =
-            Te0[(t0 >> 24)       ] ^
-            Te1[(t1 >> 16) & 0xff] ^
-            Te2[(t2 >>  8) & 0xff] ^
-            Te3[(t3      ) & 0xff] ^
-            rk[0];
-        s1 =
-            Te0[(t1 >> 24)       ] ^
-            Te1[(t2 >> 16) & 0xff] ^
-            Te2[(t3 >>  8) & 0xff] ^
-            Te3[(t0      ) & 0xff] ^
-            rk[1];
-        s2 =
-            Te0[(t2 >> 24)       ] ^
-            Te1[(t3 >> 16) & 0xff] ^
-            Te2[(t0 >>  8) & 0xff] ^
-            Te3[(t1      ) & 0xff] ^
-            rk[2];
-        s3 =
-            Te0[(t3 >> 24)       ] ^
-            Te1[(t0 >> 16) & 0xff] ^
-            Te2[(t1 >>  8) & 0xff] ^
-            Te3[(t2      ) & 0xff] ^
-            rk[3];
-	}
+        _rijndael_encrypt_lanes(rk, Nr, s, n);
 
-    /*
-    * Apply last round and map cipher state to byte array block:
-    */
-    s0 =
-        (Te2[(t0 >> 24)       ] & 0xff000000) ^
-        (Te3[(t1 >> 16) & 0xff] & 0x00ff0000) ^
-        (Te0[(t2 >>  8) & 0xff] & 0x0000ff00) ^
-        (Te1[(t3      ) & 0xff] & 0x000000ff) ^
-        rk[0];
-    PUTU32(ct, s0);
-
-    s1 =
-        (Te2[(t1 >> 24)       ] & 0xff000000) ^
-        (Te3[(t2 >> 16) & 0xff] & 0x00ff0000) ^
-        (Te0[(t3 >>  8) & 0xff] & 0x0000ff00) ^
-        (Te1[(t0      ) & 0xff] & 0x000000ff) ^
-        rk[1];
-    PUTU32(ct + 4, s1);
-
-    s2 =
-        (Te2[(t2 >> 24)       ] & 0xff000000) ^
-        (Te3[(t3 >> 16) & 0xff] & 0x00ff0000) ^
-        (Te0[(t0 >>  8) & 0xff] & 0x0000ff00) ^
-        (Te1[(t1      ) & 0xff] & 0x000000ff) ^
-        rk[2];
-    PUTU32(ct + 8, s2);
-
-    s3 =
-        (Te2[(t3 >> 24)       ] & 0xff000000) ^
-        (Te3[(t0 >> 16) & 0xff] & 0x00ff0000) ^
-        (Te0[(t1 >>  8) & 0xff] & 0x0000ff00) ^
-        (Te1[(t2      ) & 0xff] & 0x000000ff) ^
-        rk[3];
-    PUTU32(ct + 12, s3);
+        for (b = 0; b < n; b++) {
+            PUTU32(out     , GETU32(in     ) ^ s[b][0]);
+            PUTU32(out +  4, GETU32(in +  4) ^ s[b][1]);
+            PUTU32(out +  8, GETU32(in +  8) ^ s[b][2]);
+            PUTU32(out + 12, GETU32(in + 12) ^ s[b][3]);
+            in += 16;
+            out += 16;
+        }
+
+        blocks -= n;
+    }
+
+    PUTU32(ctr     , c[0]);
+    PUTU32(ctr +  4, c[1]);
+    PUTU32(ctr +  8, c[2]);
+    PUTU32(ctr + 12, c[3]);
+
+    memset(s, 0, sizeof(s));
 }
 
-void
+/* one full decryption round of a single lane, from state s into t */
+#define TD_ROUND(t, s, rk) do { \
+    (t)[0] = Td0[((s)[0] >> 24)       ] ^ Td1[((s)[3] >> 16) & 0xff] ^ \
+             Td2[((s)[2] >>  8) & 0xff] ^ Td3[((s)[1]      ) & 0xff] ^ \
+             (rk)[0]; \
+    (t)[1] = Td0[((s)[1] >> 24)       ] ^ Td1[((s)[0] >> 16) & 0xff] ^ \
+             Td2[((s)[3] >>  8) & 0xff] ^ Td3[((s)[2]      ) & 0xff] ^ \
+             (rk)[1]; \
+    (t)[2] = Td0[((s)[2] >> 24)       ] ^ Td1[((s)[1] >> 16) & 0xff] ^ \
+             Td2[((s)[0] >>  8) & 0xff] ^ Td3[((s)[3]      ) & 0xff] ^ \
+             (rk)[2]; \
+    (t)[3] = Td0[((s)[3] >> 24)       ] ^ Td1[((s)[2] >> 16) & 0xff] ^ \
+             Td2[((s)[1] >>  8) & 0xff] ^ Td3[((s)[0]      ) & 0xff] ^ \
+             (rk)[3]; \
+} while (0)
+
+/* the last decryption round: InvSubBytes and InvShiftRows only */
+#define TD_FINAL_WORD(a, b, c, d, k) \
+    (((uint32_t)Td4[((a) >> 24)       ] << 24) ^ \
+     ((uint32_t)Td4[((b) >> 16) & 0xff] << 16) ^ \
+     ((uint32_t)Td4[((c) >>  8) & 0xff] <<  8) ^ \
+     ((uint32_t)Td4[((d)      ) & 0xff])       ^ (k))
+
+/* _rijndael_encrypt with the inverse cipher */
+RIJNDAEL_INLINE void
 _rijndael_decrypt(const uint32_t *rk, int Nr, const uint8_t *ct,
     uint8_t *pt)
 {
-    uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
-    int r;
+    uint32_t s[4], t[4];
 
-    /*
-    * Map byte array block to cipher state and add initial round key:
-    */
-    s0 = GETU32(ct     ) ^ rk[0];
-    s1 = GETU32(ct +  4) ^ rk[1];
-    s2 = GETU32(ct +  8) ^ rk[2];
-    s3 = GETU32(ct + 12) ^ rk[3];
-
-    /* Nr - 1 full rounds: */
-    r = Nr >> 1;
-    while (1) {
-        t0 =
-            Td0[(s0 >> 24)       ] ^
-            Td1[(s3 >> 16) & 0xff] ^
-            Td2[(s2 >>  8) & 0xff] ^
-            Td3[(s1      ) & 0xff] ^
-            rk[4];
-        t1 =
-            Td0[(s1 >> 24)       ] ^
-            Td1[(s0 >> 16) & 0xff] ^
-            Td2[(s3 >>  8) & 0xff] ^
-            Td3[(s2      ) & 0xff] ^
-            rk[5];
-        t2 =
-            Td0[(s2 >> 24)       ] ^
-            Td1[(s1 >> 16) & 0xff] ^
-            Td2[(s0 >>  8) & 0xff] ^
-            Td3[(s3      ) & 0xff] ^
-            rk[6];
-        t3 =
-            Td0[(s3 >> 24)       ] ^
-            Td1[(s2 >> 16) & 0xff] ^
-            Td2[(s1 >>  8) & 0xff] ^
-            Td3[(s0      ) & 0xff] ^
-            rk[7];
-
-        rk += 8;
-        if (--r == 0) {
-            break;
+#define TD_STEP(t, s, r)	TD_ROUND(t, s, rk + 4*(r))
+
+    STATE_LOAD(s, ct);
+    s[0] ^= rk[0];
+    s[1] ^= rk[1];
+    s[2] ^= rk[2];
+    s[3] ^= rk[3];
+
+    RIJNDAEL_ROUNDS(TD_STEP, s, t, Nr);
+
+#undef TD_STEP
+
+    rk += 4*Nr;
+    s[0] = TD_FINAL_WORD(t[0], t[3], t[2], t[1], rk[0]);
+    s[1] = TD_FINAL_WORD(t[1], t[0], t[3], t[2], rk[1]);
+    s[2] = TD_FINAL_WORD(t[2], t[1], t[0], t[3], rk[2]);
+    s[3] = TD_FINAL_WORD(t[3], t[2], t[1], t[0], rk[3]);
+    STATE_STORE(pt, s);
+}
+
+/* _rijndael_decrypt on two blocks at once, see _rijndael_encrypt_pair2 */
+RIJNDAEL_INLINE void
+_rijndael_decrypt_pair2(const uint32_t *ka, const uint32_t *kb, int Nr,
+    uint32_t *a, uint32_t *b)
+{
+    uint32_t x[2][4], y[2][4];
+
+    x[0][0] = a[0] ^ ka[0]; x[1][0] = b[0] ^ kb[0];
+    x[0][1] = a[1] ^ ka[1]; x[1][1] = b[1] ^ kb[1];
+    x[0][2] = a[2] ^ ka[2]; x[1][2] = b[2] ^ kb[2];
+    x[0][3] = a[3] ^ ka[3]; x[1][3] = b[3] ^ kb[3];
+
+#define TD_STEP2(y, x, r) do { \
+    TD_ROUND((y)[0], (x)[0], ka + 4*(r)); \
+    TD_ROUND((y)[1], (x)[1], kb + 4*(r)); \
+} while (0)
+
+    RIJNDAEL_ROUNDS(TD_STEP2, x, y, Nr);
+
+#undef TD_STEP2
+
+    ka += 4*Nr;
+    kb += 4*Nr;
+    a[0] = TD_FINAL_WORD(y[0][0], y[0][3], y[0][2], y[0][1], ka[0]);
+    a[1] = TD_FINAL_WORD(y[0][1], y[0][0], y[0][3], y[0][2], ka[1]);
+    a[2] = TD_FINAL_WORD(y[0][2], y[0][1], y[0][0], y[0][3], ka[2]);
+    a[3] = TD_FINAL_WORD(y[0][3], y[0][2], y[0][1], y[0][0], ka[3]);
+    b[0] = TD_FINAL_WORD(y[1][0], y[1][3], y[1][2], y[1][1], kb[0]);
+    b[1] = TD_FINAL_WORD(y[1][1], y[1][0], y[1][3], y[1][2], kb[1]);
+    b[2] = TD_FINAL_WORD(y[1][2], y[1][1], y[1][0], y[1][3], kb[2]);
+    b[3] = TD_FINAL_WORD(y[1][3], y[1][2], y[1][1], y[1][0], kb[3]);
+}
+
+RIJNDAEL_INLINE void
+_rijndael_decrypt_pair(const uint32_t *rk, int Nr, uint32_t *a, uint32_t *b)
+{
+    _rijndael_decrypt_pair2(rk, rk, Nr, a, b);
+}
+
+/* decrypt n (up to RIJNDAEL_LANES) blocks held as cipher state words */
+RIJNDAEL_INLINE void
+_rijndael_decrypt_lanes(const uint32_t *rk, int Nr,
+    uint32_t s[RIJNDAEL_LANES][4], int n)
+{
+    uint32_t spare[4];
+    int b;
+
+    for (b = 0; b + 1 < n; b += 2) {
+        _rijndael_decrypt_pair(rk, Nr, s[b], s[b + 1]);
+    }
+
+    if (b < n) {
+        memcpy(spare, s[b], sizeof(spare));
+        _rijndael_decrypt_pair(rk, Nr, s[b], spare);
+    }
+}
+
+/*
+* CBC decryption has no dependency between the block decryptions, only
+* the final XOR needs the previous ciphertext block.  Up to RIJNDAEL_LANES
+* ciphertext blocks are read into c[] before anything is written, which is
+* what makes in == out safe without a copy of the buffer.
+*/
+RIJNDAEL_INLINE void
+_rijndael_cbc_dec(const uint32_t *rk, int Nr, uint8_t *iv,
+    const uint8_t *in, uint8_t *out, size_t blocks)
+{
+    uint32_t c[RIJNDAEL_LANES + 1][4];
+    uint32_t s[RIJNDAEL_LANES][4];
+    int b, n;
+
+    /* c[0] is the block before the batch: the iv, then the last ct block */
+    c[0][0] = GETU32(iv     );
+    c[0][1] = GETU32(iv +  4);
+    c[0][2] = GETU32(iv +  8);
+    c[0][3] = GETU32(iv + 12);
+
+    while (blocks > 0) {
+        n = blocks < RIJNDAEL_LANES ? (int)blocks : RIJNDAEL_LANES;
+
+        for (b = 0; b < n; b++) {
+            s[b][0] = c[b + 1][0] = GETU32(in     );
+            s[b][1] = c[b + 1][1] = GETU32(in +  4);
+            s[b][2] = c[b + 1][2] = GETU32(in +  8);
+            s[b][3] = c[b + 1][3] = GETU32(in + 12);
+            in += 16;
         }
 
-        s0 =
-            Td0[(t0 >> 24)       ] ^
-            Td1[(t3 >> 16) & 0xff] ^
-            Td2[(t2 >>  8) & 0xff] ^
-            Td3[(t1      ) & 0xff] ^
-            rk[0];
-        s1 =
-            Td0[(t1 >> 24)       ] ^
-            Td1[(t0 >> 16) & 0xff] ^
-            Td2[(t3 >>  8) & 0xff] ^
-            Td3[(t2      ) & 0xff] ^
-            rk[1];
-        s2 =
-            Td0[(t2 >> 24)       ] ^
-            Td1[(t1 >> 16) & 0xff] ^
-            Td2[(t0 >>  8) & 0xff] ^
-            Td3[(t3      ) & 0xff] ^
-            rk[2];
-        s3 =
-            Td0[(t3 >> 24)       ] ^
-            Td1[(t2 >> 16) & 0xff] ^
-            Td2[(t1 >>  8) & 0xff] ^
-            Td3[(t0      ) & 0xff] ^
-            rk[3];
+        _rijndael_decrypt_lanes(rk, Nr, s, n);
+
+        for (b = 0; b < n; b++) {
+            PUTU32(out     , s[b][0] ^ c[b][0]);
+            PUTU32(out +  4, s[b][1] ^ c[b][1]);
+            PUTU32(out +  8, s[b][2] ^ c[b][2]);
+            PUTU32(out + 12, s[b][3] ^ c[b][3]);
+            out += 16;
+        }
+
+        memcpy(c[0], c[n], sizeof(c[0]));
+        blocks -= n;
     }
 
-    /*
-    * Apply last round and map cipher state to byte array block:
-    */
-    s0 =
-        (Td4[(t0 >> 24)       ] << 24) ^
-        (Td4[(t3 >> 16) & 0xff] << 16) ^
-        (Td4[(t2 >>  8) & 0xff] <<  8) ^
-        (Td4[(t1      ) & 0xff])       ^
-        rk[0];
-    PUTU32(pt, s0);
-
-    s1 =
-        (Td4[(t1 >> 24)       ] << 24) ^
-        (Td4[(t0 >> 16) & 0xff] << 16) ^
-        (Td4[(t3 >>  8) & 0xff] <<  8) ^
-        (Td4[(t2      ) & 0xff])       ^
-        rk[1];
-    PUTU32(pt + 4, s1);
-
-    s2 =
-        (Td4[(t2 >> 24)       ] << 24) ^
-        (Td4[(t1 >> 16) & 0xff] << 16) ^
-        (Td4[(t0 >>  8) & 0xff] <<  8) ^
-        (Td4[(t3      ) & 0xff])       ^
-        rk[2];
-    PUTU32(pt + 8, s2);
-
-    s3 =
-        (Td4[(t3 >> 24)       ] << 24) ^
-        (Td4[(t2 >> 16) & 0xff] << 16) ^
-        (Td4[(t1 >>  8) & 0xff] <<  8) ^
-        (Td4[(t0      ) & 0xff])       ^
-        rk[3];
-    PUTU32(pt + 12, s3);
+    PUTU32(iv     , c[0][0]);
+    PUTU32(iv +  4, c[0][1]);
+    PUTU32(iv +  8, c[0][2]);
+    PUTU32(iv + 12, c[0][3]);
+
+    memset(s, 0, sizeof(s));
+}
+
+/*
+* Blocks under different keys, two at a time through the two-key pair
+* kernels.  An odd block out is paired with itself.
+*/
+RIJNDAEL_INLINE void
+_rijndael_encrypt_multi(const uint32_t *const *rk, int Nr,
+    const uint8_t *const *in, uint8_t *const *out, size_t n)
+{
+    uint32_t s[2][4];
+    size_t i, j;
+
+    for (i = 0; i < n; i += 2) {
+        j = i + 1 < n ? i + 1 : i;
+        STATE_LOAD(s[0], in[i]);
+        STATE_LOAD(s[1], in[j]);
+        _rijndael_encrypt_pair2(rk[i], rk[j], Nr, s[0], s[1]);
+        STATE_STORE(out[i], s[0]);
+        STATE_STORE(out[j], s[1]);
+    }
+
+    memset(s, 0, sizeof(s));
+}
+
+RIJNDAEL_INLINE void
+_rijndael_decrypt_multi(const uint32_t *const *rk, int Nr,
+    const uint8_t *const *in, uint8_t *const *out, size_t n)
+{
+    uint32_t s[2][4];
+    size_t i, j;
+
+    for (i = 0; i < n; i += 2) {
+        j = i + 1 < n ? i + 1 : i;
+        STATE_LOAD(s[0], in[i]);
+        STATE_LOAD(s[1], in[j]);
+        _rijndael_decrypt_pair2(rk[i], rk[j], Nr, s[0], s[1]);
+        STATE_STORE(out[i], s[0]);
+        STATE_STORE(out[j], s[1]);
+    }
+
+    memset(s, 0, sizeof(s));
+}
+
+static uint64_t
+_rijndael_load_le64(const uint8_t *p)
+{
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) |
+        ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+        ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) |
+        ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+static void
+_rijndael_store_le64(uint8_t *p, uint64_t v)
+{
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+/* the big-endian state word made of the four bytes of w in memory order */
+#define LE_WORD(w) \
+    ((((w) & 0xff) << 24) | (((w) & 0xff00) << 8) | \
+     (((w) >> 8) & 0xff00) | ((w) >> 24))
+
+/*
+* The tweak is kept as two little-endian 64-bit halves, so multiplying it
+* by x is a shift with the carry folded back in as 0x87.  The tweaks of a
+* whole batch are worked out first, then the blocks go through the lanes
+* like in CBC decryption.
+*/
+RIJNDAEL_INLINE void
+_rijndael_xts(const uint32_t *rk, int Nr, uint8_t *tweak,
+    const uint8_t *in, uint8_t *out, size_t blocks, int decrypt)
+{
+    uint32_t s[RIJNDAEL_LANES][4];
+    uint32_t t[RIJNDAEL_LANES][4];
+    uint64_t lo, hi, c;
+    int b, n;
+
+    lo = _rijndael_load_le64(tweak);
+    hi = _rijndael_load_le64(tweak + 8);
+
+    while (blocks > 0) {
+        n = blocks < RIJNDAEL_LANES ? (int)blocks : RIJNDAEL_LANES;
+
+        for (b = 0; b < n; b++) {
+            t[b][0] = LE_WORD((uint32_t)lo);
+            t[b][1] = LE_WORD((uint32_t)(lo >> 32));
+            t[b][2] = LE_WORD((uint32_t)hi);
+            t[b][3] = LE_WORD((uint32_t)(hi >> 32));
+
+            c = hi >> 63;
+            hi = (hi << 1) | (lo >> 63);
+            lo = (lo << 1) ^ (0x87 & (0 - c));
+
+            STATE_LOAD(s[b], in);
+            s[b][0] ^= t[b][0];
+            s[b][1] ^= t[b][1];
+            s[b][2] ^= t[b][2];
+            s[b][3] ^= t[b][3];
+            in += 16;
+        }
+
+        if (decrypt) {
+            _rijndael_decrypt_lanes(rk, Nr, s, n);
+        } else {
+            _rijndael_encrypt_lanes(rk, Nr, s, n);
+        }
+
+        for (b = 0; b < n; b++) {
+            s[b][0] ^= t[b][0];
+            s[b][1] ^= t[b][1];
+            s[b][2] ^= t[b][2];
+            s[b][3] ^= t[b][3];
+            STATE_STORE(out, s[b]);
+            out += 16;
+        }
+
+        blocks -= n;
+    }
+
+    _rijndael_store_le64(tweak, lo);
+    _rijndael_store_le64(tweak + 8, hi);
+
+    memset(s, 0, sizeof(s));
+    memset(t, 0, sizeof(t));
+}
+
+RIJNDAEL_INLINE void
+_rijndael_xts_enc(const uint32_t *rk, int Nr, uint8_t *tweak,
+    const uint8_t *in, uint8_t *out, size_t blocks)
+{
+    _rijndael_xts(rk, Nr, tweak, in, out, blocks, 0);
+}
+
+RIJNDAEL_INLINE void
+_rijndael_xts_dec(const uint32_t *rk, int Nr, uint8_t *tweak,
+    const uint8_t *in, uint8_t *out, size_t blocks)
+{
+    _rijndael_xts(rk, Nr, tweak, in, out, blocks, 1);
+}
+
+RIJNDAEL_SIZED_IMPL(_rijndael, "table", _rijndael_table_impl, 128, 10);
+RIJNDAEL_SIZED_IMPL(_rijndael, "table", _rijndael_table_impl, 192, 12);
+RIJNDAEL_SIZED_IMPL(_rijndael, "table", _rijndael_table_impl, 256, 14);
+
+static const struct rijndael_impl_t *
+_rijndael_best_impl(void)
+{
+#if defined(ECRYPT_HAVE_VAES)
+    if (_ecrypt_cpu_features() & ECRYPT_CPU_VAES) {
+        return (_ecrypt_cpu_features() & ECRYPT_CPU_AVX512) ?
+            &_rijndael_vaes512_impl : &_rijndael_vaes256_impl;
+    }
+#endif
+
+#if defined(ECRYPT_HAVE_AESNI)
+    if (_ecrypt_cpu_features() & ECRYPT_CPU_AESNI) {
+        return &_rijndael_aesni_impl;
+    }
+#endif
+
+#if defined(ECRYPT_HAVE_VPERM)
+    if (_ecrypt_cpu_features() & ECRYPT_CPU_SSSE3) {
+        return &_rijndael_vperm_impl;
+    }
+#endif
+
+    return &_rijndael_table_impl;
+}
+
+static void
+_rijndael_impl_init(void)
+{
+    _rijndael_impl = _rijndael_best_impl();
+}
+
+static const struct rijndael_impl_t *
+_rijndael_current_impl(void)
+{
+    pthread_once(&_rijndael_impl_once, _rijndael_impl_init);
+    return _rijndael_impl;
+}
+
+int
+rijndael_select_impl(int impl)
+{
+    /* so that the first use cannot undo the choice made here */
+    pthread_once(&_rijndael_impl_once, _rijndael_impl_init);
+
+    switch (impl) {
+    case RIJNDAEL_IMPL_AUTO:
+        _rijndael_impl = _rijndael_best_impl();
+        return ECRYPT_NO_ERROR;
+    case RIJNDAEL_IMPL_TABLE:
+        _rijndael_impl = &_rijndael_table_impl;
+        return ECRYPT_NO_ERROR;
+    case RIJNDAEL_IMPL_AESNI:
+#if defined(ECRYPT_HAVE_AESNI)
+        if (_ecrypt_cpu_features() & ECRYPT_CPU_AESNI) {
+            _rijndael_impl = &_rijndael_aesni_impl;
+            return ECRYPT_NO_ERROR;
+        }
+#endif
+        return ECRYPT_INVALID_PARAMETERS;
+    case RIJNDAEL_IMPL_VPERM:
+#if defined(ECRYPT_HAVE_VPERM)
+        if (_ecrypt_cpu_features() & ECRYPT_CPU_SSSE3) {
+            _rijndael_impl = &_rijndael_vperm_impl;
+            return ECRYPT_NO_ERROR;
+        }
+#endif
+        return ECRYPT_INVALID_PARAMETERS;
+    case RIJNDAEL_IMPL_VAES256:
+#if defined(ECRYPT_HAVE_VAES)
+        if (_ecrypt_cpu_features() & ECRYPT_CPU_VAES) {
+            _rijndael_impl = &_rijndael_vaes256_impl;
+            return ECRYPT_NO_ERROR;
+        }
+#endif
+        return ECRYPT_INVALID_PARAMETERS;
+    case RIJNDAEL_IMPL_VAES512:
+#if defined(ECRYPT_HAVE_VAES)
+        if ((_ecrypt_cpu_features() & ECRYPT_CPU_VAES) &&
+            (_ecrypt_cpu_features() & ECRYPT_CPU_AVX512)) {
+            _rijndael_impl = &_rijndael_vaes512_impl;
+            return ECRYPT_NO_ERROR;
+        }
+#endif
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    return ECRYPT_INVALID_PARAMETERS;
+}
+
+/* the copy of impl specialised for Nr rounds, if it has one */
+static const struct rijndael_impl_t *
+_rijndael_sized_impl(const struct rijndael_impl_t *impl, int Nr)
+{
+    const struct rijndael_impl_t *sized;
+
+    sized = impl->base->sized[(Nr - 10) / 2];
+    return sized != NULL ? sized : impl->base;
+}
+
+const char *
+rijndael_impl_name(const rijndael_ctx *ctx)
+{
+    if (ctx != NULL && ctx->impl != NULL) {
+        return ctx->impl->name;
+    }
+
+    return _rijndael_current_impl()->name;
+}
+
+/* the OpenBSD names, kept for code written against rijndael.h there */
+int
+rijndaelKeySetupEnc(uint32_t *rk, const uint8_t *cipher_key, int keybits)
+{
+	return _rijndael_current_impl()->setup_enc(rk, cipher_key, keybits);
+}
+
+int
+rijndaelKeySetupDec(uint32_t *rk, const uint8_t *cipher_key, int keybits)
+{
+	return _rijndael_current_impl()->setup_dec(rk, cipher_key, keybits);
+}
+
+void
+rijndaelEncrypt(const uint32_t *rk, int Nr, const uint8_t *pt, uint8_t *ct)
+{
+	_rijndael_current_impl()->encrypt(rk, Nr, pt, ct);
 }
 
 /* setup key context for encryption only */
 int
 rijndael_set_key_enc_only(rijndael_ctx *ctx, const uint8_t *key, int bits)
 {
+	const struct rijndael_impl_t *impl;
 	int rounds;
 
-	rounds = rijndaelKeySetupEnc(ctx->ek, key, bits);
+	impl = _rijndael_current_impl();
+	rounds = impl->setup_enc(ctx->ek, key, bits);
 	if (rounds == 0)
 		return -1;
 
 	ctx->Nr = rounds;
 	ctx->enc_only = 1;
+	ctx->impl = _rijndael_sized_impl(impl, rounds);
 
 	return 0;
 }
@@ -411,16 +909,19 @@ rijndael_set_key_enc_only(rijndael_ctx *ctx, const uint8_t *key, int bits)
 int
 rijndael_set_key(rijndael_ctx *ctx, const uint8_t *key, int bits)
 {
+	const struct rijndael_impl_t *impl;
 	int rounds;
 
-	rounds = rijndaelKeySetupEnc(ctx->ek, key, bits);
+	impl = _rijndael_current_impl();
+	rounds = impl->setup_enc(ctx->ek, key, bits);
 	if (rounds == 0)
 		return -1;
-	if (rijndaelKeySetupDec(ctx->dk, key, bits) != rounds)
-		return -1;
+	/* cheaper than expanding the key a second time */
+	impl->invert(ctx->dk, ctx->ek, rounds);
 
 	ctx->Nr = rounds;
 	ctx->enc_only = 0;
+	ctx->impl = _rijndael_sized_impl(impl, rounds);
 
 	return 0;
 }
@@ -428,11 +929,591 @@ rijndael_set_key(rijndael_ctx *ctx, const uint8_t *key, int bits)
 void
 rijndael_decrypt(rijndael_ctx *ctx, const uint8_t *src, uint8_t *dst)
 {
-	_rijndael_decrypt(ctx->dk, ctx->Nr, src, dst);
+	ctx->impl->decrypt(ctx->dk, ctx->Nr, src, dst);
 }
 
 void
 rijndael_encrypt(rijndael_ctx *ctx, const uint8_t *src, uint8_t *dst)
 {
-	_rijndael_encrypt(ctx->ek, ctx->Nr, src, dst);
+	ctx->impl->encrypt(ctx->ek, ctx->Nr, src, dst);
+}
+
+int
+rijndael_init(struct rijndael_ctx_t *ctx, const uint8_t *key, uint32_t klen)
+{
+    if (ctx == NULL || key == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (klen != 16 && klen != 24 && klen != 32) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    if (rijndael_set_key(ctx, key, klen * 8) != 0) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    return ECRYPT_NO_ERROR;
+}
+
+int
+rijndael_release(struct rijndael_ctx_t *ctx)
+{
+    if (ctx == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    return ECRYPT_NO_ERROR;
+}
+
+int
+rijndael_decrypt_ctr(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const uint8_t *ct, size_t ct_len, uint8_t *out)
+{
+    /* CTR is its own inverse */
+    return rijndael_encrypt_ctr(ctx, iv, ct, ct_len, out);
+}
+
+/* ctr += n, as one 128-bit big-endian number */
+static void
+_rijndael_ctr_add(uint8_t *ctr, uint64_t n)
+{
+    int i;
+
+    for (i = 15; i >= 0 && n != 0; i--) {
+        n += ctr[i];
+        ctr[i] = (uint8_t)n;
+        n >>= 8;
+    }
+}
+
+/* CTR over any number of bytes; ctr ends up past the last block used */
+static void
+_rijndael_ctr_crypt(struct rijndael_ctx_t *ctx, uint8_t *ctr,
+    const uint8_t *in, uint8_t *out, size_t len)
+{
+    uint8_t ks[16];
+    size_t i, tail;
+
+    ctx->impl->ctr(ctx->ek, ctx->Nr, ctr, in, out, len / 16);
+
+    /* a trailing partial block uses only as much keystream as it needs */
+    tail = len % 16;
+    if (tail != 0) {
+        in += len - tail;
+        out += len - tail;
+
+        ctx->impl->encrypt(ctx->ek, ctx->Nr, ctr, ks);
+        _rijndael_ctr_add(ctr, 1);
+        for (i = 0; i < tail; i++) {
+            out[i] = in[i] ^ ks[i];
+        }
+
+        memset(ks, 0, sizeof(ks));
+    }
+}
+
+int
+rijndael_encrypt_ctr(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const uint8_t *pt, size_t pt_len, uint8_t *out)
+{
+    uint8_t ctr[16];
+
+    if (ctx == NULL || iv == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (pt_len > 0 && (pt == NULL || out == NULL)) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    memcpy(ctr, iv, 16);
+    _rijndael_ctr_crypt(ctx, ctr, pt, out, pt_len);
+    memset(ctr, 0, sizeof(ctr));
+
+    return ECRYPT_NO_ERROR;
+}
+
+/*
+* Below this many bytes per worker, starting a thread costs more than it
+* saves.  Worker ranges are multiples of RIJNDAEL_MT_ALIGN bytes, so no two
+* threads ever write to the same cache line of out.
+*/
+#define RIJNDAEL_MT_MIN_BYTES	(256 * 1024)
+#define RIJNDAEL_MT_ALIGN	(64)
+
+struct _rijndael_ctr_job_t {
+    struct rijndael_ctx_t *ctx;
+    const uint8_t *iv;
+    const uint8_t *in;
+    uint8_t *out;
+    size_t blocks;
+    size_t share;		/* blocks per worker */
+};
+
+static void
+_rijndael_ctr_worker(void *arg, int index, int count)
+{
+    struct _rijndael_ctr_job_t *job = (struct _rijndael_ctr_job_t *)arg;
+    uint8_t ctr[16];
+    size_t first, n;
+
+    (void)count;
+
+    first = job->share * (size_t)index;
+    if (first >= job->blocks) {
+        return;
+    }
+
+    n = job->blocks - first;
+    if (n > job->share) {
+        n = job->share;
+    }
+
+    /* no need to walk the counters before ours; jump straight there */
+    memcpy(ctr, job->iv, 16);
+    _rijndael_ctr_add(ctr, (uint64_t)first);
+
+    job->ctx->impl->ctr(job->ctx->ek, job->ctx->Nr, ctr,
+        job->in + 16 * first, job->out + 16 * first, n);
+    memset(ctr, 0, sizeof(ctr));
+}
+
+int
+rijndael_decrypt_ctr_mt(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const uint8_t *ct, size_t ct_len, uint8_t *out, int workers)
+{
+    return rijndael_encrypt_ctr_mt(ctx, iv, ct, ct_len, out, workers);
+}
+
+int
+rijndael_encrypt_ctr_mt(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const uint8_t *pt, size_t pt_len, uint8_t *out, int workers)
+{
+    struct _rijndael_ctr_job_t job;
+    const size_t align = RIJNDAEL_MT_ALIGN / 16;
+    uint8_t ctr[16];
+    size_t most;
+
+    if (ctx == NULL || iv == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (pt_len > 0 && (pt == NULL || out == NULL)) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (workers < 0) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    if (workers == 0) {
+        workers = _ecrypt_default_workers();
+    }
+
+    most = pt_len / RIJNDAEL_MT_MIN_BYTES;
+    if ((size_t)workers > most) {
+        workers = most > 1 ? (int)most : 1;
+    }
+
+    job.ctx = ctx;
+    job.iv = iv;
+    job.in = pt;
+    job.out = out;
+    job.blocks = pt_len / 16;
+    job.share = (job.blocks + workers - 1) / workers;
+    job.share = (job.share + align - 1) / align * align;
+
+    _ecrypt_run_workers(workers, _rijndael_ctr_worker, &job);
+
+    /* the partial block at the end, if any */
+    memcpy(ctr, iv, 16);
+    _rijndael_ctr_add(ctr, (uint64_t)job.blocks);
+    _rijndael_ctr_crypt(ctx, ctr, pt + 16 * job.blocks, out + 16 * job.blocks,
+        pt_len % 16);
+    memset(ctr, 0, sizeof(ctr));
+
+    return ECRYPT_NO_ERROR;
+}
+
+/*
+* Splits the batch into runs of up to RIJNDAEL_LANES jobs with the same key
+* size and hands each run to the multi-key kernel of the first context.
+* Any implementation can run any context: the schedules share one layout.
+*/
+static int
+_rijndael_batch(const struct rijndael_batch_t *jobs, size_t n, int decrypt)
+{
+    const uint32_t *rk[RIJNDAEL_LANES];
+    const uint8_t *in[RIJNDAEL_LANES];
+    uint8_t *out[RIJNDAEL_LANES];
+    const struct rijndael_impl_t *impl;
+    size_t i, m;
+    int Nr;
+
+    if (n > 0 && jobs == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (jobs[i].ctx == NULL || jobs[i].in == NULL ||
+            jobs[i].out == NULL) {
+            return ECRYPT_NULL_PTR;
+        }
+
+        if (decrypt && jobs[i].ctx->enc_only) {
+            return ECRYPT_INVALID_PARAMETERS;
+        }
+    }
+
+    for (i = 0; i < n; i += m) {
+        impl = jobs[i].ctx->impl;
+        Nr = jobs[i].ctx->Nr;
+
+        for (m = 0; m < RIJNDAEL_LANES && i + m < n &&
+            jobs[i + m].ctx->Nr == Nr; m++) {
+            rk[m] = decrypt ? jobs[i + m].ctx->dk : jobs[i + m].ctx->ek;
+            in[m] = jobs[i + m].in;
+            out[m] = jobs[i + m].out;
+        }
+
+        if (decrypt) {
+            impl->decrypt_multi(rk, Nr, in, out, m);
+        } else {
+            impl->encrypt_multi(rk, Nr, in, out, m);
+        }
+    }
+
+    return ECRYPT_NO_ERROR;
+}
+
+int
+rijndael_decrypt_batch(const struct rijndael_batch_t *jobs, size_t n)
+{
+    return _rijndael_batch(jobs, n, 1);
+}
+
+int
+rijndael_encrypt_batch(const struct rijndael_batch_t *jobs, size_t n)
+{
+    return _rijndael_batch(jobs, n, 0);
+}
+
+int
+rijndael_init_enc_only_multi(struct rijndael_ctx_t *ctx,
+    const uint8_t *const *keys, uint32_t klen, size_t n)
+{
+    const struct rijndael_impl_t *impl;
+    uint32_t *rk[RIJNDAEL_LANES];
+    size_t i, j, m;
+    int Nr;
+
+    if (n > 0 && (ctx == NULL || keys == NULL)) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (klen != 16 && klen != 24 && klen != 32) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (keys[i] == NULL) {
+            return ECRYPT_NULL_PTR;
+        }
+    }
+
+    impl = _rijndael_current_impl();
+    for (i = 0; i < n; i += m) {
+        m = n - i < RIJNDAEL_LANES ? n - i : RIJNDAEL_LANES;
+        for (j = 0; j < m; j++) {
+            rk[j] = ctx[i + j].ek;
+        }
+
+        Nr = impl->setup_enc_multi(rk, keys + i, (int)klen * 8, m);
+        for (j = 0; j < m; j++) {
+            ctx[i + j].Nr = Nr;
+            ctx[i + j].enc_only = 1;
+            ctx[i + j].impl = _rijndael_sized_impl(impl, Nr);
+        }
+    }
+
+    return ECRYPT_NO_ERROR;
+}
+
+int
+rijndael_encrypt_oneshot(const uint8_t *key, uint32_t klen,
+    const uint8_t *pt, size_t pt_len, uint8_t *out)
+{
+    uint32_t ek[4*(AES_MAXROUNDS + 1)];
+    const uint32_t *rk[RIJNDAEL_LANES];
+    const uint8_t *in[RIJNDAEL_LANES];
+    uint8_t *dst[RIJNDAEL_LANES];
+    const struct rijndael_impl_t *impl;
+    size_t blocks, i, j, m;
+    int Nr;
+
+    if (key == NULL || (pt_len > 0 && (pt == NULL || out == NULL))) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if ((klen != 16 && klen != 24 && klen != 32) || pt_len % 16 != 0) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    /* the encrypt schedule alone, on the stack */
+    impl = _rijndael_current_impl();
+    Nr = impl->setup_enc(ek, key, (int)klen * 8);
+    impl = _rijndael_sized_impl(impl, Nr);
+
+    blocks = pt_len / 16;
+    for (j = 0; j < RIJNDAEL_LANES; j++) {
+        rk[j] = ek;
+    }
+    for (i = 0; i < blocks; i += m) {
+        m = blocks - i < RIJNDAEL_LANES ? blocks - i : RIJNDAEL_LANES;
+        for (j = 0; j < m; j++) {
+            in[j] = pt + 16 * (i + j);
+            dst[j] = out + 16 * (i + j);
+        }
+        impl->encrypt_multi(rk, Nr, in, dst, m);
+    }
+
+    memset(ek, 0, sizeof(ek));
+    return ECRYPT_NO_ERROR;
+}
+
+int
+rijndael_decrypt_cbc(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const uint8_t *ct, size_t ct_len, uint8_t *out)
+{
+    uint8_t chain[16];
+
+    if (ctx == NULL || iv == NULL || ct == NULL || out == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (ct_len % 16 != 0) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    if (ctx->enc_only) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    memcpy(chain, iv, 16);
+    ctx->impl->cbc_dec(ctx->dk, ctx->Nr, chain, ct, out, ct_len / 16);
+    memset(chain, 0, sizeof(chain));
+
+    return ECRYPT_NO_ERROR;
+}
+
+/* CBC encryption is serial; each block needs the previous ciphertext */
+static void
+_rijndael_cbc_enc(const rijndael_ctx *ctx, uint8_t *iv, const uint8_t *in,
+    uint8_t *out, size_t blocks)
+{
+    size_t i;
+    int j;
+
+    for (i = 0; i < blocks; i++, in += 16, out += 16) {
+        for (j = 0; j < 16; j++) {
+            iv[j] ^= in[j];
+        }
+
+        ctx->impl->encrypt(ctx->ek, ctx->Nr, iv, iv);
+        memcpy(out, iv, 16);
+    }
+}
+
+int
+rijndael_encrypt_cbc(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const uint8_t *pt, size_t pt_len, uint8_t *out)
+{
+    uint8_t chain[16];
+
+    if (ctx == NULL || iv == NULL || pt == NULL || out == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (pt_len % 16 != 0) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    memcpy(chain, iv, 16);
+    _rijndael_cbc_enc(ctx, chain, pt, out, pt_len / 16);
+    memset(chain, 0, sizeof(chain));
+
+    return ECRYPT_NO_ERROR;
+}
+
+static void
+_rijndael_stream_cbc_enc(const void *key, uint8_t *iv, const uint8_t *in,
+    uint8_t *out, size_t blocks)
+{
+    _rijndael_cbc_enc((const rijndael_ctx *)key, iv, in, out, blocks);
+}
+
+static void
+_rijndael_stream_cbc_dec(const void *key, uint8_t *iv, const uint8_t *in,
+    uint8_t *out, size_t blocks)
+{
+    const rijndael_ctx *ctx = (const rijndael_ctx *)key;
+
+    ctx->impl->cbc_dec(ctx->dk, ctx->Nr, iv, in, out, blocks);
+}
+
+static void
+_rijndael_stream_ctr(const void *key, uint8_t *ctr, const uint8_t *in,
+    uint8_t *out, size_t blocks)
+{
+    const rijndael_ctx *ctx = (const rijndael_ctx *)key;
+
+    ctx->impl->ctr(ctx->ek, ctx->Nr, ctr, in, out, blocks);
+}
+
+static const struct _ecrypt_stream_ops_t _rijndael_stream_ops = {
+    16,
+    _rijndael_stream_cbc_enc,
+    _rijndael_stream_cbc_dec,
+    _rijndael_stream_ctr
+};
+
+static int
+_rijndael_iov(struct rijndael_ctx_t *ctx, const uint8_t *iv, int mode,
+    const struct iovec *in, int in_cnt, const struct iovec *out, int out_cnt)
+{
+    uint8_t chain[16];
+    int err;
+
+    if (ctx == NULL || iv == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (mode == ECRYPT_STREAM_CBC_DECRYPT && ctx->enc_only) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    memcpy(chain, iv, 16);
+    err = _ecrypt_stream_iov(&_rijndael_stream_ops, ctx, mode, chain, in,
+        in_cnt, out, out_cnt);
+    memset(chain, 0, sizeof(chain));
+
+    return err;
+}
+
+int
+rijndael_decrypt_cbc_iov(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const struct iovec *ct, int ct_cnt, const struct iovec *out, int out_cnt)
+{
+    return _rijndael_iov(ctx, iv, ECRYPT_STREAM_CBC_DECRYPT, ct, ct_cnt, out,
+        out_cnt);
+}
+
+int
+rijndael_encrypt_cbc_iov(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const struct iovec *pt, int pt_cnt, const struct iovec *out, int out_cnt)
+{
+    return _rijndael_iov(ctx, iv, ECRYPT_STREAM_CBC_ENCRYPT, pt, pt_cnt, out,
+        out_cnt);
+}
+
+int
+rijndael_decrypt_ctr_iov(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const struct iovec *ct, int ct_cnt, const struct iovec *out, int out_cnt)
+{
+    return _rijndael_iov(ctx, iv, ECRYPT_STREAM_CTR, ct, ct_cnt, out,
+        out_cnt);
+}
+
+int
+rijndael_encrypt_ctr_iov(struct rijndael_ctx_t *ctx, const uint8_t *iv,
+    const struct iovec *pt, int pt_cnt, const struct iovec *out, int out_cnt)
+{
+    return _rijndael_iov(ctx, iv, ECRYPT_STREAM_CTR, pt, pt_cnt, out,
+        out_cnt);
+}
+
+static void
+_rijndael_stream_state(struct rijndael_stream_t *s,
+    struct _ecrypt_stream_state_t *st)
+{
+    st->mode = s->mode;
+    st->pad = s->pad;
+    st->pos = &s->pos;
+    st->iv = s->iv;
+    st->buf = s->buf;
+}
+
+int
+rijndael_stream_init(struct rijndael_stream_t *s, const rijndael_ctx *ctx,
+    int mode, int pad, const uint8_t *iv)
+{
+    if (s == NULL || ctx == NULL || iv == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (mode != RIJNDAEL_STREAM_CBC_ENCRYPT &&
+        mode != RIJNDAEL_STREAM_CBC_DECRYPT && mode != RIJNDAEL_STREAM_CTR) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    if (pad != RIJNDAEL_PAD_NONE && pad != RIJNDAEL_PAD_PKCS7) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    if (mode == RIJNDAEL_STREAM_CBC_DECRYPT && ctx->enc_only) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    memset(s, 0, sizeof(*s));
+    s->ctx = ctx;
+    s->mode = mode;
+    s->pad = mode == RIJNDAEL_STREAM_CTR ? RIJNDAEL_PAD_NONE : pad;
+    memcpy(s->iv, iv, 16);
+
+    return ECRYPT_NO_ERROR;
+}
+
+int
+rijndael_stream_update(struct rijndael_stream_t *s, const uint8_t *in,
+    size_t in_len, uint8_t *out, size_t *out_len)
+{
+    struct _ecrypt_stream_state_t st;
+
+    if (s == NULL || out_len == NULL ||
+        (in_len != 0 && (in == NULL || out == NULL))) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (s->mode == 0) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    _rijndael_stream_state(s, &st);
+    return _ecrypt_stream_update(&_rijndael_stream_ops, s->ctx, &st, in,
+        in_len, out, out_len);
+}
+
+int
+rijndael_stream_final(struct rijndael_stream_t *s, uint8_t *out,
+    size_t *out_len)
+{
+    struct _ecrypt_stream_state_t st;
+    int err;
+
+    if (s == NULL || out == NULL || out_len == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (s->mode == 0) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    _rijndael_stream_state(s, &st);
+    err = _ecrypt_stream_final(&_rijndael_stream_ops, s->ctx, &st, out,
+        out_len);
+    memset(s, 0, sizeof(*s));
+
+    return err;
 }
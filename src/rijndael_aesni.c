@@ -0,0 +1,717 @@
+#include <string.h>
+
+#include <wmmintrin.h>
+
+#include "rijndael_x86.h"
+
+static int _rijndael_aesni_key_setup_enc(uint32_t *rk,
+    const uint8_t *cipher_key, int keybits);
+static int _rijndael_aesni_key_setup_dec(uint32_t *rk,
+    const uint8_t *cipher_key, int keybits);
+static int _rijndael_aesni_key_setup_enc_multi(uint32_t *const *rk,
+    const uint8_t *const *keys, int keybits, size_t n);
+static void _rijndael_aesni_invert_key(uint32_t *dk, const uint32_t *ek,
+    int Nr);
+static void _rijndael_aesni_encrypt(const uint32_t *rk, int Nr,
+    const uint8_t *pt, uint8_t *ct);
+static void _rijndael_aesni_decrypt(const uint32_t *rk, int Nr,
+    const uint8_t *ct, uint8_t *pt);
+static void _rijndael_aesni_ctr(const uint32_t *rk, int Nr, uint8_t *ctr,
+    const uint8_t *in, uint8_t *out, size_t blocks);
+static void _rijndael_aesni_cbc_dec(const uint32_t *rk, int Nr,
+    uint8_t *iv, const uint8_t *in, uint8_t *out, size_t blocks);
+static void _rijndael_aesni_encrypt_multi(const uint32_t *const *rk, int Nr,
+    const uint8_t *const *in, uint8_t *const *out, size_t n);
+static void _rijndael_aesni_decrypt_multi(const uint32_t *const *rk, int Nr,
+    const uint8_t *const *in, uint8_t *const *out, size_t n);
+static void _rijndael_aesni_xts_enc(const uint32_t *rk, int Nr,
+    uint8_t *tweak, const uint8_t *in, uint8_t *out, size_t blocks);
+static void _rijndael_aesni_xts_dec(const uint32_t *rk, int Nr,
+    uint8_t *tweak, const uint8_t *in, uint8_t *out, size_t blocks);
+RIJNDAEL_SIZED_DECL(_rijndael_aesni);
+
+const struct rijndael_impl_t _rijndael_aesni_impl = {
+    "aesni",
+    _rijndael_aesni_key_setup_enc,
+    _rijndael_aesni_key_setup_dec,
+    _rijndael_aesni_key_setup_enc_multi,
+    _rijndael_aesni_invert_key,
+    _rijndael_aesni_encrypt,
+    _rijndael_aesni_decrypt,
+    _rijndael_aesni_ctr,
+    _rijndael_aesni_cbc_dec,
+    _rijndael_aesni_encrypt_multi,
+    _rijndael_aesni_decrypt_multi,
+    _rijndael_aesni_xts_enc,
+    _rijndael_aesni_xts_dec,
+    &_rijndael_aesni_impl,
+    RIJNDAEL_SIZED_LIST(_rijndael_aesni)
+};
+
+/**
+ * w[0..3] of the next round key: every word is XORed with all of the words
+ * before it, then with the broadcast SubWord/RotWord/rcon term t.
+ */
+static __m128i
+_aesni_expand_step(__m128i k, __m128i t)
+{
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 8));
+
+    return _mm_xor_si128(k, t);
+}
+
+/*
+* SubWord and RotWord come from AESENCLAST on a block that holds the same
+* word in every column: ShiftRows then has nothing to move, SubBytes is
+* SubWord, and the round key adds rcon.  AESKEYGENASSIST does the same in
+* one instruction, but it is microcoded on most cores and takes a constant
+* rcon, which rules out a loop over the rounds.
+*/
+#define AESNI_ROT_W3 _mm_set_epi8(12, 15, 14, 13, 12, 15, 14, 13, \
+    12, 15, 14, 13, 12, 15, 14, 13)
+#define AESNI_DUP_W3 _mm_set_epi8(15, 14, 13, 12, 15, 14, 13, 12, \
+    15, 14, 13, 12, 15, 14, 13, 12)
+#define AESNI_ROT_W1 _mm_set_epi8(4, 7, 6, 5, 4, 7, 6, 5, \
+    4, 7, 6, 5, 4, 7, 6, 5)
+
+/* RotWord(SubWord(w3)) ^ rcon, broadcast to all four words */
+#define AESNI_EXPAND(k, src, rcon) _aesni_expand_step((k), \
+    _mm_aesenclast_si128(_mm_shuffle_epi8((src), AESNI_ROT_W3), (rcon)))
+
+/* SubWord(w3) without the rotation; the odd half-steps of AES-256 */
+#define AESNI_EXPAND_SUB(k, src) _aesni_expand_step((k), \
+    _mm_aesenclast_si128(_mm_shuffle_epi8((src), AESNI_DUP_W3), \
+        _mm_setzero_si128()))
+
+/* the next rcon, broadcast: the last one times x in GF(2^8) */
+static inline __m128i
+_aesni_next_rcon(__m128i rcon)
+{
+    __m128i carry;
+
+    carry = _mm_sub_epi32(_mm_setzero_si128(), _mm_srli_epi32(rcon, 7));
+    carry = _mm_and_si128(carry, _mm_set1_epi32(0x1b));
+    return _mm_xor_si128(_mm_and_si128(_mm_slli_epi32(rcon, 1),
+        _mm_set1_epi32(0xff)), carry);
+}
+
+/*
+* n keys side by side, for _rijndael_aesni_key_setup_enc_multi; a single
+* key is n == 1.  Both are inlined with n constant.
+*/
+RIJNDAEL_INLINE void
+_aesni_expand_128(__m128i (*ks)[AES_MAXROUNDS + 1],
+    const uint8_t *const *keys, int n)
+{
+    __m128i rcon = _mm_set1_epi32(0x01);
+    int r, j;
+
+    for (j = 0; j < n; j++) {
+        ks[j][0] = _mm_loadu_si128((const __m128i *)keys[j]);
+    }
+
+    for (r = 1; r <= 10; r++) {
+        for (j = 0; j < n; j++) {
+            ks[j][r] = AESNI_EXPAND(ks[j][r - 1], ks[j][r - 1], rcon);
+        }
+        rcon = _aesni_next_rcon(rcon);
+    }
+}
+
+/* AES-256 alternates a full step and a SubWord-only step */
+RIJNDAEL_INLINE void
+_aesni_expand_256(__m128i (*ks)[AES_MAXROUNDS + 1],
+    const uint8_t *const *keys, int n)
+{
+    __m128i rcon = _mm_set1_epi32(0x01);
+    int r, j;
+
+    for (j = 0; j < n; j++) {
+        ks[j][0] = _mm_loadu_si128((const __m128i *)keys[j]);
+        ks[j][1] = _mm_loadu_si128((const __m128i *)(keys[j] + 16));
+    }
+
+    for (r = 2; r < 14; r += 2) {
+        for (j = 0; j < n; j++) {
+            ks[j][r] = AESNI_EXPAND(ks[j][r - 2], ks[j][r - 1], rcon);
+            ks[j][r + 1] = AESNI_EXPAND_SUB(ks[j][r - 1], ks[j][r]);
+        }
+        rcon = _aesni_next_rcon(rcon);
+    }
+    for (j = 0; j < n; j++) {
+        ks[j][14] = AESNI_EXPAND(ks[j][12], ks[j][13], rcon);
+    }
+}
+
+/*
+* AES-192 produces six words per step, which does not line up with the
+* four-word round keys.  Each step is written out word-wise into a flat
+* buffer and the round keys are read back from that afterwards.
+*/
+#define AESNI_EXPAND_192(lo, hi, buf, step, rcon) do { \
+    __m128i t_; \
+    t_ = _mm_aesenclast_si128(_mm_shuffle_epi8((hi), AESNI_ROT_W1), \
+        _mm_set1_epi32(rcon)); \
+    (lo) = _aesni_expand_step((lo), t_); \
+    t_ = _mm_shuffle_epi32((lo), 0xff); \
+    (hi) = _mm_xor_si128((hi), _mm_slli_si128((hi), 4)); \
+    (hi) = _mm_xor_si128((hi), t_); \
+    _mm_storeu_si128((__m128i *)((buf) + 24*(step)), (lo)); \
+    _mm_storel_epi64((__m128i *)((buf) + 24*(step) + 16), (hi)); \
+} while (0)
+
+static void
+_aesni_expand_192(__m128i *ks, const uint8_t *cipher_key)
+{
+    uint8_t buf[24*9];
+    __m128i lo, hi;
+    int i;
+
+    lo = _mm_loadu_si128((const __m128i *)cipher_key);
+    hi = _mm_loadl_epi64((const __m128i *)(cipher_key + 16));
+    memcpy(buf, cipher_key, 24);
+
+    AESNI_EXPAND_192(lo, hi, buf, 1, 0x01);
+    AESNI_EXPAND_192(lo, hi, buf, 2, 0x02);
+    AESNI_EXPAND_192(lo, hi, buf, 3, 0x04);
+    AESNI_EXPAND_192(lo, hi, buf, 4, 0x08);
+    AESNI_EXPAND_192(lo, hi, buf, 5, 0x10);
+    AESNI_EXPAND_192(lo, hi, buf, 6, 0x20);
+    AESNI_EXPAND_192(lo, hi, buf, 7, 0x40);
+    AESNI_EXPAND_192(lo, hi, buf, 8, 0x80);
+
+    for (i = 0; i <= 12; i++) {
+        ks[i] = _mm_loadu_si128((const __m128i *)(buf + 16*i));
+    }
+
+    memset(buf, 0, sizeof(buf));
+}
+
+/**
+ * Expand n cipher keys into native-order round keys, ks[i] from keys[i].
+ *
+ * @return	the number of rounds for the given cipher key size.
+ */
+RIJNDAEL_INLINE int
+_aesni_expand(__m128i (*ks)[AES_MAXROUNDS + 1], const uint8_t *const *keys,
+    int keybits, int n)
+{
+    int j;
+
+    switch (keybits) {
+    case 128:
+        _aesni_expand_128(ks, keys, n);
+        return 10;
+    case 192:
+        for (j = 0; j < n; j++) {
+            _aesni_expand_192(ks[j], keys[j]);
+        }
+        return 12;
+    case 256:
+        _aesni_expand_256(ks, keys, n);
+        return 14;
+    }
+
+    return 0;
+}
+
+static int
+_rijndael_aesni_key_setup_enc(uint32_t *rk, const uint8_t *cipher_key,
+    int keybits)
+{
+    __m128i ks[AES_MAXROUNDS + 1];
+    int Nr, i;
+
+    Nr = _aesni_expand(&ks, &cipher_key, keybits, 1);
+    if (Nr == 0) {
+        return 0;
+    }
+
+    for (i = 0; i <= Nr; i++) {
+        RIJNDAEL_STORE_RK(rk, i, ks[i]);
+    }
+
+    memset(ks, 0, sizeof(ks));
+    return Nr;
+}
+
+/* keys expanded side by side by _rijndael_aesni_key_setup_enc_multi */
+#define AESNI_KEY_LANES		(4)
+
+static int
+_rijndael_aesni_key_setup_enc_multi(uint32_t *const *rk,
+    const uint8_t *const *keys, int keybits, size_t n)
+{
+    __m128i ks[AESNI_KEY_LANES][AES_MAXROUNDS + 1];
+    size_t done;
+    int Nr, i, j, m;
+
+    if (keybits != 128 && keybits != 192 && keybits != 256) {
+        return 0;
+    }
+    Nr = keybits / 32 + 6;
+
+    for (done = 0; done < n; done += m) {
+        m = n - done < AESNI_KEY_LANES ? (int)(n - done) : AESNI_KEY_LANES;
+        if (m == AESNI_KEY_LANES) {
+            _aesni_expand(ks, keys + done, keybits, AESNI_KEY_LANES);
+        } else {
+            for (j = 0; j < m; j++) {
+                _aesni_expand(&ks[j], keys + done + j, keybits, 1);
+            }
+        }
+
+        for (j = 0; j < m; j++) {
+            for (i = 0; i <= Nr; i++) {
+                RIJNDAEL_STORE_RK(rk[done + j], i, ks[j][i]);
+            }
+        }
+    }
+
+    memset(ks, 0, sizeof(ks));
+    return Nr;
+}
+
+/*
+* Same layout as _rijndael_key_setup_dec: round keys in reverse order, with
+* InvMixColumns (AESIMC) applied to all but the first and the last.
+*/
+static int
+_rijndael_aesni_key_setup_dec(uint32_t *rk, const uint8_t *cipher_key,
+    int keybits)
+{
+    __m128i ks[AES_MAXROUNDS + 1];
+    int Nr, i;
+
+    Nr = _aesni_expand(&ks, &cipher_key, keybits, 1);
+    if (Nr == 0) {
+        return 0;
+    }
+
+    RIJNDAEL_STORE_RK(rk, 0, ks[Nr]);
+    for (i = 1; i < Nr; i++) {
+        RIJNDAEL_STORE_RK(rk, i, _mm_aesimc_si128(ks[Nr - i]));
+    }
+    RIJNDAEL_STORE_RK(rk, Nr, ks[0]);
+
+    memset(ks, 0, sizeof(ks));
+    return Nr;
+}
+
+/* the same, from an encrypt schedule that is already expanded */
+static void
+_rijndael_aesni_invert_key(uint32_t *dk, const uint32_t *ek, int Nr)
+{
+    __m128i a, b;
+    int i, j;
+
+    /* swap from both ends in, so dk may overwrite ek */
+    for (i = 0, j = Nr; i <= j; i++, j--) {
+        a = RIJNDAEL_LOAD_RK(ek, i);
+        b = RIJNDAEL_LOAD_RK(ek, j);
+        if (i != 0) {
+            a = _mm_aesimc_si128(a);
+            b = _mm_aesimc_si128(b);
+        }
+        RIJNDAEL_STORE_RK(dk, j, a);
+        RIJNDAEL_STORE_RK(dk, i, b);
+    }
+}
+
+/* one round on state s in place, for RIJNDAEL_ROUNDS */
+#define AESNI_ENC(t, s, r) \
+    ((s) = _mm_aesenc_si128((s), RIJNDAEL_LOAD_RK(rk, (r))))
+#define AESNI_DEC(t, s, r) \
+    ((s) = _mm_aesdec_si128((s), RIJNDAEL_LOAD_RK(rk, (r))))
+
+RIJNDAEL_INLINE void
+_rijndael_aesni_encrypt(const uint32_t *rk, int Nr, const uint8_t *pt,
+    uint8_t *ct)
+{
+    __m128i s;
+
+    s = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pt),
+        RIJNDAEL_LOAD_RK(rk, 0));
+    RIJNDAEL_ROUNDS(AESNI_ENC, s, s, Nr);
+    s = _mm_aesenclast_si128(s, RIJNDAEL_LOAD_RK(rk, Nr));
+
+    _mm_storeu_si128((__m128i *)ct, s);
+}
+
+RIJNDAEL_INLINE void
+_rijndael_aesni_decrypt(const uint32_t *rk, int Nr, const uint8_t *ct,
+    uint8_t *pt)
+{
+    __m128i s;
+
+    s = _mm_xor_si128(_mm_loadu_si128((const __m128i *)ct),
+        RIJNDAEL_LOAD_RK(rk, 0));
+    RIJNDAEL_ROUNDS(AESNI_DEC, s, s, Nr);
+    s = _mm_aesdeclast_si128(s, RIJNDAEL_LOAD_RK(rk, Nr));
+
+    _mm_storeu_si128((__m128i *)pt, s);
+}
+
+/* apply one round instruction to all eight lanes */
+#define AESNI_ROUND8(op, x, k) do { \
+    (x)[0] = op((x)[0], (k)); (x)[1] = op((x)[1], (k)); \
+    (x)[2] = op((x)[2], (k)); (x)[3] = op((x)[3], (k)); \
+    (x)[4] = op((x)[4], (k)); (x)[5] = op((x)[5], (k)); \
+    (x)[6] = op((x)[6], (k)); (x)[7] = op((x)[7], (k)); \
+} while (0)
+
+/* the same with the round keys already in k[], for RIJNDAEL_ROUNDS */
+#define AESNI_ENC8(t, x, r)	AESNI_ROUND8(_mm_aesenc_si128, x, k[r])
+#define AESNI_DEC8(t, x, r)	AESNI_ROUND8(_mm_aesdec_si128, x, k[r])
+
+/*
+* Eight counter blocks go through the rounds side by side: AESENC has a
+* latency of several cycles but can issue every cycle, so independent
+* blocks hide each other's latency.
+*/
+RIJNDAEL_INLINE void
+_rijndael_aesni_ctr(const uint32_t *rk, int Nr, uint8_t *ctr,
+    const uint8_t *in, uint8_t *out, size_t blocks)
+{
+    __m128i k[AES_MAXROUNDS + 1];
+    __m128i x[RIJNDAEL_LANES];
+    uint64_t hi, lo;
+    int b, r;
+
+    _rijndael_load_schedule(k, rk, Nr);
+    hi = _rijndael_load_be64(ctr);
+    lo = _rijndael_load_be64(ctr + 8);
+
+    for (; blocks >= RIJNDAEL_LANES; blocks -= RIJNDAEL_LANES) {
+        for (b = 0; b < RIJNDAEL_LANES; b++) {
+            x[b] = _mm_xor_si128(_rijndael_ctr_block(&hi, &lo), k[0]);
+        }
+
+        RIJNDAEL_ROUNDS(AESNI_ENC8, x, x, Nr);
+        AESNI_ROUND8(_mm_aesenclast_si128, x, k[Nr]);
+
+        for (b = 0; b < RIJNDAEL_LANES; b++) {
+            _mm_storeu_si128((__m128i *)out + b, _mm_xor_si128(x[b],
+                _mm_loadu_si128((const __m128i *)in + b)));
+        }
+
+        in += 16 * RIJNDAEL_LANES;
+        out += 16 * RIJNDAEL_LANES;
+    }
+
+    for (; blocks > 0; blocks--) {
+        x[0] = _mm_xor_si128(_rijndael_ctr_block(&hi, &lo), k[0]);
+        for (r = 1; r < Nr; r++) {
+            x[0] = _mm_aesenc_si128(x[0], k[r]);
+        }
+        x[0] = _mm_aesenclast_si128(x[0], k[Nr]);
+
+        _mm_storeu_si128((__m128i *)out, _mm_xor_si128(x[0],
+            _mm_loadu_si128((const __m128i *)in)));
+
+        in += 16;
+        out += 16;
+    }
+
+    _rijndael_store_be64(ctr, hi);
+    _rijndael_store_be64(ctr + 8, lo);
+
+    memset(k, 0, sizeof(k));
+}
+
+/*
+* Eight ciphertext blocks are loaded, decrypted side by side, and only then
+* XORed with their predecessors and stored, so in == out needs no copy.
+*/
+RIJNDAEL_INLINE void
+_rijndael_aesni_cbc_dec(const uint32_t *rk, int Nr, uint8_t *iv,
+    const uint8_t *in, uint8_t *out, size_t blocks)
+{
+    __m128i k[AES_MAXROUNDS + 1];
+    __m128i c[RIJNDAEL_LANES];
+    __m128i x[RIJNDAEL_LANES];
+    __m128i prev;
+    int b, r;
+
+    _rijndael_load_schedule(k, rk, Nr);
+    prev = _mm_loadu_si128((const __m128i *)iv);
+
+    for (; blocks >= RIJNDAEL_LANES; blocks -= RIJNDAEL_LANES) {
+        for (b = 0; b < RIJNDAEL_LANES; b++) {
+            c[b] = _mm_loadu_si128((const __m128i *)in + b);
+            x[b] = _mm_xor_si128(c[b], k[0]);
+        }
+
+        RIJNDAEL_ROUNDS(AESNI_DEC8, x, x, Nr);
+        AESNI_ROUND8(_mm_aesdeclast_si128, x, k[Nr]);
+
+        _mm_storeu_si128((__m128i *)out, _mm_xor_si128(x[0], prev));
+        for (b = 1; b < RIJNDAEL_LANES; b++) {
+            _mm_storeu_si128((__m128i *)out + b,
+                _mm_xor_si128(x[b], c[b - 1]));
+        }
+        prev = c[RIJNDAEL_LANES - 1];
+
+        in += 16 * RIJNDAEL_LANES;
+        out += 16 * RIJNDAEL_LANES;
+    }
+
+    for (; blocks > 0; blocks--) {
+        c[0] = _mm_loadu_si128((const __m128i *)in);
+        x[0] = _mm_xor_si128(c[0], k[0]);
+        for (r = 1; r < Nr; r++) {
+            x[0] = _mm_aesdec_si128(x[0], k[r]);
+        }
+        x[0] = _mm_aesdeclast_si128(x[0], k[Nr]);
+
+        _mm_storeu_si128((__m128i *)out, _mm_xor_si128(x[0], prev));
+        prev = c[0];
+
+        in += 16;
+        out += 16;
+    }
+
+    _mm_storeu_si128((__m128i *)iv, prev);
+
+    memset(k, 0, sizeof(k));
+}
+
+/* one round on all eight lanes, each with the round key of its own schedule */
+#define AESNI_MROUND8(op, x, k, r) do { \
+    (x)[0] = op((x)[0], RIJNDAEL_LOAD_RK((k)[0], (r))); \
+    (x)[1] = op((x)[1], RIJNDAEL_LOAD_RK((k)[1], (r))); \
+    (x)[2] = op((x)[2], RIJNDAEL_LOAD_RK((k)[2], (r))); \
+    (x)[3] = op((x)[3], RIJNDAEL_LOAD_RK((k)[3], (r))); \
+    (x)[4] = op((x)[4], RIJNDAEL_LOAD_RK((k)[4], (r))); \
+    (x)[5] = op((x)[5], RIJNDAEL_LOAD_RK((k)[5], (r))); \
+    (x)[6] = op((x)[6], RIJNDAEL_LOAD_RK((k)[6], (r))); \
+    (x)[7] = op((x)[7], RIJNDAEL_LOAD_RK((k)[7], (r))); \
+} while (0)
+
+#define AESNI_MENC8(t, x, r)	AESNI_MROUND8(_mm_aesenc_si128, x, k, r)
+#define AESNI_MDEC8(t, x, r)	AESNI_MROUND8(_mm_aesdec_si128, x, k, r)
+
+/*
+* Eight blocks under eight different keys.  Each lane fetches its own
+* round key, which costs a load and a pshufb per AESENC, but the AESENCs
+* of the lanes are still independent and pipeline just like in CTR mode.
+* Short batches go one block at a time.
+*/
+#define AESNI_MULTI(name, step, op, oplast) \
+RIJNDAEL_INLINE void \
+name(const uint32_t *const *rk, int Nr, const uint8_t *const *in, \
+    uint8_t *const *out, size_t n) \
+{ \
+    const uint32_t *k[RIJNDAEL_LANES]; \
+    __m128i x[RIJNDAEL_LANES]; \
+    size_t b; \
+    int r; \
+\
+    for (; n >= RIJNDAEL_LANES; n -= RIJNDAEL_LANES) { \
+        for (b = 0; b < RIJNDAEL_LANES; b++) { \
+            k[b] = rk[b]; \
+            x[b] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in[b]), \
+                RIJNDAEL_LOAD_RK(k[b], 0)); \
+        } \
+\
+        RIJNDAEL_ROUNDS(step, x, x, Nr); \
+        AESNI_MROUND8(oplast, x, k, Nr); \
+\
+        for (b = 0; b < RIJNDAEL_LANES; b++) { \
+            _mm_storeu_si128((__m128i *)out[b], x[b]); \
+        } \
+\
+        rk += RIJNDAEL_LANES; \
+        in += RIJNDAEL_LANES; \
+        out += RIJNDAEL_LANES; \
+    } \
+\
+    for (b = 0; b < n; b++) { \
+        x[0] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in[b]), \
+            RIJNDAEL_LOAD_RK(rk[b], 0)); \
+        for (r = 1; r < Nr; r++) { \
+            x[0] = op(x[0], RIJNDAEL_LOAD_RK(rk[b], r)); \
+        } \
+        _mm_storeu_si128((__m128i *)out[b], \
+            oplast(x[0], RIJNDAEL_LOAD_RK(rk[b], Nr))); \
+    } \
+}
+
+AESNI_MULTI(_rijndael_aesni_encrypt_multi, AESNI_MENC8, _mm_aesenc_si128,
+    _mm_aesenclast_si128)
+AESNI_MULTI(_rijndael_aesni_decrypt_multi, AESNI_MDEC8, _mm_aesdec_si128,
+    _mm_aesdeclast_si128)
+
+/*
+* Eight blocks side by side as in CTR mode.  The tweak is XORed in with
+* the first round key and, on the way out, folded into the last one, so
+* it costs no extra work inside the rounds.  Working out the next eight
+* tweaks is a short serial chain that overlaps with the rounds of the
+* previous batch.
+*/
+RIJNDAEL_INLINE void
+_rijndael_aesni_xts(const uint32_t *rk, int Nr, uint8_t *tweak,
+    const uint8_t *in, uint8_t *out, size_t blocks, int decrypt)
+{
+    __m128i k[AES_MAXROUNDS + 1];
+    __m128i t[RIJNDAEL_LANES];
+    __m128i x[RIJNDAEL_LANES];
+    __m128i tw;
+    int b, r;
+
+    _rijndael_load_schedule(k, rk, Nr);
+    tw = _mm_loadu_si128((const __m128i *)tweak);
+
+    for (; blocks >= RIJNDAEL_LANES; blocks -= RIJNDAEL_LANES) {
+        for (b = 0; b < RIJNDAEL_LANES; b++) {
+            t[b] = tw;
+            tw = _rijndael_xts_double(tw);
+            x[b] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in + b),
+                _mm_xor_si128(t[b], k[0]));
+        }
+
+        if (decrypt) {
+            RIJNDAEL_ROUNDS(AESNI_DEC8, x, x, Nr);
+            for (b = 0; b < RIJNDAEL_LANES; b++) {
+                _mm_storeu_si128((__m128i *)out + b, _mm_aesdeclast_si128(
+                    x[b], _mm_xor_si128(k[Nr], t[b])));
+            }
+        } else {
+            RIJNDAEL_ROUNDS(AESNI_ENC8, x, x, Nr);
+            for (b = 0; b < RIJNDAEL_LANES; b++) {
+                _mm_storeu_si128((__m128i *)out + b, _mm_aesenclast_si128(
+                    x[b], _mm_xor_si128(k[Nr], t[b])));
+            }
+        }
+
+        in += 16 * RIJNDAEL_LANES;
+        out += 16 * RIJNDAEL_LANES;
+    }
+
+    for (; blocks > 0; blocks--) {
+        x[0] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in),
+            _mm_xor_si128(tw, k[0]));
+        if (decrypt) {
+            for (r = 1; r < Nr; r++) {
+                x[0] = _mm_aesdec_si128(x[0], k[r]);
+            }
+            x[0] = _mm_aesdeclast_si128(x[0], _mm_xor_si128(k[Nr], tw));
+        } else {
+            for (r = 1; r < Nr; r++) {
+                x[0] = _mm_aesenc_si128(x[0], k[r]);
+            }
+            x[0] = _mm_aesenclast_si128(x[0], _mm_xor_si128(k[Nr], tw));
+        }
+        _mm_storeu_si128((__m128i *)out, x[0]);
+        tw = _rijndael_xts_double(tw);
+
+        in += 16;
+        out += 16;
+    }
+
+    _mm_storeu_si128((__m128i *)tweak, tw);
+
+    memset(k, 0, sizeof(k));
+}
+
+RIJNDAEL_INLINE void
+_rijndael_aesni_xts_enc(const uint32_t *rk, int Nr, uint8_t *tweak,
+    const uint8_t *in, uint8_t *out, size_t blocks)
+{
+    _rijndael_aesni_xts(rk, Nr, tweak, in, out, blocks, 0);
+}
+
+RIJNDAEL_INLINE void
+_rijndael_aesni_xts_dec(const uint32_t *rk, int Nr, uint8_t *tweak,
+    const uint8_t *in, uint8_t *out, size_t blocks)
+{
+    _rijndael_aesni_xts(rk, Nr, tweak, in, out, blocks, 1);
+}
+
+RIJNDAEL_SIZED_IMPL(_rijndael_aesni, "aesni", _rijndael_aesni_impl, 128, 10);
+RIJNDAEL_SIZED_IMPL(_rijndael_aesni, "aesni", _rijndael_aesni_impl, 192, 12);
+RIJNDAEL_SIZED_IMPL(_rijndael_aesni, "aesni", _rijndael_aesni_impl, 256, 14);
+
+#if defined(ECRYPT_HAVE_VAES)
+/*
+* The VAES tables: everything but CTR and CBC decryption is the code
+* above, single blocks gaining nothing from the wider registers.  The
+* names below let RIJNDAEL_SIZED_IMPL find them under the VAES prefixes.
+*/
+#define _rijndael_vaes256_key_setup_enc	_rijndael_aesni_key_setup_enc
+#define _rijndael_vaes256_key_setup_dec	_rijndael_aesni_key_setup_dec
+#define _rijndael_vaes256_key_setup_enc_multi \
+    _rijndael_aesni_key_setup_enc_multi
+#define _rijndael_vaes256_invert_key	_rijndael_aesni_invert_key
+#define _rijndael_vaes256_encrypt	_rijndael_aesni_encrypt
+#define _rijndael_vaes256_decrypt	_rijndael_aesni_decrypt
+#define _rijndael_vaes256_encrypt_multi	_rijndael_aesni_encrypt_multi
+#define _rijndael_vaes256_decrypt_multi	_rijndael_aesni_decrypt_multi
+#define _rijndael_vaes256_xts_enc	_rijndael_aesni_xts_enc
+#define _rijndael_vaes256_xts_dec	_rijndael_aesni_xts_dec
+
+#define _rijndael_vaes512_key_setup_enc	_rijndael_aesni_key_setup_enc
+#define _rijndael_vaes512_key_setup_dec	_rijndael_aesni_key_setup_dec
+#define _rijndael_vaes512_key_setup_enc_multi \
+    _rijndael_aesni_key_setup_enc_multi
+#define _rijndael_vaes512_invert_key	_rijndael_aesni_invert_key
+#define _rijndael_vaes512_encrypt	_rijndael_aesni_encrypt
+#define _rijndael_vaes512_decrypt	_rijndael_aesni_decrypt
+#define _rijndael_vaes512_encrypt_multi	_rijndael_aesni_encrypt_multi
+#define _rijndael_vaes512_decrypt_multi	_rijndael_aesni_decrypt_multi
+#define _rijndael_vaes512_xts_enc	_rijndael_aesni_xts_enc
+#define _rijndael_vaes512_xts_dec	_rijndael_aesni_xts_dec
+
+RIJNDAEL_SIZED_DECL(_rijndael_vaes256);
+RIJNDAEL_SIZED_DECL(_rijndael_vaes512);
+
+const struct rijndael_impl_t _rijndael_vaes256_impl = {
+    "vaes-avx2",
+    _rijndael_aesni_key_setup_enc,
+    _rijndael_aesni_key_setup_dec,
+    _rijndael_aesni_key_setup_enc_multi,
+    _rijndael_aesni_invert_key,
+    _rijndael_aesni_encrypt,
+    _rijndael_aesni_decrypt,
+    _rijndael_vaes256_ctr,
+    _rijndael_vaes256_cbc_dec,
+    _rijndael_aesni_encrypt_multi,
+    _rijndael_aesni_decrypt_multi,
+    _rijndael_aesni_xts_enc,
+    _rijndael_aesni_xts_dec,
+    &_rijndael_vaes256_impl,
+    RIJNDAEL_SIZED_LIST(_rijndael_vaes256)
+};
+
+const struct rijndael_impl_t _rijndael_vaes512_impl = {
+    "vaes-avx512",
+    _rijndael_aesni_key_setup_enc,
+    _rijndael_aesni_key_setup_dec,
+    _rijndael_aesni_key_setup_enc_multi,
+    _rijndael_aesni_invert_key,
+    _rijndael_aesni_encrypt,
+    _rijndael_aesni_decrypt,
+    _rijndael_vaes512_ctr,
+    _rijndael_vaes512_cbc_dec,
+    _rijndael_aesni_encrypt_multi,
+    _rijndael_aesni_decrypt_multi,
+    _rijndael_aesni_xts_enc,
+    _rijndael_aesni_xts_dec,
+    &_rijndael_vaes512_impl,
+    RIJNDAEL_SIZED_LIST(_rijndael_vaes512)
+};
+
+RIJNDAEL_SIZED_IMPL(_rijndael_vaes256, "vaes-avx2", _rijndael_vaes256_impl,
+    128, 10);
+RIJNDAEL_SIZED_IMPL(_rijndael_vaes256, "vaes-avx2", _rijndael_vaes256_impl,
+    192, 12);
+RIJNDAEL_SIZED_IMPL(_rijndael_vaes256, "vaes-avx2", _rijndael_vaes256_impl,
+    256, 14);
+RIJNDAEL_SIZED_IMPL(_rijndael_vaes512, "vaes-avx512",
+    _rijndael_vaes512_impl, 128, 10);
+RIJNDAEL_SIZED_IMPL(_rijndael_vaes512, "vaes-avx512",
+    _rijndael_vaes512_impl, 192, 12);
+RIJNDAEL_SIZED_IMPL(_rijndael_vaes512, "vaes-avx512",
+    _rijndael_vaes512_impl, 256, 14);
+#endif
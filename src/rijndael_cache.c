@@ -0,0 +1,326 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ecrypt/drbg.h>
+#include <ecrypt/rijndael.h>
+#include "rijndael_impl.h"
+
+/*
+* Lookups hash the key to pick one of these, so threads working with
+* different keys rarely wait on the same lock.
+*/
+#define RIJNDAEL_CACHE_SHARDS	(16)
+
+struct _rijndael_cache_entry_t {
+    uint64_t digest;
+    int bits;
+    int has_dk;			/* ctx.dk has been derived from ctx.ek */
+    rijndael_ctx ctx;
+    struct _rijndael_cache_entry_t *chain;	/* next in the bucket */
+    struct _rijndael_cache_entry_t *newer;	/* LRU list */
+    struct _rijndael_cache_entry_t *older;
+};
+
+struct _rijndael_cache_shard_t {
+    pthread_mutex_t lock;
+    struct _rijndael_cache_entry_t **buckets;
+    size_t mask;			/* bucket count - 1 */
+    struct _rijndael_cache_entry_t *newest;
+    struct _rijndael_cache_entry_t *oldest;
+    struct _rijndael_cache_entry_t *unused;	/* never filled yet */
+};
+
+struct rijndael_cache_t {
+    uint64_t k0, k1;		/* SipHash key, random per cache */
+    struct _rijndael_cache_entry_t *entries;
+    size_t capacity;
+    struct _rijndael_cache_shard_t shards[RIJNDAEL_CACHE_SHARDS];
+};
+
+#define ROTL64(x, b)	(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND do { \
+    v0 += v1; v1 = ROTL64(v1, 13); v1 ^= v0; v0 = ROTL64(v0, 32); \
+    v2 += v3; v3 = ROTL64(v3, 16); v3 ^= v2; \
+    v0 += v3; v3 = ROTL64(v3, 21); v3 ^= v0; \
+    v2 += v1; v1 = ROTL64(v1, 17); v1 ^= v2; v2 = ROTL64(v2, 32); \
+} while (0)
+
+static uint64_t
+_rijndael_load_le64(const uint8_t *p)
+{
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) |
+        ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+        ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) |
+        ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+/*
+* SipHash-2-4.  Keyed with a secret, so the bucket a key lands in tells an
+* observer nothing about the key, and nobody can pick keys that collide.
+* len is a multiple of 8 here (16, 24 or 32).
+*/
+static uint64_t
+_rijndael_cache_digest(const struct rijndael_cache_t *cache,
+    const uint8_t *in, size_t len)
+{
+    uint64_t v0 = cache->k0 ^ 0x736f6d6570736575ULL;
+    uint64_t v1 = cache->k1 ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = cache->k0 ^ 0x6c7967656e657261ULL;
+    uint64_t v3 = cache->k1 ^ 0x7465646279746573ULL;
+    uint64_t m;
+    size_t i;
+
+    for (i = 0; i < len; i += 8) {
+        m = _rijndael_load_le64(in + i);
+        v3 ^= m;
+        SIPROUND;
+        SIPROUND;
+        v0 ^= m;
+    }
+
+    m = (uint64_t)len << 56;
+    v3 ^= m;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= m;
+
+    v2 ^= 0xff;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+/* the first words of an encrypt schedule are the cipher key itself */
+static int
+_rijndael_cache_match(const uint32_t *ek, const uint8_t *key, uint32_t klen)
+{
+    uint32_t i, diff = 0;
+
+    for (i = 0; i < klen; i++) {
+        diff |= ((ek[i / 4] >> (24 - 8 * (i % 4))) & 0xff) ^ key[i];
+    }
+
+    return diff == 0;
+}
+
+static void
+_rijndael_cache_seed(struct rijndael_cache_t *cache)
+{
+    uint8_t seed[16];
+
+    if (drbg_random(seed, sizeof(seed)) == ECRYPT_NO_ERROR) {
+        cache->k0 = _rijndael_load_le64(seed);
+        cache->k1 = _rijndael_load_le64(seed + 8);
+    } else {
+        /* weak, but this only spreads keys over buckets */
+        cache->k0 = (uint64_t)time(NULL) ^ (uint64_t)(size_t)cache;
+        cache->k1 = (uint64_t)clock() ^ ((uint64_t)(size_t)&seed << 17);
+    }
+
+    memset(seed, 0, sizeof(seed));
+}
+
+struct rijndael_cache_t *
+rijndael_cache_create(size_t capacity)
+{
+    struct rijndael_cache_t *cache;
+    struct _rijndael_cache_shard_t *shard;
+    size_t per, buckets, i, s;
+
+    if (capacity == 0) {
+        return NULL;
+    }
+
+    per = (capacity + RIJNDAEL_CACHE_SHARDS - 1) / RIJNDAEL_CACHE_SHARDS;
+    for (buckets = 1; buckets < 2 * per; buckets <<= 1) {
+    }
+
+    cache = (struct rijndael_cache_t *)calloc(1, sizeof(*cache));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    cache->capacity = per * RIJNDAEL_CACHE_SHARDS;
+    cache->entries = (struct _rijndael_cache_entry_t *)calloc(
+        cache->capacity, sizeof(cache->entries[0]));
+    if (cache->entries == NULL) {
+        free(cache);
+        return NULL;
+    }
+
+    for (s = 0; s < RIJNDAEL_CACHE_SHARDS; s++) {
+        shard = &cache->shards[s];
+        shard->buckets = (struct _rijndael_cache_entry_t **)calloc(buckets,
+            sizeof(shard->buckets[0]));
+        if (shard->buckets == NULL) {
+            while (s-- > 0) {
+                pthread_mutex_destroy(&cache->shards[s].lock);
+                free(cache->shards[s].buckets);
+            }
+            free(cache->entries);
+            free(cache);
+            return NULL;
+        }
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->mask = buckets - 1;
+
+        for (i = 0; i < per; i++) {
+            cache->entries[s * per + i].chain = shard->unused;
+            shard->unused = &cache->entries[s * per + i];
+        }
+    }
+
+    _rijndael_cache_seed(cache);
+    return cache;
+}
+
+void
+rijndael_cache_destroy(struct rijndael_cache_t *cache)
+{
+    size_t s;
+
+    if (cache == NULL) {
+        return;
+    }
+
+    for (s = 0; s < RIJNDAEL_CACHE_SHARDS; s++) {
+        pthread_mutex_destroy(&cache->shards[s].lock);
+        free(cache->shards[s].buckets);
+    }
+
+    /* every schedule in here is as good as the key it came from */
+    memset(cache->entries, 0, cache->capacity * sizeof(cache->entries[0]));
+    free(cache->entries);
+    memset(cache, 0, sizeof(*cache));
+    free(cache);
+}
+
+static void
+_rijndael_cache_unlink(struct _rijndael_cache_shard_t *shard,
+    struct _rijndael_cache_entry_t *e)
+{
+    if (e->newer != NULL) {
+        e->newer->older = e->older;
+    } else {
+        shard->newest = e->older;
+    }
+
+    if (e->older != NULL) {
+        e->older->newer = e->newer;
+    } else {
+        shard->oldest = e->newer;
+    }
+}
+
+static void
+_rijndael_cache_push(struct _rijndael_cache_shard_t *shard,
+    struct _rijndael_cache_entry_t *e)
+{
+    e->newer = NULL;
+    e->older = shard->newest;
+    if (shard->newest != NULL) {
+        shard->newest->newer = e;
+    } else {
+        shard->oldest = e;
+    }
+    shard->newest = e;
+}
+
+/* a free entry, evicting the least recently used one if there is none */
+static struct _rijndael_cache_entry_t *
+_rijndael_cache_take(struct _rijndael_cache_shard_t *shard)
+{
+    struct _rijndael_cache_entry_t *e, **p;
+
+    e = shard->unused;
+    if (e != NULL) {
+        shard->unused = e->chain;
+        return e;
+    }
+
+    e = shard->oldest;
+    _rijndael_cache_unlink(shard, e);
+    for (p = &shard->buckets[(e->digest >> 4) & shard->mask]; *p != e;
+        p = &(*p)->chain) {
+    }
+    *p = e->chain;
+
+    return e;
+}
+
+int
+rijndael_cache_get(struct rijndael_cache_t *cache, const uint8_t *key,
+    uint32_t klen, int decrypt, rijndael_ctx *ctx)
+{
+    struct _rijndael_cache_shard_t *shard;
+    struct _rijndael_cache_entry_t *e, **bucket;
+    size_t words;
+    uint64_t digest;
+    int bits = (int)klen * 8;
+
+    if (cache == NULL || key == NULL || ctx == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (klen != 16 && klen != 24 && klen != 32) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    digest = _rijndael_cache_digest(cache, key, klen);
+    shard = &cache->shards[digest % RIJNDAEL_CACHE_SHARDS];
+    bucket = &shard->buckets[(digest >> 4) & shard->mask];
+
+    pthread_mutex_lock(&shard->lock);
+
+    for (e = *bucket; e != NULL; e = e->chain) {
+        if (e->digest == digest && e->bits == bits &&
+            _rijndael_cache_match(e->ctx.ek, key, klen)) {
+            break;
+        }
+    }
+
+    if (e != NULL) {
+        _rijndael_cache_unlink(shard, e);
+    } else {
+        /* only the encrypt schedule until somebody wants to decrypt */
+        e = _rijndael_cache_take(shard);
+        if (rijndael_set_key_enc_only(&e->ctx, key, bits) != 0) {
+            memset(e, 0, sizeof(*e));
+            e->chain = shard->unused;
+            shard->unused = e;
+            pthread_mutex_unlock(&shard->lock);
+            return ECRYPT_INVALID_PARAMETERS;
+        }
+        e->digest = digest;
+        e->bits = bits;
+        e->has_dk = 0;
+        e->chain = *bucket;
+        *bucket = e;
+    }
+    _rijndael_cache_push(shard, e);
+
+    if (decrypt && !e->has_dk) {
+        e->ctx.impl->invert(e->ctx.dk, e->ctx.ek, e->ctx.Nr);
+        e->has_dk = 1;
+    }
+
+    /* copy out only the round keys actually in use */
+    words = 4 * (size_t)(e->ctx.Nr + 1);
+    memcpy(ctx->ek, e->ctx.ek, words * sizeof(ctx->ek[0]));
+    if (decrypt) {
+        memcpy(ctx->dk, e->ctx.dk, words * sizeof(ctx->dk[0]));
+    }
+    ctx->Nr = e->ctx.Nr;
+    ctx->enc_only = !decrypt;
+    ctx->impl = e->ctx.impl;
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return ECRYPT_NO_ERROR;
+}
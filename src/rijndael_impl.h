@@ -0,0 +1,239 @@
+#ifndef ECRYPT_RIJNDAEL_IMPL_H
+#define ECRYPT_RIJNDAEL_IMPL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ecrypt/rijndael.h>
+
+/* how many independent blocks the bulk routines keep in flight at once */
+#define RIJNDAEL_LANES		(8)
+
+/*
+* Private to the library.  Every rijndael_ctx points at one of these tables;
+* rijndael_set_key picks the fastest one the processor can run.  All of them
+* read and write the key schedules in the same layout (big-endian words,
+* exactly as _rijndael_key_setup_enc/_rijndael_key_setup_dec produce them),
+* so a context can be handed from one implementation to another.
+*/
+struct rijndael_impl_t {
+    const char *name;
+    int (*setup_enc)(uint32_t *rk, const uint8_t *key, int keybits);
+    int (*setup_dec)(uint32_t *rk, const uint8_t *key, int keybits);
+
+    /*
+    * setup_enc for n keys of the same size, rk[i] from keys[i].  Returns
+    * the number of rounds, or 0 if keybits is not a valid size.  Where it
+    * pays, the keys are expanded side by side so that one key's dependency
+    * chain overlaps with the others'.
+    */
+    int (*setup_enc_multi)(uint32_t *const *rk, const uint8_t *const *keys,
+        int keybits, size_t n);
+
+    /*
+    * The decrypt schedule from an encrypt schedule, without going back to
+    * the cipher key.  dk == ek is allowed.
+    */
+    void (*invert)(uint32_t *dk, const uint32_t *ek, int Nr);
+    void (*encrypt)(const uint32_t *rk, int Nr, const uint8_t *in,
+        uint8_t *out);
+    void (*decrypt)(const uint32_t *rk, int Nr, const uint8_t *in,
+        uint8_t *out);
+
+    /*
+    * CTR keystream for whole blocks: out = in ^ E(ctr), ctr += 1 (as one
+    * 128-bit big-endian integer) per block.  ctr is left pointing at the
+    * first unused counter block.
+    */
+    void (*ctr)(const uint32_t *rk, int Nr, uint8_t *ctr, const uint8_t *in,
+        uint8_t *out, size_t blocks);
+
+    /*
+    * CBC decryption of whole blocks with the decrypt schedule.  iv is
+    * replaced by the last ciphertext block.  in == out is allowed.
+    */
+    void (*cbc_dec)(const uint32_t *rk, int Nr, uint8_t *iv,
+        const uint8_t *in, uint8_t *out, size_t blocks);
+
+    /*
+    * One block each for n different keys of the same size: out[i] =
+    * E(rk[i], in[i]).  All inputs of a batch are read before any output
+    * is written, so in[i] == out[i] is allowed.
+    */
+    void (*encrypt_multi)(const uint32_t *const *rk, int Nr,
+        const uint8_t *const *in, uint8_t *const *out, size_t n);
+    void (*decrypt_multi)(const uint32_t *const *rk, int Nr,
+        const uint8_t *const *in, uint8_t *const *out, size_t n);
+
+    /*
+    * XTS over whole blocks: out = E(in ^ T) ^ T, with T starting at tweak
+    * and multiplied by x in GF(2^128) after each block (IEEE 1619).  tweak
+    * is left at the value for the block after the last; in == out is
+    * allowed.  xts_dec runs with the decrypt schedule.
+    */
+    void (*xts_enc)(const uint32_t *rk, int Nr, uint8_t *tweak,
+        const uint8_t *in, uint8_t *out, size_t blocks);
+    void (*xts_dec)(const uint32_t *rk, int Nr, uint8_t *tweak,
+        const uint8_t *in, uint8_t *out, size_t blocks);
+
+    /* the generic table; a table is its own base unless it is sized */
+    const struct rijndael_impl_t *base;
+
+    /*
+    * Copies of the generic table whose block functions have the number of
+    * rounds compiled in, indexed by (Nr - 10) / 2.  rijndael_set_key keys
+    * a context with the one that matches the key; NULL means the generic
+    * functions are used for that key size.
+    */
+    const struct rijndael_impl_t *sized[3];
+};
+
+/*
+* For block functions that are meant to be specialised with
+* RIJNDAEL_SIZED_IMPL: inlined into every copy, so Nr becomes a constant
+* and the rounds are laid out without a loop.
+*/
+#if defined(__GNUC__)
+#define RIJNDAEL_INLINE		static inline __attribute__((always_inline))
+#else
+#define RIJNDAEL_INLINE		static inline
+#endif
+
+/*
+* Rounds 1 to Nr - 1, written out: step(to, from, r) applies round r and
+* the state goes back and forth between x and y, ending up in y.  Code that
+* works on its state in place passes the same variable twice.
+*/
+#define RIJNDAEL_ROUNDS(step, x, y, Nr) do { \
+    step(y, x, 1); step(x, y, 2); step(y, x, 3); step(x, y, 4); \
+    step(y, x, 5); step(x, y, 6); step(y, x, 7); step(x, y, 8); \
+    step(y, x, 9); \
+    if ((Nr) > 10) { \
+        step(x, y, 10); step(y, x, 11); \
+    } \
+    if ((Nr) > 12) { \
+        step(x, y, 12); step(y, x, 13); \
+    } \
+} while (0)
+
+/*
+* Defines pfx##_impl_##bits, a copy of the generic table base in which the
+* eight block functions of prefix pfx (pfx##_encrypt, pfx##_ctr and so on)
+* are called with Nr fixed to rounds.  The key setup functions are shared.
+* The generic table refers to the copies, so they are declared with
+* RIJNDAEL_SIZED_DECL ahead of it.
+*/
+#define RIJNDAEL_SIZED_IMPL(pfx, name, base, bits, rounds) \
+static void \
+pfx##_encrypt_##bits(const uint32_t *rk, int Nr, const uint8_t *in, \
+    uint8_t *out) \
+{ \
+    (void)Nr; \
+    pfx##_encrypt(rk, rounds, in, out); \
+} \
+static void \
+pfx##_decrypt_##bits(const uint32_t *rk, int Nr, const uint8_t *in, \
+    uint8_t *out) \
+{ \
+    (void)Nr; \
+    pfx##_decrypt(rk, rounds, in, out); \
+} \
+static void \
+pfx##_ctr_##bits(const uint32_t *rk, int Nr, uint8_t *ctr, \
+    const uint8_t *in, uint8_t *out, size_t blocks) \
+{ \
+    (void)Nr; \
+    pfx##_ctr(rk, rounds, ctr, in, out, blocks); \
+} \
+static void \
+pfx##_cbc_dec_##bits(const uint32_t *rk, int Nr, uint8_t *iv, \
+    const uint8_t *in, uint8_t *out, size_t blocks) \
+{ \
+    (void)Nr; \
+    pfx##_cbc_dec(rk, rounds, iv, in, out, blocks); \
+} \
+static void \
+pfx##_encrypt_multi_##bits(const uint32_t *const *rk, int Nr, \
+    const uint8_t *const *in, uint8_t *const *out, size_t n) \
+{ \
+    (void)Nr; \
+    pfx##_encrypt_multi(rk, rounds, in, out, n); \
+} \
+static void \
+pfx##_decrypt_multi_##bits(const uint32_t *const *rk, int Nr, \
+    const uint8_t *const *in, uint8_t *const *out, size_t n) \
+{ \
+    (void)Nr; \
+    pfx##_decrypt_multi(rk, rounds, in, out, n); \
+} \
+static void \
+pfx##_xts_enc_##bits(const uint32_t *rk, int Nr, uint8_t *tweak, \
+    const uint8_t *in, uint8_t *out, size_t blocks) \
+{ \
+    (void)Nr; \
+    pfx##_xts_enc(rk, rounds, tweak, in, out, blocks); \
+} \
+static void \
+pfx##_xts_dec_##bits(const uint32_t *rk, int Nr, uint8_t *tweak, \
+    const uint8_t *in, uint8_t *out, size_t blocks) \
+{ \
+    (void)Nr; \
+    pfx##_xts_dec(rk, rounds, tweak, in, out, blocks); \
+} \
+static const struct rijndael_impl_t pfx##_impl_##bits = { \
+    name, \
+    pfx##_key_setup_enc, \
+    pfx##_key_setup_dec, \
+    pfx##_key_setup_enc_multi, \
+    pfx##_invert_key, \
+    pfx##_encrypt_##bits, \
+    pfx##_decrypt_##bits, \
+    pfx##_ctr_##bits, \
+    pfx##_cbc_dec_##bits, \
+    pfx##_encrypt_multi_##bits, \
+    pfx##_decrypt_multi_##bits, \
+    pfx##_xts_enc_##bits, \
+    pfx##_xts_dec_##bits, \
+    &(base), \
+    { NULL, NULL, NULL } \
+}
+
+#define RIJNDAEL_SIZED_DECL(pfx) \
+static const struct rijndael_impl_t pfx##_impl_128; \
+static const struct rijndael_impl_t pfx##_impl_192; \
+static const struct rijndael_impl_t pfx##_impl_256
+
+#define RIJNDAEL_SIZED_LIST(pfx) \
+    { &pfx##_impl_128, &pfx##_impl_192, &pfx##_impl_256 }
+
+/* portable T-table code from rijndael.c */
+extern const struct rijndael_impl_t _rijndael_table_impl;
+
+#if defined(ECRYPT_HAVE_AESNI)
+/* AESENC/AESDEC, rijndael_aesni.c */
+extern const struct rijndael_impl_t _rijndael_aesni_impl;
+#endif
+
+#if defined(ECRYPT_HAVE_VPERM)
+/* constant-time SSSE3 byte shuffles, rijndael_vperm.c */
+extern const struct rijndael_impl_t _rijndael_vperm_impl;
+#endif
+
+#if defined(ECRYPT_HAVE_VAES)
+/*
+* AES-NI with CTR and CBC decryption run two (vaes256) or four (vaes512)
+* blocks to a register, rijndael_aesni.c and rijndael_vaes*.c.
+*/
+extern const struct rijndael_impl_t _rijndael_vaes256_impl;
+extern const struct rijndael_impl_t _rijndael_vaes512_impl;
+
+void _rijndael_vaes256_ctr(const uint32_t *rk, int Nr, uint8_t *ctr,
+    const uint8_t *in, uint8_t *out, size_t blocks);
+void _rijndael_vaes256_cbc_dec(const uint32_t *rk, int Nr, uint8_t *iv,
+    const uint8_t *in, uint8_t *out, size_t blocks);
+void _rijndael_vaes512_ctr(const uint32_t *rk, int Nr, uint8_t *ctr,
+    const uint8_t *in, uint8_t *out, size_t blocks);
+void _rijndael_vaes512_cbc_dec(const uint32_t *rk, int Nr, uint8_t *iv,
+    const uint8_t *in, uint8_t *out, size_t blocks);
+#endif
+
+#endif /* ECRYPT_RIJNDAEL_IMPL_H */
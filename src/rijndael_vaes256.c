@@ -0,0 +1,50 @@
+/*
+* The VAES kernels on 256-bit registers: AVX2 with VAES and VPCLMULQDQ, two
+* blocks per register.  See rijndael_vaes_tmpl.c.
+*/
+#include <immintrin.h>
+
+#include "gcm_x86.h"
+
+#define VAES_VEC		__m256i
+#define VAES_LANES		2
+#define VAES_FN(name)		_rijndael_vaes256##name
+#define VAES_GCM_IMPL		_gcm_vaes256_impl
+#define VAES_NAME		"vaes-avx2"
+
+#define VAES_LOAD(p)		_mm256_loadu_si256((const __m256i *)(p))
+#define VAES_STORE(p, x)	_mm256_storeu_si256((__m256i *)(p), (x))
+#define VAES_XOR		_mm256_xor_si256
+#define VAES_ZERO		_mm256_setzero_si256
+#define VAES_ADD64		_mm256_add_epi64
+#define VAES_SHUFFLE		_mm256_shuffle_epi8
+#define VAES_BCAST		_mm256_broadcastsi128_si256
+#define VAES_ZEXT(x)		_mm256_set_m128i(_mm_setzero_si128(), (x))
+#define VAES_LANE0		_mm256_castsi256_si128
+#define VAES_LAST(v)		_mm256_extracti128_si256((v), 1)
+#define VAES_PREV(c, p)		_mm256_permute2x128_si256((p), (c), 0x21)
+
+#define VAES_AESENC		_mm256_aesenc_epi128
+#define VAES_AESENCLAST		_mm256_aesenclast_epi128
+#define VAES_AESDEC		_mm256_aesdec_epi128
+#define VAES_AESDECLAST		_mm256_aesdeclast_epi128
+#define VAES_CLMUL		_mm256_clmulepi64_epi128
+
+#define VAES_COUNT		_mm256_set_epi64x(0, 1, 0, 0)
+#define VAES_STEP		_mm256_set_epi64x(0, 2, 0, 2)
+
+static inline __m128i
+_vaes_fold(__m256i v)
+{
+    return _mm_xor_si128(_mm256_castsi256_si128(v),
+        _mm256_extracti128_si256(v, 1));
+}
+
+static inline __m256i
+_vaes_powers(const uint64_t (*Htable)[2], int i)
+{
+    return _mm256_set_m128i(_mm_loadu_si128((const __m128i *)Htable[i - 1]),
+        _mm_loadu_si128((const __m128i *)Htable[i]));
+}
+
+#include "rijndael_vaes_tmpl.c"
@@ -0,0 +1,63 @@
+/*
+* The VAES kernels on 512-bit registers: AVX-512 with VAES and VPCLMULQDQ,
+* four blocks per register.  See rijndael_vaes_tmpl.c.
+*/
+#include <immintrin.h>
+
+#include "gcm_x86.h"
+
+#define VAES_VEC		__m512i
+#define VAES_LANES		4
+#define VAES_FN(name)		_rijndael_vaes512##name
+#define VAES_GCM_IMPL		_gcm_vaes512_impl
+#define VAES_NAME		"vaes-avx512"
+
+#define VAES_LOAD(p)		_mm512_loadu_si512((const void *)(p))
+#define VAES_STORE(p, x)	_mm512_storeu_si512((void *)(p), (x))
+#define VAES_XOR		_mm512_xor_si512
+#define VAES_ZERO		_mm512_setzero_si512
+#define VAES_ADD64		_mm512_add_epi64
+#define VAES_SHUFFLE		_mm512_shuffle_epi8
+#define VAES_BCAST		_mm512_broadcast_i32x4
+#define VAES_ZEXT(x)		_mm512_inserti32x4(_mm512_setzero_si512(), (x), 0)
+#define VAES_LANE0		_mm512_castsi512_si128
+#define VAES_LAST(v)		_mm512_extracti32x4_epi32((v), 3)
+#define VAES_PREV(c, p)		_mm512_alignr_epi64((c), (p), 6)
+
+#define VAES_AESENC		_mm512_aesenc_epi128
+#define VAES_AESENCLAST		_mm512_aesenclast_epi128
+#define VAES_AESDEC		_mm512_aesdec_epi128
+#define VAES_AESDECLAST		_mm512_aesdeclast_epi128
+#define VAES_CLMUL		_mm512_clmulepi64_epi128
+
+#define VAES_COUNT		_mm512_set_epi64(0, 3, 0, 2, 0, 1, 0, 0)
+#define VAES_STEP		_mm512_set_epi64(0, 4, 0, 4, 0, 4, 0, 4)
+
+static inline __m128i
+_vaes_fold(__m512i v)
+{
+    __m256i h;
+
+    h = _mm256_xor_si256(_mm512_castsi512_si256(v),
+        _mm512_extracti64x4_epi64(v, 1));
+
+    return _mm_xor_si128(_mm256_castsi256_si128(h),
+        _mm256_extracti128_si256(h, 1));
+}
+
+static inline __m512i
+_vaes_powers(const uint64_t (*Htable)[2], int i)
+{
+    __m512i v;
+    int j;
+
+    v = _mm512_setzero_si512();
+    for (j = 0; j < 4; j++) {
+        v = _mm512_mask_broadcast_i32x4(v, (__mmask16)(0xf << (4 * j)),
+            _mm_loadu_si128((const __m128i *)Htable[i - j]));
+    }
+
+    return v;
+}
+
+#include "rijndael_vaes_tmpl.c"
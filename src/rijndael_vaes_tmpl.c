@@ -0,0 +1,544 @@
+/*
+* CTR, CBC decryption and GCM on VAES and VPCLMULQDQ, written once for any
+* vector width.  Included by rijndael_vaes256.c and rijndael_vaes512.c,
+* which define the VAES_* macros below for 256 and 512-bit registers and
+* are each compiled with just the instruction sets their width needs.
+*
+*     VAES_VEC			the vector type
+*     VAES_LANES		AES blocks per vector
+*     VAES_FN(name)		prefixes name with _rijndael_vaes256 and so on
+*     VAES_GCM_IMPL, VAES_NAME	the GCM table this file defines, and its name
+*     VAES_LOAD/STORE/XOR/ZERO/ADD64/SHUFFLE	the obvious
+*     VAES_BCAST(x)		x in every lane
+*     VAES_ZEXT(x)		x in lane 0, zero elsewhere
+*     VAES_LANE0(v), VAES_LAST(v)	the first and last lane
+*     VAES_PREV(c, p)		the last lane of p, then all but the last of c
+*     VAES_AESENC/AESENCLAST/AESDEC/AESDECLAST/CLMUL	per-lane AES and
+*				carry-less multiply
+*     VAES_COUNT, VAES_STEP	lane j holds j, and VAES_LANES, in the low
+*				64 bits
+*     _vaes_fold(v)		the XOR of all lanes
+*     _vaes_powers(Htable, i)	lane j holds Htable[i - j]
+*
+* Four vectors are kept in flight, as many blocks as the AES-NI code keeps
+* in eight registers times VAES_LANES / 2.  Leftover blocks go a vector
+* and then a block at a time.
+*/
+#include <string.h>
+
+#include "gcm_x86.h"
+
+/* blocks per pass of the main loops */
+#define VAES_WIDE		(4 * VAES_LANES)
+
+/* one round on all four vectors, for RIJNDAEL_ROUNDS */
+#define VAES_ROUND4(op, x, k) do { \
+    (x)[0] = op((x)[0], (k)); (x)[1] = op((x)[1], (k)); \
+    (x)[2] = op((x)[2], (k)); (x)[3] = op((x)[3], (k)); \
+} while (0)
+
+#define VAES_ENC4(t, x, r)	VAES_ROUND4(VAES_AESENC, x, k[r])
+#define VAES_DEC4(t, x, r)	VAES_ROUND4(VAES_AESDEC, x, k[r])
+
+/* the schedule twice: in every lane, and as plain 128-bit round keys */
+static void
+_vaes_load_schedule(VAES_VEC *k, __m128i *k1, const uint32_t *rk, int Nr)
+{
+    int r;
+
+    _rijndael_load_schedule(k1, rk, Nr);
+    for (r = 0; r <= Nr; r++) {
+        k[r] = VAES_BCAST(k1[r]);
+    }
+}
+
+/* E(x) on a single block, for the ends of messages */
+static inline __m128i
+_vaes_encrypt1(const __m128i *k1, int Nr, __m128i x)
+{
+    int r;
+
+    x = _mm_xor_si128(x, k1[0]);
+    for (r = 1; r < Nr; r++) {
+        x = _mm_aesenc_si128(x, k1[r]);
+    }
+
+    return _mm_aesenclast_si128(x, k1[Nr]);
+}
+
+/*
+* The counters are kept as little-endian 128-bit numbers, one per lane,
+* and byte swapped into counter blocks.  Adding to the low 64 bits alone
+* is enough as long as they do not wrap, which the callers make sure of.
+*/
+static inline VAES_VEC
+_vaes_counter(const uint8_t *ctr)
+{
+    __m128i c;
+
+    c = _mm_set_epi64x((long long)_rijndael_load_be64(ctr),
+        (long long)_rijndael_load_be64(ctr + 8));
+
+    return VAES_ADD64(VAES_BCAST(c), VAES_COUNT);
+}
+
+/* lane 0 of c, the next unused counter, back into ctr */
+static inline void
+_vaes_store_counter(uint8_t *ctr, VAES_VEC c)
+{
+    _mm_storeu_si128((__m128i *)ctr,
+        _mm_shuffle_epi8(VAES_LANE0(c), GCM_BSWAP128));
+}
+
+/* CTR for blocks that do not carry out of the low 64 bits of ctr */
+static void
+_vaes_ctr(const VAES_VEC *k, const __m128i *k1, int Nr, uint8_t *ctr,
+    const uint8_t *in, uint8_t *out, size_t blocks)
+{
+    const VAES_VEC bswap = VAES_BCAST(GCM_BSWAP128);
+    VAES_VEC x[4], c;
+    int v;
+
+    c = _vaes_counter(ctr);
+
+    for (; blocks >= VAES_WIDE; blocks -= VAES_WIDE) {
+        for (v = 0; v < 4; v++) {
+            x[v] = VAES_XOR(VAES_SHUFFLE(c, bswap), k[0]);
+            c = VAES_ADD64(c, VAES_STEP);
+        }
+
+        RIJNDAEL_ROUNDS(VAES_ENC4, x, x, Nr);
+        VAES_ROUND4(VAES_AESENCLAST, x, k[Nr]);
+
+        for (v = 0; v < 4; v++) {
+            VAES_STORE(out + 16 * VAES_LANES * v, VAES_XOR(x[v],
+                VAES_LOAD(in + 16 * VAES_LANES * v)));
+        }
+
+        in += 16 * VAES_WIDE;
+        out += 16 * VAES_WIDE;
+    }
+
+    for (; blocks >= VAES_LANES; blocks -= VAES_LANES) {
+        x[0] = VAES_XOR(VAES_SHUFFLE(c, bswap), k[0]);
+        c = VAES_ADD64(c, VAES_STEP);
+        for (v = 1; v < Nr; v++) {
+            x[0] = VAES_AESENC(x[0], k[v]);
+        }
+        x[0] = VAES_AESENCLAST(x[0], k[Nr]);
+
+        VAES_STORE(out, VAES_XOR(x[0], VAES_LOAD(in)));
+        in += 16 * VAES_LANES;
+        out += 16 * VAES_LANES;
+    }
+
+    for (; blocks > 0; blocks--) {
+        _mm_storeu_si128((__m128i *)out, _mm_xor_si128(_vaes_encrypt1(k1,
+            Nr, _mm_shuffle_epi8(VAES_LANE0(c), GCM_BSWAP128)),
+            _mm_loadu_si128((const __m128i *)in)));
+        c = VAES_ADD64(c, VAES_BCAST(_mm_set_epi64x(0, 1)));
+        in += 16;
+        out += 16;
+    }
+
+    _vaes_store_counter(ctr, c);
+}
+
+void
+VAES_FN(_ctr)(const uint32_t *rk, int Nr, uint8_t *ctr, const uint8_t *in,
+    uint8_t *out, size_t blocks)
+{
+    VAES_VEC k[AES_MAXROUNDS + 1];
+    __m128i k1[AES_MAXROUNDS + 1];
+    uint64_t lo, run;
+    int i;
+
+    _vaes_load_schedule(k, k1, rk, Nr);
+
+    /* split where the low half of the counter wraps, once in 2^64 blocks */
+    while (blocks > 0) {
+        lo = _rijndael_load_be64(ctr + 8);
+        run = lo != 0 && (uint64_t)blocks > 0 - lo ? 0 - lo : blocks;
+        _vaes_ctr(k, k1, Nr, ctr, in, out, (size_t)run);
+
+        if (lo + run == 0) {
+            for (i = 7; i >= 0 && ++ctr[i] == 0; i--) {
+            }
+        }
+        in += 16 * run;
+        out += 16 * run;
+        blocks -= (size_t)run;
+    }
+
+    memset(k, 0, sizeof(k));
+    memset(k1, 0, sizeof(k1));
+}
+
+/*
+* As in the AES-NI code, a whole pass is loaded before anything is
+* stored, so in == out works.  Each vector is XORed with the blocks one
+* position back, shifted in from the vector before it.
+*/
+void
+VAES_FN(_cbc_dec)(const uint32_t *rk, int Nr, uint8_t *iv,
+    const uint8_t *in, uint8_t *out, size_t blocks)
+{
+    VAES_VEC k[AES_MAXROUNDS + 1];
+    __m128i k1[AES_MAXROUNDS + 1];
+    VAES_VEC c[4], x[4], p;
+    __m128i prev, c1, x1;
+    int v, r;
+
+    _vaes_load_schedule(k, k1, rk, Nr);
+    p = VAES_BCAST(_mm_loadu_si128((const __m128i *)iv));
+
+    for (; blocks >= VAES_WIDE; blocks -= VAES_WIDE) {
+        for (v = 0; v < 4; v++) {
+            c[v] = VAES_LOAD(in + 16 * VAES_LANES * v);
+            x[v] = VAES_XOR(c[v], k[0]);
+        }
+
+        RIJNDAEL_ROUNDS(VAES_DEC4, x, x, Nr);
+        VAES_ROUND4(VAES_AESDECLAST, x, k[Nr]);
+
+        VAES_STORE(out, VAES_XOR(x[0], VAES_PREV(c[0], p)));
+        for (v = 1; v < 4; v++) {
+            VAES_STORE(out + 16 * VAES_LANES * v,
+                VAES_XOR(x[v], VAES_PREV(c[v], c[v - 1])));
+        }
+        p = c[3];
+
+        in += 16 * VAES_WIDE;
+        out += 16 * VAES_WIDE;
+    }
+
+    for (; blocks >= VAES_LANES; blocks -= VAES_LANES) {
+        c[0] = VAES_LOAD(in);
+        x[0] = VAES_XOR(c[0], k[0]);
+        for (r = 1; r < Nr; r++) {
+            x[0] = VAES_AESDEC(x[0], k[r]);
+        }
+        x[0] = VAES_AESDECLAST(x[0], k[Nr]);
+
+        VAES_STORE(out, VAES_XOR(x[0], VAES_PREV(c[0], p)));
+        p = c[0];
+
+        in += 16 * VAES_LANES;
+        out += 16 * VAES_LANES;
+    }
+
+    prev = VAES_LAST(p);
+    for (; blocks > 0; blocks--) {
+        c1 = _mm_loadu_si128((const __m128i *)in);
+        x1 = _mm_xor_si128(c1, k1[0]);
+        for (r = 1; r < Nr; r++) {
+            x1 = _mm_aesdec_si128(x1, k1[r]);
+        }
+        x1 = _mm_aesdeclast_si128(x1, k1[Nr]);
+
+        _mm_storeu_si128((__m128i *)out, _mm_xor_si128(x1, prev));
+        prev = c1;
+
+        in += 16;
+        out += 16;
+    }
+
+    _mm_storeu_si128((__m128i *)iv, prev);
+
+    memset(k, 0, sizeof(k));
+    memset(k1, 0, sizeof(k1));
+}
+
+/*
+* GCM.  Htable[i] = H^(i+1), byte reversed, for i < VAES_WIDE: a pass of
+* VAES_WIDE blocks is hashed with one reduction, block j multiplied by
+* H^(VAES_WIDE - j).  hv[v] holds the powers for vector v of a pass, and
+* hl those for a single vector.
+*/
+static void _gcm_vaes_init(uint64_t (*Htable)[2], const uint8_t *H);
+static void _gcm_vaes_ghash(const uint64_t (*Htable)[2], uint8_t *X,
+    const uint8_t *in, size_t blocks);
+static void _gcm_vaes_encrypt(const uint32_t *rk, int Nr,
+    const uint64_t (*Htable)[2], uint8_t *X, uint8_t *ctr,
+    const uint8_t *in, uint8_t *out, size_t blocks);
+static void _gcm_vaes_decrypt(const uint32_t *rk, int Nr,
+    const uint64_t (*Htable)[2], uint8_t *X, uint8_t *ctr,
+    const uint8_t *in, uint8_t *out, size_t blocks);
+
+const struct gcm_impl_t VAES_GCM_IMPL = {
+    VAES_NAME,
+    _gcm_vaes_init,
+    _gcm_vaes_ghash,
+    _gcm_vaes_encrypt,
+    _gcm_vaes_decrypt
+};
+
+static void
+_gcm_vaes_init(uint64_t (*Htable)[2], const uint8_t *H)
+{
+    __m128i h, p;
+    int i;
+
+    h = GCM_LOAD(H);
+    p = h;
+    _mm_storeu_si128((__m128i *)Htable[0], p);
+    for (i = 1; i < VAES_WIDE; i++) {
+        p = _gcm_mul(p, h);
+        _mm_storeu_si128((__m128i *)Htable[i], p);
+    }
+}
+
+static void
+_gcm_vaes_load_powers(VAES_VEC *hv, VAES_VEC *hl,
+    const uint64_t (*Htable)[2])
+{
+    int v;
+
+    for (v = 0; v < 4; v++) {
+        hv[v] = _vaes_powers(Htable, VAES_WIDE - 1 - VAES_LANES * v);
+    }
+    *hl = _vaes_powers(Htable, VAES_LANES - 1);
+}
+
+/* adds a * b, lane by lane and unreduced, to hi:mid:lo */
+static inline void
+_gcm_vaes_clmul_acc(VAES_VEC a, VAES_VEC b, VAES_VEC *lo, VAES_VEC *mid,
+    VAES_VEC *hi)
+{
+    *lo = VAES_XOR(*lo, VAES_CLMUL(a, b, 0x00));
+    *hi = VAES_XOR(*hi, VAES_CLMUL(a, b, 0x11));
+    *mid = VAES_XOR(*mid, VAES_XOR(VAES_CLMUL(a, b, 0x10),
+        VAES_CLMUL(a, b, 0x01)));
+}
+
+static inline __m128i
+_gcm_vaes_reduce(VAES_VEC lo, VAES_VEC mid, VAES_VEC hi)
+{
+    return _gcm_reduce(_vaes_fold(lo), _vaes_fold(mid), _vaes_fold(hi));
+}
+
+/* x folded into one vector of byte-swapped data d, hashed with powers h */
+static inline __m128i
+_gcm_vaes_ghash1(VAES_VEC h, __m128i x, VAES_VEC d)
+{
+    VAES_VEC lo, mid, hi;
+
+    lo = mid = hi = VAES_ZERO();
+    _gcm_vaes_clmul_acc(VAES_XOR(d, VAES_ZEXT(x)), h, &lo, &mid, &hi);
+
+    return _gcm_vaes_reduce(lo, mid, hi);
+}
+
+/* one pass of VAES_WIDE blocks */
+static inline __m128i
+_gcm_vaes_ghash4(const VAES_VEC *hv, __m128i x, const uint8_t *in)
+{
+    const VAES_VEC bswap = VAES_BCAST(GCM_BSWAP128);
+    VAES_VEC lo, mid, hi, d;
+    int v;
+
+    lo = mid = hi = VAES_ZERO();
+    for (v = 0; v < 4; v++) {
+        d = VAES_SHUFFLE(VAES_LOAD(in + 16 * VAES_LANES * v), bswap);
+        if (v == 0) {
+            d = VAES_XOR(d, VAES_ZEXT(x));
+        }
+        _gcm_vaes_clmul_acc(d, hv[v], &lo, &mid, &hi);
+    }
+
+    return _gcm_vaes_reduce(lo, mid, hi);
+}
+
+static void
+_gcm_vaes_ghash(const uint64_t (*Htable)[2], uint8_t *X, const uint8_t *in,
+    size_t blocks)
+{
+    const VAES_VEC bswap = VAES_BCAST(GCM_BSWAP128);
+    VAES_VEC hv[4], hl;
+    __m128i x, h;
+
+    _gcm_vaes_load_powers(hv, &hl, Htable);
+    h = _mm_loadu_si128((const __m128i *)Htable[0]);
+    x = GCM_LOAD(X);
+
+    for (; blocks >= VAES_WIDE; blocks -= VAES_WIDE) {
+        x = _gcm_vaes_ghash4(hv, x, in);
+        in += 16 * VAES_WIDE;
+    }
+
+    for (; blocks >= VAES_LANES; blocks -= VAES_LANES) {
+        x = _gcm_vaes_ghash1(hl, x, VAES_SHUFFLE(VAES_LOAD(in), bswap));
+        in += 16 * VAES_LANES;
+    }
+
+    for (; blocks > 0; blocks--) {
+        x = _gcm_mul(_mm_xor_si128(x, GCM_LOAD(in)), h);
+        in += 16;
+    }
+
+    GCM_STORE(X, x);
+}
+
+/*
+* A pass of counter blocks goes through the rounds while the pass in g is
+* hashed, one vector of multiplies after each of the first four rounds;
+* the same stitching as the AES-NI code.  With g == NULL only the AES half
+* runs.  in may equal g: all of g is read before out is written.
+*/
+static inline __m128i
+_gcm_vaes_stitch4(const VAES_VEC *k, int Nr, const VAES_VEC *hv, __m128i x,
+    const uint8_t *g, VAES_VEC *c, const uint8_t *in, uint8_t *out)
+{
+    const VAES_VEC bswap = VAES_BCAST(GCM_BSWAP128);
+    VAES_VEC b[4], d, lo, mid, hi;
+    int v, r;
+
+    for (v = 0; v < 4; v++) {
+        b[v] = VAES_XOR(VAES_SHUFFLE(*c, bswap), k[0]);
+        *c = VAES_ADD64(*c, VAES_STEP);
+    }
+
+    r = 1;
+    if (g != NULL) {
+        lo = mid = hi = VAES_ZERO();
+        for (v = 0; v < 4; v++) {
+            VAES_ROUND4(VAES_AESENC, b, k[v + 1]);
+            d = VAES_SHUFFLE(VAES_LOAD(g + 16 * VAES_LANES * v), bswap);
+            if (v == 0) {
+                d = VAES_XOR(d, VAES_ZEXT(x));
+            }
+            _gcm_vaes_clmul_acc(d, hv[v], &lo, &mid, &hi);
+        }
+        x = _gcm_vaes_reduce(lo, mid, hi);
+        r = 5;
+    }
+
+    for (; r < Nr; r++) {
+        VAES_ROUND4(VAES_AESENC, b, k[r]);
+    }
+    VAES_ROUND4(VAES_AESENCLAST, b, k[Nr]);
+
+    for (v = 0; v < 4; v++) {
+        VAES_STORE(out + 16 * VAES_LANES * v, VAES_XOR(b[v],
+            VAES_LOAD(in + 16 * VAES_LANES * v)));
+    }
+
+    return x;
+}
+
+/* one vector of CTR; returns the output, byte swapped for hashing */
+static inline VAES_VEC
+_gcm_vaes_ctr1(const VAES_VEC *k, int Nr, VAES_VEC *c, const uint8_t *in,
+    uint8_t *out)
+{
+    const VAES_VEC bswap = VAES_BCAST(GCM_BSWAP128);
+    VAES_VEC b;
+    int r;
+
+    b = VAES_XOR(VAES_SHUFFLE(*c, bswap), k[0]);
+    *c = VAES_ADD64(*c, VAES_STEP);
+    for (r = 1; r < Nr; r++) {
+        b = VAES_AESENC(b, k[r]);
+    }
+    b = VAES_XOR(VAES_AESENCLAST(b, k[Nr]), VAES_LOAD(in));
+    VAES_STORE(out, b);
+
+    return VAES_SHUFFLE(b, bswap);
+}
+
+/* one block of CTR, likewise */
+static inline __m128i
+_gcm_vaes_ctr_block(const __m128i *k1, int Nr, VAES_VEC *c,
+    const uint8_t *in, uint8_t *out)
+{
+    __m128i b;
+
+    b = _vaes_encrypt1(k1, Nr, _mm_shuffle_epi8(VAES_LANE0(*c),
+        GCM_BSWAP128));
+    *c = VAES_ADD64(*c, VAES_BCAST(_mm_set_epi64x(0, 1)));
+    b = _mm_xor_si128(b, _mm_loadu_si128((const __m128i *)in));
+    _mm_storeu_si128((__m128i *)out, b);
+
+    return _mm_shuffle_epi8(b, GCM_BSWAP128);
+}
+
+static void
+_gcm_vaes_crypt(const uint32_t *rk, int Nr, const uint64_t (*Htable)[2],
+    uint8_t *X, uint8_t *ctr, const uint8_t *in, uint8_t *out,
+    size_t blocks, int decrypt)
+{
+    const VAES_VEC bswap = VAES_BCAST(GCM_BSWAP128);
+    VAES_VEC k[AES_MAXROUNDS + 1];
+    __m128i k1[AES_MAXROUNDS + 1];
+    VAES_VEC hv[4], hl, c, d;
+    const uint8_t *g = NULL;
+    __m128i x, h, b;
+
+    _vaes_load_schedule(k, k1, rk, Nr);
+    _gcm_vaes_load_powers(hv, &hl, Htable);
+    h = _mm_loadu_si128((const __m128i *)Htable[0]);
+    x = GCM_LOAD(X);
+    c = _vaes_counter(ctr);
+
+    /*
+    * Decrypting, the ciphertext is there up front and each pass hashes
+    * itself.  Encrypting, it only exists once a pass is done, so each
+    * pass hashes the one before and the last is hashed on its own.
+    */
+    for (; blocks >= VAES_WIDE; blocks -= VAES_WIDE) {
+        x = _gcm_vaes_stitch4(k, Nr, hv, x, decrypt ? in : g, &c, in, out);
+        g = out;
+        in += 16 * VAES_WIDE;
+        out += 16 * VAES_WIDE;
+    }
+
+    if (!decrypt && g != NULL) {
+        x = _gcm_vaes_ghash4(hv, x, g);
+    }
+
+    for (; blocks >= VAES_LANES; blocks -= VAES_LANES) {
+        if (decrypt) {
+            x = _gcm_vaes_ghash1(hl, x, VAES_SHUFFLE(VAES_LOAD(in), bswap));
+            _gcm_vaes_ctr1(k, Nr, &c, in, out);
+        } else {
+            d = _gcm_vaes_ctr1(k, Nr, &c, in, out);
+            x = _gcm_vaes_ghash1(hl, x, d);
+        }
+        in += 16 * VAES_LANES;
+        out += 16 * VAES_LANES;
+    }
+
+    for (; blocks > 0; blocks--) {
+        if (decrypt) {
+            x = _gcm_mul(_mm_xor_si128(x, GCM_LOAD(in)), h);
+            _gcm_vaes_ctr_block(k1, Nr, &c, in, out);
+        } else {
+            b = _gcm_vaes_ctr_block(k1, Nr, &c, in, out);
+            x = _gcm_mul(_mm_xor_si128(x, b), h);
+        }
+        in += 16;
+        out += 16;
+    }
+
+    GCM_STORE(X, x);
+    _vaes_store_counter(ctr, c);
+
+    memset(k, 0, sizeof(k));
+    memset(k1, 0, sizeof(k1));
+}
+
+static void
+_gcm_vaes_encrypt(const uint32_t *rk, int Nr, const uint64_t (*Htable)[2],
+    uint8_t *X, uint8_t *ctr, const uint8_t *in, uint8_t *out,
+    size_t blocks)
+{
+    _gcm_vaes_crypt(rk, Nr, Htable, X, ctr, in, out, blocks, 0);
+}
+
+static void
+_gcm_vaes_decrypt(const uint32_t *rk, int Nr, const uint64_t (*Htable)[2],
+    uint8_t *X, uint8_t *ctr, const uint8_t *in, uint8_t *out,
+    size_t blocks)
+{
+    _gcm_vaes_crypt(rk, Nr, Htable, X, ctr, in, out, blocks, 1);
+}
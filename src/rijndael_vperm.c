@@ -0,0 +1,591 @@
+#include <string.h>
+
+#include "rijndael_x86.h"
+
+/*
+* Constant-time AES built from SSSE3 byte shuffles, after Mike Hamburg's
+* "Accelerating AES with Vector Permute Instructions" (vpaes).
+*
+* The T-table code indexes 4 KB tables with secret data, which leaks
+* timing through the cache and keeps 20 KB of tables hot in L1.  Here no
+* memory access depends on the data.  The only tables are ten 16-byte
+* vectors, and pshufb does all of the "lookups" inside registers.
+*
+* pshufb can only index 16 entries, so the S-box is not looked up directly.
+* Each byte is mapped (linearly, two nibble lookups) into GF(2^8) written
+* as the tower field GF(2^4)[t]/(t^2 + a t + a), a = 2, where x = i t + k
+* for nibbles i and k.  With j = i + k, the inverse is then reached with
+* nothing but lookups of single nibbles:
+*
+*     iak = 1/i + a/k          io = j + 1/iak
+*     jak = 1/j + a/k          jo = i + 1/jak
+*
+* io and jo are the reciprocals of two independent coordinates of 1/x.
+* The output tables take each of them back to the AES basis, with the
+* affine part of SubBytes folded in.  1/0 is represented by 0x80, which
+* pshufb turns into 0 on the next lookup; that makes x = 0 and the other
+* corner cases come out right without any branches.
+*
+* MixColumns is done with byte rotations and shifts.
+*/
+
+/* ShiftRows/InvShiftRows and the in-column rotations used by MixColumns,
+ * for the AES byte order (byte 4c + r is row r of column c). */
+#define VP_SHIFT_ROWS \
+    _mm_set_epi8(11, 6, 1, 12, 7, 2, 13, 8, 3, 14, 9, 4, 15, 10, 5, 0)
+#define VP_INV_SHIFT_ROWS \
+    _mm_set_epi8(3, 6, 9, 12, 15, 2, 5, 8, 11, 14, 1, 4, 7, 10, 13, 0)
+#define VP_ROT1 \
+    _mm_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1)
+#define VP_ROT2 \
+    _mm_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2)
+
+/* 1/x and a/x in GF(2^4) = GF(2)[w]/(w^4 + w + 1), with 1/0 = 0x80 */
+#define VP_INV _mm_setr_epi8( \
+    0x80, 0x01, 0x09, 0x0e, 0x0d, 0x0b, 0x07, 0x06, \
+    0x0f, 0x02, 0x0c, 0x05, 0x0a, 0x04, 0x03, 0x08)
+#define VP_AK _mm_setr_epi8( \
+    0x80, 0x02, 0x01, 0x0f, 0x09, 0x05, 0x0e, 0x0c, \
+    0x0d, 0x04, 0x0b, 0x0a, 0x07, 0x08, 0x06, 0x03)
+
+/* SubBytes: AES basis to tower field, by low and by high nibble ... */
+#define VP_ENC_IN_LO _mm_setr_epi8( \
+    0x00, 0x01, 0x1c, 0x1d, 0x2d, 0x2c, 0x31, 0x30, \
+    0x27, 0x26, 0x3b, 0x3a, 0x0a, 0x0b, 0x16, 0x17)
+#define VP_ENC_IN_HI _mm_setr_epi8( \
+    0x00, 0x86, 0xfd, 0x7b, 0x8e, 0x08, 0x73, 0xf5, \
+    0x77, 0xf1, 0x8a, 0x0c, 0xf9, 0x7f, 0x04, 0x82)
+
+/* ... and io, jo back to the AES basis through the affine transform
+ * (less its 0x63 constant) */
+#define VP_ENC_OUT_O _mm_setr_epi8( \
+    0x00, 0xcb, 0xd7, 0xb0, 0x21, 0x8d, 0x67, 0xac, \
+    0x7b, 0x5a, 0xea, 0x3d, 0x46, 0xf6, 0x91, 0x1c)
+#define VP_ENC_OUT_T _mm_setr_epi8( \
+    0x00, 0x9f, 0x61, 0x16, 0xc2, 0x2a, 0x77, 0xe8, \
+    0x89, 0x4b, 0x5d, 0x3c, 0xb5, 0xa3, 0xd4, 0xfe)
+
+/* InvSubBytes: the inverse affine transform happens on the way in */
+#define VP_DEC_IN_LO _mm_setr_epi8( \
+    0x2c, 0x99, 0xf0, 0x45, 0xf7, 0x42, 0x2b, 0x9e, \
+    0x38, 0x8d, 0xe4, 0x51, 0xe3, 0x56, 0x3f, 0x8a)
+#define VP_DEC_IN_HI _mm_setr_epi8( \
+    0x00, 0xa7, 0xa8, 0x0f, 0xed, 0x4a, 0x45, 0xe2, \
+    0xd1, 0x76, 0x79, 0xde, 0x3c, 0x9b, 0x94, 0x33)
+#define VP_DEC_OUT_O _mm_setr_epi8( \
+    0x00, 0x3b, 0xe4, 0xc8, 0x03, 0x14, 0x2c, 0x17, \
+    0xf3, 0xf0, 0x38, 0xdc, 0x2f, 0xe7, 0xcb, 0xdf)
+#define VP_DEC_OUT_T _mm_setr_epi8( \
+    0x00, 0x24, 0x91, 0x19, 0x23, 0x8f, 0x88, 0xac, \
+    0x3d, 0x1e, 0x07, 0x96, 0xab, 0xb2, 0x3a, 0xb5)
+
+static int _rijndael_vperm_key_setup_enc(uint32_t *rk,
+    const uint8_t *cipher_key, int keybits);
+static int _rijndael_vperm_key_setup_dec(uint32_t *rk,
+    const uint8_t *cipher_key, int keybits);
+static int _rijndael_vperm_key_setup_enc_multi(uint32_t *const *rk,
+    const uint8_t *const *keys, int keybits, size_t n);
+static void _rijndael_vperm_invert_key(uint32_t *dk, const uint32_t *ek,
+    int Nr);
+static void _rijndael_vperm_encrypt(const uint32_t *rk, int Nr,
+    const uint8_t *pt, uint8_t *ct);
+static void _rijndael_vperm_decrypt(const uint32_t *rk, int Nr,
+    const uint8_t *ct, uint8_t *pt);
+static void _rijndael_vperm_ctr(const uint32_t *rk, int Nr, uint8_t *ctr,
+    const uint8_t *in, uint8_t *out, size_t blocks);
+static void _rijndael_vperm_cbc_dec(const uint32_t *rk, int Nr,
+    uint8_t *iv, const uint8_t *in, uint8_t *out, size_t blocks);
+static void _rijndael_vperm_encrypt_multi(const uint32_t *const *rk, int Nr,
+    const uint8_t *const *in, uint8_t *const *out, size_t n);
+static void _rijndael_vperm_decrypt_multi(const uint32_t *const *rk, int Nr,
+    const uint8_t *const *in, uint8_t *const *out, size_t n);
+static void _rijndael_vperm_xts_enc(const uint32_t *rk, int Nr,
+    uint8_t *tweak, const uint8_t *in, uint8_t *out, size_t blocks);
+static void _rijndael_vperm_xts_dec(const uint32_t *rk, int Nr,
+    uint8_t *tweak, const uint8_t *in, uint8_t *out, size_t blocks);
+
+const struct rijndael_impl_t _rijndael_vperm_impl = {
+    "vperm",
+    _rijndael_vperm_key_setup_enc,
+    _rijndael_vperm_key_setup_dec,
+    _rijndael_vperm_key_setup_enc_multi,
+    _rijndael_vperm_invert_key,
+    _rijndael_vperm_encrypt,
+    _rijndael_vperm_decrypt,
+    _rijndael_vperm_ctr,
+    _rijndael_vperm_cbc_dec,
+    _rijndael_vperm_encrypt_multi,
+    _rijndael_vperm_decrypt_multi,
+    _rijndael_vperm_xts_enc,
+    _rijndael_vperm_xts_dec,
+    &_rijndael_vperm_impl,
+    { NULL, NULL, NULL }	/* a round costs too much for the loop to show */
+};
+
+/*
+* Push all sixteen bytes through the tower field inversion.  in_lo/in_hi
+* map into the tower field, out_o/out_t map io and jo back out.
+*/
+static __m128i
+_vp_invert(__m128i x, __m128i in_lo, __m128i in_hi, __m128i out_o,
+    __m128i out_t)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    __m128i i, j, k, ak, iak, jak, io, jo;
+
+    x = _mm_xor_si128(
+        _mm_shuffle_epi8(in_lo, _mm_and_si128(x, nibble)),
+        _mm_shuffle_epi8(in_hi,
+            _mm_and_si128(_mm_srli_epi16(x, 4), nibble)));
+
+    i = _mm_and_si128(_mm_srli_epi16(x, 4), nibble);
+    k = _mm_and_si128(x, nibble);
+    j = _mm_xor_si128(i, k);
+
+    ak = _mm_shuffle_epi8(VP_AK, k);
+    iak = _mm_xor_si128(_mm_shuffle_epi8(VP_INV, i), ak);
+    jak = _mm_xor_si128(_mm_shuffle_epi8(VP_INV, j), ak);
+    io = _mm_xor_si128(_mm_shuffle_epi8(VP_INV, iak), j);
+    jo = _mm_xor_si128(_mm_shuffle_epi8(VP_INV, jak), i);
+
+    return _mm_xor_si128(_mm_shuffle_epi8(out_o, io),
+        _mm_shuffle_epi8(out_t, jo));
+}
+
+static __m128i
+_vp_sub_bytes(__m128i x)
+{
+    return _mm_xor_si128(_mm_set1_epi8(0x63), _vp_invert(x, VP_ENC_IN_LO,
+        VP_ENC_IN_HI, VP_ENC_OUT_O, VP_ENC_OUT_T));
+}
+
+static __m128i
+_vp_inv_sub_bytes(__m128i x)
+{
+    return _vp_invert(x, VP_DEC_IN_LO, VP_DEC_IN_HI, VP_DEC_OUT_O,
+        VP_DEC_OUT_T);
+}
+
+/* multiply every byte by x in GF(2^8) */
+static __m128i
+_vp_xtime(__m128i x)
+{
+    __m128i carry;
+
+    carry = _mm_cmplt_epi8(x, _mm_setzero_si128());
+    return _mm_xor_si128(_mm_add_epi8(x, x),
+        _mm_and_si128(carry, _mm_set1_epi8(0x1b)));
+}
+
+/* b[i] = 2 a[i] ^ 3 a[i+1] ^ a[i+2] ^ a[i+3] within each column */
+static __m128i
+_vp_mix_columns(__m128i a)
+{
+    __m128i r1, t;
+
+    r1 = _mm_shuffle_epi8(a, VP_ROT1);
+    t = _mm_xor_si128(a, r1);
+
+    return _mm_xor_si128(_mm_xor_si128(_vp_xtime(t), r1),
+        _mm_shuffle_epi8(t, VP_ROT2));
+}
+
+/* InvMixColumns is MixColumns after a[i] ^= 4 (a[i] ^ a[i+2]) */
+static __m128i
+_vp_inv_mix_columns(__m128i a)
+{
+    __m128i u;
+
+    u = _mm_xor_si128(a, _mm_shuffle_epi8(a, VP_ROT2));
+    u = _vp_xtime(_vp_xtime(u));
+
+    return _vp_mix_columns(_mm_xor_si128(a, u));
+}
+
+/* the same steps as AESENC/AESENCLAST and AESDEC/AESDECLAST */
+static __m128i
+_vp_enc_round(__m128i s, __m128i k)
+{
+    s = _vp_sub_bytes(_mm_shuffle_epi8(s, VP_SHIFT_ROWS));
+    return _mm_xor_si128(_vp_mix_columns(s), k);
+}
+
+static __m128i
+_vp_enc_last(__m128i s, __m128i k)
+{
+    s = _vp_sub_bytes(_mm_shuffle_epi8(s, VP_SHIFT_ROWS));
+    return _mm_xor_si128(s, k);
+}
+
+static __m128i
+_vp_dec_round(__m128i s, __m128i k)
+{
+    s = _vp_inv_sub_bytes(_mm_shuffle_epi8(s, VP_INV_SHIFT_ROWS));
+    return _mm_xor_si128(_vp_inv_mix_columns(s), k);
+}
+
+static __m128i
+_vp_dec_last(__m128i s, __m128i k)
+{
+    s = _vp_inv_sub_bytes(_mm_shuffle_epi8(s, VP_INV_SHIFT_ROWS));
+    return _mm_xor_si128(s, k);
+}
+
+/* SubWord on a big-endian schedule word */
+static uint32_t
+_vp_sub_word(uint32_t w)
+{
+    return (uint32_t)_mm_cvtsi128_si32(
+        _vp_sub_bytes(_mm_cvtsi32_si128((int)w)));
+}
+
+/**
+ * Expand the cipher key into the encryption key schedule, word by word as
+ * FIPS-197 describes it, with SubWord going through the constant-time
+ * S-box instead of the T-tables.
+ *
+ * @return	the number of rounds for the given cipher key size.
+ */
+static int
+_rijndael_vperm_key_setup_enc(uint32_t *rk, const uint8_t *cipher_key,
+    int keybits)
+{
+    uint32_t temp, rcon = 0x01;
+    int Nk, Nr, i;
+
+    if (keybits != 128 && keybits != 192 && keybits != 256) {
+        return 0;
+    }
+
+    Nk = keybits / 32;
+    Nr = Nk + 6;
+
+    for (i = 0; i < Nk; i++) {
+        rk[i] = ((uint32_t)cipher_key[4*i] << 24) ^
+            ((uint32_t)cipher_key[4*i + 1] << 16) ^
+            ((uint32_t)cipher_key[4*i + 2] << 8) ^
+            ((uint32_t)cipher_key[4*i + 3]);
+    }
+
+    for (; i < 4 * (Nr + 1); i++) {
+        temp = rk[i - 1];
+        if (i % Nk == 0) {
+            temp = _vp_sub_word((temp << 8) | (temp >> 24)) ^ (rcon << 24);
+            rcon = (rcon << 1) ^ ((rcon >> 7) * 0x11b);
+        } else if (Nk > 6 && i % Nk == 4) {
+            temp = _vp_sub_word(temp);
+        }
+        rk[i] = rk[i - Nk] ^ temp;
+    }
+
+    return Nr;
+}
+
+/*
+* Four keys at a time.  The S-box works on a whole register, so the
+* SubWords of one step for all four keys cost the same as one.
+*/
+static int
+_rijndael_vperm_key_setup_enc_multi(uint32_t *const *rk,
+    const uint8_t *const *keys, int keybits, size_t n)
+{
+    uint32_t t[4], rcon;
+    size_t done;
+    int Nk, Nr, i, j, m, k;
+
+    if (keybits != 128 && keybits != 192 && keybits != 256) {
+        return 0;
+    }
+
+    Nk = keybits / 32;
+    Nr = Nk + 6;
+
+    for (done = 0; done < n; done += m) {
+        m = n - done < 4 ? (int)(n - done) : 4;
+        for (j = 0; j < m; j++) {
+            for (i = 0; i < Nk; i++) {
+                rk[done + j][i] =
+                    ((uint32_t)keys[done + j][4*i] << 24) ^
+                    ((uint32_t)keys[done + j][4*i + 1] << 16) ^
+                    ((uint32_t)keys[done + j][4*i + 2] << 8) ^
+                    ((uint32_t)keys[done + j][4*i + 3]);
+            }
+        }
+
+        memset(t, 0, sizeof(t));
+        rcon = 0x01;
+        for (i = Nk; i < 4 * (Nr + 1); i++) {
+            k = i % Nk;
+            if (k != 0 && (Nk <= 6 || k != 4)) {
+                for (j = 0; j < m; j++) {
+                    rk[done + j][i] = rk[done + j][i - Nk] ^
+                        rk[done + j][i - 1];
+                }
+                continue;
+            }
+
+            for (j = 0; j < m; j++) {
+                t[j] = rk[done + j][i - 1];
+                if (k == 0) {
+                    t[j] = (t[j] << 8) | (t[j] >> 24);
+                }
+            }
+            _mm_storeu_si128((__m128i *)t,
+                _vp_sub_bytes(_mm_loadu_si128((const __m128i *)t)));
+            for (j = 0; j < m; j++) {
+                rk[done + j][i] = rk[done + j][i - Nk] ^ t[j] ^
+                    (k == 0 ? rcon << 24 : 0);
+            }
+            if (k == 0) {
+                rcon = (rcon << 1) ^ ((rcon >> 7) * 0x11b);
+            }
+        }
+    }
+
+    memset(t, 0, sizeof(t));
+    return Nr;
+}
+
+static int
+_rijndael_vperm_key_setup_dec(uint32_t *rk, const uint8_t *cipher_key,
+    int keybits)
+{
+    int Nr;
+
+    Nr = _rijndael_vperm_key_setup_enc(rk, cipher_key, keybits);
+    if (Nr == 0) {
+        return 0;
+    }
+
+    _rijndael_vperm_invert_key(rk, rk, Nr);
+    return Nr;
+}
+
+/* round keys reversed, InvMixColumns on all but the first and the last */
+static void
+_rijndael_vperm_invert_key(uint32_t *dk, const uint32_t *ek, int Nr)
+{
+    __m128i a, b;
+    int i, j;
+
+    /* swap from both ends in, so dk may overwrite ek */
+    for (i = 0, j = Nr; i <= j; i++, j--) {
+        a = RIJNDAEL_LOAD_RK(ek, i);
+        b = RIJNDAEL_LOAD_RK(ek, j);
+        if (i != 0) {
+            a = _vp_inv_mix_columns(a);
+            b = _vp_inv_mix_columns(b);
+        }
+        RIJNDAEL_STORE_RK(dk, j, a);
+        RIJNDAEL_STORE_RK(dk, i, b);
+    }
+}
+
+static void
+_rijndael_vperm_encrypt(const uint32_t *rk, int Nr, const uint8_t *pt,
+    uint8_t *ct)
+{
+    __m128i s;
+    int r;
+
+    s = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pt),
+        RIJNDAEL_LOAD_RK(rk, 0));
+    for (r = 1; r < Nr; r++) {
+        s = _vp_enc_round(s, RIJNDAEL_LOAD_RK(rk, r));
+    }
+    s = _vp_enc_last(s, RIJNDAEL_LOAD_RK(rk, Nr));
+
+    _mm_storeu_si128((__m128i *)ct, s);
+}
+
+static void
+_rijndael_vperm_decrypt(const uint32_t *rk, int Nr, const uint8_t *ct,
+    uint8_t *pt)
+{
+    __m128i s;
+    int r;
+
+    s = _mm_xor_si128(_mm_loadu_si128((const __m128i *)ct),
+        RIJNDAEL_LOAD_RK(rk, 0));
+    for (r = 1; r < Nr; r++) {
+        s = _vp_dec_round(s, RIJNDAEL_LOAD_RK(rk, r));
+    }
+    s = _vp_dec_last(s, RIJNDAEL_LOAD_RK(rk, Nr));
+
+    _mm_storeu_si128((__m128i *)pt, s);
+}
+
+/*
+* The bulk modes keep VP_LANES blocks in flight.  A round here is a long
+* chain of dependent shuffles, so independent blocks fill the gaps until
+* the shuffle port is saturated.
+*/
+#define VP_LANES		(4)
+
+static void
+_rijndael_vperm_ctr(const uint32_t *rk, int Nr, uint8_t *ctr,
+    const uint8_t *in, uint8_t *out, size_t blocks)
+{
+    __m128i k[AES_MAXROUNDS + 1];
+    __m128i x[VP_LANES];
+    uint64_t hi, lo;
+    int b, n, r;
+
+    _rijndael_load_schedule(k, rk, Nr);
+    hi = _rijndael_load_be64(ctr);
+    lo = _rijndael_load_be64(ctr + 8);
+
+    while (blocks > 0) {
+        n = blocks < VP_LANES ? (int)blocks : VP_LANES;
+
+        for (b = 0; b < n; b++) {
+            x[b] = _mm_xor_si128(_rijndael_ctr_block(&hi, &lo), k[0]);
+        }
+
+        for (r = 1; r < Nr; r++) {
+            for (b = 0; b < n; b++) {
+                x[b] = _vp_enc_round(x[b], k[r]);
+            }
+        }
+
+        for (b = 0; b < n; b++) {
+            x[b] = _vp_enc_last(x[b], k[Nr]);
+            _mm_storeu_si128((__m128i *)out + b, _mm_xor_si128(x[b],
+                _mm_loadu_si128((const __m128i *)in + b)));
+        }
+
+        in += 16 * n;
+        out += 16 * n;
+        blocks -= n;
+    }
+
+    _rijndael_store_be64(ctr, hi);
+    _rijndael_store_be64(ctr + 8, lo);
+
+    memset(k, 0, sizeof(k));
+}
+
+static void
+_rijndael_vperm_cbc_dec(const uint32_t *rk, int Nr, uint8_t *iv,
+    const uint8_t *in, uint8_t *out, size_t blocks)
+{
+    __m128i k[AES_MAXROUNDS + 1];
+    __m128i c[VP_LANES + 1];
+    __m128i x[VP_LANES];
+    int b, n, r;
+
+    _rijndael_load_schedule(k, rk, Nr);
+    c[0] = _mm_loadu_si128((const __m128i *)iv);
+
+    while (blocks > 0) {
+        n = blocks < VP_LANES ? (int)blocks : VP_LANES;
+
+        for (b = 0; b < n; b++) {
+            c[b + 1] = _mm_loadu_si128((const __m128i *)in + b);
+            x[b] = _mm_xor_si128(c[b + 1], k[0]);
+        }
+
+        for (r = 1; r < Nr; r++) {
+            for (b = 0; b < n; b++) {
+                x[b] = _vp_dec_round(x[b], k[r]);
+            }
+        }
+
+        for (b = 0; b < n; b++) {
+            x[b] = _vp_dec_last(x[b], k[Nr]);
+            _mm_storeu_si128((__m128i *)out + b, _mm_xor_si128(x[b], c[b]));
+        }
+        c[0] = c[n];
+
+        in += 16 * n;
+        out += 16 * n;
+        blocks -= n;
+    }
+
+    _mm_storeu_si128((__m128i *)iv, c[0]);
+
+    memset(k, 0, sizeof(k));
+}
+
+/* VP_LANES blocks under as many keys, each lane loading its own round keys */
+#define VP_MULTI(name, round, last) \
+static void \
+name(const uint32_t *const *rk, int Nr, const uint8_t *const *in, \
+    uint8_t *const *out, size_t n) \
+{ \
+    __m128i x[VP_LANES]; \
+    size_t b, m; \
+    int r; \
+\
+    for (; n > 0; n -= m, rk += m, in += m, out += m) { \
+        m = n < VP_LANES ? n : VP_LANES; \
+\
+        for (b = 0; b < m; b++) { \
+            x[b] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in[b]), \
+                RIJNDAEL_LOAD_RK(rk[b], 0)); \
+        } \
+\
+        for (r = 1; r < Nr; r++) { \
+            for (b = 0; b < m; b++) { \
+                x[b] = round(x[b], RIJNDAEL_LOAD_RK(rk[b], r)); \
+            } \
+        } \
+\
+        for (b = 0; b < m; b++) { \
+            _mm_storeu_si128((__m128i *)out[b], \
+                last(x[b], RIJNDAEL_LOAD_RK(rk[b], Nr))); \
+        } \
+    } \
+}
+
+VP_MULTI(_rijndael_vperm_encrypt_multi, _vp_enc_round, _vp_enc_last)
+VP_MULTI(_rijndael_vperm_decrypt_multi, _vp_dec_round, _vp_dec_last)
+
+/* XTS, VP_LANES blocks at a time; the tweak goes in with the outer keys */
+#define VP_XTS(name, round, last) \
+static void \
+name(const uint32_t *rk, int Nr, uint8_t *tweak, const uint8_t *in, \
+    uint8_t *out, size_t blocks) \
+{ \
+    __m128i k[AES_MAXROUNDS + 1]; \
+    __m128i t[VP_LANES]; \
+    __m128i x[VP_LANES]; \
+    __m128i tw; \
+    int b, n, r; \
+\
+    _rijndael_load_schedule(k, rk, Nr); \
+    tw = _mm_loadu_si128((const __m128i *)tweak); \
+\
+    while (blocks > 0) { \
+        n = blocks < VP_LANES ? (int)blocks : VP_LANES; \
+\
+        for (b = 0; b < n; b++) { \
+            t[b] = tw; \
+            tw = _rijndael_xts_double(tw); \
+            x[b] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in + b), \
+                _mm_xor_si128(t[b], k[0])); \
+        } \
+\
+        for (r = 1; r < Nr; r++) { \
+            for (b = 0; b < n; b++) { \
+                x[b] = round(x[b], k[r]); \
+            } \
+        } \
+\
+        for (b = 0; b < n; b++) { \
+            _mm_storeu_si128((__m128i *)out + b, \
+                last(x[b], _mm_xor_si128(k[Nr], t[b]))); \
+        } \
+\
+        in += 16 * n; \
+        out += 16 * n; \
+        blocks -= n; \
+    } \
+\
+    _mm_storeu_si128((__m128i *)tweak, tw); \
+\
+    memset(k, 0, sizeof(k)); \
+}
+
+VP_XTS(_rijndael_vperm_xts_enc, _vp_enc_round, _vp_enc_last)
+VP_XTS(_rijndael_vperm_xts_dec, _vp_dec_round, _vp_dec_last)
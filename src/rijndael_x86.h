@@ -0,0 +1,91 @@
+#ifndef ECRYPT_RIJNDAEL_X86_H
+#define ECRYPT_RIJNDAEL_X86_H
+
+/*
+* Helpers shared by the x86 SIMD implementations.  Only include this from
+* files that are compiled with at least -mssse3.
+*/
+#include <string.h>
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+
+#include "rijndael_impl.h"
+
+/*
+* The key schedules in rijndael_ctx hold big-endian words, while the SIMD
+* code wants the round key in plain byte order.  One pshufb per round key
+* converts between the two.
+*/
+#define RIJNDAEL_BSWAP32 \
+    _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3)
+
+#define RIJNDAEL_LOAD_RK(rk, i) \
+    _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)((rk) + 4*(i))), \
+        RIJNDAEL_BSWAP32)
+
+#define RIJNDAEL_STORE_RK(rk, i, k) \
+    _mm_storeu_si128((__m128i *)((rk) + 4*(i)), \
+        _mm_shuffle_epi8((k), RIJNDAEL_BSWAP32))
+
+/* the whole schedule in registers (or at worst, in one hot stack line) */
+static inline void
+_rijndael_load_schedule(__m128i *k, const uint32_t *rk, int Nr)
+{
+    int r;
+
+    for (r = 0; r <= Nr; r++) {
+        k[r] = RIJNDAEL_LOAD_RK(rk, r);
+    }
+}
+
+/* the CTR counter is kept as two native 64-bit halves between blocks */
+static inline uint64_t
+_rijndael_load_be64(const uint8_t *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, 8);
+    return __builtin_bswap64(v);
+}
+
+static inline void
+_rijndael_store_be64(uint8_t *p, uint64_t v)
+{
+    v = __builtin_bswap64(v);
+    memcpy(p, &v, 8);
+}
+
+/* the next counter block in byte order; advances the counter */
+static inline __m128i
+_rijndael_ctr_block(uint64_t *hi, uint64_t *lo)
+{
+    __m128i b;
+
+    b = _mm_set_epi64x((long long)__builtin_bswap64(*lo),
+        (long long)__builtin_bswap64(*hi));
+    if (++*lo == 0) {
+        ++*hi;
+    }
+
+    return b;
+}
+
+/*
+* The next XTS tweak: t * x in GF(2^128), t in byte order, which makes it
+* one little-endian 128-bit number.  Both 64-bit halves are shifted with
+* one add; the bit carried out of the low half and the reduction for the
+* bit carried out of the top are put back from the old sign bits.
+*/
+static inline __m128i
+_rijndael_xts_double(__m128i t)
+{
+    __m128i c;
+
+    c = _mm_srai_epi32(_mm_shuffle_epi32(t, 0x13), 31);
+    c = _mm_and_si128(c, _mm_set_epi32(0, 1, 0, 0x87));
+
+    return _mm_xor_si128(_mm_add_epi64(t, t), c);
+}
+
+#endif /* ECRYPT_RIJNDAEL_X86_H */
@@ -0,0 +1,543 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ecrypt/sha256.h>
+#include "cpu.h"
+#include "sha256_impl.h"
+
+/* SHA256 rotate macros */
+#define SHA256_ROTL(a,b) (((a) << (b)) | ((a) >> (32-(b))))
+#define SHA256_ROTR(a,b) (((a) >> (b)) | ((a) << (32-(b))))
+
+/* from the name, one assumes that this adds a 32-bit int to a 64-bit int,
+ * but if you had to decipher the code, that wouldn't be all that clear */
+#define SHA256_INT64_ADD32(a,b,c) if (a > 0xffffffff - (c)) ++b; a+=c;
+
+/* basic SHA256 functions.  defined in the standard */
+#define SHA256_CH(x,y,z) (((x) & (y)) ^ (~(x) & (z)))
+#define SHA256_MAJ(x,y,z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define SHA256_EP0(x) (SHA256_ROTR(x,2) ^ SHA256_ROTR(x,13) ^ SHA256_ROTR(x,22))
+#define SHA256_EP1(x) (SHA256_ROTR(x,6) ^ SHA256_ROTR(x,11) ^ SHA256_ROTR(x,25))
+#define SHA256_SIG0(x) (SHA256_ROTR(x,7) ^ SHA256_ROTR(x,18) ^ ((x) >> 3))
+#define SHA256_SIG1(x) (SHA256_ROTR(x,17) ^ SHA256_ROTR(x,19) ^ ((x) >> 10))
+
+/* used to initialize the state for sha256 */
+const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/* the initial hash value */
+static const uint32_t sha256_h0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/* function prototypes */
+static void sha256_transform(struct sha256_context_t* ctx, uint8_t* data);
+static const struct sha256_impl_t* _sha256_current_impl(void);
+
+/* function definitions */
+
+void sha256_finalize(struct sha256_context_t* ctx, uint8_t* hash)
+{
+    uint32_t i;
+
+    i  = ctx->datalen;
+
+    if (ctx->datalen < 56) {
+        ctx->data[i++] = 0x80;
+        while (i < 56) {
+            ctx->data[i++] = 0x00;
+        }
+    } else {
+        ctx->data[i++] = 0x80;
+        while (i < 64) {
+            ctx->data[i++] = 0x00;
+        }
+
+        sha256_transform(ctx, ctx->data);
+        memset(ctx->data, 0, 56);
+    }
+
+    SHA256_INT64_ADD32(ctx->bitlen[0], ctx->bitlen[1], ctx->datalen*8);
+    ctx->data[63] = ctx->bitlen[0];
+    ctx->data[62] = ctx->bitlen[0] >> 8;
+    ctx->data[61] = ctx->bitlen[0] >> 16;
+    ctx->data[60] = ctx->bitlen[0] >> 24;
+
+    ctx->data[59] = ctx->bitlen[1];
+    ctx->data[58] = ctx->bitlen[1] >> 8;
+    ctx->data[57] = ctx->bitlen[1] >> 16;
+    ctx->data[56] = ctx->bitlen[1] >> 24;
+
+    sha256_transform(ctx, ctx->data);
+
+    /* reverse byte ordering.. */
+    for (i = 0; i < 4; ++i) {
+        hash[i] = (ctx->state[0] >> (24 - (i*8))) & 0x000000ff;
+        hash[i+4] = (ctx->state[1] >> (24 - (i*8))) & 0x000000ff;
+        hash[i+8] = (ctx->state[2] >> (24 - (i*8))) & 0x000000ff;
+        hash[i+12] = (ctx->state[3] >> (24 - (i*8))) & 0x000000ff;
+        hash[i+16] = (ctx->state[4] >> (24 - (i*8))) & 0x000000ff;
+        hash[i+20] = (ctx->state[5] >> (24 - (i*8))) & 0x000000ff;
+        hash[i+24] = (ctx->state[6] >> (24 - (i*8))) & 0x000000ff;
+        hash[i+28] = (ctx->state[7] >> (24 - (i*8))) & 0x000000ff;
+    }
+}
+
+void sha256_init(struct sha256_context_t* ctx)
+{
+    ctx->datalen = 0;
+    ctx->bitlen[0] = 0;
+    ctx->bitlen[1] = 0;
+
+    memcpy(ctx->state, sha256_h0, sizeof(ctx->state));
+}
+
+static void sha256_transform(struct sha256_context_t* ctx, uint8_t* data)
+{
+    _sha256_current_impl()->blocks(ctx->state, data, 1);
+}
+
+/* the portable compression function, one block at a time */
+static void _sha256_scalar_blocks(uint32_t* state, const uint8_t* data,
+    size_t blocks)
+{
+    uint32_t a, b, c, d, e, f, g, h, i, j;
+    uint32_t t1, t2;
+    uint32_t m[64];
+
+    for (; blocks > 0; --blocks, data += 64) {
+        for (i = 0, j = 0; i < 16; ++i, j += 4) {
+            m[i] = ((uint32_t)data[j+0] << 24) | (data[j+1] << 16) |
+                   (data[j+2] <<  8) | (data[j+3] << 0);
+        }
+
+        while (i < 64) {
+            m[i] = SHA256_SIG1(m[i-2]) + m[i-7] + SHA256_SIG0(m[i-15]) +
+                m[i-16];
+            ++i;
+        }
+
+        a = state[0];
+        b = state[1];
+        c = state[2];
+        d = state[3];
+        e = state[4];
+        f = state[5];
+        g = state[6];
+        h = state[7];
+
+        for (i = 0; i < 64; ++i) {
+            t1 = h + SHA256_EP1(e) + SHA256_CH(e,f,g) + sha256_k[i] + m[i];
+            t2 = SHA256_EP0(a) + SHA256_MAJ(a,b,c);
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+const struct sha256_impl_t _sha256_scalar_impl = {
+    "scalar",
+    _sha256_scalar_blocks
+};
+
+/* The compression function every hash goes through.  Picked once, on
+ * first use from any thread, unless sha256_select_impl has chosen one. */
+static const struct sha256_impl_t* _sha256_impl = NULL;
+static pthread_once_t _sha256_impl_once = PTHREAD_ONCE_INIT;
+
+static const struct sha256_impl_t* _sha256_best_impl(void)
+{
+#if defined(ECRYPT_HAVE_SHANI)
+    if (_ecrypt_cpu_features() & ECRYPT_CPU_SHA) {
+        return &_sha256_shani_impl;
+    }
+#endif
+
+    return &_sha256_scalar_impl;
+}
+
+static void _sha256_impl_init(void)
+{
+    _sha256_impl = _sha256_best_impl();
+}
+
+static const struct sha256_impl_t* _sha256_current_impl(void)
+{
+    pthread_once(&_sha256_impl_once, _sha256_impl_init);
+    return _sha256_impl;
+}
+
+int sha256_select_impl(int impl)
+{
+    /* first, or the first use would undo the choice */
+    pthread_once(&_sha256_impl_once, _sha256_impl_init);
+
+    switch (impl) {
+    case SHA256_IMPL_AUTO:
+        _sha256_impl = _sha256_best_impl();
+        return ECRYPT_NO_ERROR;
+    case SHA256_IMPL_SCALAR:
+        _sha256_impl = &_sha256_scalar_impl;
+        return ECRYPT_NO_ERROR;
+    case SHA256_IMPL_SHANI:
+#if defined(ECRYPT_HAVE_SHANI)
+        if (_ecrypt_cpu_features() & ECRYPT_CPU_SHA) {
+            _sha256_impl = &_sha256_shani_impl;
+            return ECRYPT_NO_ERROR;
+        }
+#endif
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    return ECRYPT_INVALID_PARAMETERS;
+}
+
+const char* sha256_impl_name(void)
+{
+    return _sha256_current_impl()->name;
+}
+
+void sha256_update(struct sha256_context_t* ctx, const uint8_t* data,
+    size_t len)
+{
+    uint64_t bits;
+    size_t n;
+
+    while (len > 0) {
+        /* whole blocks go straight from data, the rest through ctx->data */
+        if (ctx->datalen == 0 && len >= 64) {
+            n = len / 64;
+            _sha256_current_impl()->blocks(ctx->state, data, n);
+            bits = ((uint64_t)ctx->bitlen[1] << 32 | ctx->bitlen[0]) +
+                (uint64_t)n * 512;
+            ctx->bitlen[0] = (uint32_t)bits;
+            ctx->bitlen[1] = (uint32_t)(bits >> 32);
+            data += n * 64;
+            len -= n * 64;
+            continue;
+        }
+
+        n = 64 - ctx->datalen;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(&ctx->data[ctx->datalen], data, n);
+        ctx->datalen += (uint32_t)n;
+        data += n;
+        len -= n;
+
+        if (ctx->datalen == 64) {
+            sha256_transform(ctx, ctx->data);
+            SHA256_INT64_ADD32(ctx->bitlen[0], ctx->bitlen[1], 512);
+            ctx->datalen = 0;
+        }
+    }
+}
+
+/* sha256_multi hashes every message from its first block to its last
+ * without going through a context: the whole blocks straight from the
+ * message, then one or two blocks of padding built in tail. */
+struct _sha256_lane_t {
+    const struct sha256_batch_t* job;	/* NULL while the lane is idle */
+    const uint8_t* data;		/* the next block */
+    size_t blocks;			/* left from data on */
+    size_t tail_blocks;			/* to follow from tail, if not there yet */
+    uint8_t tail[128];
+};
+
+/* runs one hash at a time through the sha256_select_impl function */
+static const struct sha256_multi_impl_t _sha256_serial_impl = {
+    "serial",
+    0,
+    NULL
+};
+
+/* Picked once like _sha256_impl. */
+static const struct sha256_multi_impl_t* _sha256_multi_impl = NULL;
+static pthread_once_t _sha256_multi_impl_once = PTHREAD_ONCE_INIT;
+
+static const struct sha256_multi_impl_t* _sha256_multi_best_impl(void)
+{
+#if defined(ECRYPT_HAVE_AVX512)
+    if (_ecrypt_cpu_features() & ECRYPT_CPU_AVX512) {
+        return &_sha256_avx512_impl;
+    }
+#endif
+
+#if defined(ECRYPT_HAVE_AVX2)
+    /* eight lanes of AVX2 do not keep up with the SHA extensions */
+    if ((_ecrypt_cpu_features() & ECRYPT_CPU_AVX2) &&
+      !(_ecrypt_cpu_features() & ECRYPT_CPU_SHA)) {
+        return &_sha256_avx2_impl;
+    }
+#endif
+
+    return &_sha256_serial_impl;
+}
+
+static void _sha256_multi_impl_init(void)
+{
+    _sha256_multi_impl = _sha256_multi_best_impl();
+}
+
+static const struct sha256_multi_impl_t* _sha256_multi_current_impl(void)
+{
+    pthread_once(&_sha256_multi_impl_once, _sha256_multi_impl_init);
+    return _sha256_multi_impl;
+}
+
+int sha256_multi_select_impl(int impl)
+{
+    pthread_once(&_sha256_multi_impl_once, _sha256_multi_impl_init);
+
+    switch (impl) {
+    case SHA256_MULTI_AUTO:
+        _sha256_multi_impl = _sha256_multi_best_impl();
+        return ECRYPT_NO_ERROR;
+    case SHA256_MULTI_SERIAL:
+        _sha256_multi_impl = &_sha256_serial_impl;
+        return ECRYPT_NO_ERROR;
+    case SHA256_MULTI_AVX2:
+#if defined(ECRYPT_HAVE_AVX2)
+        if (_ecrypt_cpu_features() & ECRYPT_CPU_AVX2) {
+            _sha256_multi_impl = &_sha256_avx2_impl;
+            return ECRYPT_NO_ERROR;
+        }
+#endif
+        return ECRYPT_INVALID_PARAMETERS;
+    case SHA256_MULTI_AVX512:
+#if defined(ECRYPT_HAVE_AVX512)
+        if (_ecrypt_cpu_features() & ECRYPT_CPU_AVX512) {
+            _sha256_multi_impl = &_sha256_avx512_impl;
+            return ECRYPT_NO_ERROR;
+        }
+#endif
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    return ECRYPT_INVALID_PARAMETERS;
+}
+
+const char* sha256_multi_impl_name(void)
+{
+    return _sha256_multi_current_impl()->name;
+}
+
+/* Puts job in lane, whose state words are state[0], state[stride], ... */
+static void _sha256_lane_start(struct _sha256_lane_t* lane,
+    const struct sha256_batch_t* job, uint32_t* state, int stride)
+{
+    uint64_t bits = (uint64_t)job->len * 8;
+    size_t rest = job->len % 64;
+    size_t tail_len;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        state[i * stride] = sha256_h0[i];
+    }
+
+    /* the end of the message, 0x80, zeros and the length in bits */
+    tail_len = (rest < 56) ? 64 : 128;
+    if (rest > 0) {
+        memcpy(lane->tail, job->msg + job->len - rest, rest);
+    }
+    lane->tail[rest] = 0x80;
+    memset(&lane->tail[rest + 1], 0, tail_len - rest - 9);
+    for (i = 1; i <= 8; i++) {
+        lane->tail[tail_len - i] = (uint8_t)bits;
+        bits >>= 8;
+    }
+
+    lane->job = job;
+    lane->data = job->msg;
+    lane->blocks = job->len / 64;
+    lane->tail_blocks = tail_len / 64;
+    if (lane->blocks == 0) {
+        lane->data = lane->tail;
+        lane->blocks = lane->tail_blocks;
+        lane->tail_blocks = 0;
+    }
+}
+
+static void _sha256_lane_digest(const struct _sha256_lane_t* lane,
+    const uint32_t* state, int stride)
+{
+    uint8_t* out = lane->job->digest;
+    uint32_t w;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        w = state[i * stride];
+        out[4 * i] = (uint8_t)(w >> 24);
+        out[4 * i + 1] = (uint8_t)(w >> 16);
+        out[4 * i + 2] = (uint8_t)(w >> 8);
+        out[4 * i + 3] = (uint8_t)w;
+    }
+}
+
+/* Runs whatever is left of lane's message through the single buffer
+ * compression function and writes out its digest. */
+static void _sha256_lane_finish(struct _sha256_lane_t* lane,
+    const uint32_t* state, int stride)
+{
+    const struct sha256_impl_t* impl = _sha256_current_impl();
+    uint32_t st[8];
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        st[i] = state[i * stride];
+    }
+
+    impl->blocks(st, lane->data, lane->blocks);
+    if (lane->tail_blocks > 0) {
+        impl->blocks(st, lane->tail, lane->tail_blocks);
+    }
+
+    _sha256_lane_digest(lane, st, 1);
+    lane->job = NULL;
+}
+
+/* The scheduler behind sha256_multi.  Every round hands each busy lane's
+ * next block to the kernel and runs as many blocks as the shortest of them
+ * has left; a lane that runs out moves on to its padding, and then to the
+ * next job.  Idle lanes are pointed at a busy lane's data, their results
+ * thrown away.  When the queue is empty and at most half the lanes are
+ * still busy, the vector kernel is mostly wasted work, so those messages
+ * are finished one by one. */
+static void _sha256_multi_lanes(const struct sha256_multi_impl_t* impl,
+    const struct sha256_batch_t* jobs, size_t n)
+{
+    struct _sha256_lane_t lane[SHA256_MAX_LANES];
+    uint32_t state[8 * SHA256_MAX_LANES];
+    const uint8_t* data[SHA256_MAX_LANES];
+    int lanes = impl->lanes;
+    int active = 0;
+    int i, busy;
+    size_t next = 0;
+    size_t run;
+
+    for (i = 0; i < lanes; i++) {
+        lane[i].job = NULL;
+    }
+
+    for (;;) {
+        for (i = 0; i < lanes && next < n; i++) {
+            if (lane[i].job == NULL) {
+                _sha256_lane_start(&lane[i], &jobs[next++], &state[i], lanes);
+                active++;
+            }
+        }
+
+        if (next == n && active * 2 <= lanes) {
+            break;
+        }
+
+        run = 0;
+        busy = 0;
+        for (i = 0; i < lanes; i++) {
+            if (lane[i].job != NULL && (run == 0 || lane[i].blocks < run)) {
+                run = lane[i].blocks;
+                busy = i;
+            }
+        }
+
+        for (i = 0; i < lanes; i++) {
+            data[i] = (lane[i].job != NULL) ? lane[i].data : lane[busy].data;
+        }
+
+        impl->blocks(state, data, run);
+
+        for (i = 0; i < lanes; i++) {
+            if (lane[i].job == NULL) {
+                continue;
+            }
+
+            lane[i].data = data[i];
+            lane[i].blocks -= run;
+            if (lane[i].blocks > 0) {
+                continue;
+            }
+
+            if (lane[i].tail_blocks > 0) {
+                lane[i].data = lane[i].tail;
+                lane[i].blocks = lane[i].tail_blocks;
+                lane[i].tail_blocks = 0;
+            } else {
+                _sha256_lane_digest(&lane[i], &state[i], lanes);
+                lane[i].job = NULL;
+                active--;
+            }
+        }
+    }
+
+    for (i = 0; i < lanes; i++) {
+        if (lane[i].job != NULL) {
+            _sha256_lane_finish(&lane[i], &state[i], lanes);
+        }
+    }
+}
+
+int sha256_multi(const struct sha256_batch_t* jobs, size_t n)
+{
+    const struct sha256_multi_impl_t* impl;
+    struct _sha256_lane_t lane;
+    uint32_t state[8];
+    size_t i;
+
+    if (jobs == NULL && n > 0) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (jobs[i].digest == NULL ||
+            (jobs[i].msg == NULL && jobs[i].len > 0)) {
+            return ECRYPT_NULL_PTR;
+        }
+    }
+
+    impl = _sha256_multi_current_impl();
+    if (impl->lanes == 0) {
+        for (i = 0; i < n; i++) {
+            _sha256_lane_start(&lane, &jobs[i], state, 1);
+            _sha256_lane_finish(&lane, state, 1);
+        }
+    } else {
+        _sha256_multi_lanes(impl, jobs, n);
+    }
+
+    return ECRYPT_NO_ERROR;
+}
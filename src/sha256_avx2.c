@@ -0,0 +1,66 @@
+#include <immintrin.h>
+
+#include "sha256_impl.h"
+
+/* sha256_multi on eight lanes of AVX2 registers.  See sha256_mb_tmpl.c. */
+
+#define SHA_MB_VEC		__m256i
+#define SHA_MB_LANES		8
+#define SHA_MB_IMPL		_sha256_avx2_impl
+#define SHA_MB_NAME		"avx2"
+
+#define SHA_MB_LOAD(p)		_mm256_loadu_si256((const __m256i*)(p))
+#define SHA_MB_STORE(p, x)	_mm256_storeu_si256((__m256i*)(p), (x))
+#define SHA_MB_ADD		_mm256_add_epi32
+#define SHA_MB_XOR		_mm256_xor_si256
+#define SHA_MB_BCAST(x)		_mm256_set1_epi32((int)(x))
+#define SHA_MB_SHR		_mm256_srli_epi32
+#define SHA_MB_ROR(x, n) \
+  _mm256_or_si256(_mm256_srli_epi32((x), (n)), \
+    _mm256_slli_epi32((x), 32 - (n)))
+#define SHA_MB_XOR3(x, y, z)	SHA_MB_XOR(SHA_MB_XOR((x), (y)), (z))
+/* g ^ (e & (f ^ g)) and (a & b) | (c & (a | b)) */
+#define SHA_MB_CH(e, f, g) \
+  SHA_MB_XOR((g), _mm256_and_si256((e), SHA_MB_XOR((f), (g))))
+#define SHA_MB_MAJ(a, b, c) \
+  _mm256_or_si256(_mm256_and_si256((a), (b)), \
+    _mm256_and_si256((c), _mm256_or_si256((a), (b))))
+
+/* Eight words from each of the eight lanes is an 8x8 transpose: unpacking
+ * 32 then 64 bits leaves every lane's four words in one 128-bit half, and
+ * the halves are then paired up across registers. */
+static void _sha_mb_transpose(__m256i* w, const uint8_t** data, int off)
+{
+    const __m256i bswap = _mm256_set_epi64x(0x0c0d0e0f08090a0bLL,
+      0x0405060700010203LL, 0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+    __m256i r[8], t[8], u[8];
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        r[i] = _mm256_loadu_si256((const __m256i*)(data[i] + off));
+    }
+    for (i = 0; i < 8; i += 2) {
+        t[i] = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+        t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+    }
+    for (i = 0; i < 8; i += 4) {
+        u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+        u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+        u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+        u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+    }
+    for (i = 0; i < 4; i++) {
+        w[i] = _mm256_shuffle_epi8(
+          _mm256_permute2x128_si256(u[i], u[i + 4], 0x20), bswap);
+        w[i + 4] = _mm256_shuffle_epi8(
+          _mm256_permute2x128_si256(u[i], u[i + 4], 0x31), bswap);
+    }
+}
+
+static void _sha_mb_load(__m256i* w, const uint8_t** data)
+{
+    _sha_mb_transpose(w, data, 0);
+    _sha_mb_transpose(w + 8, data, 32);
+}
+
+#include "sha256_mb_tmpl.c"
@@ -0,0 +1,64 @@
+#include <immintrin.h>
+
+#include "sha256_impl.h"
+
+/* sha256_multi on sixteen lanes of AVX-512 registers, with its rotates and
+ * three-input logic.  See sha256_mb_tmpl.c. */
+
+#define SHA_MB_VEC		__m512i
+#define SHA_MB_LANES		16
+#define SHA_MB_IMPL		_sha256_avx512_impl
+#define SHA_MB_NAME		"avx512"
+
+#define SHA_MB_LOAD(p)		_mm512_loadu_si512((const void*)(p))
+#define SHA_MB_STORE(p, x)	_mm512_storeu_si512((void*)(p), (x))
+#define SHA_MB_ADD		_mm512_add_epi32
+#define SHA_MB_XOR		_mm512_xor_si512
+#define SHA_MB_BCAST(x)		_mm512_set1_epi32((int)(x))
+#define SHA_MB_SHR		_mm512_srli_epi32
+#define SHA_MB_ROR		_mm512_ror_epi32
+#define SHA_MB_XOR3(x, y, z)	_mm512_ternarylogic_epi32((x), (y), (z), 0x96)
+#define SHA_MB_CH(e, f, g)	_mm512_ternarylogic_epi32((e), (f), (g), 0xca)
+#define SHA_MB_MAJ(a, b, c)	_mm512_ternarylogic_epi32((a), (b), (c), 0xe8)
+
+/* A 16x16 transpose: unpacking 32 then 64 bits leaves every lane's four
+ * words in one 128-bit quarter, which two rounds of shuffle_i32x4 then
+ * gather into place. */
+static void _sha_mb_load(__m512i* w, const uint8_t** data)
+{
+    const __m512i bswap = _mm512_set4_epi32(0x0c0d0e0f, 0x08090a0b,
+      0x04050607, 0x00010203);
+    __m512i r[16], t[16], u[16];
+    __m512i a, b, c, d;
+    int i, j;
+
+    for (i = 0; i < 16; i++) {
+        r[i] = _mm512_loadu_si512((const void*)data[i]);
+    }
+    for (i = 0; i < 16; i += 2) {
+        t[i] = _mm512_unpacklo_epi32(r[i], r[i + 1]);
+        t[i + 1] = _mm512_unpackhi_epi32(r[i], r[i + 1]);
+    }
+    /* u[4 * g + j] is word j of lanes 4g..4g+3, for every quarter */
+    for (i = 0; i < 16; i += 4) {
+        u[i] = _mm512_unpacklo_epi64(t[i], t[i + 2]);
+        u[i + 1] = _mm512_unpackhi_epi64(t[i], t[i + 2]);
+        u[i + 2] = _mm512_unpacklo_epi64(t[i + 1], t[i + 3]);
+        u[i + 3] = _mm512_unpackhi_epi64(t[i + 1], t[i + 3]);
+    }
+    for (j = 0; j < 4; j++) {
+        a = _mm512_shuffle_i32x4(u[j], u[4 + j], 0x44);
+        b = _mm512_shuffle_i32x4(u[j], u[4 + j], 0xee);
+        c = _mm512_shuffle_i32x4(u[8 + j], u[12 + j], 0x44);
+        d = _mm512_shuffle_i32x4(u[8 + j], u[12 + j], 0xee);
+        w[j] = _mm512_shuffle_epi8(_mm512_shuffle_i32x4(a, c, 0x88), bswap);
+        w[4 + j] = _mm512_shuffle_epi8(_mm512_shuffle_i32x4(a, c, 0xdd),
+          bswap);
+        w[8 + j] = _mm512_shuffle_epi8(_mm512_shuffle_i32x4(b, d, 0x88),
+          bswap);
+        w[12 + j] = _mm512_shuffle_epi8(_mm512_shuffle_i32x4(b, d, 0xdd),
+          bswap);
+    }
+}
+
+#include "sha256_mb_tmpl.c"
@@ -0,0 +1,51 @@
+#ifndef ECRYPT_SHA256_IMPL_H
+#define ECRYPT_SHA256_IMPL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Private to the library.  A SHA-256 compression function: runs blocks
+ * 64 byte blocks of data through state, the eight working words in their
+ * usual order.  sha256.c runs every hash through the one
+ * sha256_select_impl picked, the fastest the processor supports unless
+ * told otherwise. */
+struct sha256_impl_t {
+    const char* name;
+    void (*blocks)(uint32_t* state, const uint8_t* data, size_t blocks);
+};
+
+/* the round constants; sha256.c */
+extern const uint32_t sha256_k[64];
+
+/* portable code; sha256.c */
+extern const struct sha256_impl_t _sha256_scalar_impl;
+
+#if defined(ECRYPT_HAVE_SHANI)
+/* the SHA extensions, two rounds per sha256rnds2; sha256_shani.c */
+extern const struct sha256_impl_t _sha256_shani_impl;
+#endif
+
+/* The most lanes any sha256_multi kernel has. */
+#define SHA256_MAX_LANES	(16)
+
+/* A multi-buffer compression function: runs blocks 64 byte blocks through
+ * each of lanes independent hashes.  state holds word i of every lane's
+ * state at state[i * lanes + lane]; data[lane] is that lane's next block,
+ * and is left just past the last one. */
+struct sha256_multi_impl_t {
+    const char* name;
+    int lanes;
+    void (*blocks)(uint32_t* state, const uint8_t** data, size_t blocks);
+};
+
+#if defined(ECRYPT_HAVE_AVX2)
+/* eight lanes in AVX2 registers; sha256_avx2.c */
+extern const struct sha256_multi_impl_t _sha256_avx2_impl;
+#endif
+
+#if defined(ECRYPT_HAVE_AVX512)
+/* sixteen lanes in AVX-512 registers; sha256_avx512.c */
+extern const struct sha256_multi_impl_t _sha256_avx512_impl;
+#endif
+
+#endif /* ECRYPT_SHA256_IMPL_H */
@@ -0,0 +1,102 @@
+/* SHA-256 on SHA_MB_LANES independent messages at once, one per 32-bit
+ * lane, written once for any vector width.  Included by sha256_avx2.c and
+ * sha256_avx512.c, which define the SHA_MB_* macros below and are each
+ * compiled with just the instruction sets their width needs.
+ *
+ *     SHA_MB_VEC		the vector type
+ *     SHA_MB_LANES		32-bit lanes per vector
+ *     SHA_MB_IMPL, SHA_MB_NAME	the sha256_multi_impl_t this file defines,
+ *				and its name
+ *     SHA_MB_LOAD/STORE/ADD/XOR	the obvious
+ *     SHA_MB_BCAST(x)		x in every lane
+ *     SHA_MB_ROR(x, n)		every lane rotated right by n
+ *     SHA_MB_SHR(x, n)		every lane shifted right by n
+ *     SHA_MB_XOR3(x, y, z)	x ^ y ^ z
+ *     SHA_MB_CH, SHA_MB_MAJ	the SHA-256 Ch and Maj functions
+ *     _sha_mb_load(w, data)	the sixteen message words of the block at
+ *				each data[lane], byte swapped, word t of
+ *				every lane in w[t]
+ *
+ * Lanes have nothing to do with each other, so the rounds are the plain
+ * ones from the standard on vectors.  The eight working variables are
+ * renamed from round to round rather than moved, and the message schedule
+ * is kept as a ring of sixteen words. */
+
+#define SHA_MB_S0(x) \
+  SHA_MB_XOR3(SHA_MB_ROR(x, 2), SHA_MB_ROR(x, 13), SHA_MB_ROR(x, 22))
+#define SHA_MB_S1(x) \
+  SHA_MB_XOR3(SHA_MB_ROR(x, 6), SHA_MB_ROR(x, 11), SHA_MB_ROR(x, 25))
+#define SHA_MB_SIG0(x) \
+  SHA_MB_XOR3(SHA_MB_ROR(x, 7), SHA_MB_ROR(x, 18), SHA_MB_SHR(x, 3))
+#define SHA_MB_SIG1(x) \
+  SHA_MB_XOR3(SHA_MB_ROR(x, 17), SHA_MB_ROR(x, 19), SHA_MB_SHR(x, 10))
+
+/* round t + j; from the second group of sixteen on, w[j] is first replaced
+ * by the next word of the schedule */
+#define SHA_MB_ROUND(a, b, c, d, e, f, g, h, j) do { \
+    if (t > 0) { \
+        w[j] = SHA_MB_ADD(SHA_MB_ADD(w[j], w[((j) + 9) & 15]), \
+          SHA_MB_ADD(SHA_MB_SIG0(w[((j) + 1) & 15]), \
+          SHA_MB_SIG1(w[((j) + 14) & 15]))); \
+    } \
+    t1 = SHA_MB_ADD(SHA_MB_ADD(h, SHA_MB_S1(e)), \
+      SHA_MB_ADD(SHA_MB_CH(e, f, g), \
+      SHA_MB_ADD(SHA_MB_BCAST(sha256_k[t + (j)]), w[j]))); \
+    t2 = SHA_MB_ADD(SHA_MB_S0(a), SHA_MB_MAJ(a, b, c)); \
+    d = SHA_MB_ADD(d, t1); \
+    h = SHA_MB_ADD(t1, t2); \
+} while (0)
+
+/* eight rounds, after which every variable is back under its own name */
+#define SHA_MB_ROUND8(j) do { \
+    SHA_MB_ROUND(a, b, c, d, e, f, g, h, (j)); \
+    SHA_MB_ROUND(h, a, b, c, d, e, f, g, (j) + 1); \
+    SHA_MB_ROUND(g, h, a, b, c, d, e, f, (j) + 2); \
+    SHA_MB_ROUND(f, g, h, a, b, c, d, e, (j) + 3); \
+    SHA_MB_ROUND(e, f, g, h, a, b, c, d, (j) + 4); \
+    SHA_MB_ROUND(d, e, f, g, h, a, b, c, (j) + 5); \
+    SHA_MB_ROUND(c, d, e, f, g, h, a, b, (j) + 6); \
+    SHA_MB_ROUND(b, c, d, e, f, g, h, a, (j) + 7); \
+} while (0)
+
+static void _sha_mb_blocks(uint32_t* state, const uint8_t** data,
+  size_t blocks)
+{
+    SHA_MB_VEC s[8], w[16];
+    SHA_MB_VEC a, b, c, d, e, f, g, h, t1, t2;
+    int i, t;
+
+    for (i = 0; i < 8; i++) {
+        s[i] = SHA_MB_LOAD(&state[i * SHA_MB_LANES]);
+    }
+
+    while (blocks-- > 0) {
+        _sha_mb_load(w, data);
+        for (i = 0; i < SHA_MB_LANES; i++) {
+            data[i] += 64;
+        }
+
+        a = s[0]; b = s[1]; c = s[2]; d = s[3];
+        e = s[4]; f = s[5]; g = s[6]; h = s[7];
+
+        for (t = 0; t < 64; t += 16) {
+            SHA_MB_ROUND8(0);
+            SHA_MB_ROUND8(8);
+        }
+
+        s[0] = SHA_MB_ADD(s[0], a); s[1] = SHA_MB_ADD(s[1], b);
+        s[2] = SHA_MB_ADD(s[2], c); s[3] = SHA_MB_ADD(s[3], d);
+        s[4] = SHA_MB_ADD(s[4], e); s[5] = SHA_MB_ADD(s[5], f);
+        s[6] = SHA_MB_ADD(s[6], g); s[7] = SHA_MB_ADD(s[7], h);
+    }
+
+    for (i = 0; i < 8; i++) {
+        SHA_MB_STORE(&state[i * SHA_MB_LANES], s[i]);
+    }
+}
+
+const struct sha256_multi_impl_t SHA_MB_IMPL = {
+    SHA_MB_NAME,
+    SHA_MB_LANES,
+    _sha_mb_blocks
+};
@@ -0,0 +1,84 @@
+#include <immintrin.h>
+
+#include "sha256_impl.h"
+
+/* The SHA extensions keep the state as two registers, ABEF and CDGH, and
+ * do two rounds per sha256rnds2; the message schedule is sha256msg1 and
+ * sha256msg2 with an alignr for the w[t-7] term.  The state is rearranged
+ * once per call, not once per block. */
+
+/* four rounds on message words w, k being the group's index */
+#define SHA256_SHANI_ROUNDS(k, w) do { \
+    msg = _mm_add_epi32((w), \
+      _mm_loadu_si128((const __m128i*)&sha256_k[4 * (k)])); \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg); \
+    msg = _mm_shuffle_epi32(msg, 0x0e); \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg); \
+} while (0)
+
+/* the next four message words in place of w0, from the last sixteen
+ * held in w0 (oldest) to w3 */
+#define SHA256_SHANI_SCHEDULE(w0, w1, w2, w3) \
+  (w0) = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32((w0), (w1)), \
+    _mm_alignr_epi8((w3), (w2), 4)), (w3))
+
+static void _sha256_shani_blocks(uint32_t* state, const uint8_t* data,
+  size_t blocks)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bLL,
+      0x0405060700010203LL);
+    __m128i state0, state1, abef, cdgh, msg, tmp;
+    __m128i m0, m1, m2, m3;
+    int i;
+
+    /* DCBA and HGFE as loaded to ABEF and CDGH */
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xb1);
+    state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]),
+      0x1b);
+    state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+    while (blocks-- > 0) {
+        abef = state0;
+        cdgh = state1;
+
+        m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), bswap);
+        m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16)),
+          bswap);
+        m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 32)),
+          bswap);
+        m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 48)),
+          bswap);
+
+        SHA256_SHANI_ROUNDS(0, m0);
+        SHA256_SHANI_ROUNDS(1, m1);
+        SHA256_SHANI_ROUNDS(2, m2);
+        SHA256_SHANI_ROUNDS(3, m3);
+
+        for (i = 4; i < 16; i += 4) {
+            SHA256_SHANI_SCHEDULE(m0, m1, m2, m3);
+            SHA256_SHANI_ROUNDS(i, m0);
+            SHA256_SHANI_SCHEDULE(m1, m2, m3, m0);
+            SHA256_SHANI_ROUNDS(i + 1, m1);
+            SHA256_SHANI_SCHEDULE(m2, m3, m0, m1);
+            SHA256_SHANI_ROUNDS(i + 2, m2);
+            SHA256_SHANI_SCHEDULE(m3, m0, m1, m2);
+            SHA256_SHANI_ROUNDS(i + 3, m3);
+        }
+
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+        data += 64;
+    }
+
+    /* and back to DCBA and HGFE */
+    tmp = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    _mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(tmp, state1, 0xf0));
+    _mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(state1, tmp, 8));
+}
+
+const struct sha256_impl_t _sha256_shani_impl = {
+    "shani",
+    _sha256_shani_blocks
+};
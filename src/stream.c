@@ -0,0 +1,294 @@
+#include <string.h>
+
+#include <ecrypt/global.h>
+#include "stream.h"
+
+/*
+* CTR: pos is the number of keystream bytes left unused at the end of buf.
+* The next block of keystream is only generated once a byte of it is
+* needed, so the counter always says how much keystream has been made.
+*/
+static void
+_ecrypt_stream_ctr(const struct _ecrypt_stream_ops_t *ops, const void *key,
+    struct _ecrypt_stream_state_t *st, const uint8_t *in, size_t len,
+    uint8_t *out)
+{
+    const unsigned int bs = ops->block;
+    size_t n, i, blocks;
+
+    n = *st->pos < len ? *st->pos : len;
+    for (i = 0; i < n; i++) {
+        out[i] = in[i] ^ st->buf[bs - *st->pos + i];
+    }
+    *st->pos -= (unsigned int)n;
+    in += n;
+    out += n;
+    len -= n;
+
+    blocks = len / bs;
+    ops->ctr(key, st->iv, in, out, blocks);
+    in += blocks * bs;
+    out += blocks * bs;
+    len -= blocks * bs;
+
+    if (len > 0) {
+        memset(st->buf, 0, bs);
+        ops->ctr(key, st->iv, st->buf, st->buf, 1);
+        for (i = 0; i < len; i++) {
+            out[i] = in[i] ^ st->buf[i];
+        }
+        *st->pos = bs - (unsigned int)len;
+    }
+}
+
+/*
+* CBC: pos is the number of input bytes held in buf.  Decryption with
+* padding always holds back the last whole block it has seen, since that
+* block may turn out to be the padding; everything else holds back only a
+* partial block.
+*/
+int
+_ecrypt_stream_update(const struct _ecrypt_stream_ops_t *ops,
+    const void *key, struct _ecrypt_stream_state_t *st, const uint8_t *in,
+    size_t len, uint8_t *out, size_t *out_len)
+{
+    const unsigned int bs = ops->block;
+    void (*cbc)(const void *, uint8_t *, const uint8_t *, uint8_t *,
+        size_t);
+    size_t n, blocks, done = 0;
+    int hold;
+
+    *out_len = 0;
+    if (len == 0) {
+        return ECRYPT_NO_ERROR;
+    }
+
+    if (st->mode == ECRYPT_STREAM_CTR) {
+        _ecrypt_stream_ctr(ops, key, st, in, len, out);
+        *out_len = len;
+        return ECRYPT_NO_ERROR;
+    }
+
+    cbc = st->mode == ECRYPT_STREAM_CBC_ENCRYPT ? ops->cbc_enc : ops->cbc_dec;
+    hold = st->mode == ECRYPT_STREAM_CBC_DECRYPT && st->pad;
+
+    /* top up a held block; it goes out once there is more input after it */
+    if (*st->pos > 0) {
+        n = bs - *st->pos < len ? bs - *st->pos : len;
+        memcpy(st->buf + *st->pos, in, n);
+        *st->pos += (unsigned int)n;
+        in += n;
+        len -= n;
+
+        if (*st->pos < bs || (hold && len == 0)) {
+            return ECRYPT_NO_ERROR;
+        }
+        cbc(key, st->iv, st->buf, out, 1);
+        *st->pos = 0;
+        done = bs;
+    }
+
+    blocks = len / bs;
+    if (hold && blocks > 0 && len % bs == 0) {
+        blocks--;
+    }
+    cbc(key, st->iv, in, out + done, blocks);
+    done += blocks * bs;
+    in += blocks * bs;
+    len -= blocks * bs;
+
+    memcpy(st->buf, in, len);
+    *st->pos = (unsigned int)len;
+    *out_len = done;
+
+    return ECRYPT_NO_ERROR;
+}
+
+int
+_ecrypt_stream_final(const struct _ecrypt_stream_ops_t *ops,
+    const void *key, struct _ecrypt_stream_state_t *st, uint8_t *out,
+    size_t *out_len)
+{
+    const unsigned int bs = ops->block;
+    uint8_t block[16];
+    unsigned int i, v, bad;
+
+    *out_len = 0;
+    if (st->mode == ECRYPT_STREAM_CTR) {
+        return ECRYPT_NO_ERROR;
+    }
+
+    if (!st->pad) {
+        return *st->pos == 0 ? ECRYPT_NO_ERROR : ECRYPT_INVALID_LENGTH;
+    }
+
+    if (st->mode == ECRYPT_STREAM_CBC_ENCRYPT) {
+        /* PKCS #7: 1 to bs bytes, each holding the count */
+        v = bs - *st->pos;
+        memset(st->buf + *st->pos, (int)v, v);
+        ops->cbc_enc(key, st->iv, st->buf, out, 1);
+        *out_len = bs;
+        return ECRYPT_NO_ERROR;
+    }
+
+    if (*st->pos != bs) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    /*
+    * Every byte of the block is looked at whatever the padding turns out
+    * to be, so the time taken says nothing about where it went wrong.
+    */
+    ops->cbc_dec(key, st->iv, st->buf, block, 1);
+    v = block[bs - 1];
+    bad = (unsigned int)((v - 1) >> 8) | (unsigned int)((bs - v) >> 8);
+    for (i = 0; i < bs; i++) {
+        /* bytes at or past bs - v must equal v */
+        bad |= (((bs - v - 1 - i) >> 8) & 1) * (block[i] ^ v);
+    }
+
+    if (bad != 0) {
+        memset(block, 0, sizeof(block));
+        return ECRYPT_INVALID_PADDING;
+    }
+
+    memcpy(out, block, bs - v);
+    *out_len = bs - v;
+    memset(block, 0, sizeof(block));
+
+    return ECRYPT_NO_ERROR;
+}
+
+/* a position in a list of segments */
+struct _ecrypt_iov_cursor_t {
+    const struct iovec *v;
+    int cnt;
+    int i;			/* current segment */
+    size_t off;			/* bytes of it already used */
+};
+
+/* bytes left in the current segment, moving past any that are used up */
+static size_t
+_ecrypt_iov_avail(struct _ecrypt_iov_cursor_t *c)
+{
+    while (c->i < c->cnt && c->off == c->v[c->i].iov_len) {
+        c->i++;
+        c->off = 0;
+    }
+
+    return c->i < c->cnt ? c->v[c->i].iov_len - c->off : 0;
+}
+
+static uint8_t *
+_ecrypt_iov_ptr(const struct _ecrypt_iov_cursor_t *c)
+{
+    return (uint8_t *)c->v[c->i].iov_base + c->off;
+}
+
+/* len bytes between buf and the segments, to_buf saying which way */
+static void
+_ecrypt_iov_copy(struct _ecrypt_iov_cursor_t *c, uint8_t *buf, size_t len,
+    int to_buf)
+{
+    size_t n;
+
+    while (len > 0) {
+        n = _ecrypt_iov_avail(c);
+        n = n < len ? n : len;
+        if (to_buf) {
+            memcpy(buf, _ecrypt_iov_ptr(c), n);
+        } else {
+            memcpy(_ecrypt_iov_ptr(c), buf, n);
+        }
+        c->off += n;
+        buf += n;
+        len -= n;
+    }
+}
+
+/* total length of a segment list, or (size_t)-1 if a segment is NULL */
+static size_t
+_ecrypt_iov_total(const struct iovec *v, int cnt)
+{
+    size_t total = 0;
+    int i;
+
+    for (i = 0; i < cnt; i++) {
+        if (v[i].iov_base == NULL && v[i].iov_len != 0) {
+            return (size_t)-1;
+        }
+        total += v[i].iov_len;
+    }
+
+    return total;
+}
+
+int
+_ecrypt_stream_iov(const struct _ecrypt_stream_ops_t *ops,
+    const void *key, int mode, uint8_t *iv, const struct iovec *in,
+    int in_cnt, const struct iovec *out, int out_cnt)
+{
+    const unsigned int bs = ops->block;
+    void (*fn)(const void *, uint8_t *, const uint8_t *, uint8_t *, size_t);
+    struct _ecrypt_iov_cursor_t ic, oc;
+    uint8_t block[16];
+    size_t total, n, a, b, blocks;
+
+    if ((in == NULL && in_cnt != 0) || (out == NULL && out_cnt != 0)) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (in_cnt < 0 || out_cnt < 0) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    total = _ecrypt_iov_total(in, in_cnt);
+    n = _ecrypt_iov_total(out, out_cnt);
+    if (total == (size_t)-1 || n == (size_t)-1) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (total != n || (mode != ECRYPT_STREAM_CTR && total % bs != 0)) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    if (mode == ECRYPT_STREAM_CBC_ENCRYPT) {
+        fn = ops->cbc_enc;
+    } else if (mode == ECRYPT_STREAM_CBC_DECRYPT) {
+        fn = ops->cbc_dec;
+    } else {
+        fn = ops->ctr;
+    }
+
+    ic.v = in;
+    ic.cnt = in_cnt;
+    oc.v = out;
+    oc.cnt = out_cnt;
+    ic.i = oc.i = 0;
+    ic.off = oc.off = 0;
+
+    while (total > 0) {
+        a = _ecrypt_iov_avail(&ic);
+        b = _ecrypt_iov_avail(&oc);
+        blocks = (a < b ? a : b) / bs;
+
+        if (blocks > 0) {
+            fn(key, iv, _ecrypt_iov_ptr(&ic), _ecrypt_iov_ptr(&oc), blocks);
+            ic.off += blocks * bs;
+            oc.off += blocks * bs;
+            total -= blocks * bs;
+            continue;
+        }
+
+        /* a block split across segments, or the end of a CTR message */
+        n = total < bs ? total : bs;
+        memset(block, 0, sizeof(block));
+        _ecrypt_iov_copy(&ic, block, n, 1);
+        fn(key, iv, block, block, 1);
+        _ecrypt_iov_copy(&oc, block, n, 0);
+        total -= n;
+    }
+
+    memset(block, 0, sizeof(block));
+    return ECRYPT_NO_ERROR;
+}
@@ -0,0 +1,73 @@
+#ifndef ECRYPT_STREAM_H
+#define ECRYPT_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+/*
+* The buffering and padding behind rijndael_stream_t and blowfish_stream_t,
+* shared by both ciphers.  Each cipher describes itself with one of these;
+* key is its context, passed through untouched.  All three functions work
+* on whole blocks, may be called with in == out, and leave iv at the
+* chaining value (CBC) or next counter block (CTR) for the next call.
+*/
+struct _ecrypt_stream_ops_t {
+    unsigned int block;		/* block size in bytes, at most 16 */
+    void (*cbc_enc)(const void *key, uint8_t *iv, const uint8_t *in,
+        uint8_t *out, size_t blocks);
+    void (*cbc_dec)(const void *key, uint8_t *iv, const uint8_t *in,
+        uint8_t *out, size_t blocks);
+    void (*ctr)(const void *key, uint8_t *ctr, const uint8_t *in,
+        uint8_t *out, size_t blocks);
+};
+
+/* what a stream does, the same values as RIJNDAEL_STREAM_* and
+ * BLOWFISH_STREAM_* */
+#define ECRYPT_STREAM_CBC_ENCRYPT	(1)
+#define ECRYPT_STREAM_CBC_DECRYPT	(2)
+#define ECRYPT_STREAM_CTR		(3)
+
+/* the state the public stream structures share, minus the key */
+struct _ecrypt_stream_state_t {
+    int mode;			/* ECRYPT_STREAM_* */
+    int pad;			/* PKCS #7 padding on */
+    unsigned int *pos;		/* see the public structures */
+    uint8_t *iv;
+    uint8_t *buf;
+};
+
+/* _ecrypt_stream_update:
+ *
+ * description:
+ *     The update call of either cipher.  *out_len is set to the number of
+ *     bytes written to out, which is at most len + block - 1 for CBC, and
+ *     exactly len for CTR.
+ *****************************************************************************/
+int _ecrypt_stream_update(const struct _ecrypt_stream_ops_t *ops,
+    const void *key, struct _ecrypt_stream_state_t *st, const uint8_t *in,
+    size_t len, uint8_t *out, size_t *out_len);
+
+/* _ecrypt_stream_final:
+ *
+ * description:
+ *     The final call of either cipher; writes at most one block.
+ *****************************************************************************/
+int _ecrypt_stream_final(const struct _ecrypt_stream_ops_t *ops,
+    const void *key, struct _ecrypt_stream_state_t *st, uint8_t *out,
+    size_t *out_len);
+
+/* _ecrypt_stream_iov:
+ *
+ * description:
+ *     One whole message in mode, read from the in segments and written to
+ *     the out segments, which have to add up to the same length.  Runs of
+ *     whole blocks inside a segment go straight to ops; only a block that
+ *     straddles a segment boundary is copied.  No padding: CBC needs a
+ *     whole number of blocks, CTR takes any length.
+ *****************************************************************************/
+int _ecrypt_stream_iov(const struct _ecrypt_stream_ops_t *ops,
+    const void *key, int mode, uint8_t *iv, const struct iovec *in,
+    int in_cnt, const struct iovec *out, int out_cnt);
+
+#endif /* ECRYPT_STREAM_H */
@@ -0,0 +1,73 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "thread.h"
+
+struct _ecrypt_worker_t {
+    pthread_t thread;
+    int started;
+    int index;
+    int count;
+    void (*job)(void *arg, int index, int count);
+    void *arg;
+};
+
+static void *_ecrypt_worker_main(void *p);
+
+int _ecrypt_default_workers(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return n < 1 ? 1 : (int)n;
+}
+
+void _ecrypt_run_workers(int count, void (*job)(void *arg, int index,
+    int count), void *arg)
+{
+    struct _ecrypt_worker_t *workers;
+    int i;
+
+    if (count <= 1) {
+        job(arg, 0, 1);
+        return;
+    }
+
+    workers = (struct _ecrypt_worker_t *)calloc(count, sizeof(*workers));
+    if (workers == NULL) {
+        for (i = 0; i < count; i++) {
+            job(arg, i, count);
+        }
+        return;
+    }
+
+    /* the caller takes job 0, everything else gets a thread */
+    for (i = 1; i < count; i++) {
+        workers[i].index = i;
+        workers[i].count = count;
+        workers[i].job = job;
+        workers[i].arg = arg;
+        workers[i].started = pthread_create(&workers[i].thread, NULL,
+            _ecrypt_worker_main, &workers[i]) == 0;
+    }
+
+    job(arg, 0, count);
+
+    for (i = 1; i < count; i++) {
+        if (workers[i].started) {
+            pthread_join(workers[i].thread, NULL);
+        } else {
+            job(arg, i, count);
+        }
+    }
+
+    free(workers);
+}
+
+static void *_ecrypt_worker_main(void *p)
+{
+    struct _ecrypt_worker_t *w = (struct _ecrypt_worker_t *)p;
+
+    w->job(w->arg, w->index, w->count);
+    return NULL;
+}
@@ -0,0 +1,23 @@
+#ifndef ECRYPT_THREAD_H
+#define ECRYPT_THREAD_H
+
+/* _ecrypt_default_workers:
+ *
+ * description:
+ *     Number of processors online, used when a caller asks for 0 workers.
+ *****************************************************************************/
+int _ecrypt_default_workers(void);
+
+/* _ecrypt_run_workers:
+ *
+ * description:
+ *     Calls job(arg, i, count) once for every i in [0, count), each on its
+ *     own thread, and returns when all of them have finished.  The calling
+ *     thread runs one of the jobs itself.  If a thread cannot be started,
+ *     its job runs on the calling thread instead, so every job always runs
+ *     exactly once.
+ *****************************************************************************/
+void _ecrypt_run_workers(int count, void (*job)(void *arg, int index,
+    int count), void *arg);
+
+#endif /* ECRYPT_THREAD_H */
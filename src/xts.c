@@ -0,0 +1,209 @@
+#include <string.h>
+
+#include <ecrypt/xts.h>
+#include "rijndael_impl.h"
+
+int
+xts_set_key(xts_ctx *ctx, const uint8_t *key, uint32_t klen)
+{
+    uint32_t half, i;
+    uint8_t diff = 0;
+
+    if (ctx == NULL || key == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (klen != 32 && klen != 64) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    half = klen / 2;
+    for (i = 0; i < half; i++) {
+        diff |= key[i] ^ key[half + i];
+    }
+    if (diff == 0) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    if (rijndael_set_key(&ctx->data, key, (int)half * 8) != 0 ||
+        rijndael_set_key_enc_only(&ctx->tweak, key + half,
+        (int)half * 8) != 0) {
+        memset(ctx, 0, sizeof(*ctx));
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    return ECRYPT_NO_ERROR;
+}
+
+int
+xts_release(xts_ctx *ctx)
+{
+    if (ctx == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    return ECRYPT_NO_ERROR;
+}
+
+/* t *= x in GF(2^128); t is a little-endian number */
+static void
+_xts_double(uint8_t *t)
+{
+    uint8_t carry = 0, next;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        next = t[i] >> 7;
+        t[i] = (uint8_t)((t[i] << 1) | carry);
+        carry = next;
+    }
+    t[0] ^= (uint8_t)(0x87 & (0 - carry));
+}
+
+/*
+* One sector, with its encrypted tweak in T.  A partial last block steals
+* the tail of the ciphertext of the block before it (IEEE 1619, 5.3.2).
+*/
+static void
+_xts_crypt_sector(const rijndael_ctx *data, uint8_t *T, const uint8_t *in,
+    size_t len, uint8_t *out, int decrypt)
+{
+    const struct rijndael_impl_t *impl = data->impl;
+    size_t blocks = len / 16;
+    size_t tail = len % 16;
+    uint8_t a[16], b[16], next[16];
+
+    if (tail == 0) {
+        if (decrypt) {
+            impl->xts_dec(data->dk, data->Nr, T, in, out, blocks);
+        } else {
+            impl->xts_enc(data->ek, data->Nr, T, in, out, blocks);
+        }
+        return;
+    }
+
+    /* everything before the last full block goes the usual way */
+    blocks--;
+    if (decrypt) {
+        impl->xts_dec(data->dk, data->Nr, T, in, out, blocks);
+    } else {
+        impl->xts_enc(data->ek, data->Nr, T, in, out, blocks);
+    }
+    in += 16 * blocks;
+    out += 16 * blocks;
+
+    /* both input blocks are read before either output block is written */
+    if (decrypt) {
+        /* the last full block was encrypted under the tweak after it */
+        memcpy(next, T, 16);
+        _xts_double(next);
+        impl->xts_dec(data->dk, data->Nr, next, in, a, 1);
+        memcpy(b, in + 16, tail);
+        memcpy(b + tail, a + tail, 16 - tail);
+        memcpy(out + 16, a, tail);
+        impl->xts_dec(data->dk, data->Nr, T, b, out, 1);
+    } else {
+        impl->xts_enc(data->ek, data->Nr, T, in, a, 1);
+        memcpy(b, in + 16, tail);
+        memcpy(b + tail, a + tail, 16 - tail);
+        memcpy(out + 16, a, tail);
+        impl->xts_enc(data->ek, data->Nr, T, b, out, 1);
+    }
+
+    memset(a, 0, sizeof(a));
+    memset(b, 0, sizeof(b));
+    memset(next, 0, sizeof(next));
+}
+
+/*
+* The tweaks of up to RIJNDAEL_LANES sectors are encrypted in one
+* encrypt_multi call, which keeps that many blocks in flight, before the
+* sectors themselves are processed.
+*/
+static int
+_xts_crypt(xts_ctx *ctx, uint64_t sector, size_t sector_len,
+    const uint8_t *in, size_t len, uint8_t *out, int decrypt)
+{
+    const uint32_t *rk[RIJNDAEL_LANES];
+    const uint8_t *tin[RIJNDAEL_LANES];
+    uint8_t *tout[RIJNDAEL_LANES];
+    uint8_t T[RIJNDAEL_LANES][16];
+    uint64_t hi = 0;
+    size_t sectors, n, i;
+    int j;
+
+    if (ctx == NULL || in == NULL || out == NULL) {
+        return ECRYPT_NULL_PTR;
+    }
+
+    if (ctx->data.impl == NULL || ctx->tweak.impl == NULL) {
+        return ECRYPT_INVALID_PARAMETERS;
+    }
+
+    if (sector_len < XTS_BLOCK_LENGTH || sector_len > XTS_MAX_SECTOR_LENGTH ||
+        len % sector_len != 0) {
+        return ECRYPT_INVALID_LENGTH;
+    }
+
+    for (i = 0; i < RIJNDAEL_LANES; i++) {
+        rk[i] = ctx->tweak.ek;
+        tin[i] = T[i];
+        tout[i] = T[i];
+    }
+
+    for (sectors = len / sector_len; sectors > 0; sectors -= n) {
+        n = sectors < RIJNDAEL_LANES ? sectors : RIJNDAEL_LANES;
+
+        /* sector numbers count on into the upper half of the tweak */
+        for (i = 0; i < n; i++) {
+            for (j = 0; j < 8; j++) {
+                T[i][j] = (uint8_t)(sector >> (8 * j));
+                T[i][8 + j] = (uint8_t)(hi >> (8 * j));
+            }
+            if (++sector == 0) {
+                hi++;
+            }
+        }
+        ctx->tweak.impl->encrypt_multi(rk, ctx->tweak.Nr, tin, tout, n);
+
+        for (i = 0; i < n; i++) {
+            _xts_crypt_sector(&ctx->data, T[i], in, sector_len, out,
+                decrypt);
+            in += sector_len;
+            out += sector_len;
+        }
+    }
+
+    memset(T, 0, sizeof(T));
+    return ECRYPT_NO_ERROR;
+}
+
+int
+xts_encrypt_sectors(xts_ctx *ctx, uint64_t sector, size_t sector_len,
+    const uint8_t *pt, size_t pt_len, uint8_t *out)
+{
+    return _xts_crypt(ctx, sector, sector_len, pt, pt_len, out, 0);
+}
+
+int
+xts_decrypt_sectors(xts_ctx *ctx, uint64_t sector, size_t sector_len,
+    const uint8_t *ct, size_t ct_len, uint8_t *out)
+{
+    return _xts_crypt(ctx, sector, sector_len, ct, ct_len, out, 1);
+}
+
+int
+xts_encrypt_sector(xts_ctx *ctx, uint64_t sector, const uint8_t *pt,
+    size_t pt_len, uint8_t *out)
+{
+    return _xts_crypt(ctx, sector, pt_len, pt, pt_len, out, 0);
+}
+
+int
+xts_decrypt_sector(xts_ctx *ctx, uint64_t sector, const uint8_t *ct,
+    size_t ct_len, uint8_t *out)
+{
+    return _xts_crypt(ctx, sector, ct_len, ct, ct_len, out, 1);
+}
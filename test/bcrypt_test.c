@@ -0,0 +1,167 @@
+/* Known answer tests for bcrypt, checked against the Python bcrypt module
+ * (OpenBSD's code), and checks that bcrypt_verify_batch gives every job
+ * the result bcrypt_verify would, whatever its neighbours, with one worker
+ * and with several. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ecrypt/bcrypt.h>
+
+#include "test_util.h"
+
+struct vector_t {
+    const char* pass;
+    const char* hash;
+};
+
+const struct vector_t vectors[] = {
+    { "password",
+      "$2b$04$abcdefghijklmnopqrstuughE8Ev8uGFaUgY2cNEySvxngrb/Jzdm" },
+    { "",
+      "$2b$05$CCCCCCCCCCCCCCCCCCCCC.7uG0VCzI2bS7j6ymqJi9CdcdxiRTWNy" },
+    { "U*U",
+      "$2a$05$CCCCCCCCCCCCCCCCCCCCC.E5YPO9kmyuRGyh0XouQYb4YMJKvyOeW" },
+    { "secret",
+      "$2b$05$abcdefghijklmnopqrstuuOQiyCxlgf/oeuTqixKmWdcYUh4Hjl0a" }
+};
+
+/* bytes 0x20 to 0x67 hash to this; anything after them is ignored */
+const char* long_hash =
+    "$2b$04$......................rOXzJkVAr7sHupJh8fzzfbzErnxLsF.";
+
+/* the salt of vectors[0], "abcdefghijklmnopqrstuu", decoded */
+const uint8_t salt0[BCRYPT_SALT_LENGTH] = {
+    0x71, 0xd7, 0x9f, 0x82, 0x18, 0xa3, 0x92, 0x59,
+    0xa7, 0xa2, 0x9a, 0xab, 0xb2, 0xdb, 0xaf, 0xc3
+};
+
+const char* malformed[] = {
+    "",
+    "$2b$04$abcdefghijklmnopqrstuughE8Ev8uGFaUgY2cNEySvxngrb/Jzd",
+    "$2x$04$abcdefghijklmnopqrstuughE8Ev8uGFaUgY2cNEySvxngrb/Jzdm",
+    "$2b$03$abcdefghijklmnopqrstuughE8Ev8uGFaUgY2cNEySvxngrb/Jzdm",
+    "$2b$4a$abcdefghijklmnopqrstuughE8Ev8uGFaUgY2cNEySvxngrb/Jzdm",
+    "$2b$04$abcdefghijklmnopqrst!ughE8Ev8uGFaUgY2cNEySvxngrb/Jzdm"
+};
+
+int test_vectors(void);
+int test_hash(void);
+int test_batch(int workers);
+
+int main(int argc, char* argv[])
+{
+    int failed = 0;
+
+    fprintf(stdout, "********bcrypt********\n");
+    failed |= test_vectors();
+    failed |= test_hash();
+    failed |= test_batch(1);
+    failed |= test_batch(3);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int test_vectors(void)
+{
+    uint8_t pass[80];
+    int failed = 0, bad = 0;
+    size_t i;
+
+    for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        bad |= bcrypt_verify((const uint8_t*)vectors[i].pass,
+            strlen(vectors[i].pass), vectors[i].hash) != ECRYPT_NO_ERROR;
+        bad |= bcrypt_verify((const uint8_t*)"passwore", 8,
+            vectors[i].hash) != ECRYPT_AUTH_FAILED;
+    }
+    fprintf(stdout, "%-24s %s\n", "verify", bad ? "FAILED" : "ok");
+    failed |= bad;
+
+    for (i = 0; i < sizeof(pass); i++) {
+        pass[i] = (uint8_t)(0x20 + i);
+    }
+    bad = bcrypt_verify(pass, 72, long_hash) != ECRYPT_NO_ERROR;
+    bad |= bcrypt_verify(pass, 80, long_hash) != ECRYPT_NO_ERROR;
+    bad |= bcrypt_verify(pass, 71, long_hash) != ECRYPT_AUTH_FAILED;
+    fprintf(stdout, "%-24s %s\n", "72 byte limit", bad ? "FAILED" : "ok");
+    failed |= bad;
+
+    bad = 0;
+    for (i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+        bad |= bcrypt_verify((const uint8_t*)"password", 8, malformed[i]) !=
+            ECRYPT_INVALID_PARAMETERS;
+    }
+    fprintf(stdout, "%-24s %s\n", "malformed hashes", bad ? "FAILED" : "ok");
+    failed |= bad;
+
+    return failed;
+}
+
+int test_hash(void)
+{
+    char out[BCRYPT_HASH_LENGTH + 1], again[BCRYPT_HASH_LENGTH + 1];
+    int failed = 0, bad;
+
+    /* a failed call leaves the zeroed output behind */
+    memset(out, 0, sizeof(out));
+    bcrypt_hash((const uint8_t*)"password", 8, salt0, 4, out);
+    failed |= check("hash", (const uint8_t*)out,
+        (const uint8_t*)vectors[0].hash, BCRYPT_HASH_LENGTH);
+
+    bad = bcrypt_hash((const uint8_t*)"password", 8, NULL, 4, out) !=
+        ECRYPT_NO_ERROR;
+    bad |= bcrypt_hash((const uint8_t*)"password", 8, NULL, 4, again) !=
+        ECRYPT_NO_ERROR;
+    bad |= strcmp(out, again) == 0;
+    bad |= bcrypt_verify((const uint8_t*)"password", 8, out) !=
+        ECRYPT_NO_ERROR;
+    fprintf(stdout, "%-24s %s\n", "random salt", bad ? "FAILED" : "ok");
+    failed |= bad;
+
+    bad = bcrypt_hash((const uint8_t*)"x", 1, salt0, 3, out) !=
+        ECRYPT_INVALID_PARAMETERS;
+    fprintf(stdout, "%-24s %s\n", "cost limits", bad ? "FAILED" : "ok");
+    failed |= bad;
+
+    return failed;
+}
+
+/* Every vector twice, once with its password and once with a wrong one,
+ * with a malformed hash in the middle and the costs mixed so that groups
+ * of every size up to four get run. */
+int test_batch(int workers)
+{
+    const char* what = workers == 1 ? "batch, 1 worker" : "batch, 3 workers";
+    struct bcrypt_batch_t jobs[20];
+    size_t i, n = 0, nv = sizeof(vectors) / sizeof(vectors[0]);
+    int bad = 0;
+
+    for (i = 0; i < 2 * nv; i++) {
+        jobs[n].pass = (const uint8_t*)(i % 3 == 1 ? "wrong" :
+            vectors[i % nv].pass);
+        jobs[n].pass_len = strlen((const char*)jobs[n].pass);
+        jobs[n].hash = vectors[i % nv].hash;
+        jobs[n++].result = -1;
+        if (i == nv) {
+            jobs[n].pass = (const uint8_t*)"password";
+            jobs[n].pass_len = 8;
+            jobs[n].hash = malformed[3];
+            jobs[n++].result = -1;
+        }
+    }
+    for (i = 0; i < 5; i++) {
+        jobs[n].pass = (const uint8_t*)vectors[0].pass;
+        jobs[n].pass_len = i == 2 ? 7 : 8;
+        jobs[n].hash = vectors[0].hash;
+        jobs[n++].result = -1;
+    }
+
+    bad |= bcrypt_verify_batch(jobs, n, workers) != ECRYPT_NO_ERROR;
+    for (i = 0; i < n; i++) {
+        bad |= jobs[i].result !=
+            bcrypt_verify(jobs[i].pass, jobs[i].pass_len, jobs[i].hash);
+    }
+
+    fprintf(stdout, "%-24s %s\n", what, bad ? "FAILED" : "ok");
+    return bad;
+}
@@ -6,6 +6,8 @@
 
 #include <ecrypt/blowfish.h>
 
+#include "test_util.h"
+
 const unsigned char ivc[8] = {
     0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10
 };
@@ -23,18 +25,55 @@ const unsigned char def_data[29] = {
     0x66, 0x6F, 0x72, 0x20, 0x00
 };
 
+/* the same message under the CBC key and iv above, from the same source */
+const unsigned char cbc_ct[32] = {
+    0x6B, 0x77, 0xB4, 0xD6, 0x30, 0x06, 0xDE, 0xE6,
+    0x05, 0xB1, 0x56, 0xE2, 0x74, 0x03, 0x97, 0x93,
+    0x58, 0xDE, 0xB9, 0xE7, 0x15, 0x46, 0x16, 0xD9,
+    0x59, 0xF1, 0x65, 0x2B, 0xD5, 0xFF, 0x92, 0xCC
+};
+
+const int impls[] = {
+    BLOWFISH_IMPL_SCALAR,
+    BLOWFISH_IMPL_AVX2
+};
+
 int test_cbc(void);
 int test_ecb(void);
+int test_vectors(void);
+int test_bulk(void);
+int test_ctr(void);
+int test_multi(void);
+int test_cbc_mt(void);
 
 int main(int argc, char* argv[])
 {
+    int failed = 0;
+    size_t i;
+
     fprintf(stdout, "********Simple ECB Test Vector********\n");
     test_ecb();
 
     fprintf(stdout, "********Simple CBC Test Vector********\n");
     test_cbc();
-    
-    return 0;
+
+    fprintf(stdout, "********Key setup********\n");
+    failed |= test_multi();
+
+    for (i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+        if (blowfish_select_impl(impls[i]) != ECRYPT_NO_ERROR) {
+            continue;
+        }
+
+        fprintf(stdout, "********%s********\n", blowfish_impl_name());
+        failed |= test_vectors();
+        failed |= test_bulk();
+        failed |= test_ctr();
+        failed |= test_cbc_mt();
+    }
+    blowfish_select_impl(BLOWFISH_IMPL_AUTO);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 int test_ecb(void)
@@ -152,3 +191,224 @@ int test_cbc(void)
     
     return 0;
 }
+
+/* the two vectors test_ecb prints, and the CBC message both ways */
+int test_vectors(void)
+{
+    static const uint8_t zero_ct[8] = {
+        0x4E, 0xF9, 0x97, 0x45, 0x61, 0x98, 0xDD, 0x78
+    };
+    static const uint8_t ones_ct[8] = {
+        0x51, 0x86, 0x6F, 0xD5, 0xB8, 0x5E, 0xCB, 0x8A
+    };
+    struct blowfish_context_t ctx;
+    uint8_t key[8], pt[32], out[32];
+    int failed = 0;
+
+    memset(key, 0, 8);
+    memset(pt, 0, 8);
+    blowfish_init(&ctx, key, 8);
+    blowfish_encrypt_ecb(&ctx, pt, 8, out);
+    failed |= check("ECB zero key", out, zero_ct, 8);
+    blowfish_decrypt_ecb(&ctx, zero_ct, 8, out);
+    failed |= check("ECB zero key decrypt", out, pt, 8);
+
+    memset(key, 0xFF, 8);
+    memset(pt, 0xFF, 8);
+    blowfish_init(&ctx, key, 8);
+    blowfish_encrypt_ecb(&ctx, pt, 8, out);
+    failed |= check("ECB ones key", out, ones_ct, 8);
+
+    memset(pt, 0, 32);
+    memcpy(pt, def_data, 29);
+    blowfish_init(&ctx, keyc, 16);
+    blowfish_encrypt(&ctx, ivc, pt, 32, out);
+    failed |= check("CBC encrypt", out, cbc_ct, 32);
+    blowfish_decrypt(&ctx, ivc, cbc_ct, 32, out);
+    failed |= check("CBC decrypt", out, pt, 32);
+    blowfish_end(&ctx);
+
+    return failed;
+}
+
+/* The multi-block paths against one block at a time, which goes through
+ * the single-block code checked by test_vectors, for every length up to a
+ * few groups of the widest implementation. */
+int test_bulk(void)
+{
+    struct blowfish_context_t ctx;
+    struct blowfish_stream_t s;
+    uint8_t pt[400], ct[400], want[400], got[400], iv[8], ctr[8];
+    size_t n, i, len;
+    int failed = 0;
+
+    fill(pt, sizeof(pt), 19);
+    fill(iv, sizeof(iv), 23);
+    blowfish_init(&ctx, keyc, 16);
+
+    for (n = 0; n <= sizeof(pt) / 8; n++) {
+        for (i = 0; i < n; i++) {
+            blowfish_encrypt_ecb(&ctx, &pt[i*8], 8, &want[i*8]);
+        }
+        blowfish_encrypt_ecb(&ctx, pt, n * 8, got);
+        failed |= memcmp(got, want, n * 8) != 0;
+        blowfish_decrypt_ecb(&ctx, got, n * 8, got);
+        failed |= memcmp(got, pt, n * 8) != 0;
+
+        blowfish_encrypt(&ctx, iv, pt, n * 8, ct);
+        blowfish_decrypt(&ctx, iv, ct, n * 8, got);
+        failed |= memcmp(got, pt, n * 8) != 0;
+        memcpy(got, ct, n * 8);
+        blowfish_decrypt(&ctx, iv, got, n * 8, got);
+        failed |= memcmp(got, pt, n * 8) != 0;
+
+        /* the low word of the counter wraps a few blocks in */
+        memset(ctr, 0, 8);
+        ctr[3] = 0x42;
+        ctr[4] = ctr[5] = ctr[6] = 0xFF;
+        ctr[7] = 0xF5;
+        for (i = 0; i < n; i++) {
+            blowfish_encrypt_ecb(&ctx, ctr, 8, &want[i*8]);
+            for (len = 8; len-- > 0 && ++ctr[len] == 0; ) {
+            }
+        }
+        for (i = 0; i < n * 8; i++) {
+            want[i] ^= pt[i];
+        }
+        ctr[3] = 0x42;
+        ctr[4] = ctr[5] = ctr[6] = 0xFF;
+        ctr[7] = 0xF5;
+        memcpy(got, pt, n * 8);
+        blowfish_stream_init(&s, &ctx, BLOWFISH_STREAM_CTR, BLOWFISH_PAD_NONE,
+            ctr);
+        blowfish_stream_update(&s, got, n * 8, got, &len);
+        failed |= len != n * 8 || memcmp(got, want, n * 8) != 0;
+        blowfish_stream_final(&s, got, &len);
+    }
+    blowfish_end(&ctx);
+
+    fprintf(stdout, "%-24s %s\n", "bulk lengths 0..50", failed ? "FAILED" :
+        "ok");
+
+    return failed;
+}
+
+/* CTR against a keystream made with ECB, the counter wrapping all 64 bits
+ * a few blocks in; then ranges at every offset, and a threaded run */
+int test_ctr(void)
+{
+    static uint8_t big[3 << 20], big_want[3 << 20];
+    struct blowfish_context_t ctx;
+    uint8_t pt[1000], want[1000], got[1000], iv[8], ctr[8];
+    size_t i, off, len;
+    int j, failed = 0;
+
+    fill(pt, sizeof(pt), 29);
+    memset(iv, 0xFF, 8);
+    iv[7] = 0xF9;
+    blowfish_init(&ctx, keyc, 16);
+
+    memcpy(ctr, iv, 8);
+    for (i = 0; i < sizeof(want); i += 8) {
+        blowfish_encrypt_ecb(&ctx, ctr, 8, &want[i]);
+        for (j = 7; j >= 0 && ++ctr[j] == 0; j--) {
+        }
+    }
+    for (i = 0; i < sizeof(want); i++) {
+        want[i] ^= pt[i];
+    }
+
+    blowfish_encrypt_ctr(&ctx, iv, pt, sizeof(pt), got);
+    failed |= check("CTR encrypt", got, want, sizeof(want));
+    blowfish_decrypt_ctr(&ctx, iv, got, sizeof(got), got);
+    failed |= check("CTR decrypt", got, pt, sizeof(pt));
+
+    for (off = 0; off < 200; off++) {
+        for (len = 0; off + len <= sizeof(pt); len += 1 + len / 2) {
+            memset(got, 0, sizeof(got));
+            blowfish_ctr_at(&ctx, iv, off, &pt[off], len, got, 1);
+            failed |= memcmp(got, &want[off], len) != 0;
+        }
+    }
+    fprintf(stdout, "%-24s %s\n", "CTR at offsets 0..199", failed ? "FAILED" :
+        "ok");
+
+    /* a buffer big enough to be split, at an offset inside a block */
+    fill(big, sizeof(big), 31);
+    blowfish_ctr_at(&ctx, iv, 5, big, sizeof(big), big_want, 1);
+    for (j = 0; j <= 4; j++) {
+        blowfish_ctr_at(&ctx, iv, 5, big, sizeof(big), big, j);
+        failed |= memcmp(big, big_want, sizeof(big)) != 0;
+        fill(big, sizeof(big), 31);
+    }
+    fprintf(stdout, "%-24s %s\n", "CTR threaded", failed ? "FAILED" : "ok");
+    blowfish_end(&ctx);
+
+    return failed;
+}
+
+/* blowfish_decrypt_mt against blowfish_decrypt on a buffer big enough to
+ * be split, in place and not, with ranges that do and do not divide it */
+int test_cbc_mt(void)
+{
+    static uint8_t pt[(3 << 20) + 8], ct[sizeof(pt)], got[sizeof(pt)];
+    struct blowfish_context_t ctx;
+    uint8_t iv[8];
+    int j, failed = 0;
+
+    fill(pt, sizeof(pt), 37);
+    fill(iv, sizeof(iv), 43);
+    blowfish_init(&ctx, keyc, 16);
+    blowfish_encrypt(&ctx, iv, pt, sizeof(pt), ct);
+
+    for (j = 0; j <= 5; j++) {
+        memset(got, 0, sizeof(got));
+        failed |= blowfish_decrypt_mt(&ctx, iv, ct, sizeof(ct), got, j) !=
+            ECRYPT_NO_ERROR;
+        failed |= memcmp(got, pt, sizeof(pt)) != 0;
+
+        memcpy(got, ct, sizeof(ct));
+        blowfish_decrypt_mt(&ctx, iv, got, sizeof(got) - 8, got, j);
+        failed |= memcmp(got, pt, sizeof(pt) - 8) != 0;
+    }
+    failed |= blowfish_decrypt_mt(&ctx, iv, ct, 12, got, 2) !=
+        ECRYPT_INVALID_LENGTH;
+    blowfish_end(&ctx);
+
+    fprintf(stdout, "%-24s %s\n", "CBC decrypt threaded", failed ? "FAILED" :
+        "ok");
+
+    return failed;
+}
+
+/* blowfish_init_multi against blowfish_init, which test_vectors checks,
+ * for every count up to a few groups and every key length */
+int test_multi(void)
+{
+    struct blowfish_context_t want, got[11];
+    uint8_t keys[11][56];
+    const uint8_t* kp[11];
+    uint32_t klen;
+    size_t n, i;
+    int failed = 0;
+
+    fill(&keys[0][0], sizeof(keys), 41);
+    for (i = 0; i < 11; i++) {
+        kp[i] = keys[i];
+    }
+
+    for (n = 0; n <= 11; n++) {
+        klen = 4 + (uint32_t)(n * 5) % 53;
+        failed |= blowfish_init_multi(got, kp, klen, n) != ECRYPT_NO_ERROR;
+        for (i = 0; i < n; i++) {
+            blowfish_init(&want, keys[i], klen);
+            failed |= memcmp(&got[i], &want, sizeof(want)) != 0;
+        }
+    }
+    failed |= blowfish_init_multi(got, kp, 3, 4) != ECRYPT_INVALID_LENGTH;
+    failed |= blowfish_init_multi(got, kp, 57, 4) != ECRYPT_INVALID_LENGTH;
+
+    fprintf(stdout, "%-24s %s\n", "init_multi", failed ? "FAILED" : "ok");
+
+    return failed;
+}
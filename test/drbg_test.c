@@ -0,0 +1,207 @@
+/* Known answer tests for CTR_DRBG with AES-256 and no derivation function,
+ * checked against OpenSSL's CTR-DRBG, and checks that the per-thread
+ * generators behind drbg_random do not repeat each other. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <ecrypt/drbg.h>
+
+#include "test_util.h"
+
+/* entropy[i] = 7 * i + 1, pers[i] = 0xa0 + i: the second 64 byte
+ * generate after instantiating */
+const uint8_t kat1[64] = {
+    0xd2, 0xcd, 0xd3, 0x82, 0x02, 0x8b, 0x45, 0xb7,
+    0xcc, 0xb1, 0xa9, 0x1c, 0x1d, 0x75, 0xac, 0x86,
+    0x59, 0xf0, 0xdb, 0xad, 0x13, 0x67, 0x03, 0x8a,
+    0xdd, 0x61, 0xfc, 0xec, 0x16, 0x47, 0x35, 0x58,
+    0xb6, 0xe6, 0xb5, 0x73, 0x10, 0x64, 0xdc, 0x5d,
+    0x1f, 0x2b, 0xd5, 0x90, 0xa4, 0x17, 0xb1, 0xdf,
+    0x64, 0xe7, 0x85, 0xd1, 0xcc, 0x80, 0x01, 0xf5,
+    0x55, 0x02, 0x57, 0x0f, 0xad, 0x93, 0x3d, 0x22
+};
+
+/* then reseeded with the same entropy and adin[i] = 3 * i + 0x40, and
+ * 100 bytes generated with the first 37 bytes of adin */
+const uint8_t kat2[100] = {
+    0xa1, 0x47, 0xeb, 0x13, 0x3d, 0x14, 0xae, 0x8d,
+    0x60, 0xe8, 0x5b, 0x98, 0x7b, 0x6b, 0x61, 0xd6,
+    0xff, 0xdf, 0xfa, 0xb5, 0x94, 0x5b, 0x71, 0x1e,
+    0x82, 0x69, 0x7f, 0x52, 0x84, 0xbe, 0xc0, 0x64,
+    0x4a, 0x21, 0x95, 0x32, 0xc6, 0x30, 0xb7, 0x84,
+    0xdd, 0x60, 0x07, 0x84, 0xbb, 0xaa, 0xa9, 0x0b,
+    0xd4, 0x56, 0xf7, 0xc5, 0xab, 0xfa, 0xfa, 0x60,
+    0x6a, 0xd3, 0x70, 0xe2, 0x43, 0x7b, 0x42, 0x52,
+    0x2e, 0xf4, 0x2f, 0xad, 0x97, 0x67, 0x64, 0xe3,
+    0x9a, 0xe3, 0xa4, 0xaa, 0xa6, 0xe2, 0x7e, 0xc1,
+    0xf6, 0x47, 0x72, 0x27, 0x55, 0xe7, 0x19, 0xc3,
+    0xc5, 0x0d, 0xbb, 0x06, 0x55, 0x2b, 0xaf, 0x83,
+    0x5d, 0xf1, 0x7b, 0xe9
+};
+
+int aes_tests(void);
+void* thread_main(void* arg);
+int test_kat(void);
+int test_threads(void);
+int test_fork(void);
+int test_reject(void);
+
+int main(int argc, char* argv[])
+{
+    int failed = 0;
+
+    failed |= run_aes_impls(aes_tests);
+
+    fprintf(stdout, "********drbg_random********\n");
+    failed |= test_threads();
+    failed |= test_fork();
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int aes_tests(void)
+{
+    int failed = 0;
+
+    failed |= test_kat();
+    failed |= test_reject();
+
+    return failed;
+}
+
+int test_kat(void)
+{
+    int failed = 0;
+    size_t i;
+    uint8_t entropy[48], pers[48], adin[48], out[100];
+    drbg_ctx ctx;
+
+    for (i = 0; i < sizeof(pers); i++) {
+        entropy[i] = (uint8_t)(7 * i + 1);
+        pers[i] = (uint8_t)(0xa0 + i);
+        adin[i] = (uint8_t)(3 * i + 0x40);
+    }
+
+    drbg_instantiate(&ctx, entropy, 48, pers, 48);
+    drbg_generate(&ctx, out, 64, NULL, 0);
+    drbg_generate(&ctx, out, 64, NULL, 0);
+    failed |= check("CTR_DRBG generate", out, kat1, sizeof(kat1));
+
+    drbg_reseed(&ctx, entropy, 48, adin, 48);
+    drbg_generate(&ctx, out, 100, adin, 37);
+    failed |= check("CTR_DRBG reseed, adin", out, kat2, sizeof(kat2));
+
+    drbg_release(&ctx);
+    return failed;
+}
+
+/* every thread has its own generator, so no two hand out the same bytes */
+void* thread_main(void* arg)
+{
+    drbg_random((uint8_t*)arg, 32);
+    return NULL;
+}
+
+int test_threads(void)
+{
+    int failed = 0;
+    uint8_t out[4][32], big[3 * DRBG_BUFFER_LENGTH], zero[32];
+    pthread_t threads[4];
+    size_t i, j;
+
+    for (i = 0; i < 4; i++) {
+        if (pthread_create(&threads[i], NULL, thread_main, out[i]) != 0) {
+            thread_main(out[i]);
+            threads[i] = pthread_self();
+        }
+    }
+    for (i = 0; i < 4; i++) {
+        if (!pthread_equal(threads[i], pthread_self())) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    memset(zero, 0, sizeof(zero));
+    for (i = 0; i < 4; i++) {
+        failed |= memcmp(out[i], zero, 32) == 0;
+        for (j = 0; j < i; j++) {
+            failed |= memcmp(out[i], out[j], 32) == 0;
+        }
+    }
+
+    /* a short request, then one that runs past the buffer */
+    failed |= drbg_random(out[0], 5) != ECRYPT_NO_ERROR;
+    failed |= drbg_random(big, sizeof(big)) != ECRYPT_NO_ERROR;
+    failed |= memcmp(big + sizeof(big) - 32, zero, 32) == 0;
+    fprintf(stdout, "%-24s %s\n", "per-thread streams",
+        failed ? "FAILED" : "ok");
+
+    return failed;
+}
+
+/* a child must not repeat what the parent gets next */
+int test_fork(void)
+{
+    uint8_t parent[16], child[16];
+    int fds[2], status, failed;
+    pid_t pid;
+
+    drbg_random(parent, 1);
+    if (pipe(fds) != 0 || (pid = fork()) < 0) {
+        fprintf(stdout, "%-24s %s\n", "fork", "skipped");
+        return 0;
+    }
+
+    if (pid == 0) {
+        drbg_random(child, sizeof(child));
+        _exit(write(fds[1], child, sizeof(child)) == sizeof(child) ? 0 : 1);
+    }
+
+    drbg_random(parent, sizeof(parent));
+    failed = read(fds[0], child, sizeof(child)) != sizeof(child);
+    waitpid(pid, &status, 0);
+    close(fds[0]);
+    close(fds[1]);
+
+    failed |= memcmp(parent, child, sizeof(parent)) == 0;
+    fprintf(stdout, "%-24s %s\n", "fork", failed ? "FAILED" : "ok");
+
+    return failed;
+}
+
+int test_reject(void)
+{
+    int failed = 0;
+    uint8_t seed[49], out[16];
+    drbg_ctx ctx;
+
+    memset(seed, 1, sizeof(seed));
+    memset(&ctx, 0, sizeof(ctx));
+    if (drbg_generate(&ctx, out, 16, NULL, 0) != ECRYPT_INVALID_PARAMETERS) {
+        fprintf(stdout, "DRBG generated without a seed\n");
+        failed = 1;
+    }
+    if (drbg_instantiate(&ctx, seed, 32, NULL, 0) != ECRYPT_INVALID_LENGTH) {
+        fprintf(stdout, "DRBG accepted 32 bytes of entropy\n");
+        failed = 1;
+    }
+    if (drbg_instantiate(&ctx, seed, 48, seed, 49) != ECRYPT_INVALID_LENGTH) {
+        fprintf(stdout, "DRBG accepted a 49 byte personalization\n");
+        failed = 1;
+    }
+
+    drbg_instantiate(&ctx, NULL, 0, NULL, 0);
+    if (drbg_generate(&ctx, out, DRBG_MAX_REQUEST + 1, NULL, 0) !=
+        ECRYPT_INVALID_LENGTH) {
+        fprintf(stdout, "DRBG accepted an oversized request\n");
+        failed = 1;
+    }
+    fprintf(stdout, "%-24s %s\n", "DRBG rejects", failed ? "FAILED" : "ok");
+
+    drbg_release(&ctx);
+    return failed;
+}
@@ -0,0 +1,309 @@
+/* Known answer tests for AES-GCM.  The vectors are test cases 4, 5, 6 and
+ * 16 from McGrew and Viega, "The Galois/Counter Mode of Operation (GCM)",
+ * the same ones NIST SP 800-38D points at.  Every test is run once per
+ * GHASH implementation the running processor supports. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ecrypt/gcm.h>
+
+#include "test_util.h"
+
+const uint8_t tc_key[32] = {
+    0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c,
+    0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08,
+    0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c,
+    0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08
+};
+
+const uint8_t tc_pt[60] = {
+    0xd9, 0x31, 0x32, 0x25, 0xf8, 0x84, 0x06, 0xe5,
+    0xa5, 0x59, 0x09, 0xc5, 0xaf, 0xf5, 0x26, 0x9a,
+    0x86, 0xa7, 0xa9, 0x53, 0x15, 0x34, 0xf7, 0xda,
+    0x2e, 0x4c, 0x30, 0x3d, 0x8a, 0x31, 0x8a, 0x72,
+    0x1c, 0x3c, 0x0c, 0x95, 0x95, 0x68, 0x09, 0x53,
+    0x2f, 0xcf, 0x0e, 0x24, 0x49, 0xa6, 0xb5, 0x25,
+    0xb1, 0x6a, 0xed, 0xf5, 0xaa, 0x0d, 0xe6, 0x57,
+    0xba, 0x63, 0x7b, 0x39
+};
+
+const uint8_t tc_aad[20] = {
+    0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef,
+    0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef,
+    0xab, 0xad, 0xda, 0xd2
+};
+
+/* test cases 4 and 16 use all 12 bytes, test case 5 the first 8 */
+const uint8_t tc_iv[12] = {
+    0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad,
+    0xde, 0xca, 0xf8, 0x88
+};
+
+const uint8_t tc6_iv[60] = {
+    0x93, 0x13, 0x22, 0x5d, 0xf8, 0x84, 0x06, 0xe5,
+    0x55, 0x90, 0x9c, 0x5a, 0xff, 0x52, 0x69, 0xaa,
+    0x6a, 0x7a, 0x95, 0x38, 0x53, 0x4f, 0x7d, 0xa1,
+    0xe4, 0xc3, 0x03, 0xd2, 0xa3, 0x18, 0xa7, 0x28,
+    0xc3, 0xc0, 0xc9, 0x51, 0x56, 0x80, 0x95, 0x39,
+    0xfc, 0xf0, 0xe2, 0x42, 0x9a, 0x6b, 0x52, 0x54,
+    0x16, 0xae, 0xdb, 0xf5, 0xa0, 0xde, 0x6a, 0x57,
+    0xa6, 0x37, 0xb3, 0x9b
+};
+
+const uint8_t tc4_ct[60] = {
+    0x42, 0x83, 0x1e, 0xc2, 0x21, 0x77, 0x74, 0x24,
+    0x4b, 0x72, 0x21, 0xb7, 0x84, 0xd0, 0xd4, 0x9c,
+    0xe3, 0xaa, 0x21, 0x2f, 0x2c, 0x02, 0xa4, 0xe0,
+    0x35, 0xc1, 0x7e, 0x23, 0x29, 0xac, 0xa1, 0x2e,
+    0x21, 0xd5, 0x14, 0xb2, 0x54, 0x66, 0x93, 0x1c,
+    0x7d, 0x8f, 0x6a, 0x5a, 0xac, 0x84, 0xaa, 0x05,
+    0x1b, 0xa3, 0x0b, 0x39, 0x6a, 0x0a, 0xac, 0x97,
+    0x3d, 0x58, 0xe0, 0x91
+};
+
+const uint8_t tc4_tag[16] = {
+    0x5b, 0xc9, 0x4f, 0xbc, 0x32, 0x21, 0xa5, 0xdb,
+    0x94, 0xfa, 0xe9, 0x5a, 0xe7, 0x12, 0x1a, 0x47
+};
+
+const uint8_t tc5_tag[16] = {
+    0x36, 0x12, 0xd2, 0xe7, 0x9e, 0x3b, 0x07, 0x85,
+    0x56, 0x1b, 0xe1, 0x4a, 0xac, 0xa2, 0xfc, 0xcb
+};
+
+const uint8_t tc6_tag[16] = {
+    0x61, 0x9c, 0xc5, 0xae, 0xff, 0xfe, 0x0b, 0xfa,
+    0x46, 0x2a, 0xf4, 0x3c, 0x16, 0x99, 0xd0, 0x50
+};
+
+const uint8_t tc16_tag[16] = {
+    0x76, 0xfc, 0x6e, 0xce, 0x0f, 0x4e, 0x17, 0x68,
+    0xcd, 0xdf, 0x88, 0x53, 0xbb, 0x2d, 0x55, 0x1b
+};
+
+/* an IV whose counter carries out of its low 32 bits after 140 blocks;
+ * key 00..0f, pt[i] = 7 * i, 4000 bytes.  Checked against OpenSSL. */
+const uint8_t wrap_iv[16] = {
+    0x93, 0x1b, 0xf8, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+const uint8_t wrap_tag[16] = {
+    0xa4, 0x21, 0xc9, 0x83, 0x92, 0x98, 0x2e, 0xbc,
+    0x3c, 0xc0, 0x45, 0xe9, 0x43, 0x86, 0xaf, 0xf8
+};
+
+/* GHASH code, and the block cipher code it runs with */
+const struct {
+    int gcm;
+    int aes;
+} impls[] = {
+    { GCM_IMPL_TABLE, RIJNDAEL_IMPL_AUTO },
+    { GCM_IMPL_PCLMUL, RIJNDAEL_IMPL_AUTO },
+    { GCM_IMPL_AESNI, RIJNDAEL_IMPL_AESNI },
+    { GCM_IMPL_VAES, RIJNDAEL_IMPL_VAES256 },
+    { GCM_IMPL_VAES, RIJNDAEL_IMPL_VAES512 }
+};
+
+int test_kat(void);
+int test_stream(void);
+int test_wrap(void);
+int test_reject(void);
+
+int main(int argc, char* argv[])
+{
+    int failed = 0;
+    size_t i;
+
+    for (i = 0; i < sizeof(impls) / sizeof(impls[0]) + 1; i++) {
+        /* the last pass pairs the default GHASH with T-table AES */
+        if (i == sizeof(impls) / sizeof(impls[0])) {
+            gcm_select_impl(GCM_IMPL_AUTO);
+            rijndael_select_impl(RIJNDAEL_IMPL_TABLE);
+        } else if (gcm_select_impl(impls[i].gcm) != ECRYPT_NO_ERROR ||
+            rijndael_select_impl(impls[i].aes) != ECRYPT_NO_ERROR) {
+            continue;
+        }
+
+        fprintf(stdout, "********%s/%s********\n", gcm_impl_name(NULL),
+            rijndael_impl_name(NULL));
+        failed |= test_kat();
+        failed |= test_stream();
+        failed |= test_wrap();
+        failed |= test_reject();
+    }
+    gcm_select_impl(GCM_IMPL_AUTO);
+    rijndael_select_impl(RIJNDAEL_IMPL_AUTO);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int test_kat(void)
+{
+    const struct {
+        const char* name;
+        uint32_t klen;
+        const uint8_t* iv;
+        size_t iv_len;
+        const uint8_t* tag;
+    } tc[] = {
+        { "GCM test case 4", 16, tc_iv, 12, tc4_tag },
+        { "GCM test case 5", 16, tc_iv, 8, tc5_tag },
+        { "GCM test case 6", 16, tc6_iv, 60, tc6_tag },
+        { "GCM test case 16", 32, tc_iv, 12, tc16_tag }
+    };
+    int failed = 0;
+    size_t i;
+    uint8_t ct[60], pt[60], tag[16];
+    gcm_ctx ctx;
+
+    for (i = 0; i < sizeof(tc) / sizeof(tc[0]); i++) {
+        gcm_set_key(&ctx, tc_key, tc[i].klen);
+        gcm_encrypt(&ctx, tc[i].iv, tc[i].iv_len, tc_aad, sizeof(tc_aad),
+            tc_pt, sizeof(tc_pt), ct, tag, 16);
+        if (i == 0) {
+            failed |= check("GCM test case 4 ct", ct, tc4_ct, sizeof(ct));
+        }
+        failed |= check(tc[i].name, tag, tc[i].tag, 16);
+
+        if (gcm_decrypt(&ctx, tc[i].iv, tc[i].iv_len, tc_aad,
+            sizeof(tc_aad), ct, sizeof(ct), pt, tc[i].tag, 16) !=
+            ECRYPT_NO_ERROR || memcmp(pt, tc_pt, sizeof(pt)) != 0) {
+            fprintf(stdout, "%s did not decrypt\n", tc[i].name);
+            failed = 1;
+        }
+    }
+
+    gcm_release(&ctx);
+    return failed;
+}
+
+/* any way of cutting up the AAD and text has to give the same result */
+int test_stream(void)
+{
+    const size_t steps[] = { 1, 7, 15, 16, 17, 100, 129, 1000 };
+    int failed = 0;
+    size_t i, pos, n;
+    uint8_t aad[77], pt[1000], ref[1000], buf[1000], tag[16], want[16];
+    gcm_ctx ctx;
+
+    fill(aad, sizeof(aad), 1);
+    fill(pt, sizeof(pt), 2);
+    gcm_set_key(&ctx, tc_key, 24);
+    gcm_encrypt(&ctx, tc_iv, 12, aad, sizeof(aad), pt, sizeof(pt), ref,
+        want, 16);
+
+    for (i = 0; i < sizeof(steps) / sizeof(steps[0]) && !failed; i++) {
+        memcpy(buf, pt, sizeof(buf));
+        gcm_init(&ctx, tc_iv, 12);
+        for (pos = 0; pos < sizeof(aad); pos += n) {
+            n = sizeof(aad) - pos < steps[i] ? sizeof(aad) - pos : steps[i];
+            gcm_aad(&ctx, aad + pos, n);
+        }
+        for (pos = 0; pos < sizeof(buf); pos += n) {
+            n = sizeof(buf) - pos < steps[i] ? sizeof(buf) - pos : steps[i];
+            gcm_encrypt_update(&ctx, buf + pos, n, buf + pos);
+        }
+        gcm_encrypt_final(&ctx, tag, 16);
+        if (memcmp(buf, ref, sizeof(buf)) != 0 || memcmp(tag, want, 16)) {
+            fprintf(stdout, "GCM encrypt in %lu byte steps mismatch\n",
+                (unsigned long)steps[i]);
+            failed = 1;
+        }
+
+        gcm_init(&ctx, tc_iv, 12);
+        gcm_aad(&ctx, aad, sizeof(aad));
+        for (pos = 0; pos < sizeof(buf); pos += n) {
+            n = sizeof(buf) - pos < steps[i] ? sizeof(buf) - pos : steps[i];
+            gcm_decrypt_update(&ctx, buf + pos, n, buf + pos);
+        }
+        if (gcm_decrypt_final(&ctx, want, 16) != ECRYPT_NO_ERROR ||
+            memcmp(buf, pt, sizeof(buf)) != 0) {
+            fprintf(stdout, "GCM decrypt in %lu byte steps mismatch\n",
+                (unsigned long)steps[i]);
+            failed = 1;
+        }
+    }
+    fprintf(stdout, "%-24s %s\n", "GCM streaming", failed ? "FAILED" : "ok");
+
+    gcm_release(&ctx);
+    return failed;
+}
+
+int test_wrap(void)
+{
+    int failed;
+    size_t i;
+    uint8_t key[16], tag[16];
+    uint8_t* pt = (uint8_t*)malloc(4000);
+    gcm_ctx ctx;
+
+    if (pt == NULL) {
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(key); i++) {
+        key[i] = (uint8_t)i;
+    }
+    for (i = 0; i < 4000; i++) {
+        pt[i] = (uint8_t)(7 * i);
+    }
+
+    gcm_set_key(&ctx, key, 16);
+    gcm_encrypt(&ctx, wrap_iv, sizeof(wrap_iv), NULL, 0, pt, 4000, pt, tag,
+        16);
+    failed = check("GCM counter wrap", tag, wrap_tag, 16);
+
+    gcm_release(&ctx);
+    free(pt);
+    return failed;
+}
+
+/* forged messages, bad tag lengths and calls out of order */
+int test_reject(void)
+{
+    int failed = 0;
+    uint8_t ct[60], pt[60], tag[16];
+    gcm_ctx ctx;
+
+    gcm_set_key(&ctx, tc_key, 16);
+    gcm_encrypt(&ctx, tc_iv, 12, tc_aad, sizeof(tc_aad), tc_pt,
+        sizeof(tc_pt), ct, tag, 12);
+
+    if (gcm_decrypt(&ctx, tc_iv, 12, tc_aad, sizeof(tc_aad), ct, sizeof(ct),
+        pt, tag, 12) != ECRYPT_NO_ERROR) {
+        fprintf(stdout, "GCM rejected a truncated tag\n");
+        failed = 1;
+    }
+
+    ct[17] ^= 0x04;
+    if (gcm_decrypt(&ctx, tc_iv, 12, tc_aad, sizeof(tc_aad), ct, sizeof(ct),
+        pt, tag, 12) != ECRYPT_AUTH_FAILED || pt[0] != 0 || pt[59] != 0) {
+        fprintf(stdout, "GCM accepted a forged message\n");
+        failed = 1;
+    }
+
+    if (gcm_encrypt(&ctx, tc_iv, 12, NULL, 0, tc_pt, 16, ct, tag, 5) !=
+        ECRYPT_INVALID_LENGTH) {
+        fprintf(stdout, "GCM accepted a 5 byte tag\n");
+        failed = 1;
+    }
+
+    gcm_init(&ctx, tc_iv, 12);
+    gcm_encrypt_update(&ctx, tc_pt, 16, ct);
+    if (gcm_aad(&ctx, tc_aad, 4) != ECRYPT_INVALID_PARAMETERS) {
+        fprintf(stdout, "GCM accepted AAD after the text\n");
+        failed = 1;
+    }
+    gcm_encrypt_final(&ctx, tag, 16);
+    if (gcm_encrypt_update(&ctx, tc_pt, 16, ct) !=
+        ECRYPT_INVALID_PARAMETERS) {
+        fprintf(stdout, "GCM accepted text after the tag\n");
+        failed = 1;
+    }
+    fprintf(stdout, "%-24s %s\n", "GCM rejects", failed ? "FAILED" : "ok");
+
+    gcm_release(&ctx);
+    return failed;
+}
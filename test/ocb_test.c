@@ -0,0 +1,233 @@
+/* AES-OCB3 against the iterated test of RFC 7253, appendix A, which runs
+ * every message and AAD length from 0 to 127 bytes; the results for 128-bit
+ * keys are the RFC's, the rest were checked against OpenSSL. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ecrypt/ocb.h>
+
+#include "test_util.h"
+
+/* the final tags of the iterated test, by tag length and key size */
+const uint8_t iter_16[3][16] = {
+    { 0x67, 0xe9, 0x44, 0xd2, 0x32, 0x56, 0xc5, 0xe0,
+      0xb6, 0xc6, 0x1f, 0xa2, 0x2f, 0xdf, 0x1e, 0xa2 },
+    { 0xf6, 0x73, 0xf2, 0xc3, 0xe7, 0x17, 0x4a, 0xae,
+      0x7b, 0xae, 0x98, 0x6c, 0xa9, 0xf2, 0x9e, 0x17 },
+    { 0xd9, 0x0e, 0xb8, 0xe9, 0xc9, 0x77, 0xc8, 0x8b,
+      0x79, 0xdd, 0x79, 0x3d, 0x7f, 0xfa, 0x16, 0x1c }
+};
+
+const uint8_t iter_12[3][12] = {
+    { 0x77, 0xa3, 0xd8, 0xe7, 0x35, 0x89, 0x15, 0x8d,
+      0x25, 0xd0, 0x12, 0x09 },
+    { 0x05, 0xd5, 0x6e, 0xad, 0x27, 0x52, 0xc8, 0x6b,
+      0xe6, 0x93, 0x2c, 0x5e },
+    { 0x54, 0x58, 0x35, 0x9a, 0xc2, 0x3b, 0x0c, 0xba,
+      0x9e, 0x63, 0x30, 0xdd }
+};
+
+const uint8_t iter_8[3][8] = {
+    { 0x19, 0x2c, 0x9b, 0x7b, 0xd9, 0x0b, 0xa0, 0x6a },
+    { 0x00, 0x66, 0xbc, 0x6e, 0x0e, 0xf3, 0x4e, 0x24 },
+    { 0x7d, 0x4e, 0xa5, 0xd4, 0x45, 0x50, 0x1c, 0xbe }
+};
+
+/* AES-256, key[i] = 11 * i + 3, a 15 byte nonce i + 1, 77 bytes of AAD
+ * 5 * i and 1000 bytes of plaintext 3 * i + 1: the last 32 bytes of the
+ * ciphertext, then the tag */
+const uint8_t long_tail[48] = {
+    0xbc, 0x4d, 0xc5, 0xe2, 0x71, 0xd0, 0x0c, 0x77,
+    0x99, 0xba, 0xc8, 0xfe, 0xa4, 0xaf, 0xb2, 0x25,
+    0xf5, 0x73, 0x9e, 0x42, 0x75, 0xa3, 0x81, 0x34,
+    0x8d, 0x76, 0x04, 0x5a, 0xf2, 0x4a, 0x69, 0x85,
+    0xc5, 0x60, 0xbd, 0x38, 0x17, 0x90, 0x31, 0x5f,
+    0x52, 0x12, 0xa7, 0x09, 0x75, 0x20, 0x45, 0xa4
+};
+
+int aes_tests(void);
+void nonce96(uint8_t* N, unsigned int n);
+int test_iterated(void);
+int test_long(void);
+int test_reject(void);
+
+int main(int argc, char* argv[])
+{
+    int failed = 0;
+
+    failed |= run_aes_impls(aes_tests);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int aes_tests(void)
+{
+    int failed = 0;
+
+    failed |= test_iterated();
+    failed |= test_long();
+    failed |= test_reject();
+
+    return failed;
+}
+
+/* the nonce is the 96-bit number n */
+void nonce96(uint8_t* N, unsigned int n)
+{
+    memset(N, 0, 12);
+    N[10] = (uint8_t)(n >> 8);
+    N[11] = (uint8_t)n;
+}
+
+/*
+* RFC 7253, appendix A.  Each message is decrypted again as well, which
+* checks the decrypt side over the same lengths.
+*/
+int test_iterated(void)
+{
+    const size_t tag_lens[] = { 16, 12, 8 };
+    const uint8_t* want;
+    int failed = 0;
+    size_t t, k, i, len;
+    uint8_t K[32], N[12], S[128], P[128], T[16];
+    uint8_t* C = (uint8_t*)malloc(128 * (3 * 128 + 3 * 16));
+    char name[32];
+    ocb_ctx ctx;
+
+    if (C == NULL) {
+        return 1;
+    }
+
+    memset(S, 0, sizeof(S));
+    for (t = 0; t < 3; t++) {
+        for (k = 0; k < 3; k++) {
+            want = t == 0 ? iter_16[k] : t == 1 ? iter_12[k] : iter_8[k];
+
+            memset(K, 0, sizeof(K));
+            K[15 + 8 * k] = (uint8_t)(tag_lens[t] * 8);
+            ocb_set_key(&ctx, K, (uint32_t)(16 + 8 * k));
+
+            len = 0;
+            for (i = 0; i < 128; i++) {
+                nonce96(N, 3 * i + 1);
+                ocb_encrypt(&ctx, N, 12, S, i, S, i, C + len, C + len + i,
+                    tag_lens[t]);
+                if (ocb_decrypt(&ctx, N, 12, S, i, C + len, i, P,
+                    C + len + i, tag_lens[t]) != ECRYPT_NO_ERROR ||
+                    memcmp(P, S, i) != 0) {
+                    fprintf(stdout, "OCB length %lu did not decrypt\n",
+                        (unsigned long)i);
+                    failed = 1;
+                }
+                len += i + tag_lens[t];
+
+                nonce96(N, 3 * i + 2);
+                ocb_encrypt(&ctx, N, 12, NULL, 0, S, i, C + len,
+                    C + len + i, tag_lens[t]);
+                len += i + tag_lens[t];
+
+                nonce96(N, 3 * i + 3);
+                ocb_encrypt(&ctx, N, 12, S, i, NULL, 0, NULL, C + len,
+                    tag_lens[t]);
+                len += tag_lens[t];
+            }
+
+            nonce96(N, 385);
+            ocb_encrypt(&ctx, N, 12, C, len, NULL, 0, NULL, T, tag_lens[t]);
+            snprintf(name, sizeof(name), "RFC 7253 AES-%lu/%lu",
+                (unsigned long)(128 + 64 * k),
+                (unsigned long)(8 * tag_lens[t]));
+            failed |= check(name, T, want, tag_lens[t]);
+        }
+    }
+
+    ocb_release(&ctx);
+    free(C);
+    return failed;
+}
+
+/* several groups of interleaved blocks, a partial block and long AAD */
+int test_long(void)
+{
+    int failed = 0;
+    size_t i;
+    uint8_t key[32], nonce[15], aad[77], pt[1000], ct[1000], tag[16];
+    uint8_t got[48];
+    ocb_ctx ctx;
+
+    for (i = 0; i < sizeof(key); i++) {
+        key[i] = (uint8_t)(11 * i + 3);
+    }
+    for (i = 0; i < sizeof(nonce); i++) {
+        nonce[i] = (uint8_t)(i + 1);
+    }
+    for (i = 0; i < sizeof(aad); i++) {
+        aad[i] = (uint8_t)(5 * i);
+    }
+    for (i = 0; i < sizeof(pt); i++) {
+        pt[i] = (uint8_t)(3 * i + 1);
+    }
+
+    ocb_set_key(&ctx, key, 32);
+    ocb_encrypt(&ctx, nonce, sizeof(nonce), aad, sizeof(aad), pt,
+        sizeof(pt), ct, tag, sizeof(tag));
+    memcpy(got, ct + sizeof(ct) - 32, 32);
+    memcpy(got + 32, tag, 16);
+    failed |= check("OCB 1000 bytes", got, long_tail, sizeof(got));
+
+    if (ocb_decrypt(&ctx, nonce, sizeof(nonce), aad, sizeof(aad), ct,
+        sizeof(ct), ct, tag, sizeof(tag)) != ECRYPT_NO_ERROR) {
+        fprintf(stdout, "OCB 1000 bytes failed to authenticate\n");
+        failed = 1;
+    }
+    failed |= check("OCB 1000 bytes dec", ct, pt, sizeof(pt));
+
+    ocb_release(&ctx);
+    return failed;
+}
+
+int test_reject(void)
+{
+    int failed = 0;
+    uint8_t key[16], nonce[16], pt[40], ct[40], tag[16];
+    ocb_ctx ctx;
+
+    memset(key, 0x42, sizeof(key));
+    memset(nonce, 0x24, sizeof(nonce));
+    memset(pt, 0x99, sizeof(pt));
+    ocb_set_key(&ctx, key, 16);
+    ocb_encrypt(&ctx, nonce, 12, NULL, 0, pt, sizeof(pt), ct, tag, 16);
+
+    ct[33] ^= 1;
+    if (ocb_decrypt(&ctx, nonce, 12, NULL, 0, ct, sizeof(ct), pt, tag,
+        16) != ECRYPT_AUTH_FAILED || pt[0] != 0) {
+        fprintf(stdout, "OCB accepted a modified ciphertext\n");
+        failed = 1;
+    }
+    ct[33] ^= 1;
+    if (ocb_decrypt(&ctx, nonce, 12, key, 1, ct, sizeof(ct), pt, tag,
+        16) != ECRYPT_AUTH_FAILED) {
+        fprintf(stdout, "OCB accepted modified AAD\n");
+        failed = 1;
+    }
+    if (ocb_decrypt(&ctx, nonce, 12, NULL, 0, ct, sizeof(ct), pt, tag,
+        12) != ECRYPT_AUTH_FAILED) {
+        fprintf(stdout, "OCB accepted a truncated tag\n");
+        failed = 1;
+    }
+    if (ocb_encrypt(&ctx, nonce, 16, NULL, 0, pt, sizeof(pt), ct, tag,
+        16) != ECRYPT_INVALID_LENGTH) {
+        fprintf(stdout, "OCB accepted a 16 byte nonce\n");
+        failed = 1;
+    }
+    if (ocb_encrypt(&ctx, nonce, 12, NULL, 0, pt, sizeof(pt), ct, tag,
+        17) != ECRYPT_INVALID_LENGTH) {
+        fprintf(stdout, "OCB accepted a 17 byte tag\n");
+        failed = 1;
+    }
+    fprintf(stdout, "%-24s %s\n", "OCB rejects", failed ? "FAILED" : "ok");
+
+    ocb_release(&ctx);
+    return failed;
+}
@@ -9,9 +9,42 @@
 #define DEFAULT_ROUNDS  (4096)
 #define DEFAULT_LENGTH  (256)
 
+/* known answers from Python's hashlib.pbkdf2_hmac; the last one has a key
+ * longer than a block and a salt spanning several */
+struct vector_t {
+    const char* pass;
+    size_t plen;
+    const char* salt;
+    size_t slen;
+    uint32_t rounds;
+    const char* hex;
+};
+
+const struct vector_t vectors[] = {
+    { "password", 8, "salt", 4, 1,
+      "120fb6cffcf8b32c43e7225256c4f837a86548c92ccc35480805987cb70be17b" },
+    { "password", 8, "salt", 4, 4096,
+      "c5e478d59288c841aa530db6845c4c8d962893a001ce4e11a4963873aa98134a" },
+    { "passwordPASSWORDpassword", 24,
+      "saltSALTsaltSALTsaltSALTsaltSALTsalt", 36, 4096,
+      "348c89dbcbd32b2f32d814b8116e84cf2b17347ebc1800181c4e2a1fb8dd53e1"
+      "c635518c7dac47e9" },
+    { NULL, 100, NULL, 200, 3,
+      "7f35c46aa3562096146d0b7d3687b682a8f4be2f3323e15823c401fbe3534fd9"
+      "4802333a8d7a51206b40a92b321aadc1896ecf4601abf1a44afc9187e8a4c4b8"
+      "8c4eefd93c88" }
+};
+
+const int impls[] = {
+    SHA256_IMPL_SCALAR,
+    SHA256_IMPL_SHANI
+};
+
+int test_vectors(void);
+
 int main(int argc, char* argv[])
 {
-    int i;
+    int i, failed = 0;
     uint8_t* output;
     int len = DEFAULT_LENGTH;
     const uint8_t* pass = (uint8_t*)DEFAULT_PASS;
@@ -19,6 +52,16 @@ int main(int argc, char* argv[])
     uint32_t c = DEFAULT_ROUNDS;
 
     if (argc == 1) {
+        for (i = 0; i < (int)(sizeof(impls) / sizeof(impls[0])); i++) {
+            if (sha256_select_impl(impls[i]) != ECRYPT_NO_ERROR) {
+                continue;
+            }
+
+            fprintf(stdout, "********%s********\n", sha256_impl_name());
+            failed |= test_vectors();
+        }
+        sha256_select_impl(SHA256_IMPL_AUTO);
+
         fprintf(stdout, "Usage:\n\t-p\tPassword\n\t-s\tSalt\n\t-r\tRounds\n");
         fprintf(stdout, "\t-l\tKey Length\n\n");
         fprintf(stdout, "Using defaults!\n");
@@ -78,6 +121,40 @@ int main(int argc, char* argv[])
     }
 
     fprintf(stdout, "\n");
-    return 0;
+    free(output);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int test_vectors(void)
+{
+    uint8_t pass[100], salt[200], out[70];
+    char hex[141];
+    size_t i, j, len;
+    int failed = 0;
+
+    for (i = 0; i < sizeof(pass); i++) {
+        pass[i] = (uint8_t)i;
+    }
+    for (i = 0; i < sizeof(salt); i++) {
+        salt[i] = (uint8_t)(i + 7);
+    }
+
+    for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        len = strlen(vectors[i].hex) / 2;
+        pbkdf2_hmac_sha256(vectors[i].pass != NULL ?
+            (const uint8_t*)vectors[i].pass : pass, vectors[i].plen,
+            vectors[i].salt != NULL ? (const uint8_t*)vectors[i].salt : salt,
+            vectors[i].slen, out, len, vectors[i].rounds);
+        for (j = 0; j < len; j++) {
+            sprintf(&hex[j * 2], "%02x", out[j]);
+        }
+
+        fprintf(stdout, "vector %-17lu %s\n", (unsigned long)i,
+            strcmp(hex, vectors[i].hex) == 0 ? "ok" : "FAILED");
+        failed |= strcmp(hex, vectors[i].hex) != 0;
+    }
+
+    return failed;
 }
 
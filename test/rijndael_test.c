@@ -1,10 +1,522 @@
+/* Known answer tests for the AES code.  The block cipher vectors come from
+ * FIPS-197, appendix C, the modes of operation from NIST SP 800-38A,
+ * appendix F.  Every test is run once per implementation the
+ * running processor supports. */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <ecrypt/rijndael.h>
 
+#include "test_util.h"
+
+const uint8_t fips_key[32] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+    0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f
+};
+
+const uint8_t fips_pt[16] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+};
+
+const uint8_t fips_ct[3][16] = {
+    {
+        0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+        0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a
+    }, {
+        0xdd, 0xa9, 0x7c, 0xa4, 0x86, 0x4c, 0xdf, 0xe0,
+        0x6e, 0xaf, 0x70, 0xa0, 0xec, 0x0d, 0x71, 0x91
+    }, {
+        0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf,
+        0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89
+    }
+};
+
+const uint8_t sp_key128[16] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+const uint8_t sp_key256[32] = {
+    0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe,
+    0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+    0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7,
+    0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4
+};
+
+const uint8_t sp_pt[64] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+    0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
+    0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11,
+    0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17,
+    0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+};
+
+const uint8_t sp_ctr_iv[16] = {
+    0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+    0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+};
+
+/* F.5.1 CTR-AES128.Encrypt */
+const uint8_t sp_ctr128_ct[64] = {
+    0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26,
+    0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+    0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff,
+    0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+    0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e,
+    0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+    0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1,
+    0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee
+};
+
+/* F.5.5 CTR-AES256.Encrypt */
+const uint8_t sp_ctr256_ct[64] = {
+    0x60, 0x1e, 0xc3, 0x13, 0x77, 0x57, 0x89, 0xa5,
+    0xb7, 0xa7, 0xf5, 0x04, 0xbb, 0xf3, 0xd2, 0x28,
+    0xf4, 0x43, 0xe3, 0xca, 0x4d, 0x62, 0xb5, 0x9a,
+    0xca, 0x84, 0xe9, 0x90, 0xca, 0xca, 0xf5, 0xc5,
+    0x2b, 0x09, 0x30, 0xda, 0xa2, 0x3d, 0xe9, 0x4c,
+    0xe8, 0x70, 0x17, 0xba, 0x2d, 0x84, 0x98, 0x8d,
+    0xdf, 0xc9, 0xc5, 0x8d, 0xb6, 0x7a, 0xad, 0xa6,
+    0x13, 0xc2, 0xdd, 0x08, 0x45, 0x79, 0x41, 0xa6
+};
+
+const uint8_t sp_cbc_iv[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+
+/* F.2.1 CBC-AES128.Encrypt */
+const uint8_t sp_cbc128_ct[64] = {
+    0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46,
+    0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d,
+    0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72, 0x19, 0xee,
+    0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2,
+    0x73, 0xbe, 0xd6, 0xb8, 0xe3, 0xc1, 0x74, 0x3b,
+    0x71, 0x16, 0xe6, 0x9e, 0x22, 0x22, 0x95, 0x16,
+    0x3f, 0xf1, 0xca, 0xa1, 0x68, 0x1f, 0xac, 0x09,
+    0x12, 0x0e, 0xca, 0x30, 0x75, 0x86, 0xe1, 0xa7
+};
+
+int test_block(void);
+int test_schedule(int impl);
+int test_ctr(void);
+int test_ctr_mt(void);
+int test_cbc(void);
+int test_cache(int impl);
+int test_batch(void);
+int test_key_multi(int impl);
+int test_oneshot(void);
+
 int main(int argc, char* argv[])
 {
-    fprintf(stdout, "Test!\n");
-    return 0;
+    int failed = 0;
+    size_t i;
+
+    for (i = 0; i < aes_impl_count; i++) {
+        if (rijndael_select_impl(aes_impls[i]) != ECRYPT_NO_ERROR) {
+            continue;
+        }
+
+        fprintf(stdout, "********%s********\n", rijndael_impl_name(NULL));
+        failed |= test_block();
+        failed |= test_schedule(aes_impls[i]);
+        failed |= test_ctr();
+        failed |= test_ctr_mt();
+        failed |= test_cbc();
+        failed |= test_cache(aes_impls[i]);
+        failed |= test_batch();
+        failed |= test_key_multi(aes_impls[i]);
+        failed |= test_oneshot();
+    }
+    rijndael_select_impl(RIJNDAEL_IMPL_AUTO);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int test_block(void)
+{
+    int i, failed = 0;
+    char name[32];
+    uint8_t buf[16];
+    rijndael_ctx ctx;
+
+    for (i = 0; i < 3; i++) {
+        rijndael_set_key(&ctx, fips_key, 128 + 64*i);
+
+        rijndael_encrypt(&ctx, fips_pt, buf);
+        sprintf(name, "AES-%d encrypt", 128 + 64*i);
+        failed |= check(name, buf, fips_ct[i], 16);
+
+        rijndael_decrypt(&ctx, buf, buf);
+        sprintf(name, "AES-%d decrypt", 128 + 64*i);
+        failed |= check(name, buf, fips_pt, 16);
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    return failed;
+}
+
+/* every implementation has to produce the T-table code's key schedules */
+int test_schedule(int impl)
+{
+    int i, failed = 0;
+    char name[32];
+    rijndael_ctx ref, ctx;
+
+    for (i = 0; i < 3; i++) {
+        rijndael_select_impl(RIJNDAEL_IMPL_TABLE);
+        rijndael_set_key(&ref, fips_key, 128 + 64*i);
+        rijndael_select_impl(impl);
+        rijndael_set_key(&ctx, fips_key, 128 + 64*i);
+
+        sprintf(name, "AES-%d ek schedule", 128 + 64*i);
+        failed |= check(name, (uint8_t*)ctx.ek, (uint8_t*)ref.ek,
+            sizeof(ctx.ek[0]) * 4 * (ref.Nr + 1));
+        sprintf(name, "AES-%d dk schedule", 128 + 64*i);
+        failed |= check(name, (uint8_t*)ctx.dk, (uint8_t*)ref.dk,
+            sizeof(ctx.dk[0]) * 4 * (ref.Nr + 1));
+    }
+
+    memset(&ref, 0, sizeof(ref));
+    memset(&ctx, 0, sizeof(ctx));
+    return failed;
+}
+
+int test_ctr(void)
+{
+    int failed = 0;
+    uint32_t len, i, j;
+    uint8_t iv[16], ctr[16], ks[16];
+    uint8_t pt[300], ct[300], ref[300];
+    rijndael_ctx ctx;
+
+    rijndael_init(&ctx, sp_key128, 16);
+    rijndael_encrypt_ctr(&ctx, sp_ctr_iv, sp_pt, 64, ct);
+    failed |= check("CTR-AES128 encrypt", ct, sp_ctr128_ct, 64);
+    rijndael_decrypt_ctr(&ctx, sp_ctr_iv, ct, 64, ct);
+    failed |= check("CTR-AES128 decrypt", ct, sp_pt, 64);
+    rijndael_release(&ctx);
+
+    rijndael_init(&ctx, sp_key256, 32);
+    rijndael_encrypt_ctr(&ctx, sp_ctr_iv, sp_pt, 64, ct);
+    failed |= check("CTR-AES256 encrypt", ct, sp_ctr256_ct, 64);
+
+    /* every length, against one block at a time, with the counter about
+     * to carry all the way into its top byte */
+    memset(iv, 0xff, 16);
+    iv[0] = 0x42;
+    iv[15] = 0xfb;
+    fill(pt, sizeof(pt), 1);
+
+    for (len = 0; len <= sizeof(pt); len++) {
+        memcpy(ctr, iv, 16);
+        for (i = 0; i < len; i += 16) {
+            rijndael_encrypt(&ctx, ctr, ks);
+            for (j = i; j < len && j < i + 16; j++) {
+                ref[j] = pt[j] ^ ks[j - i];
+            }
+            for (j = 16; j > 0 && ++ctr[j - 1] == 0; j--) {
+            }
+        }
+
+        rijndael_encrypt_ctr(&ctx, iv, pt, len, ct);
+        if (memcmp(ct, ref, len) != 0) {
+            fprintf(stdout, "CTR length %u mismatch\n", len);
+            failed = 1;
+            break;
+        }
+    }
+    fprintf(stdout, "%-24s %s\n", "CTR lengths 0..300",
+        failed ? "FAILED" : "ok");
+    rijndael_release(&ctx);
+
+    return failed;
+}
+
+/* the threaded CTR has to match the single-threaded one exactly */
+int test_ctr_mt(void)
+{
+    const size_t lens[] = { 0, 1000, 256 * 1024 * 2 + 16, 256 * 1024 * 3 + 5,
+        (1 << 20) + 37 };
+    const int workers[] = { 0, 1, 2, 3, 7 };
+    const size_t max = (1 << 20) + 37;
+    int failed = 0;
+    size_t i, j;
+    uint8_t iv[16];
+    uint8_t *pt, *ct, *ref;
+    rijndael_ctx ctx;
+
+    pt = (uint8_t*)malloc(max);
+    ct = (uint8_t*)malloc(max);
+    ref = (uint8_t*)malloc(max);
+    if (pt == NULL || ct == NULL || ref == NULL) {
+        fprintf(stdout, "%-24s FAILED (out of memory)\n", "CTR threaded");
+        free(pt);
+        free(ct);
+        free(ref);
+        return 1;
+    }
+
+    /* one worker's range starts just before the counter carries */
+    memset(iv, 0xff, 16);
+    iv[0] = 0x42;
+    iv[13] = 0xfe;
+    fill(pt, max, 3);
+    rijndael_init(&ctx, sp_key256, 32);
+
+    for (i = 0; i < sizeof(lens) / sizeof(lens[0]) && !failed; i++) {
+        rijndael_encrypt_ctr(&ctx, iv, pt, lens[i], ref);
+        for (j = 0; j < sizeof(workers) / sizeof(workers[0]); j++) {
+            memset(ct, 0, lens[i]);
+            rijndael_encrypt_ctr_mt(&ctx, iv, pt, lens[i], ct, workers[j]);
+            if (memcmp(ct, ref, lens[i]) != 0) {
+                fprintf(stdout, "CTR length %lu, %d workers mismatch\n",
+                    (unsigned long)lens[i], workers[j]);
+                failed = 1;
+                break;
+            }
+        }
+    }
+
+    /* in place */
+    memcpy(ct, pt, max);
+    rijndael_decrypt_ctr_mt(&ctx, iv, ct, max, ct, 3);
+    rijndael_decrypt_ctr_mt(&ctx, iv, ct, max, ct, 2);
+    if (memcmp(ct, pt, max) != 0) {
+        fprintf(stdout, "CTR threaded in place mismatch\n");
+        failed = 1;
+    }
+    fprintf(stdout, "%-24s %s\n", "CTR threaded", failed ? "FAILED" : "ok");
+
+    rijndael_release(&ctx);
+    free(pt);
+    free(ct);
+    free(ref);
+    return failed;
+}
+
+int test_cbc(void)
+{
+    int failed = 0;
+    uint32_t len;
+    uint8_t pt[320], ct[320], buf[320];
+    rijndael_ctx ctx;
+
+    rijndael_init(&ctx, sp_key128, 16);
+    rijndael_encrypt_cbc(&ctx, sp_cbc_iv, sp_pt, 64, ct);
+    failed |= check("CBC-AES128 encrypt", ct, sp_cbc128_ct, 64);
+    rijndael_decrypt_cbc(&ctx, sp_cbc_iv, ct, 64, buf);
+    failed |= check("CBC-AES128 decrypt", buf, sp_pt, 64);
+
+    /* in place, for every block count either side of the batch size */
+    fill(pt, sizeof(pt), 2);
+    for (len = 0; len <= sizeof(pt); len += 16) {
+        rijndael_encrypt_cbc(&ctx, sp_cbc_iv, pt, len, ct);
+        memcpy(buf, ct, len);
+        rijndael_decrypt_cbc(&ctx, sp_cbc_iv, buf, len, buf);
+        if (memcmp(buf, pt, len) != 0) {
+            fprintf(stdout, "CBC length %u mismatch\n", len);
+            failed = 1;
+            break;
+        }
+    }
+    fprintf(stdout, "%-24s %s\n", "CBC in place 0..320",
+        failed ? "FAILED" : "ok");
+
+    if (rijndael_decrypt_cbc(&ctx, sp_cbc_iv, ct, 24, buf) !=
+        ECRYPT_INVALID_LENGTH) {
+        fprintf(stdout, "CBC accepted a partial block\n");
+        failed = 1;
+    }
+    rijndael_release(&ctx);
+
+    return failed;
+}
+
+/* cached contexts have to match freshly keyed ones, through evictions */
+int test_cache(int impl)
+{
+    int failed = 0;
+    uint32_t i, round;
+    uint8_t keys[40][32], buf[16];
+    rijndael_ctx ref, ctx;
+    struct rijndael_cache_t* cache;
+
+    /* the capacity rounds up to 16, so 40 keys keep evicting */
+    cache = rijndael_cache_create(16);
+    if (cache == NULL) {
+        fprintf(stdout, "%-24s FAILED (out of memory)\n", "cache");
+        return 1;
+    }
+    fill(&keys[0][0], sizeof(keys), 4);
+
+    for (round = 0; round < 3 && !failed; round++) {
+        for (i = 0; i < 40 && !failed; i++) {
+            uint32_t klen = 16 + 8 * (i % 3);
+            int decrypt = (i + round) % 2;
+
+            rijndael_select_impl(impl);
+            rijndael_set_key(&ref, keys[i], klen * 8);
+            memset(&ctx, 0, sizeof(ctx));
+            if (rijndael_cache_get(cache, keys[i], klen, decrypt, &ctx) !=
+                ECRYPT_NO_ERROR || ctx.Nr != ref.Nr ||
+                ctx.enc_only != !decrypt) {
+                failed = 1;
+                break;
+            }
+
+            failed |= memcmp(ctx.ek, ref.ek,
+                sizeof(ref.ek[0]) * 4 * (ref.Nr + 1)) != 0;
+            if (decrypt) {
+                failed |= memcmp(ctx.dk, ref.dk,
+                    sizeof(ref.dk[0]) * 4 * (ref.Nr + 1)) != 0;
+                rijndael_encrypt(&ctx, fips_pt, buf);
+                rijndael_decrypt(&ctx, buf, buf);
+                failed |= memcmp(buf, fips_pt, 16) != 0;
+            }
+        }
+    }
+
+    if (rijndael_cache_get(cache, keys[0], 20, 0, &ctx) !=
+        ECRYPT_INVALID_LENGTH) {
+        failed = 1;
+    }
+    fprintf(stdout, "%-24s %s\n", "key schedule cache",
+        failed ? "FAILED" : "ok");
+
+    rijndael_cache_destroy(cache);
+    memset(&ref, 0, sizeof(ref));
+    memset(&ctx, 0, sizeof(ctx));
+    return failed;
+}
+
+/* every job in a batch has to come out as if encrypted on its own */
+int test_batch(void)
+{
+    int failed = 0;
+    size_t i;
+    uint8_t keys[37][32], pt[37][16], ct[37][16], buf[37][16], sep[37][16];
+    rijndael_ctx ctx[37];
+    struct rijndael_batch_t jobs[37];
+
+    fill(&keys[0][0], sizeof(keys), 5);
+    fill(&pt[0][0], sizeof(pt), 6);
+
+    /* a run of one size, then the sizes mixed up */
+    for (i = 0; i < 37; i++) {
+        rijndael_set_key(&ctx[i], keys[i], i < 20 ? 128 : 128 + 64 * (i % 3));
+        rijndael_encrypt(&ctx[i], pt[i], ct[i]);
+
+        /* even jobs in place, odd ones into a separate buffer */
+        memcpy(buf[i], pt[i], 16);
+        jobs[i].ctx = &ctx[i];
+        jobs[i].in = buf[i];
+        jobs[i].out = i % 2 ? sep[i] : buf[i];
+    }
+
+    rijndael_encrypt_batch(jobs, 37);
+    for (i = 0; i < 37; i++) {
+        failed |= memcmp(jobs[i].out, ct[i], 16) != 0;
+        memcpy(buf[i], jobs[i].out, 16);
+    }
+
+    rijndael_decrypt_batch(jobs, 37);
+    for (i = 0; i < 37; i++) {
+        failed |= memcmp(jobs[i].out, pt[i], 16) != 0;
+    }
+
+    rijndael_set_key_enc_only(&ctx[5], keys[5], 128);
+    if (rijndael_decrypt_batch(jobs, 37) != ECRYPT_INVALID_PARAMETERS) {
+        failed = 1;
+    }
+    fprintf(stdout, "%-24s %s\n", "multi-key batch", failed ? "FAILED" : "ok");
+
+    memset(ctx, 0, sizeof(ctx));
+    return failed;
+}
+
+/* batched key expansion has to match the table code key by key */
+int test_key_multi(int impl)
+{
+    int failed = 0, bits;
+    size_t i;
+    uint8_t keys[37][32];
+    const uint8_t* kp[37];
+    rijndael_ctx ctx[37], ref;
+
+    fill(&keys[0][0], sizeof(keys), 7);
+    for (i = 0; i < 37; i++) {
+        kp[i] = keys[i];
+    }
+
+    for (bits = 128; bits <= 256; bits += 64) {
+        memset(ctx, 0, sizeof(ctx));
+        rijndael_select_impl(impl);
+        if (rijndael_init_enc_only_multi(ctx, kp, bits / 8, 37) !=
+            ECRYPT_NO_ERROR) {
+            failed = 1;
+            continue;
+        }
+
+        rijndael_select_impl(RIJNDAEL_IMPL_TABLE);
+        for (i = 0; i < 37; i++) {
+            rijndael_set_key_enc_only(&ref, keys[i], bits);
+            failed |= ctx[i].Nr != ref.Nr || !ctx[i].enc_only ||
+                memcmp(ctx[i].ek, ref.ek, sizeof(ref.ek[0]) * 4 *
+                (ref.Nr + 1)) != 0;
+        }
+    }
+    rijndael_select_impl(impl);
+
+    if (rijndael_init_enc_only_multi(ctx, kp, 20, 37) !=
+        ECRYPT_INVALID_LENGTH) {
+        failed = 1;
+    }
+    fprintf(stdout, "%-24s %s\n", "multi-key setup", failed ? "FAILED" : "ok");
+
+    memset(ctx, 0, sizeof(ctx));
+    memset(&ref, 0, sizeof(ref));
+    return failed;
+}
+
+/* one call against rijndael_encrypt block by block, in place and not */
+int test_oneshot(void)
+{
+    int failed = 0;
+    size_t i, n;
+    uint8_t key[32], pt[16 * 21], ct[16 * 21], buf[16 * 21];
+    rijndael_ctx ctx;
+
+    fill(key, sizeof(key), 8);
+    fill(pt, sizeof(pt), 9);
+    rijndael_init(&ctx, key, 24);
+    for (i = 0; i < sizeof(pt); i += 16) {
+        rijndael_encrypt(&ctx, pt + i, ct + i);
+    }
+
+    for (n = 0; n <= 21; n++) {
+        memset(buf, 0, sizeof(buf));
+        rijndael_encrypt_oneshot(key, 24, pt, 16 * n, buf);
+        failed |= memcmp(buf, ct, 16 * n) != 0;
+
+        memcpy(buf, pt, sizeof(buf));
+        rijndael_encrypt_oneshot(key, 24, buf, 16 * n, buf);
+        failed |= memcmp(buf, ct, 16 * n) != 0;
+    }
+
+    if (rijndael_encrypt_oneshot(key, 24, pt, 17, buf) !=
+        ECRYPT_INVALID_LENGTH) {
+        failed = 1;
+    }
+    fprintf(stdout, "%-24s %s\n", "one-shot encrypt", failed ? "FAILED" : "ok");
+
+    rijndael_release(&ctx);
+    return failed;
 }
@@ -0,0 +1,180 @@
+/* Known answer tests for SHA-256 from FIPS 180-2, under every compression
+ * function, and checks that sha256_multi gives every message the hash
+ * sha256_update would, however many there are and whatever their lengths,
+ * under every multi-buffer implementation. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ecrypt/sha256.h>
+
+#include "test_util.h"
+
+#define MULTI_JOBS	(100)
+#define MULTI_MAX_LEN	(1100)
+
+struct vector_t {
+    const char* name;
+    const char* msg;
+    uint8_t hash[SHA256_DIGEST_LENGTH];
+};
+
+const struct vector_t vectors[] = {
+    { "empty message", "", {
+    0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14,
+    0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+    0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c,
+    0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55 } },
+    { "\"abc\"", "abc", {
+    0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+    0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+    0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+    0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad } },
+    { "two block message",
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", {
+    0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+    0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+    0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+    0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1 } }
+};
+
+/* a million times 'a' */
+const uint8_t million_a[SHA256_DIGEST_LENGTH] = {
+    0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92,
+    0x81, 0xa1, 0xc7, 0xe2, 0x84, 0xd7, 0x3e, 0x67,
+    0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97, 0x20, 0x0e,
+    0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0
+};
+
+const int impls[] = {
+    SHA256_IMPL_SCALAR,
+    SHA256_IMPL_SHANI
+};
+
+const int multi_impls[] = {
+    SHA256_MULTI_SERIAL,
+    SHA256_MULTI_AVX2,
+    SHA256_MULTI_AVX512
+};
+
+int test_vectors(void);
+int test_multi(void);
+
+int main(int argc, char* argv[])
+{
+    int i, failed = 0;
+
+    for (i = 0; i < (int)(sizeof(impls) / sizeof(impls[0])); i++) {
+        if (sha256_select_impl(impls[i]) != ECRYPT_NO_ERROR) {
+            continue;
+        }
+
+        fprintf(stdout, "********%s********\n", sha256_impl_name());
+        failed |= test_vectors();
+    }
+    sha256_select_impl(SHA256_IMPL_AUTO);
+
+    for (i = 0; i < (int)(sizeof(multi_impls) / sizeof(multi_impls[0]));
+        i++) {
+        if (sha256_multi_select_impl(multi_impls[i]) != ECRYPT_NO_ERROR) {
+            continue;
+        }
+
+        fprintf(stdout, "********multi %s********\n", sha256_multi_impl_name());
+        failed |= test_multi();
+    }
+    sha256_multi_select_impl(SHA256_MULTI_AUTO);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int test_vectors(void)
+{
+    struct sha256_context_t ctx;
+    uint8_t hash[SHA256_DIGEST_LENGTH];
+    uint8_t chunk[1000];
+    int failed = 0;
+    size_t i;
+
+    for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        sha256_init(&ctx);
+        sha256_update(&ctx, (const uint8_t*)vectors[i].msg,
+            strlen(vectors[i].msg));
+        sha256_finalize(&ctx, hash);
+        failed |= check(vectors[i].name, hash, vectors[i].hash, sizeof(hash));
+    }
+
+    /* in pieces that leave the buffer half full */
+    memset(chunk, 'a', sizeof(chunk));
+    sha256_init(&ctx);
+    sha256_update(&ctx, chunk, 1);
+    for (i = 0; i < 999; i++) {
+        sha256_update(&ctx, chunk, sizeof(chunk));
+    }
+    sha256_update(&ctx, chunk, 999);
+    sha256_finalize(&ctx, hash);
+    failed |= check("million a", hash, million_a, sizeof(hash));
+
+    return failed;
+}
+
+/* Hashes the first n of a set of messages whose lengths run through every
+ * padding case, with a few long ones in between so that lanes finish at
+ * different times, and checks each against sha256_update. */
+int test_multi(void)
+{
+    static uint8_t msg[MULTI_MAX_LEN];
+    static uint8_t digest[MULTI_JOBS][SHA256_DIGEST_LENGTH];
+    static uint8_t want[MULTI_JOBS][SHA256_DIGEST_LENGTH];
+    const size_t counts[] = { 1, 3, 8, 9, 16, 17, 40, MULTI_JOBS };
+    struct sha256_batch_t jobs[MULTI_JOBS];
+    struct sha256_context_t ctx;
+    int failed = 0, bad;
+    size_t i, c;
+    char name[32];
+
+    for (i = 0; i < sizeof(msg); i++) {
+        msg[i] = (uint8_t)(i * 7 + 3);
+    }
+
+    for (i = 0; i < MULTI_JOBS; i++) {
+        jobs[i].msg = &msg[i % 5];
+        jobs[i].len = (i % 7 == 3) ? MULTI_MAX_LEN - 5 - i : (i * 13) % 150;
+        jobs[i].digest = digest[i];
+        sha256_init(&ctx);
+        sha256_update(&ctx, jobs[i].msg, jobs[i].len);
+        sha256_finalize(&ctx, want[i]);
+    }
+
+    /* a failed call leaves the zeroed digests behind */
+    for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        memset(digest, 0, sizeof(digest));
+        sha256_multi(jobs, counts[c]);
+        snprintf(name, sizeof(name), "%lu messages", (unsigned long)counts[c]);
+        failed |= check(name, digest[0], want[0],
+            counts[c] * SHA256_DIGEST_LENGTH);
+    }
+
+    jobs[0].msg = (const uint8_t*)vectors[1].msg;
+    jobs[0].len = 3;
+    jobs[1].msg = NULL;
+    jobs[1].len = 0;
+    memset(digest, 0, sizeof(digest));
+    sha256_multi(jobs, 2);
+    failed |= check("multi \"abc\"", digest[0], vectors[1].hash,
+        SHA256_DIGEST_LENGTH);
+    failed |= check("multi empty message", digest[1], vectors[0].hash,
+        SHA256_DIGEST_LENGTH);
+
+    bad = sha256_multi(NULL, 1) != ECRYPT_NULL_PTR;
+    jobs[1].len = 1;
+    bad |= sha256_multi(jobs, 2) != ECRYPT_NULL_PTR;
+    jobs[1].msg = msg;
+    jobs[1].digest = NULL;
+    bad |= sha256_multi(jobs, 2) != ECRYPT_NULL_PTR;
+    bad |= sha256_multi(jobs, 0) != ECRYPT_NO_ERROR;
+    fprintf(stdout, "%-24s %s\n", "null pointers", bad ? "FAILED" : "ok");
+    failed |= bad;
+
+    return failed;
+}
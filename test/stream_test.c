@@ -0,0 +1,407 @@
+/* Checks for the streaming CBC and CTR contexts and the scatter-gather
+ * functions: the output has to be the same as the one-shot functions
+ * give, however the message is cut into pieces. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include <ecrypt/blowfish.h>
+#include <ecrypt/rijndael.h>
+
+#include "test_util.h"
+
+/* AES-128 CBC with PKCS #7, key 00..0f, iv 10..1f, checked against
+ * OpenSSL; the plaintext is "a streaming test message" */
+const uint8_t pkcs7_ct[32] = {
+    0x35, 0x12, 0xb9, 0x15, 0x63, 0x80, 0x59, 0x87,
+    0xaf, 0xd0, 0xe7, 0x16, 0x5a, 0x60, 0x72, 0x6b,
+    0x44, 0xd4, 0x1f, 0x79, 0xa7, 0x43, 0x0d, 0x77,
+    0x10, 0x51, 0x65, 0x08, 0x8b, 0x35, 0xd7, 0xf2
+};
+
+/* the piece sizes each message is cut into, in turn */
+const size_t chunks[] = { 1, 7, 8, 15, 16, 17, 100, 1000 };
+
+/* segment lengths for the scatter-gather tests, 1000 bytes each; the two
+ * lists are cut in different places */
+const size_t in_cuts[] = { 1, 15, 33, 7, 200, 0, 16, 328, 400 };
+const size_t out_cuts[] = { 24, 3, 500, 9, 64, 400 };
+
+int aes_tests(void);
+int cut(struct iovec* v, const size_t* lens, int cnt, uint8_t* buf,
+    size_t len);
+int run_aes(struct rijndael_stream_t* s, const uint8_t* in, size_t len,
+    size_t chunk, uint8_t* out, size_t* out_len);
+int run_blowfish(struct blowfish_stream_t* s, const uint8_t* in, size_t len,
+    size_t chunk, uint8_t* out, size_t* out_len);
+int test_kat(void);
+int test_aes_chunks(void);
+int test_blowfish_chunks(void);
+int test_aes_iov(void);
+int test_blowfish_iov(void);
+int test_reject(void);
+
+int main(int argc, char* argv[])
+{
+    int failed = 0;
+
+    failed |= run_aes_impls(aes_tests);
+
+    fprintf(stdout, "********blowfish********\n");
+    failed |= test_blowfish_chunks();
+    failed |= test_blowfish_iov();
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int aes_tests(void)
+{
+    int failed = 0;
+
+    failed |= test_kat();
+    failed |= test_aes_chunks();
+    failed |= test_aes_iov();
+    failed |= test_reject();
+
+    return failed;
+}
+
+/* buf split into segments of the given lengths, the last one taking
+ * whatever is left of len; returns the number of segments */
+int cut(struct iovec* v, const size_t* lens, int cnt, uint8_t* buf,
+    size_t len)
+{
+    int i;
+
+    for (i = 0; i < cnt - 1; i++) {
+        v[i].iov_base = buf;
+        v[i].iov_len = lens[i];
+        buf += lens[i];
+        len -= lens[i];
+    }
+    v[i].iov_base = buf;
+    v[i].iov_len = len;
+
+    return cnt;
+}
+
+/* the whole of in through s, chunk bytes at a time, then final */
+int run_aes(struct rijndael_stream_t* s, const uint8_t* in, size_t len,
+    size_t chunk, uint8_t* out, size_t* out_len)
+{
+    size_t i, n, got;
+    int err;
+
+    *out_len = 0;
+    for (i = 0; i < len; i += n) {
+        n = len - i < chunk ? len - i : chunk;
+        err = rijndael_stream_update(s, in + i, n, out + *out_len, &got);
+        if (err != ECRYPT_NO_ERROR) {
+            return err;
+        }
+        *out_len += got;
+    }
+
+    err = rijndael_stream_final(s, out + *out_len, &got);
+    *out_len += got;
+
+    return err;
+}
+
+int run_blowfish(struct blowfish_stream_t* s, const uint8_t* in, size_t len,
+    size_t chunk, uint8_t* out, size_t* out_len)
+{
+    size_t i, n, got;
+    int err;
+
+    *out_len = 0;
+    for (i = 0; i < len; i += n) {
+        n = len - i < chunk ? len - i : chunk;
+        err = blowfish_stream_update(s, in + i, n, out + *out_len, &got);
+        if (err != ECRYPT_NO_ERROR) {
+            return err;
+        }
+        *out_len += got;
+    }
+
+    err = blowfish_stream_final(s, out + *out_len, &got);
+    *out_len += got;
+
+    return err;
+}
+
+int test_kat(void)
+{
+    const char* msg = "a streaming test message";
+    int failed = 0;
+    uint8_t key[16], iv[16], out[48];
+    size_t i, len;
+    struct rijndael_stream_t s;
+    rijndael_ctx ctx;
+
+    for (i = 0; i < 16; i++) {
+        key[i] = (uint8_t)i;
+        iv[i] = (uint8_t)(0x10 + i);
+    }
+    rijndael_set_key(&ctx, key, 128);
+
+    rijndael_stream_init(&s, &ctx, RIJNDAEL_STREAM_CBC_ENCRYPT,
+        RIJNDAEL_PAD_PKCS7, iv);
+    failed |= run_aes(&s, (const uint8_t*)msg, strlen(msg), 5, out, &len);
+    failed |= len != sizeof(pkcs7_ct);
+    failed |= check("CBC PKCS #7 encrypt", out, pkcs7_ct, sizeof(pkcs7_ct));
+
+    rijndael_stream_init(&s, &ctx, RIJNDAEL_STREAM_CBC_DECRYPT,
+        RIJNDAEL_PAD_PKCS7, iv);
+    failed |= run_aes(&s, pkcs7_ct, sizeof(pkcs7_ct), 16, out, &len);
+    failed |= len != strlen(msg);
+    failed |= check("CBC PKCS #7 decrypt", out, (const uint8_t*)msg,
+        strlen(msg));
+
+    return failed;
+}
+
+int test_aes_chunks(void)
+{
+    int failed = 0, err = 0;
+    uint8_t key[32], iv[16], pt[1000], want[1016], got[1016], back[1016];
+    size_t c, len, n;
+    struct rijndael_stream_t s;
+    rijndael_ctx ctx;
+
+    fill(key, sizeof(key), 1);
+    fill(iv, sizeof(iv), 2);
+    fill(pt, sizeof(pt), 3);
+    rijndael_set_key(&ctx, key, 256);
+
+    for (c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        /* CBC without padding, on a whole number of blocks */
+        rijndael_encrypt_cbc(&ctx, iv, pt, 992, want);
+        rijndael_stream_init(&s, &ctx, RIJNDAEL_STREAM_CBC_ENCRYPT,
+            RIJNDAEL_PAD_NONE, iv);
+        err |= run_aes(&s, pt, 992, chunks[c], got, &len);
+        failed |= len != 992 || memcmp(got, want, 992) != 0;
+
+        rijndael_stream_init(&s, &ctx, RIJNDAEL_STREAM_CBC_DECRYPT,
+            RIJNDAEL_PAD_NONE, iv);
+        err |= run_aes(&s, want, 992, chunks[c], back, &len);
+        failed |= len != 992 || memcmp(back, pt, 992) != 0;
+
+        /* CTR, including the partial last block */
+        rijndael_encrypt_ctr(&ctx, iv, pt, sizeof(pt), want);
+        rijndael_stream_init(&s, &ctx, RIJNDAEL_STREAM_CTR,
+            RIJNDAEL_PAD_NONE, iv);
+        err |= run_aes(&s, pt, sizeof(pt), chunks[c], got, &len);
+        failed |= len != sizeof(pt) || memcmp(got, want, sizeof(pt)) != 0;
+
+        /* padded round trips, ending on and off a block boundary */
+        for (n = 991; n <= 992; n++) {
+            rijndael_stream_init(&s, &ctx, RIJNDAEL_STREAM_CBC_ENCRYPT,
+                RIJNDAEL_PAD_PKCS7, iv);
+            err |= run_aes(&s, pt, n, chunks[c], got, &len);
+            failed |= len != (n / 16 + 1) * 16;
+
+            rijndael_stream_init(&s, &ctx, RIJNDAEL_STREAM_CBC_DECRYPT,
+                RIJNDAEL_PAD_PKCS7, iv);
+            err |= run_aes(&s, got, len, chunks[c], back, &len);
+            failed |= len != n || memcmp(back, pt, n) != 0;
+        }
+    }
+
+    failed |= err != ECRYPT_NO_ERROR;
+    fprintf(stdout, "%-24s %s\n", "AES piece sizes", failed ? "FAILED" : "ok");
+
+    return failed;
+}
+
+int test_blowfish_chunks(void)
+{
+    int failed = 0, err = 0;
+    uint8_t key[16], iv[8], pt[1000], want[1008], got[1008], back[1008];
+    uint8_t ctr[8 * 125];
+    size_t c, i, len;
+    struct blowfish_stream_t s;
+    struct blowfish_context_t ctx;
+
+    fill(key, sizeof(key), 4);
+    fill(pt, sizeof(pt), 5);
+    blowfish_init(&ctx, key, sizeof(key));
+
+    /* the counter carries out of the low 32 bits after two blocks */
+    memcpy(iv, "\x01\x02\x03\x04\xff\xff\xff\xfe", 8);
+    for (i = 0; i < 125; i++) {
+        uint64_t v = 0x01020304fffffffeULL + i;
+        int b;
+
+        for (b = 0; b < 8; b++) {
+            ctr[8 * i + b] = (uint8_t)(v >> (56 - 8 * b));
+        }
+    }
+
+    for (c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        blowfish_encrypt(&ctx, iv, pt, 1000, want);
+        blowfish_stream_init(&s, &ctx, BLOWFISH_STREAM_CBC_ENCRYPT,
+            BLOWFISH_PAD_NONE, iv);
+        err |= run_blowfish(&s, pt, 1000, chunks[c], got, &len);
+        failed |= len != 1000 || memcmp(got, want, 1000) != 0;
+
+        blowfish_stream_init(&s, &ctx, BLOWFISH_STREAM_CBC_DECRYPT,
+            BLOWFISH_PAD_NONE, iv);
+        err |= run_blowfish(&s, want, 1000, chunks[c], back, &len);
+        failed |= len != 1000 || memcmp(back, pt, 1000) != 0;
+
+        /* CTR is the ECB encryption of successive counters */
+        blowfish_encrypt_ecb(&ctx, ctr, sizeof(ctr), want);
+        for (i = 0; i < 999; i++) {
+            want[i] ^= pt[i];
+        }
+        blowfish_stream_init(&s, &ctx, BLOWFISH_STREAM_CTR,
+            BLOWFISH_PAD_NONE, iv);
+        err |= run_blowfish(&s, pt, 999, chunks[c], got, &len);
+        failed |= len != 999 || memcmp(got, want, 999) != 0;
+
+        blowfish_stream_init(&s, &ctx, BLOWFISH_STREAM_CBC_ENCRYPT,
+            BLOWFISH_PAD_PKCS7, iv);
+        err |= run_blowfish(&s, pt, 999, chunks[c], got, &len);
+        failed |= len != 1000;
+        blowfish_stream_init(&s, &ctx, BLOWFISH_STREAM_CBC_DECRYPT,
+            BLOWFISH_PAD_PKCS7, iv);
+        err |= run_blowfish(&s, got, len, chunks[c], back, &len);
+        failed |= len != 999 || memcmp(back, pt, 999) != 0;
+    }
+
+    failed |= err != ECRYPT_NO_ERROR;
+    fprintf(stdout, "%-24s %s\n", "Blowfish piece sizes",
+        failed ? "FAILED" : "ok");
+
+    blowfish_end(&ctx);
+    return failed;
+}
+
+int test_aes_iov(void)
+{
+    int failed = 0, err = 0, ni, no;
+    uint8_t key[16], iv[16], pt[1000], want[1000], got[1000];
+    struct iovec in[9], out[6];
+    rijndael_ctx ctx;
+
+    fill(key, sizeof(key), 9);
+    fill(iv, sizeof(iv), 10);
+    fill(pt, sizeof(pt), 11);
+    rijndael_set_key(&ctx, key, 128);
+
+    ni = cut(in, in_cuts, 9, pt, 992);
+    no = cut(out, out_cuts, 6, got, 992);
+    rijndael_encrypt_cbc(&ctx, iv, pt, 992, want);
+    err |= rijndael_encrypt_cbc_iov(&ctx, iv, in, ni, out, no);
+    failed |= memcmp(got, want, 992) != 0;
+
+    /* in place, cut the other way */
+    ni = cut(in, out_cuts, 6, got, 992);
+    err |= rijndael_decrypt_cbc_iov(&ctx, iv, in, ni, in, ni);
+    failed |= memcmp(got, pt, 992) != 0;
+
+    ni = cut(in, in_cuts, 9, pt, 1000);
+    no = cut(out, out_cuts, 6, got, 1000);
+    rijndael_encrypt_ctr(&ctx, iv, pt, 1000, want);
+    err |= rijndael_encrypt_ctr_iov(&ctx, iv, in, ni, out, no);
+    failed |= memcmp(got, want, 1000) != 0;
+
+    /* the lengths have to match, and CBC needs whole blocks */
+    failed |= rijndael_encrypt_ctr_iov(&ctx, iv, in, ni, out, no - 1) !=
+        ECRYPT_INVALID_LENGTH;
+    failed |= rijndael_encrypt_cbc_iov(&ctx, iv, in, ni, out, no) !=
+        ECRYPT_INVALID_LENGTH;
+
+    failed |= err != ECRYPT_NO_ERROR;
+    fprintf(stdout, "%-24s %s\n", "AES scatter-gather",
+        failed ? "FAILED" : "ok");
+
+    return failed;
+}
+
+int test_blowfish_iov(void)
+{
+    int failed = 0, err = 0, ni, no;
+    uint8_t key[16], iv[8], pt[1000], want[1000], got[1000];
+    struct iovec in[9], out[6];
+    struct blowfish_context_t ctx;
+
+    fill(key, sizeof(key), 12);
+    fill(iv, sizeof(iv), 13);
+    fill(pt, sizeof(pt), 14);
+    blowfish_init(&ctx, key, sizeof(key));
+
+    ni = cut(in, in_cuts, 9, pt, 1000);
+    no = cut(out, out_cuts, 6, got, 1000);
+    blowfish_encrypt(&ctx, iv, pt, 1000, want);
+    err |= blowfish_encrypt_iov(&ctx, iv, in, ni, out, no);
+    failed |= memcmp(got, want, 1000) != 0;
+
+    ni = cut(in, out_cuts, 6, got, 1000);
+    err |= blowfish_decrypt_iov(&ctx, iv, in, ni, in, ni);
+    failed |= memcmp(got, pt, 1000) != 0;
+
+    failed |= err != ECRYPT_NO_ERROR;
+    fprintf(stdout, "%-24s %s\n", "Blowfish scatter-gather",
+        failed ? "FAILED" : "ok");
+
+    blowfish_end(&ctx);
+    return failed;
+}
+
+int test_reject(void)
+{
+    int failed = 0;
+    uint8_t key[16], iv[16], pt[32], ct[48], out[48];
+    size_t len;
+    struct rijndael_stream_t s;
+    rijndael_ctx ctx;
+
+    fill(key, sizeof(key), 6);
+    fill(iv, sizeof(iv), 7);
+    fill(pt, sizeof(pt), 8);
+
+    rijndael_set_key_enc_only(&ctx, key, 128);
+    if (rijndael_stream_init(&s, &ctx, RIJNDAEL_STREAM_CBC_DECRYPT,
+        RIJNDAEL_PAD_NONE, iv) != ECRYPT_INVALID_PARAMETERS) {
+        fprintf(stdout, "stream decrypted with an encrypt-only key\n");
+        failed = 1;
+    }
+
+    rijndael_set_key(&ctx, key, 128);
+    rijndael_stream_init(&s, &ctx, RIJNDAEL_STREAM_CBC_ENCRYPT,
+        RIJNDAEL_PAD_NONE, iv);
+    if (run_aes(&s, pt, 20, 20, out, &len) != ECRYPT_INVALID_LENGTH) {
+        fprintf(stdout, "stream accepted a partial block without padding\n");
+        failed = 1;
+    }
+    if (rijndael_stream_update(&s, pt, 16, out, &len) !=
+        ECRYPT_INVALID_PARAMETERS) {
+        fprintf(stdout, "stream was used after final\n");
+        failed = 1;
+    }
+
+    /* the padding claims 0x11 bytes once the last byte is flipped */
+    rijndael_stream_init(&s, &ctx, RIJNDAEL_STREAM_CBC_ENCRYPT,
+        RIJNDAEL_PAD_PKCS7, iv);
+    run_aes(&s, pt, 32, 32, ct, &len);
+    ct[31] ^= 0x10 ^ 0x11;
+    rijndael_stream_init(&s, &ctx, RIJNDAEL_STREAM_CBC_DECRYPT,
+        RIJNDAEL_PAD_PKCS7, iv);
+    if (run_aes(&s, ct, 48, 48, out, &len) != ECRYPT_INVALID_PADDING) {
+        fprintf(stdout, "stream accepted bad padding\n");
+        failed = 1;
+    }
+
+    rijndael_stream_init(&s, &ctx, RIJNDAEL_STREAM_CBC_DECRYPT,
+        RIJNDAEL_PAD_PKCS7, iv);
+    if (run_aes(&s, ct, 40, 40, out, &len) != ECRYPT_INVALID_LENGTH) {
+        fprintf(stdout, "stream accepted a partial ciphertext block\n");
+        failed = 1;
+    }
+    fprintf(stdout, "%-24s %s\n", "stream rejects", failed ? "FAILED" : "ok");
+
+    return failed;
+}
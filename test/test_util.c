@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <ecrypt/rijndael.h>
+
+#include "test_util.h"
+
+const int aes_impls[] = {
+    RIJNDAEL_IMPL_TABLE,
+    RIJNDAEL_IMPL_AESNI,
+    RIJNDAEL_IMPL_VPERM,
+    RIJNDAEL_IMPL_VAES256,
+    RIJNDAEL_IMPL_VAES512
+};
+
+const size_t aes_impl_count = sizeof(aes_impls) / sizeof(aes_impls[0]);
+
+int check(const char* what, const uint8_t* got, const uint8_t* want,
+    size_t len)
+{
+    size_t i;
+    int ok = memcmp(got, want, len) == 0;
+
+    fprintf(stdout, "%-24s ", what);
+    for (i = 0; i < len && i < 16; i++) {
+        fprintf(stdout, "%02x", got[i]);
+    }
+    fprintf(stdout, " %s\n", ok ? "ok" : "FAILED");
+
+    return !ok;
+}
+
+void fill(uint8_t* buf, size_t len, uint32_t seed)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = (uint8_t)(seed >> 16);
+    }
+}
+
+int run_aes_impls(int (*tests)(void))
+{
+    int failed = 0;
+    size_t i;
+
+    for (i = 0; i < aes_impl_count; i++) {
+        if (rijndael_select_impl(aes_impls[i]) != ECRYPT_NO_ERROR) {
+            continue;
+        }
+
+        fprintf(stdout, "********%s********\n", rijndael_impl_name(NULL));
+        failed |= tests();
+    }
+    rijndael_select_impl(RIJNDAEL_IMPL_AUTO);
+
+    return failed;
+}
@@ -0,0 +1,44 @@
+#ifndef ECRYPT_TEST_UTIL_H
+#define ECRYPT_TEST_UTIL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Helpers shared by the test programs. */
+
+/* every AES implementation, whether or not this processor supports it */
+extern const int aes_impls[];
+extern const size_t aes_impl_count;
+
+/* check:
+ *
+ * description:
+ *     Prints what, the first bytes of got and "ok" or "FAILED".
+ *
+ * outputs:
+ *     int: 1 if the len bytes of got and want differ, otherwise 0.
+ *****************************************************************************/
+int check(const char* what, const uint8_t* got, const uint8_t* want,
+    size_t len);
+
+/* fill:
+ *
+ * description:
+ *     Deterministic filler data for the self-consistency checks; the same
+ *     seed always gives the same bytes.
+ *****************************************************************************/
+void fill(uint8_t* buf, size_t len, uint32_t seed);
+
+/* run_aes_impls:
+ *
+ * description:
+ *     Runs tests once under each AES implementation the running processor
+ *     supports, each run under a header naming it, and goes back to
+ *     RIJNDAEL_IMPL_AUTO afterwards.
+ *
+ * outputs:
+ *     int: nonzero if any run of tests returned nonzero.
+ *****************************************************************************/
+int run_aes_impls(int (*tests)(void));
+
+#endif /* ECRYPT_TEST_UTIL_H */
@@ -0,0 +1,230 @@
+/* XTS-AES against IEEE 1619 vectors 2 and 15 and OpenSSL-checked ones. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ecrypt/xts.h>
+
+#include "test_util.h"
+
+/* vector 2: keys 11..11 and 22..22, sector 0x3333333333, 32 x 0x44 */
+const uint8_t v2_ct[32] = {
+    0xc4, 0x54, 0x18, 0x5e, 0x6a, 0x16, 0x93, 0x6e,
+    0x39, 0x33, 0x40, 0x38, 0xac, 0xef, 0x83, 0x8b,
+    0xfb, 0x18, 0x6f, 0xff, 0x74, 0x80, 0xad, 0xc4,
+    0x28, 0x93, 0x82, 0xec, 0xd6, 0xd3, 0x94, 0xf0
+};
+
+/* vector 15: keys fffefd.. and bfbebd.., sector 0x123456789a, 17 bytes
+ * 00..10, so the second block is stolen from the first */
+const uint8_t v15_ct[17] = {
+    0x6c, 0x16, 0x25, 0xdb, 0x46, 0x71, 0x52, 0x2d,
+    0x3d, 0x75, 0x99, 0x60, 0x1d, 0xe7, 0xca, 0x09,
+    0xed
+};
+
+/* XTS-AES-256, key[i] = 13 * i + 5, three 200 byte sectors starting at
+ * 2^64 - 2, pt[i] = 7 * i.  Bytes 112..127 and 176..199 of each sector:
+ * the last block of the first eight, and the stolen tail. */
+const uint8_t long_ct[120] = {
+    0x49, 0x11, 0x66, 0x75, 0x21, 0x3f, 0x34, 0x09,
+    0x5f, 0xb6, 0xb0, 0x53, 0x3d, 0xbc, 0x0b, 0xe8,
+    0x1a, 0x30, 0x7f, 0xf7, 0xfa, 0x0f, 0x9b, 0x3a,
+    0x0b, 0xbf, 0xbe, 0x9b, 0xde, 0x73, 0x5e, 0xa4,
+    0xa1, 0x5a, 0x22, 0x1d, 0xb5, 0x3b, 0x58, 0x28,
+    0xbe, 0xf9, 0x6a, 0xd8, 0x4b, 0x07, 0xba, 0xea,
+    0xa2, 0x70, 0x8a, 0x6f, 0xc5, 0xd3, 0xbb, 0x90,
+    0xfe, 0x9e, 0xc3, 0xc7, 0xdb, 0x65, 0x15, 0x06,
+    0x1e, 0x66, 0x35, 0x5f, 0x15, 0xcc, 0x4f, 0x28,
+    0x9c, 0xed, 0xe4, 0x90, 0x97, 0xf2, 0x0e, 0x6d,
+    0x18, 0xb1, 0x77, 0xf6, 0x46, 0xd3, 0x59, 0x25,
+    0x50, 0x1f, 0x6a, 0x87, 0x5e, 0x7d, 0x9e, 0x36,
+    0xef, 0x1a, 0x49, 0x73, 0x51, 0xa2, 0x12, 0xbb,
+    0x30, 0xa8, 0xc9, 0x79, 0x4a, 0x30, 0x39, 0xe7,
+    0x59, 0x72, 0x28, 0x68, 0x9e, 0xdf, 0xb7, 0x13
+};
+
+int aes_tests(void);
+int test_kat(void);
+int test_long(void);
+int test_sectors(void);
+int test_reject(void);
+
+int main(int argc, char* argv[])
+{
+    int failed = 0;
+
+    failed |= run_aes_impls(aes_tests);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int aes_tests(void)
+{
+    int failed = 0;
+
+    failed |= test_kat();
+    failed |= test_long();
+    failed |= test_sectors();
+    failed |= test_reject();
+
+    return failed;
+}
+
+int test_kat(void)
+{
+    int failed = 0;
+    size_t i;
+    uint8_t key[32], pt[32], buf[32];
+    xts_ctx ctx;
+
+    memset(key, 0x11, 16);
+    memset(key + 16, 0x22, 16);
+    memset(pt, 0x44, 32);
+    xts_set_key(&ctx, key, 32);
+    xts_encrypt_sector(&ctx, 0x3333333333ULL, pt, 32, buf);
+    failed |= check("IEEE 1619 vector 2", buf, v2_ct, 32);
+    xts_decrypt_sector(&ctx, 0x3333333333ULL, buf, 32, buf);
+    failed |= check("IEEE 1619 vector 2 dec", buf, pt, 32);
+
+    for (i = 0; i < 16; i++) {
+        key[i] = (uint8_t)(0xff - i);
+        key[16 + i] = (uint8_t)(0xbf - i);
+    }
+    for (i = 0; i < 17; i++) {
+        pt[i] = (uint8_t)i;
+    }
+    xts_set_key(&ctx, key, 32);
+    xts_encrypt_sector(&ctx, 0x123456789aULL, pt, 17, buf);
+    failed |= check("IEEE 1619 vector 15", buf, v15_ct, 17);
+    xts_decrypt_sector(&ctx, 0x123456789aULL, buf, 17, buf);
+    failed |= check("IEEE 1619 vector 15 dec", buf, pt, 17);
+
+    xts_release(&ctx);
+    return failed;
+}
+
+/* several sectors in one call, across the 64-bit sector number boundary */
+int test_long(void)
+{
+    int failed = 0;
+    size_t i;
+    uint8_t key[64], pt[600], ct[600], got[120];
+    xts_ctx ctx;
+
+    for (i = 0; i < sizeof(key); i++) {
+        key[i] = (uint8_t)(13 * i + 5);
+    }
+    for (i = 0; i < sizeof(pt); i++) {
+        pt[i] = (uint8_t)(7 * i);
+    }
+
+    xts_set_key(&ctx, key, 64);
+    xts_encrypt_sectors(&ctx, 0xfffffffffffffffeULL, 200, pt, sizeof(pt),
+        ct);
+    for (i = 0; i < 3; i++) {
+        memcpy(got + 40 * i, ct + 200 * i + 112, 16);
+        memcpy(got + 40 * i + 16, ct + 200 * i + 176, 24);
+    }
+    failed |= check("XTS-AES-256 3 sectors", got, long_ct, sizeof(got));
+
+    xts_decrypt_sectors(&ctx, 0xfffffffffffffffeULL, 200, ct, sizeof(ct),
+        ct);
+    failed |= check("XTS-AES-256 3 sectors dec", ct, pt, sizeof(pt));
+
+    xts_release(&ctx);
+    return failed;
+}
+
+/*
+* A range of sectors has to come out the same as the sectors one at a
+* time, for whole and partial last blocks, and in place.
+*/
+int test_sectors(void)
+{
+    const size_t lens[] = { 16, 31, 512, 520, 4096 };
+    int failed = 0;
+    size_t i, s, n;
+    uint8_t key[32];
+    uint8_t* pt = (uint8_t*)malloc(11 * 4096);
+    uint8_t* ref = (uint8_t*)malloc(11 * 4096);
+    uint8_t* buf = (uint8_t*)malloc(11 * 4096);
+    xts_ctx ctx;
+
+    if (pt == NULL || ref == NULL || buf == NULL) {
+        free(pt);
+        free(ref);
+        free(buf);
+        return 1;
+    }
+
+    fill(key, sizeof(key), 3);
+    xts_set_key(&ctx, key, 32);
+
+    for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        n = 11 * lens[i];
+        fill(pt, n, (uint32_t)i);
+
+        for (s = 0; s < 11; s++) {
+            xts_encrypt_sector(&ctx, 1000 + s, pt + s * lens[i], lens[i],
+                ref + s * lens[i]);
+        }
+
+        memcpy(buf, pt, n);
+        xts_encrypt_sectors(&ctx, 1000, lens[i], buf, n, buf);
+        if (memcmp(buf, ref, n) != 0) {
+            fprintf(stdout, "XTS %lu byte sectors mismatch\n",
+                (unsigned long)lens[i]);
+            failed = 1;
+        }
+
+        xts_decrypt_sectors(&ctx, 1000, lens[i], buf, n, buf);
+        if (memcmp(buf, pt, n) != 0) {
+            fprintf(stdout, "XTS %lu byte sectors did not decrypt\n",
+                (unsigned long)lens[i]);
+            failed = 1;
+        }
+    }
+    fprintf(stdout, "%-24s %s\n", "XTS sector ranges",
+        failed ? "FAILED" : "ok");
+
+    xts_release(&ctx);
+    free(pt);
+    free(ref);
+    free(buf);
+    return failed;
+}
+
+int test_reject(void)
+{
+    int failed = 0;
+    uint8_t key[64], buf[64];
+    xts_ctx ctx;
+
+    memset(key, 0x5a, sizeof(key));
+    if (xts_set_key(&ctx, key, 64) != ECRYPT_INVALID_PARAMETERS) {
+        fprintf(stdout, "XTS accepted two equal keys\n");
+        failed = 1;
+    }
+    if (xts_set_key(&ctx, key, 48) != ECRYPT_INVALID_LENGTH) {
+        fprintf(stdout, "XTS accepted a 48 byte key\n");
+        failed = 1;
+    }
+
+    key[0] = 0;
+    xts_set_key(&ctx, key, 32);
+    memset(buf, 0, sizeof(buf));
+    if (xts_encrypt_sector(&ctx, 0, buf, 15, buf) != ECRYPT_INVALID_LENGTH) {
+        fprintf(stdout, "XTS accepted a 15 byte sector\n");
+        failed = 1;
+    }
+    if (xts_encrypt_sectors(&ctx, 0, 32, buf, 48, buf) !=
+        ECRYPT_INVALID_LENGTH) {
+        fprintf(stdout, "XTS accepted a partial sector\n");
+        failed = 1;
+    }
+    fprintf(stdout, "%-24s %s\n", "XTS rejects", failed ? "FAILED" : "ok");
+
+    xts_release(&ctx);
+    return failed;
+}